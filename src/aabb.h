@@ -0,0 +1,109 @@
+/**
+ * @file aabb.h
+ * @brief Defines the `aabb` class, an axis-aligned bounding box.
+ *
+ * Bounding boxes are the building block of the bounding volume hierarchy: a ray
+ * that misses a box cannot hit anything inside it, so whole groups of objects
+ * can be skipped with a single cheap slab test.
+ */
+
+#ifndef AABB_H
+#define AABB_H
+
+#include "constants.h"
+#include "interval.h"
+#include "ray.h"
+
+/**
+ * @class aabb
+ * @brief Axis-aligned bounding box stored as one interval per axis.
+ */
+class aabb
+{
+public:
+    interval x, y, z; ///< Extent of the box along each axis
+
+    /**
+     * @brief Default constructor.
+     * Creates an empty box (every interval is empty).
+     */
+    aabb() {}
+
+    /** @brief Constructs a box from the three axis intervals. */
+    aabb(const interval &x, const interval &y, const interval &z) : x(x), y(y), z(z) {}
+
+    /**
+     * @brief Constructs the box spanned by two corner points (in any order).
+     */
+    aabb(const point3 &a, const point3 &b)
+    {
+        x = (a[0] <= b[0]) ? interval(a[0], b[0]) : interval(b[0], a[0]);
+        y = (a[1] <= b[1]) ? interval(a[1], b[1]) : interval(b[1], a[1]);
+        z = (a[2] <= b[2]) ? interval(a[2], b[2]) : interval(b[2], a[2]);
+    }
+
+    /** @brief Constructs the tightest box enclosing two boxes. */
+    aabb(const aabb &box0, const aabb &box1)
+    {
+        x = interval(box0.x, box1.x);
+        y = interval(box0.y, box1.y);
+        z = interval(box0.z, box1.z);
+    }
+
+    /** @brief Returns the interval of axis `n` (0 = x, 1 = y, 2 = z). */
+    const interval &axis_interval(int n) const
+    {
+        if (n == 1)
+            return y;
+        if (n == 2)
+            return z;
+        return x;
+    }
+
+    /** @brief Returns the index of the longest axis of the box. */
+    int longest_axis() const
+    {
+        if (x.size() > y.size())
+            return x.size() > z.size() ? 0 : 2;
+        return y.size() > z.size() ? 1 : 2;
+    }
+
+    /**
+     * @brief Slab test: does the ray pass through the box within `ray_t`?
+     */
+    bool hit(const ray &r, interval ray_t) const
+    {
+        const point3 &ray_orig = r.origin();
+        const vec3 &ray_dir = r.direction();
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const interval &ax = axis_interval(axis);
+            const double adinv = 1.0 / ray_dir[axis];
+
+            auto t0 = (ax.min - ray_orig[axis]) * adinv;
+            auto t1 = (ax.max - ray_orig[axis]) * adinv;
+
+            if (t0 < t1)
+            {
+                if (t0 > ray_t.min)
+                    ray_t.min = t0;
+                if (t1 < ray_t.max)
+                    ray_t.max = t1;
+            }
+            else
+            {
+                if (t1 > ray_t.min)
+                    ray_t.min = t1;
+                if (t0 < ray_t.max)
+                    ray_t.max = t0;
+            }
+
+            if (ray_t.max <= ray_t.min)
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif
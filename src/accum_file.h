@@ -0,0 +1,294 @@
+/**
+ * @file accum_file.h
+ * @brief Compressed accumulation files: checkpoints, sample-range files and tile
+ * results of distributed renders.
+ *
+ * An accumulation file holds the raw per-pixel radiance sums and weights of part of
+ * a render, not the resolved image, so that more samples can be added to it later:
+ *
+ *  - a checkpoint holds the whole image for samples [0, n); a resumed render
+ *    continues with sample n;
+ *  - a sample-range file holds the whole image for samples [a, b), rendered by one
+ *    of several processes that split the sample count;
+ *  - a tile result holds one node's pixel rectangle (widened by the filter border,
+ *    which the node's splats reach) for all samples.
+ *
+ * `read_accumulation` adds a file into a framebuffer, so merging the files of one
+ * render is just reading them in turn. The sums are stored exactly, so a merged
+ * render equals one that accumulated the same passes in one process.
+ *
+ * Layout (all values little-endian):
+ *
+ *     header  "RCACCUM1", uint32 width, height, x0, y0, x1, y1, first_sample,
+ *             samples, block_size, block_count
+ *     table   block_count x (uint32 compressed block size, uint32 Adler-32 of the block)
+ *     blocks  for each block_size square of the rectangle (row by row): the red,
+ *             green and blue sums and the weights, each an `encode_float_stream`
+ *             of doubles in row-major order
+ *
+ * Full 8K double buffers are about a gigabyte, so blocks are compressed and
+ * decompressed on all threads; the codec (float_codec.h) saves about 40%. Raw byte
+ * planes would pass corruption on silently, hence the checksums.
+ */
+
+#ifndef ACCUM_FILE_H
+#define ACCUM_FILE_H
+
+#include "float_codec.h"
+#include "framebuffer.h"
+#include "scene_file.h"
+#include "tile_schedule.h"
+
+#include <atomic>
+#include <chrono>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char accum_file_magic[8] = {'R', 'C', 'A', 'C', 'C', 'U', 'M', '1'};
+static const int accum_block_size = 128; ///< Edge of the independently compressed blocks
+
+/**
+ * @class accum_info
+ * @brief Which part of a render an accumulation file holds.
+ */
+struct accum_info
+{
+    int width = 0, height = 0;  ///< Size of the whole image
+    tile_rect rect{0, 0, 0, 0}; ///< Pixels stored (the whole image except for tile results)
+    int first_sample = 0;       ///< First sample of the range
+    int samples = 0;            ///< Samples per pixel in the range
+
+    /** @brief First sample after the range (where a resumed render continues). */
+    int end_sample() const { return first_sample + samples; }
+};
+
+/**
+ * @class codec_report
+ * @brief Size and speed of writing or reading one accumulation file.
+ */
+struct codec_report
+{
+    uint64_t raw_bytes = 0; ///< Sums and weights uncompressed
+    uint64_t bytes = 0;     ///< File size
+    double seconds = 0;     ///< Compression or decompression time (without I/O)
+
+    double ratio() const { return bytes ? double(raw_bytes) / bytes : 0; }
+    double gigabytes_per_second() const { return seconds > 0 ? raw_bytes / seconds / 1e9 : 0; }
+};
+
+/** @brief Runs `body(block)` for blocks [0, count) on `threads` threads (0 = all). */
+template <typename Body>
+inline void for_each_block(int count, int threads, Body body)
+{
+    if (threads <= 0)
+        threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    std::atomic<int> next{0};
+    auto worker = [&]()
+    {
+        for (int b; (b = next++) < count;)
+            body(b);
+    };
+    std::vector<std::thread> workers;
+    for (int t = 1; t < std::min(threads, count); t++)
+        workers.emplace_back(worker);
+    worker();
+    for (auto &w : workers)
+        w.join();
+}
+
+/** @brief Pixel rectangle of block `b` of `rect`. */
+inline tile_rect accum_block(const tile_rect &rect, int b)
+{
+    int blocks_x = (rect.x1 - rect.x0 + accum_block_size - 1) / accum_block_size;
+    int x0 = rect.x0 + (b % blocks_x) * accum_block_size, y0 = rect.y0 + (b / blocks_x) * accum_block_size;
+    return tile_rect{x0, y0, std::min(x0 + accum_block_size, rect.x1), std::min(y0 + accum_block_size, rect.y1)};
+}
+
+/** @brief Number of blocks `rect` is cut into. */
+inline int accum_block_count(const tile_rect &rect)
+{
+    if (rect.x1 <= rect.x0 || rect.y1 <= rect.y0)
+        return 0;
+    return ((rect.x1 - rect.x0 + accum_block_size - 1) / accum_block_size) *
+           ((rect.y1 - rect.y0 + accum_block_size - 1) / accum_block_size);
+}
+
+/**
+ * @brief Writes `info.rect` of `fb` as an accumulation file.
+ * @param threads Compression threads (0 = all hardware threads).
+ * @param report Receives sizes and compression time when not null.
+ * @return True if every write succeeded.
+ */
+inline bool write_accumulation(std::ostream &out, const framebuffer &fb, const accum_info &info, int threads = 0,
+                               codec_report *report = nullptr)
+{
+    int count = accum_block_count(info.rect);
+    std::vector<std::vector<unsigned char>> blocks(count);
+    std::vector<uint32_t> checksums(count);
+    auto start = std::chrono::steady_clock::now();
+    for_each_block(count, threads,
+                   [&](int b)
+                   {
+                       tile_rect r = accum_block(info.rect, b);
+                       std::vector<double> channel(size_t(r.pixels()));
+                       for (int c = 0; c < 4; c++)
+                       {
+                           size_t k = 0;
+                           for (int j = r.y0; j < r.y1; j++)
+                               for (int i = r.x0; i < r.x1; i++)
+                               {
+                                   size_t idx = fb.index(i, j);
+                                   channel[k++] = c < 3 ? fb.sum[idx][c] : fb.weight[idx];
+                               }
+                           encode_float_stream(channel.data(), channel.size(), blocks[b]);
+                       }
+                       checksums[b] = adler32(blocks[b].data(), blocks[b].size());
+                   });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<unsigned char> header(accum_file_magic, accum_file_magic + 8);
+    for (int v : {info.width, info.height, info.rect.x0, info.rect.y0, info.rect.x1, info.rect.y1, info.first_sample,
+                  info.samples, accum_block_size, count})
+        put_u32(header, uint32_t(v));
+    for (int b = 0; b < count; b++)
+    {
+        put_u32(header, uint32_t(blocks[b].size()));
+        put_u32(header, checksums[b]);
+    }
+    out.write(reinterpret_cast<const char *>(header.data()), header.size());
+    uint64_t bytes = header.size();
+    for (const auto &block : blocks)
+    {
+        out.write(reinterpret_cast<const char *>(block.data()), block.size());
+        bytes += block.size();
+    }
+
+    if (report)
+    {
+        report->raw_bytes = uint64_t(info.rect.pixels()) * 4 * sizeof(double);
+        report->bytes = bytes;
+        report->seconds = seconds;
+    }
+    return bool(out);
+}
+
+/**
+ * @brief Reads an accumulation file and adds its sums and weights into `fb`.
+ *
+ * An empty `fb` is sized to the file's image; otherwise the sizes must match. On
+ * failure `fb` may hold part of the file.
+ *
+ * @param info Receives what the file holds.
+ * @param error Receives a description when reading fails.
+ * @param threads Decompression threads (0 = all hardware threads).
+ * @param report Receives sizes and decompression time when not null.
+ */
+inline bool read_accumulation(std::istream &in, framebuffer &fb, accum_info &info, std::string &error, int threads = 0,
+                              codec_report *report = nullptr)
+{
+    unsigned char header[48];
+    if (!in.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+        std::memcmp(header, accum_file_magic, sizeof(accum_file_magic)) != 0)
+    {
+        error = "not a RayCraft accumulation file";
+        return false;
+    }
+    int v[10];
+    for (int k = 0; k < 10; k++)
+        v[k] = int(get_u32(header + 8 + 4 * k));
+    info.width = v[0];
+    info.height = v[1];
+    info.rect = tile_rect{v[2], v[3], v[4], v[5]};
+    info.first_sample = v[6];
+    info.samples = v[7];
+    int count = v[9];
+    const tile_rect &r = info.rect;
+    if (info.width <= 0 || info.height <= 0 || info.width > 1 << 16 || info.height > 1 << 16 || r.x0 < 0 ||
+        r.y0 < 0 || r.x1 > info.width || r.y1 > info.height || r.x0 > r.x1 || r.y0 > r.y1 ||
+        v[8] != accum_block_size || count != accum_block_count(r) || info.first_sample < 0 || info.samples < 0)
+    {
+        error = "inconsistent accumulation file header";
+        return false;
+    }
+    if (fb.width == 0 && fb.height == 0)
+        fb.resize(info.width, info.height);
+    else if (fb.width != info.width || fb.height != info.height)
+    {
+        error = "image is " + std::to_string(info.width) + "x" + std::to_string(info.height) + ", expected " +
+                std::to_string(fb.width) + "x" + std::to_string(fb.height);
+        return false;
+    }
+
+    std::vector<unsigned char> table(size_t(count) * 8);
+    if (!in.read(reinterpret_cast<char *>(table.data()), table.size()))
+    {
+        error = "truncated block table";
+        return false;
+    }
+    std::vector<std::vector<unsigned char>> blocks(count);
+    uint64_t bytes = sizeof(header) + table.size();
+    for (int b = 0; b < count; b++)
+    {
+        // Compressed blocks are never much larger than raw ones; reject absurd sizes
+        // before allocating them
+        uint32_t size = get_u32(table.data() + 8 * b);
+        if (size > uint64_t(accum_block(r, b).pixels()) * 4 * (sizeof(double) + 1) + 64)
+        {
+            error = "block " + std::to_string(b) + " has an impossible size";
+            return false;
+        }
+        blocks[b].resize(size);
+        if (!in.read(reinterpret_cast<char *>(blocks[b].data()), size))
+        {
+            error = "truncated block " + std::to_string(b);
+            return false;
+        }
+        bytes += size;
+    }
+
+    std::atomic<int> damaged{-1};
+    auto start = std::chrono::steady_clock::now();
+    for_each_block(count, threads,
+                   [&](int b)
+                   {
+                       tile_rect t = accum_block(r, b);
+                       size_t n = size_t(t.pixels());
+                       std::vector<double> channels(4 * n);
+                       const unsigned char *p = blocks[b].data(), *end = p + blocks[b].size();
+                       if (adler32(p, blocks[b].size()) != get_u32(table.data() + 8 * b + 4))
+                       {
+                           damaged = b;
+                           return;
+                       }
+                       for (int c = 0; c < 4; c++)
+                           if (!decode_float_stream(p, end, channels.data() + c * n, n))
+                           {
+                               damaged = b;
+                               return;
+                           }
+                       // Blocks cover disjoint pixels, so they are added concurrently
+                       size_t k = 0;
+                       for (int j = t.y0; j < t.y1; j++)
+                           for (int i = t.x0; i < t.x1; i++, k++)
+                               fb.add_weighted(i, j, color(channels[k], channels[n + k], channels[2 * n + k]),
+                                               channels[3 * n + k]);
+                   });
+    if (damaged >= 0)
+    {
+        error = "block " + std::to_string(damaged.load()) + " is damaged";
+        return false;
+    }
+
+    if (report)
+    {
+        report->raw_bytes = uint64_t(r.pixels()) * 4 * sizeof(double);
+        report->bytes = bytes;
+        report->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return true;
+}
+
+#endif
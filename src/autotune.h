@@ -0,0 +1,265 @@
+/**
+ * @file autotune.h
+ * @brief Calibrates render settings for the current machine and persists them.
+ *
+ * The best tile size, BVH leaf size and thread count depend on cache sizes, core
+ * count and SMT, so one set of defaults cannot be right everywhere. The tuner runs
+ * short calibration renders over a grid of candidates using successive halving:
+ * every round renders all surviving candidates, keeps the faster half and doubles
+ * the samples per pixel (up to a cap), so most of the time goes to the promising
+ * settings.
+ *
+ * The winner is stored in a per-machine profile (keyed by CPU model, hardware
+ * thread count and host name) that later renders load automatically.
+ */
+
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include "camera.h"
+#include "constants.h"
+#include "hittable.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @class tuning_profile
+ * @brief Render settings tuned for one machine.
+ */
+struct tuning_profile
+{
+    int tile_size = 16; ///< camera::tile_size
+    int leaf_size = 4;  ///< Maximum primitives per BVH leaf
+    int threads = 0;    ///< camera::num_threads (0 = all hardware threads)
+
+    std::string describe() const
+    {
+        std::ostringstream s;
+        s << "tile " << tile_size << ", leaf " << leaf_size << ", threads "
+          << (threads > 0 ? std::to_string(threads) : std::string("auto"));
+        return s.str();
+    }
+};
+
+/**
+ * @brief Returns a string identifying this machine: CPU model, hardware thread
+ * count and host name.
+ */
+inline std::string machine_id()
+{
+    std::string model = "unknown-cpu";
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line))
+    {
+        if (line.compare(0, 10, "model name") == 0 && line.find(':') != std::string::npos)
+        {
+            model = line.substr(line.find(':') + 2);
+            break;
+        }
+    }
+
+    char host[256] = "unknown-host";
+    gethostname(host, sizeof(host) - 1);
+    return model + " / " + std::to_string(std::thread::hardware_concurrency()) + " threads / " + host;
+}
+
+/**
+ * @brief Returns the default profile location for this machine.
+ *
+ * `$RAYCRAFT_PROFILE` if set, otherwise
+ * `$XDG_CONFIG_HOME/raycraft/profile-<machine hash>.txt` (falling back to
+ * `~/.config`). The hash keeps profiles apart when the home directory is shared
+ * between machines.
+ */
+inline std::string default_profile_path()
+{
+    if (const char *path = std::getenv("RAYCRAFT_PROFILE"))
+        return path;
+
+    std::string dir;
+    if (const char *xdg = std::getenv("XDG_CONFIG_HOME"))
+        dir = xdg;
+    else if (const char *home = std::getenv("HOME"))
+        dir = std::string(home) + "/.config";
+    else
+        dir = ".";
+
+    std::ostringstream name;
+    name << dir << "/raycraft/profile-" << std::hex << (std::hash<std::string>()(machine_id()) & 0xffffffffu) << ".txt";
+    return name.str();
+}
+
+/**
+ * @brief Loads a profile; fails if the file is missing or was made on another machine.
+ */
+inline bool load_profile(const std::string &path, tuning_profile &profile)
+{
+    std::ifstream in(path);
+    if (!in)
+        return false;
+
+    std::map<std::string, std::string> values;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        auto space = line.find(' ');
+        if (space != std::string::npos)
+            values[line.substr(0, space)] = line.substr(space + 1);
+    }
+    if (values["machine"] != machine_id())
+        return false;
+
+    tuning_profile p;
+    p.tile_size = std::atoi(values["tile_size"].c_str());
+    p.leaf_size = std::atoi(values["leaf_size"].c_str());
+    p.threads = std::atoi(values["threads"].c_str());
+    if (p.tile_size < 1 || p.leaf_size < 1 || p.threads < 0)
+        return false;
+    profile = p;
+    return true;
+}
+
+/**
+ * @brief Writes a profile, creating its directory if needed.
+ * @param gain Measured speedup over the defaults, recorded as a comment.
+ */
+inline bool save_profile(const std::string &path, const tuning_profile &profile, double gain)
+{
+    // Create missing parent directories (one level of ~/.config/raycraft at most in practice)
+    for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1))
+        mkdir(path.substr(0, slash).c_str(), 0755);
+
+    std::ofstream out(path);
+    out << "# RayCraft tuning profile, written by --autotune (" << gain << "x over defaults)\n"
+        << "machine " << machine_id() << "\n"
+        << "tile_size " << profile.tile_size << "\n"
+        << "leaf_size " << profile.leaf_size << "\n"
+        << "threads " << profile.threads << "\n";
+    return bool(out);
+}
+
+static const double autotune_noise_margin = 0.03; ///< Speedup over the defaults that counts as noise
+
+/**
+ * @class autotune_result
+ * @brief Outcome of a tuning run.
+ */
+struct autotune_result
+{
+    tuning_profile best;
+    double best_seconds = 0;    ///< Final calibration render time of the winner
+    double default_seconds = 0; ///< Same render with the default settings
+    int renders = 0;            ///< Calibration renders performed
+
+    double gain() const { return best_seconds > 0 ? default_seconds / best_seconds : 1; }
+};
+
+/**
+ * @brief Tunes tile size, BVH leaf size and thread count by successive halving.
+ *
+ * @param cam Camera with the view and image size to calibrate for (its sample count
+ * is ignored).
+ * @param prepare Builds the scene with the given BVH leaf size and returns it; the
+ * reference must stay valid until the next call.
+ * @param start_spp Samples per pixel of the first round.
+ * @param max_spp Cap on the samples per pixel of later rounds (keeps tuning short).
+ */
+inline autotune_result autotune(camera cam, const std::function<const hittable &(int leaf_size)> &prepare,
+                                int start_spp = 1, int max_spp = 8)
+{
+    int hw = int(std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<int> thread_options;
+    for (int t = hw; t >= 1 && thread_options.size() < 3; t /= 2)
+        thread_options.push_back(t);
+    thread_options.push_back(2 * hw); // oversubscription hides imbalance between tiles
+
+    std::vector<tuning_profile> candidates;
+    for (int tile : {8, 16, 32, 64})
+        for (int leaf : {1, 2, 4, 8, 16})
+            for (int threads : thread_options)
+                candidates.push_back(tuning_profile{tile, leaf, threads});
+
+    autotune_result result;
+    cam.show_progress = false;
+    cam.stats = nullptr;
+    cam.cost = nullptr;
+
+    int built_leaf = -1;
+    const hittable *world = nullptr;
+    auto time_render = [&](const tuning_profile &p, int spp)
+    {
+        if (p.leaf_size != built_leaf)
+        {
+            world = &prepare(p.leaf_size);
+            built_leaf = p.leaf_size;
+        }
+        cam.tile_size = p.tile_size;
+        cam.num_threads = p.threads;
+        framebuffer fb;
+        auto start = std::chrono::steady_clock::now();
+        cam.render_pass(*world, fb, 0, spp);
+        result.renders++;
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    int spp = std::max(1, start_spp);
+    std::vector<double> seconds;
+    while (candidates.size() > 1)
+    {
+        // Group by leaf size so the scene is rebuilt at most once per leaf size and round
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](const tuning_profile &a, const tuning_profile &b) { return a.leaf_size < b.leaf_size; });
+        seconds.clear();
+        for (const auto &c : candidates)
+            seconds.push_back(time_render(c, spp));
+
+        std::vector<size_t> order(candidates.size());
+        for (size_t n = 0; n < order.size(); n++)
+            order[n] = n;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return seconds[a] < seconds[b]; });
+
+        std::clog << "  " << candidates.size() << " candidates at " << spp << " spp, fastest: "
+                  << candidates[order[0]].describe() << " (" << seconds[order[0]] << " s)\n";
+
+        std::vector<tuning_profile> survivors;
+        for (size_t n = 0; n < (candidates.size() + 1) / 2; n++)
+            survivors.push_back(candidates[order[n]]);
+        candidates = survivors;
+        spp = std::min(2 * spp, std::max(max_spp, spp));
+    }
+    result.best = candidates[0];
+
+    // Compare against the defaults at the final budget, best of three to damp noise
+    tuning_profile defaults;
+    defaults.threads = hw;
+    result.best_seconds = result.default_seconds = infinity;
+    for (int repeat = 0; repeat < 3; repeat++)
+    {
+        result.default_seconds = std::min(result.default_seconds, time_render(defaults, spp));
+        result.best_seconds = std::min(result.best_seconds, time_render(result.best, spp));
+    }
+
+    // Within noise of the defaults: keep the defaults rather than a lucky winner
+    if (result.best_seconds * (1 + autotune_noise_margin) >= result.default_seconds)
+    {
+        result.best = defaults;
+        result.best_seconds = result.default_seconds;
+    }
+    return result;
+}
+
+#endif
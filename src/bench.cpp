@@ -0,0 +1,675 @@
+/**
+ * @file bench.cpp
+ * @brief Performance regression harness for the renderer.
+ *
+ * Renders the random spheres scene from `main.cpp` over a fixed matrix of image
+ * sizes, samples per pixel and ray depths, N times each, and records the
+ * distribution of rays per second. Results can be saved as a baseline file and
+ * later runs compared against it with Welch's t-test; a configuration regresses
+ * when its mean throughput dropped by more than the threshold *and* the drop is
+ * statistically significant. Runs entirely locally.
+ *
+ * Usage:
+ * @code
+ * raycraft_bench --save-baseline bench_baseline.txt
+ * ... change code, rebuild ...
+ * raycraft_bench --baseline bench_baseline.txt --json bench.json
+ * @endcode
+ *
+ * Exit status: 0 when no configuration regressed, 1 on a regression, 2 on
+ * usage or I/O errors.
+ *
+ * With `--converge SECONDS` the harness instead runs the equal-time convergence
+ * benchmark: every configuration (accel x sampler x integrator x thread count) renders the
+ * same scene progressively for the same wall clock budget, and the error against
+ * a high-spp reference is recorded after every pass. Comparing at equal spp hides
+ * differences in cost per sample; error at equal time is what matters.
+ *
+ * With `--png` it measures the PNG encoder instead: a frame is rendered once and
+ * encoded with each thread count of `--threads-list`, reporting MB/s of raw pixels
+ * and the speed-up over single-threaded encoding, plus the row filters alone with
+ * and without SIMD.
+ */
+
+#include "bvh.h"
+#include "constants.h"
+#include "hittable_list.h"
+#include "image_metrics.h"
+#include "png_encoder.h"
+#include "scenes.h"
+#include "statistics.h"
+
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @class bench_config
+ * @brief One entry of the benchmark matrix.
+ */
+struct bench_config
+{
+    int width;
+    int spp;
+    int depth;
+
+    /** @brief Stable key used in baseline files. */
+    std::string name() const
+    {
+        return "w" + std::to_string(width) + "_spp" + std::to_string(spp) + "_d" + std::to_string(depth);
+    }
+};
+
+/**
+ * @class bench_result
+ * @brief Measurements of one configuration.
+ */
+struct bench_result
+{
+    bench_config config;
+    std::vector<double> rays_per_sec; ///< One value per timed run
+    render_stats stats;               ///< Counters summed over all timed runs
+};
+
+/** @brief The fixed scene matrix: two sizes x two sample counts x two depths. */
+inline std::vector<bench_config> bench_matrix(bool quick)
+{
+    std::vector<bench_config> configs;
+    for (int width : {96, 192})
+        for (int spp : {2, 8})
+            for (int depth : {5, 50})
+                configs.push_back(bench_config{quick ? width / 2 : width, spp, depth});
+    return configs;
+}
+
+/** @brief Renders `config` once and returns rays per second; counters accumulate into `stats`. */
+inline double bench_run(const hittable &world, const bench_config &config, int threads, render_stats &stats)
+{
+    camera cam;
+    random_spheres_view(cam);
+    cam.image_width = config.width;
+    cam.max_depth = config.depth;
+    cam.num_threads = threads;
+    cam.show_progress = false;
+    cam.stats = &stats;
+
+    auto pass_totals = [&]()
+    {
+        auto p = stats.phases.find("render pass");
+        auto w = stats.phase_wall.find("render pass");
+        return std::make_pair(p == stats.phases.end() ? 0.0 : double(p->second.work.rays),
+                              w == stats.phase_wall.end() ? 0.0 : w->second);
+    };
+
+    auto before = pass_totals();
+    framebuffer fb;
+    cam.render_pass(world, fb, 0, config.spp);
+    auto after = pass_totals();
+
+    return (after.first - before.first) / (after.second - before.second);
+}
+
+/**
+ * @brief Loads a baseline file.
+ *
+ * Format: one configuration per line, `<name> <rays_per_sec> <rays_per_sec> ...`;
+ * lines starting with '#' are comments.
+ */
+inline bool load_baseline(const std::string &path, std::map<std::string, std::vector<double>> &baseline)
+{
+    std::ifstream in(path);
+    if (!in)
+        return false;
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        std::string name;
+        fields >> name;
+        double v;
+        while (fields >> v)
+            baseline[name].push_back(v);
+    }
+    return true;
+}
+
+/** @brief Writes results in the baseline file format. */
+inline bool save_baseline(const std::string &path, const std::deque<bench_result> &results)
+{
+    std::ofstream out(path);
+    if (!out)
+        return false;
+
+    out << "# RayCraft benchmark baseline: <config> <rays/sec per run...>\n";
+    out.precision(10);
+    for (const auto &r : results)
+    {
+        out << r.config.name();
+        for (double v : r.rays_per_sec)
+            out << ' ' << v;
+        out << '\n';
+    }
+    return true;
+}
+
+/**
+ * @class converge_config
+ * @brief One candidate configuration of the equal-time convergence benchmark.
+ */
+struct converge_config
+{
+    bool use_bvh; ///< Trace against the BVH instead of the plain object list
+    sampler_type sampler;
+    integrator_type integrator;
+    int threads;
+
+    std::string name() const
+    {
+        return std::string(use_bvh ? "bvh/" : "list/") +
+               (sampler == sampler_type::stratified ? "stratified" : "independent") + "/" +
+               (integrator == integrator_type::russian_roulette ? "russian_roulette" : "recursive") + "/t" +
+               std::to_string(threads);
+    }
+};
+
+/**
+ * @class converge_point
+ * @brief Error of a progressive render after one pass.
+ */
+struct converge_point
+{
+    double seconds; ///< Render time so far (excluding error evaluation)
+    int spp;        ///< Samples per pixel accumulated so far
+    double mse;
+    double relmse;
+};
+
+/** @brief Returns a camera set up for the convergence scene. */
+inline camera converge_camera(int width, int depth)
+{
+    camera cam;
+    material_spheres_view(cam);
+    cam.image_width = width;
+    cam.max_depth = depth;
+    cam.show_progress = false;
+    return cam;
+}
+
+/**
+ * @brief Renders `config` progressively until the next pass would exceed `budget`.
+ *
+ * Passes of `pass_spp` samples are accumulated into one framebuffer; after each
+ * pass the clock is paused while the error against `ref` is measured.
+ */
+inline std::vector<converge_point> converge_run(const hittable_list &list, const bvh &accel,
+                                                const converge_config &config,
+                                                const float_image &ref, int width, int depth,
+                                                int pass_spp, double budget)
+{
+    camera cam = converge_camera(width, depth);
+    cam.sampler = config.sampler;
+    cam.integrator = config.integrator;
+    cam.num_threads = config.threads;
+    cam.seed = 7;
+
+    std::vector<converge_point> curve;
+    framebuffer fb;
+    double elapsed = 0, last_pass = 0;
+    int spp = 0;
+
+    while (elapsed + last_pass <= budget || spp == 0)
+    {
+        auto start = std::chrono::steady_clock::now();
+        cam.render_pass(config.use_bvh ? static_cast<const hittable &>(accel) : list, fb, spp, pass_spp);
+        std::chrono::duration<double> pass_time = std::chrono::steady_clock::now() - start;
+
+        last_pass = pass_time.count();
+        elapsed += last_pass;
+        spp += pass_spp;
+
+        float_image img = fb.resolved();
+        curve.push_back(converge_point{elapsed, spp, image_mse(img, ref), image_relmse(img, ref)});
+    }
+    return curve;
+}
+
+/** @brief Splits a comma separated list. */
+inline std::vector<std::string> split_list(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::istringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+/**
+ * @brief Entry point of the equal-time convergence benchmark (`--converge SECONDS`).
+ */
+inline int converge_main(double budget, int argc, char *argv[])
+{
+    int width = 160, depth = 20, pass_spp = 4, reference_spp = 2048;
+    std::string reference_path = "converge_reference.pfm", csv_path, json_path;
+    std::vector<std::string> accels = {"bvh"};
+    std::vector<std::string> samplers = {"independent", "stratified"};
+    std::vector<std::string> integrators = {"recursive", "russian_roulette"};
+    std::vector<int> thread_counts = {int(std::max(1u, std::thread::hardware_concurrency()))};
+
+    for (int n = 1; n < argc; n++)
+    {
+        std::string arg = argv[n];
+        bool has_value = n + 1 < argc;
+        if (arg == "--converge" && has_value)
+            n++;
+        else if (arg == "--width" && has_value)
+            width = std::atoi(argv[++n]);
+        else if (arg == "--depth" && has_value)
+            depth = std::atoi(argv[++n]);
+        else if (arg == "--pass-spp" && has_value)
+            pass_spp = std::atoi(argv[++n]);
+        else if (arg == "--reference" && has_value)
+            reference_path = argv[++n];
+        else if (arg == "--reference-spp" && has_value)
+            reference_spp = std::atoi(argv[++n]);
+        else if (arg == "--csv" && has_value)
+            csv_path = argv[++n];
+        else if (arg == "--json" && has_value)
+            json_path = argv[++n];
+        else if (arg == "--accels" && has_value)
+            accels = split_list(argv[++n]);
+        else if (arg == "--samplers" && has_value)
+            samplers = split_list(argv[++n]);
+        else if (arg == "--integrators" && has_value)
+            integrators = split_list(argv[++n]);
+        else if (arg == "--threads-list" && has_value)
+        {
+            thread_counts.clear();
+            for (const auto &t : split_list(argv[++n]))
+                thread_counts.push_back(std::atoi(t.c_str()));
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " --converge SECONDS [--width N] [--depth N] [--pass-spp N]\n"
+                         "       [--reference FILE.pfm] [--reference-spp N] [--csv FILE] [--json FILE]\n"
+                         "       [--samplers independent,stratified] [--integrators recursive,russian_roulette]\n"
+                         "       [--accels list,bvh] [--threads-list 1,2,4]\n";
+            return 2;
+        }
+    }
+
+    std::vector<converge_config> configs;
+    for (const auto &accel : accels)
+    {
+        for (const auto &sampler : samplers)
+        {
+            for (const auto &integrator : integrators)
+            {
+                for (int threads : thread_counts)
+                {
+                    if ((accel != "list" && accel != "bvh") || (sampler != "independent" && sampler != "stratified") ||
+                        (integrator != "recursive" && integrator != "russian_roulette") || threads < 1)
+                    {
+                        std::cerr << "Unknown configuration " << accel << "/" << sampler << "/" << integrator << "/t"
+                                  << threads << "\n";
+                        return 2;
+                    }
+                    configs.push_back(converge_config{
+                        accel == "bvh",
+                        sampler == "stratified" ? sampler_type::stratified : sampler_type::independent,
+                        integrator == "russian_roulette" ? integrator_type::russian_roulette
+                                                         : integrator_type::recursive,
+                        threads});
+                }
+            }
+        }
+    }
+
+    hittable_list world = material_spheres_scene();
+    bvh accel(world);
+
+    // Reuse the reference when it was rendered with the same settings, otherwise render
+    // it; the PFM header holds only the size, so the settings are kept next to it
+    float_image ref;
+    {
+        camera cam = converge_camera(width, depth);
+        cam.prepare();
+        std::ostringstream settings;
+        settings << "width " << width << " height " << cam.height() << " spp " << reference_spp << " depth " << depth;
+        std::string settings_path = reference_path + ".settings", saved;
+        std::ifstream saved_settings(settings_path);
+        std::getline(saved_settings, saved);
+        std::ifstream in(reference_path, std::ios::binary);
+        if (!read_pfm(in, ref) || ref.width != width || ref.height != cam.height() || saved != settings.str())
+        {
+            std::clog << "Rendering reference at " << reference_spp << " spp...\n";
+            cam.sampler = sampler_type::stratified;
+            cam.seed = 0x5eedf00dULL;
+            framebuffer fb;
+            for (int spp = 0; spp < reference_spp; spp += 64)
+                cam.render_pass(accel, fb, spp, std::min(64, reference_spp - spp));
+            ref = fb.resolved();
+            std::ofstream out(reference_path, std::ios::binary);
+            write_pfm(out, ref);
+            std::ofstream(settings_path) << settings.str() << "\n";
+        }
+    }
+
+    std::ofstream csv;
+    if (!csv_path.empty())
+    {
+        csv.open(csv_path);
+        csv << "config,seconds,spp,mse,relmse\n";
+    }
+
+    std::ostringstream json;
+    json << "{\"budget_seconds\":" << budget << ",\"width\":" << width << ",\"depth\":" << depth
+         << ",\"pass_spp\":" << pass_spp << ",\"configs\":[";
+
+    std::clog << "Equal-time convergence, " << budget << " s per configuration\n";
+    double best_relmse = 0;
+    std::string best;
+    for (size_t c = 0; c < configs.size(); c++)
+    {
+        auto curve = converge_run(world, accel, configs[c], ref, width, depth, pass_spp, budget);
+        const auto &last = curve.back();
+        std::string name = configs[c].name();
+
+        // relMSE * time is the inverse efficiency: lower means less error for the same time
+        std::clog << "  " << name << ": " << last.spp << " spp in " << last.seconds << " s, relMSE "
+                  << last.relmse << ", relMSE x time " << last.relmse * last.seconds << "\n";
+        if (best.empty() || last.relmse < best_relmse)
+        {
+            best = name;
+            best_relmse = last.relmse;
+        }
+
+        json << (c ? "," : "") << "{\"name\":\"" << name << "\",\"final_spp\":" << last.spp
+             << ",\"final_seconds\":" << last.seconds << ",\"final_relmse\":" << last.relmse
+             << ",\"final_mse\":" << last.mse << ",\"curve\":[";
+        for (size_t k = 0; k < curve.size(); k++)
+        {
+            const auto &p = curve[k];
+            json << (k ? "," : "") << "[" << p.seconds << "," << p.spp << "," << p.mse << "," << p.relmse << "]";
+            if (csv.is_open())
+                csv << name << ',' << p.seconds << ',' << p.spp << ',' << p.mse << ',' << p.relmse << '\n';
+        }
+        json << "]}";
+    }
+    json << "],\"best\":\"" << best << "\"}\n";
+    std::clog << "Lowest error at equal time: " << best << "\n";
+
+    if (!json_path.empty())
+    {
+        std::ofstream out(json_path);
+        out << json.str();
+    }
+    return 0;
+}
+
+/**
+ * @brief Entry point of the PNG encoder benchmark (`--png`).
+ */
+inline int png_main(int argc, char *argv[])
+{
+    int width = 1920, spp = 1, runs = 3;
+    std::vector<int> thread_counts = {1};
+    int all_threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    if (all_threads > 1)
+        thread_counts.push_back(all_threads);
+    std::string output_path;
+
+    for (int n = 1; n < argc; n++)
+    {
+        std::string arg = argv[n];
+        bool has_value = n + 1 < argc;
+        if (arg == "--png")
+            continue;
+        else if (arg == "--width" && has_value)
+            width = std::atoi(argv[++n]);
+        else if (arg == "--spp" && has_value)
+            spp = std::atoi(argv[++n]);
+        else if (arg == "--runs" && has_value)
+            runs = std::atoi(argv[++n]);
+        else if (arg == "--output" && has_value)
+            output_path = argv[++n];
+        else if (arg == "--threads-list" && has_value)
+        {
+            thread_counts.clear();
+            for (const auto &t : split_list(argv[++n]))
+                thread_counts.push_back(std::atoi(t.c_str()));
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " --png [--width N] [--spp N] [--runs N] [--threads-list 1,8]\n"
+                         "       [--output FILE.png]\n";
+            return 2;
+        }
+    }
+    if (width < 1 || spp < 1 || runs < 1 || thread_counts.empty() ||
+        *std::min_element(thread_counts.begin(), thread_counts.end()) < 1)
+    {
+        std::cerr << "--width, --spp, --runs and the thread counts must be positive\n";
+        return 2;
+    }
+
+    hittable_list world = random_spheres_scene();
+    bvh accel(world);
+    camera cam;
+    random_spheres_view(cam);
+    cam.image_width = width;
+    cam.samples_per_pixel = spp;
+    cam.max_depth = 10;
+    cam.show_progress = false;
+    cam.prepare();
+    framebuffer fb;
+    cam.render_pass(accel, fb, 0, spp);
+
+    int height = fb.height;
+    std::vector<unsigned char> rgb = fb.resolved_rgb8();
+    double megabytes = rgb.size() / 1e6;
+    std::clog << "PNG encoding of a " << width << "x" << height << " frame at " << spp << " spp ("
+              << megabytes << " MB raw), best of " << runs << " runs\n";
+
+    // Row filters alone: the per-row filter selection with and without SIMD
+    std::vector<unsigned char> filtered((size_t(width) * 3 + 1) * height);
+    for (bool simd : {false, true})
+    {
+        double best = 0;
+        for (int r = 0; r < runs; r++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            png_filter_rows(rgb.data(), size_t(width) * 3, 0, height, 3, filtered.data(), simd);
+            std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+            best = r == 0 ? took.count() : std::min(best, took.count());
+        }
+        std::clog << "  filters " << (simd ? "simd  " : "scalar") << ": " << megabytes / best << " MB/s\n";
+    }
+
+    double single = 0;
+    std::string png;
+    for (int threads : thread_counts)
+    {
+        png_encode_stats best;
+        for (int r = 0; r < runs; r++)
+        {
+            png_encode_stats stats;
+            png = encode_png(rgb.data(), width, height, threads, &stats);
+            if (r == 0 || stats.seconds < best.seconds)
+                best = stats;
+        }
+        if (threads == 1)
+            single = best.seconds;
+        std::clog << "  " << threads << " thread" << (threads > 1 ? "s" : " ") << ": " << best.megabytes_per_second()
+                  << " MB/s, " << best.png_bytes / 1e6 << " MB (" << 100.0 * best.png_bytes / best.raw_bytes
+                  << "%), " << best.groups << " row groups";
+        if (single > 0 && threads > 1)
+            std::clog << ", " << single / best.seconds << "x single-threaded";
+        std::clog << "\n";
+    }
+
+    if (!output_path.empty())
+    {
+        std::ofstream out(output_path, std::ios::binary);
+        out.write(png.data(), std::streamsize(png.size()));
+        if (!out)
+        {
+            std::cerr << "Cannot write " << output_path << "\n";
+            return 2;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    for (int n = 1; n + 1 < argc; n++)
+        if (!std::strcmp(argv[n], "--converge"))
+            return converge_main(std::atof(argv[n + 1]), argc, argv);
+    for (int n = 1; n < argc; n++)
+        if (!std::strcmp(argv[n], "--png"))
+            return png_main(argc, argv);
+
+    int runs = 5;
+    int threads = 0;
+    double threshold = 0.05; // relative slowdown that counts as a regression
+    double alpha = 0.01;     // significance level of the one-sided test
+    bool quick = false;
+    bool use_counters = true;
+    std::string baseline_path, save_path, json_path;
+
+    for (int n = 1; n < argc; n++)
+    {
+        if (!std::strcmp(argv[n], "--runs") && n + 1 < argc)
+            runs = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--threads") && n + 1 < argc)
+            threads = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--threshold") && n + 1 < argc)
+            threshold = std::atof(argv[++n]);
+        else if (!std::strcmp(argv[n], "--alpha") && n + 1 < argc)
+            alpha = std::atof(argv[++n]);
+        else if (!std::strcmp(argv[n], "--baseline") && n + 1 < argc)
+            baseline_path = argv[++n];
+        else if (!std::strcmp(argv[n], "--save-baseline") && n + 1 < argc)
+            save_path = argv[++n];
+        else if (!std::strcmp(argv[n], "--json") && n + 1 < argc)
+            json_path = argv[++n];
+        else if (!std::strcmp(argv[n], "--quick"))
+            quick = true;
+        else if (!std::strcmp(argv[n], "--no-counters"))
+            use_counters = false;
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--runs N] [--threads N] [--quick] [--no-counters]\n"
+                         "       [--baseline FILE] [--threshold FRACTION] [--alpha P]\n"
+                         "       [--save-baseline FILE] [--json FILE]\n"
+                         "       " << argv[0] << " --converge SECONDS ... (equal-time convergence mode)\n"
+                         "       " << argv[0] << " --png ... (PNG encoder throughput)\n";
+            return 2;
+        }
+    }
+    if (runs < 2)
+    {
+        std::cerr << "--runs must be at least 2 for the significance test\n";
+        return 2;
+    }
+
+    std::map<std::string, std::vector<double>> baseline;
+    if (!baseline_path.empty() && !load_baseline(baseline_path, baseline))
+    {
+        std::cerr << "Cannot read baseline " << baseline_path << "\n";
+        return 2;
+    }
+
+    // Same acceleration structure as the renderer
+    bvh world(random_spheres_scene());
+
+    std::deque<bench_result> results; // deque: render_stats is not movable
+    for (const auto &config : bench_matrix(quick))
+    {
+        results.emplace_back();
+        bench_result &result = results.back();
+        result.config = config;
+        result.stats.use_counters = use_counters;
+
+        // One untimed warm-up run to settle caches and CPU frequency
+        render_stats warmup;
+        warmup.use_counters = false;
+        bench_run(world, config, threads, warmup);
+
+        for (int run = 0; run < runs; run++)
+            result.rays_per_sec.push_back(bench_run(world, config, threads, result.stats));
+
+        std::clog << config.name() << ": " << sample_mean(result.rays_per_sec) / 1e6 << " Mrays/s"
+                  << " (sd " << std::sqrt(sample_variance(result.rays_per_sec)) / 1e6 << ")\n";
+    }
+
+    // Compare against the baseline
+    bool regressed = false;
+    std::ostringstream json;
+    json << "{\"runs\":" << runs << ",\"threshold\":" << threshold << ",\"alpha\":" << alpha << ",\"configs\":[";
+
+    for (size_t n = 0; n < results.size(); n++)
+    {
+        const auto &r = results[n];
+        double mean = sample_mean(r.rays_per_sec);
+
+        json << (n ? "," : "") << "{\"name\":\"" << r.config.name() << "\",\"width\":" << r.config.width
+             << ",\"spp\":" << r.config.spp << ",\"depth\":" << r.config.depth << ",\"rays_per_sec\":[";
+        for (size_t k = 0; k < r.rays_per_sec.size(); k++)
+            json << (k ? "," : "") << r.rays_per_sec[k];
+        json << "],\"mean\":" << mean << ",\"stddev\":" << std::sqrt(sample_variance(r.rays_per_sec));
+
+        auto base = baseline.find(r.config.name());
+        if (base != baseline.end())
+        {
+            double base_mean = sample_mean(base->second);
+            double change = base_mean > 0 ? mean / base_mean - 1 : 0;
+            welch_result test = welch_t_test(base->second, r.rays_per_sec);
+            bool regression = change < -threshold && test.p_less < alpha;
+            regressed |= regression;
+
+            std::clog << (regression ? "REGRESSION " : "ok         ") << r.config.name() << ": "
+                      << (change >= 0 ? "+" : "") << 100 * change << "% (p=" << test.p_less << ")\n";
+
+            json << ",\"baseline_mean\":" << base_mean << ",\"change\":" << change
+                 << ",\"p_value\":" << test.p_less << ",\"regression\":" << (regression ? "true" : "false");
+        }
+        else if (!baseline.empty())
+            std::clog << "new        " << r.config.name() << ": not in baseline\n";
+
+        json << ",\"stats\":";
+        r.stats.write_json(json);
+        json << '}';
+    }
+    json << "],\"regression\":" << (regressed ? "true" : "false") << "}\n";
+
+    if (!json_path.empty())
+    {
+        std::ofstream out(json_path);
+        out << json.str();
+        if (!out)
+        {
+            std::cerr << "Cannot write " << json_path << "\n";
+            return 2;
+        }
+    }
+
+    if (!save_path.empty() && !save_baseline(save_path, results))
+    {
+        std::cerr << "Cannot write baseline " << save_path << "\n";
+        return 2;
+    }
+
+    return regressed ? 1 : 0;
+}
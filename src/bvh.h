@@ -0,0 +1,464 @@
+/**
+ * @file bvh.h
+ * @brief Bounding volume hierarchy over scene primitives.
+ *
+ * A linear scan of `hittable_list` costs one intersection test per object per ray,
+ * which is fine for the ~500 spheres of the random spheres scene but hopeless for
+ * generated scenes with millions of primitives. The BVH groups primitives into a
+ * tree of bounding boxes so a ray only tests the few leaves it actually passes
+ * through.
+ *
+ * The tree itself (`bvh_tree`) only sees boxes and primitive indices, so the same
+ * code accelerates a list of `hittable` objects (`bvh`) and the packed sphere
+ * storage of generated scenes (`sphere_set`).
+ *
+ * Layout: nodes live in one flat array in depth-first order. An interior node's
+ * left child directly follows it and `first` holds the index of the right child;
+ * a leaf's `first`/`count` select a range of the `indices` array. Nodes store
+ * float bounds (rounded outwards) so a node fits in 32 bytes.
+ */
+
+#ifndef BVH_H
+#define BVH_H
+
+#include "constants.h"
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/**
+ * @class bvh_box
+ * @brief Compact single precision bounding box used while building the tree.
+ */
+struct bvh_box
+{
+    float lo[3] = {+std::numeric_limits<float>::infinity(), +std::numeric_limits<float>::infinity(),
+                   +std::numeric_limits<float>::infinity()};
+    float hi[3] = {-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+                   -std::numeric_limits<float>::infinity()};
+
+    /** @brief Grows the box to enclose `b`. */
+    void grow(const bvh_box &b)
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            lo[a] = std::min(lo[a], b.lo[a]);
+            hi[a] = std::max(hi[a], b.hi[a]);
+        }
+    }
+
+    /** @brief Grows the box to enclose point `p`. */
+    void grow(const float p[3])
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            lo[a] = std::min(lo[a], p[a]);
+            hi[a] = std::max(hi[a], p[a]);
+        }
+    }
+
+    /** @brief Surface area of the box (0 for an empty box). */
+    float area() const
+    {
+        float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+        if (dx < 0 || dy < 0 || dz < 0)
+            return 0;
+        return 2 * (dx * dy + dy * dz + dz * dx);
+    }
+};
+
+/**
+ * @brief Converts an `aabb` to a `bvh_box`, rounding outwards so the float box
+ * always encloses the double precision one.
+ */
+inline bvh_box to_bvh_box(const aabb &box)
+{
+    bvh_box b;
+    for (int a = 0; a < 3; a++)
+    {
+        const interval &ax = box.axis_interval(a);
+        b.lo[a] = std::nextafter(float(ax.min), -std::numeric_limits<float>::infinity());
+        b.hi[a] = std::nextafter(float(ax.max), +std::numeric_limits<float>::infinity());
+    }
+    return b;
+}
+
+/**
+ * @class bvh_node
+ * @brief One 32-byte node of the flattened tree.
+ */
+struct bvh_node
+{
+    float lo[3], hi[3]; ///< Node bounds
+    uint32_t first;     ///< Leaf: first entry in `indices`; interior: index of the right child
+    uint16_t count;     ///< Number of primitives in a leaf, 0 for interior nodes
+    uint16_t axis;      ///< Split axis of an interior node (near child is visited first)
+};
+
+/**
+ * @class bvh_tree
+ * @brief Flat BVH built with the binned surface area heuristic.
+ */
+class bvh_tree
+{
+public:
+    std::vector<bvh_node> nodes;   ///< Depth-first node array, root at 0
+    std::vector<uint32_t> indices; ///< Primitive indices referenced by the leaves
+
+    /**
+     * @brief Builds the tree over the given primitive boxes.
+     *
+     * The top levels are split across threads; every subtree below them is built by
+     * a single thread. The result does not depend on the thread count.
+     *
+     * @param boxes Bounding box of every primitive.
+     * @param leaf_size Maximum number of primitives per leaf.
+     * @param threads Build threads (0 = all hardware threads).
+     */
+    void build(const std::vector<bvh_box> &boxes, int leaf_size = 4, int threads = 0)
+    {
+        nodes.clear();
+        indices.resize(boxes.size());
+        for (size_t n = 0; n < boxes.size(); n++)
+            indices[n] = uint32_t(n);
+        if (boxes.empty())
+            return;
+
+        build_context ctx;
+        ctx.boxes = &boxes;
+        ctx.leaf_size = std::max(1, std::min(leaf_size, 255));
+        ctx.centroids.resize(boxes.size() * 3);
+        for (size_t n = 0; n < boxes.size(); n++)
+            for (int a = 0; a < 3; a++)
+                ctx.centroids[3 * n + a] = 0.5f * (boxes[n].lo[a] + boxes[n].hi[a]);
+
+        if (threads <= 0)
+            threads = int(std::max(1u, std::thread::hardware_concurrency()));
+        int spawn_depth = 0;
+        while ((1 << spawn_depth) < threads)
+            spawn_depth++;
+
+        nodes.reserve(2 * boxes.size() / ctx.leaf_size + 1);
+        build_node(ctx, nodes, 0, uint32_t(boxes.size()), 0, spawn_depth);
+    }
+
+    /** @brief Returns the bytes held by the node and index arrays. */
+    size_t memory_bytes() const { return nodes.size() * sizeof(bvh_node) + indices.size() * sizeof(uint32_t); }
+
+    /**
+     * @brief Finds the closest primitive hit along `r` within `ray_t`.
+     *
+     * @param hit_primitive Called as `hit_primitive(index, interval, t_hit)` for every
+     * primitive in a visited leaf; returns true on a hit closer than the interval
+     * maximum and stores the hit distance in `t_hit`.
+     * @return True if any primitive was hit.
+     */
+    template <typename HitPrimitive>
+    bool traverse(const ray &r, interval ray_t, HitPrimitive &&hit_primitive) const
+    {
+        if (nodes.empty())
+            return false;
+        return traverse_nodes(nodes.data(), indices.data(), r, ray_t, hit_primitive);
+    }
+
+    /**
+     * @brief `traverse` over node and index arrays stored elsewhere, e.g. a scene
+     * mapped from shared memory (see shared_scene.h). `nodes` must not be empty.
+     */
+    template <typename HitPrimitive>
+    static bool traverse_nodes(const bvh_node *nodes, const uint32_t *indices, const ray &r, interval ray_t,
+                               HitPrimitive &&hit_primitive)
+    {
+        const point3 &orig = r.origin();
+        const vec3 &dir = r.direction();
+        double inv[3] = {1.0 / dir[0], 1.0 / dir[1], 1.0 / dir[2]};
+        bool negative[3] = {dir[0] < 0, dir[1] < 0, dir[2] < 0};
+
+        uint32_t stack[max_depth];
+        int top = 0;
+        uint32_t current = 0;
+        bool hit_anything = false;
+
+        while (true)
+        {
+            const bvh_node &node = nodes[current];
+            if (box_hit(node, orig, inv, ray_t))
+            {
+                if (node.count > 0)
+                {
+                    for (uint32_t k = node.first; k < node.first + node.count; k++)
+                    {
+                        double t_hit;
+                        if (hit_primitive(indices[k], ray_t, t_hit))
+                        {
+                            hit_anything = true;
+                            ray_t.max = t_hit;
+                        }
+                    }
+                }
+                else
+                {
+                    // Visit the child on the ray's side of the split first
+                    uint32_t left = current + 1, right = node.first;
+                    if (negative[node.axis])
+                        std::swap(left, right);
+                    stack[top++] = right;
+                    current = left;
+                    continue;
+                }
+            }
+            if (top == 0)
+                break;
+            current = stack[--top];
+        }
+        return hit_anything;
+    }
+
+private:
+    static const int max_depth = 128;    ///< Traversal stack size; the build never goes deeper
+    static const int bins = 16;          ///< SAH bins per axis
+    static const int median_depth = 64;  ///< Depth from which the build falls back to median splits
+    static const uint32_t min_parallel = 4096; ///< Smallest range handed to a new build thread
+
+    /** @brief Read-only state shared by all build threads. */
+    struct build_context
+    {
+        const std::vector<bvh_box> *boxes;
+        std::vector<float> centroids;
+        int leaf_size;
+    };
+
+    /** @brief Slab test of `ray_t` against a node's float bounds. */
+    static bool box_hit(const bvh_node &node, const point3 &orig, const double inv[3], const interval &ray_t)
+    {
+        double tmin = ray_t.min, tmax = ray_t.max;
+        for (int a = 0; a < 3; a++)
+        {
+            double t0 = (node.lo[a] - orig[a]) * inv[a];
+            double t1 = (node.hi[a] - orig[a]) * inv[a];
+            if (t0 > t1)
+                std::swap(t0, t1);
+            // Comparisons written so a NaN (ray in the slab plane) leaves the range untouched
+            if (t0 > tmin)
+                tmin = t0;
+            if (t1 < tmax)
+                tmax = t1;
+            if (tmax < tmin)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Builds the subtree over `indices[begin, end)` and appends it to `out`.
+     *
+     * Child links are relative to the start of `out`, so a subtree built into a
+     * separate vector can be spliced in by offsetting its interior links.
+     */
+    void build_node(const build_context &ctx, std::vector<bvh_node> &out, uint32_t begin, uint32_t end,
+                    int depth, int spawn_depth)
+    {
+        const auto &boxes = *ctx.boxes;
+        bvh_box bounds, centroid_bounds;
+        for (uint32_t k = begin; k < end; k++)
+        {
+            bounds.grow(boxes[indices[k]]);
+            centroid_bounds.grow(&ctx.centroids[3 * size_t(indices[k])]);
+        }
+
+        bvh_node node;
+        for (int a = 0; a < 3; a++)
+        {
+            node.lo[a] = bounds.lo[a];
+            node.hi[a] = bounds.hi[a];
+        }
+        node.axis = 0;
+
+        uint32_t count = end - begin;
+        if (count <= uint32_t(ctx.leaf_size))
+        {
+            node.first = begin;
+            node.count = uint16_t(count);
+            out.push_back(node);
+            return;
+        }
+
+        uint32_t mid = depth < median_depth ? sah_split(ctx, begin, end, centroid_bounds, node.axis) : begin;
+        if (mid == begin || mid == end)
+        {
+            // No useful SAH split (coincident centroids, or the tree got too deep):
+            // split the range in half along the longest centroid axis
+            int axis = 0;
+            for (int a = 1; a < 3; a++)
+                if (centroid_bounds.hi[a] - centroid_bounds.lo[a] > centroid_bounds.hi[axis] - centroid_bounds.lo[axis])
+                    axis = a;
+            mid = begin + count / 2;
+            std::nth_element(indices.begin() + begin, indices.begin() + mid, indices.begin() + end,
+                             [&](uint32_t i, uint32_t j)
+                             { return ctx.centroids[3 * size_t(i) + axis] < ctx.centroids[3 * size_t(j) + axis]; });
+            node.axis = uint16_t(axis);
+        }
+
+        node.count = 0;
+        size_t self = out.size();
+        out.push_back(node);
+
+        if (spawn_depth > 0 && count >= min_parallel)
+        {
+            // Build the right subtree on another thread into its own array, then splice
+            std::vector<bvh_node> right_nodes;
+            std::thread worker([&]()
+                               { build_node(ctx, right_nodes, mid, end, depth + 1, spawn_depth - 1); });
+            build_node(ctx, out, begin, mid, depth + 1, spawn_depth - 1);
+            worker.join();
+
+            uint32_t offset = uint32_t(out.size());
+            out[self].first = offset;
+            for (auto &n : right_nodes)
+            {
+                if (n.count == 0)
+                    n.first += offset;
+                out.push_back(n);
+            }
+        }
+        else
+        {
+            build_node(ctx, out, begin, mid, depth + 1, 0);
+            out[self].first = uint32_t(out.size());
+            build_node(ctx, out, mid, end, depth + 1, 0);
+        }
+    }
+
+    /**
+     * @brief Partitions `indices[begin, end)` at the cheapest binned SAH split.
+     * @return The partition point, or `begin` if no split improves on a single bin.
+     */
+    uint32_t sah_split(const build_context &ctx, uint32_t begin, uint32_t end, const bvh_box &centroid_bounds,
+                       uint16_t &axis_out)
+    {
+        const auto &boxes = *ctx.boxes;
+        float best_cost = std::numeric_limits<float>::infinity();
+        int best_axis = -1, best_bin = 0;
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float lo = centroid_bounds.lo[axis], extent = centroid_bounds.hi[axis] - lo;
+            if (!(extent > 0))
+                continue;
+            float scale = bins / extent;
+
+            bvh_box bin_box[bins];
+            uint32_t bin_count[bins] = {};
+            for (uint32_t k = begin; k < end; k++)
+            {
+                uint32_t p = indices[k];
+                int b = std::min(bins - 1, int((ctx.centroids[3 * size_t(p) + axis] - lo) * scale));
+                bin_count[b]++;
+                bin_box[b].grow(boxes[p]);
+            }
+
+            // Sweep from the right to get the cost of every split plane in one pass
+            float right_area[bins];
+            uint32_t right_count[bins];
+            bvh_box acc;
+            uint32_t n = 0;
+            for (int b = bins - 1; b > 0; b--)
+            {
+                acc.grow(bin_box[b]);
+                n += bin_count[b];
+                right_area[b] = acc.area();
+                right_count[b] = n;
+            }
+
+            acc = bvh_box();
+            n = 0;
+            for (int b = 1; b < bins; b++)
+            {
+                acc.grow(bin_box[b - 1]);
+                n += bin_count[b - 1];
+                if (n == 0 || right_count[b] == 0)
+                    continue;
+                float cost = acc.area() * n + right_area[b] * right_count[b];
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = b;
+                }
+            }
+        }
+
+        if (best_axis < 0)
+            return begin;
+
+        axis_out = uint16_t(best_axis);
+        float lo = centroid_bounds.lo[best_axis];
+        float scale = bins / (centroid_bounds.hi[best_axis] - lo);
+        auto it = std::partition(indices.begin() + begin, indices.begin() + end,
+                                 [&](uint32_t p)
+                                 {
+                                     int b = std::min(bins - 1, int((ctx.centroids[3 * size_t(p) + best_axis] - lo) * scale));
+                                     return b < best_bin;
+                                 });
+        return uint32_t(it - indices.begin());
+    }
+};
+
+/**
+ * @class bvh
+ * @brief A `hittable` that accelerates a list of objects with a `bvh_tree`.
+ *
+ * Example usage:
+ * @code
+ * hittable_list world = random_spheres_scene();
+ * bvh accel(world);
+ * cam.render(accel);
+ * @endcode
+ */
+class bvh : public hittable
+{
+public:
+    /**
+     * @brief Builds the hierarchy over the objects of `list`.
+     * @param list Objects to accelerate (shared, not copied).
+     * @param leaf_size Maximum number of objects per leaf.
+     * @param threads Build threads (0 = all hardware threads).
+     */
+    bvh(const hittable_list &list, int leaf_size = 4, int threads = 0)
+        : objects(list.objects), bbox(list.bounding_box())
+    {
+        std::vector<bvh_box> boxes(objects.size());
+        for (size_t n = 0; n < objects.size(); n++)
+            boxes[n] = to_bvh_box(objects[n]->bounding_box());
+        tree.build(boxes, leaf_size, threads);
+    }
+
+    bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+    {
+        // Objects only write `rec` when they report a hit, and every reported hit is
+        // closer than the previous one, so `rec` ends up holding the closest hit
+        return tree.traverse(r, ray_t,
+                             [&](uint32_t index, const interval &t, double &t_hit)
+                             {
+                                 if (!objects[index]->hit(r, t, rec))
+                                     return false;
+                                 t_hit = rec.t;
+                                 return true;
+                             });
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    /** @brief Returns the underlying tree (for statistics). */
+    const bvh_tree &tree_data() const { return tree; }
+
+private:
+    std::vector<shared_ptr<hittable>> objects;
+    bvh_tree tree;
+    aabb bbox;
+};
+
+#endif
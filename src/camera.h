@@ -9,7 +9,9 @@
  *  - adjustable aspect ratio and image resolution
  *  - depth of field (defocus blur) simulation
  *  - anti aliasing via multiple sample per pixel
+ *  - box, Gaussian, Mitchell or Blackman-Harris pixel reconstruction filters
  *  - recursive ray tracing with material scattering
+ *  - tiled rendering spread over worker threads
  *
  */
 
@@ -18,6 +20,61 @@
 
 #include "hittable.h"
 #include "material.h"
+#include "framebuffer.h"
+#include "counters.h"
+#include "geometry_aov.h"
+#include "heatmap.h"
+#include "metrics.h"
+#include "pixel_filter.h"
+#include "progress.h"
+#include "render_stats.h"
+#include "sample_guard.h"
+#include "sample_budget.h"
+#include "tile_schedule.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** @brief How sub-pixel sample positions are chosen within a pass. */
+enum class sampler_type
+{
+    independent, ///< Every sample uniformly random over the pixel
+    stratified   ///< Jittered sqrt(spp) x sqrt(spp) grid per pixel and pass
+};
+
+/** @brief How light paths are terminated. */
+enum class integrator_type
+{
+    recursive,       ///< Trace every path until it escapes, is absorbed or hits max_depth
+    russian_roulette ///< Randomly terminate dim paths after a few bounces, reweighting survivors
+};
+
+/** @brief How the samples a pixel takes in one pass are combined. */
+enum class estimator_type
+{
+    mean,           ///< Plain average
+    median_of_means ///< Median of group means; rejects fireflies at the cost of a small bias (box filter only)
+};
+
+/**
+ * @class pass_report
+ * @brief Timing of the last render pass.
+ */
+struct pass_report
+{
+    double seconds = 0;      ///< Wall time of the pass
+    double tail_seconds = 0; ///< Time between the first and the last worker running out of work
+    int work_items = 0;      ///< Tiles (or split tiles) rendered
+    uint64_t samples = 0;    ///< Camera samples taken (fewer than pixels x spp with a sample budget)
+    bool cancelled = false;  ///< The pass stopped early because `camera::cancel` was set
+};
+
 class camera
 {
 public:
@@ -34,6 +91,33 @@ public:
     double defocus_angle = 0; // Variation angle of rays through each pixel
     double focus_dist = 10;   // Distance from camera lookfrom point to plane of perfect focus
 
+    int tile_size = 16;  // Edge length of the square tiles handed to worker threads
+    int num_threads = 0; // Worker thread count (0 = one per hardware thread)
+    tile_rect crop{0, 0, 0, 0}; // Pixels to render, e.g. one node's share of a distributed render (empty = all)
+    uint64_t seed = 0;   // Base seed; each tile derives its own random stream from it
+    bool show_progress = true; // Print a rate-limited status line (percent, throughput, ETA) to stderr
+
+    sampler_type sampler = sampler_type::independent;       // Sub-pixel sample placement
+    integrator_type integrator = integrator_type::recursive; // Path termination strategy
+    int rr_min_bounces = 3;                                  // Bounces before russian roulette may terminate a path
+    pixel_filter filter;                                     // Pixel reconstruction filter (default box)
+    estimator_type estimator = estimator_type::mean;         // How a pixel's samples in one pass are combined
+    int mom_groups = 5;                                      // Groups of the median-of-means estimator
+    double clamp_indirect = 0; // Cap on any channel of a sample that bounced at least once (0 = off)
+    sample_guard *guard = nullptr; // Optional counters of dropped (NaN / Inf) and clamped samples
+
+    cost_aov *cost = nullptr;      // Optional per-pixel cost AOV, filled during rendering when set
+    render_stats *stats = nullptr; // Optional per-phase / per-thread statistics collector
+    tile_schedule *schedule = nullptr; // Optional cost history; plans tiles from the previous pass when set
+    render_metrics *metrics = nullptr; // Optional live telemetry, updated once per tile
+    progress_reporter *progress = nullptr; // Optional progress events; replaces the show_progress status line
+    const sample_budget *budget = nullptr;  // Optional per-pixel sample density; scales each pass's spp per pixel
+
+    const std::atomic<bool> *cancel = nullptr;          // When set to true, workers stop claiming tiles
+    std::function<void(int done, int total)> on_progress; // Called (serialised) after every finished tile
+
+    pass_report last_pass; // Timing of the most recent render pass
+
     /**
      * @brief Renders the scene (world) from the camera's viewpoint
      *
@@ -46,25 +130,307 @@ public:
     {
         initialize();
 
-        std::cout << "P3\n"
-                  << image_width << ' ' << image_height << "\n255\n";
+        framebuffer fb;
+        if (cost)
+            cost->resize(image_width, image_height);
+        render_pass(world, fb, 0, samples_per_pixel);
 
-        for (int j = 0; j < image_height; j++)
+        RAYCRAFT_TRACE_SCOPE("write output", "output");
+        phase_scope output_phase(stats, "output");
+        write_ppm(std::cout, fb);
+    }
+
+    /**
+     * @brief Renders one pass of `spp` samples per pixel into `fb`.
+     *
+     * The image is cut into `tile_size` squares which worker threads claim from a
+     * shared counter. With a `schedule`, the tiles are instead planned from the cost
+     * of the previous pass (hot tiles split, expensive ones first) and the measured
+     * cost of this pass is recorded. Every pixel reseeds the random generator from
+     * (seed, pixel, first_sample), so the result depends neither on the thread count
+     * nor on how the image was cut into work items.
+     *
+     * @param world the hittable scene to be rendered
+     * @param fb framebuffer to accumulate into (resized and cleared if its size differs,
+     * as is the `cost` AOV)
+     * @param first_sample index of the first sample in this pass (for seeding)
+     * @param spp samples per pixel to take in this pass
+     */
+    void render_pass(const hittable &world, framebuffer &fb, int first_sample, int spp)
+    {
+        RAYCRAFT_TRACE_SCOPE_ARG("render pass", "render", first_sample);
+        initialize();
+        if (fb.width != image_width || fb.height != image_height)
+            fb.resize(image_width, image_height);
+        if (cost && (cost->width != image_width || cost->height != image_height))
+            cost->resize(image_width, image_height);
+
+        int threads = thread_count();
+        std::vector<tile_rect> tiles = schedule ? schedule->plan(image_width, image_height, tile_size, threads)
+                                                : grid_tiles(image_width, image_height, tile_size);
+        tile_rect area = render_area();
+        bool cropped = area.pixels() < image_width * image_height;
+        if (cropped)
         {
-            std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush;
-            for (int i = 0; i < image_width; i++)
+            std::vector<tile_rect> inside;
+            for (auto t : tiles)
             {
+                t = tile_rect{std::max(t.x0, area.x0), std::max(t.y0, area.y0), std::min(t.x1, area.x1),
+                              std::min(t.y1, area.y1)};
+                if (t.x0 < t.x1 && t.y0 < t.y1)
+                    inside.push_back(t);
+            }
+            tiles.swap(inside);
+        }
+        int tile_count = int(tiles.size());
+        std::vector<double> tile_seconds(schedule ? tiles.size() : 0);
+        std::vector<splat_tile> overlaps(filter.type == filter_type::box ? 0 : tiles.size());
+        std::vector<std::chrono::steady_clock::time_point> finished(threads);
+
+        std::atomic<int> next_tile{0};
+        std::atomic<int> tiles_done{0};
+        std::atomic<int> next_worker{0};
+        std::atomic<uint64_t> samples_taken{0};
+        std::mutex progress_lock;
+        auto pass_start = std::chrono::steady_clock::now();
+        if (metrics)
+            metrics->tiles_queued(tile_count);
+
+        progress_reporter console;
+        progress_reporter *reporter = progress ? progress : show_progress ? &console : nullptr;
+        if (reporter)
+            reporter->begin(tile_count, tile_samples(area, spp), threads);
+
+        auto worker = [&]()
+        {
+            int id = next_worker++;
+            phase_scope worker_phase(stats, "render pass", id);
+            for (int t = next_tile++; t < tile_count; t = next_tile++)
+            {
+                if (cancel && cancel->load(std::memory_order_relaxed))
+                    break;
+                if (metrics)
+                    metrics->tile_started();
+                uint64_t rays_before = thread_counters().rays;
+                auto tile_start = std::chrono::steady_clock::now();
+                render_tile(world, fb, tiles[t], t, first_sample, spp, overlaps.empty() ? nullptr : &overlaps[t]);
+                std::chrono::duration<double> spent = std::chrono::steady_clock::now() - tile_start;
+                uint64_t samples = tile_samples(tiles[t], spp);
+                samples_taken += samples;
+                if (schedule)
+                    tile_seconds[t] = spent.count();
+                if (metrics)
+                    metrics->tile_finished(id, thread_counters().rays - rays_before, samples, spent.count());
+
+                int done = ++tiles_done;
+                if (!reporter && !on_progress)
+                    continue;
+                std::lock_guard<std::mutex> guard(progress_lock);
+                if (on_progress)
+                    on_progress(done, tile_count);
+                if (reporter)
+                    reporter->tile_done(samples, spent.count());
+            }
+            finished[id] = std::chrono::steady_clock::now();
+        };
+
+        std::vector<std::thread> pool;
+        for (int n = 1; n < threads; n++)
+            pool.emplace_back(worker);
+        worker();
+        for (auto &t : pool)
+            t.join();
+
+        // Splats across tile borders, in tile order so the sums do not depend on the threads
+        for (const auto &overlap : overlaps)
+            overlap.merge_border(fb);
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - pass_start;
+        auto first_idle = *std::min_element(finished.begin(), finished.end());
+        auto last_idle = *std::max_element(finished.begin(), finished.end());
+        last_pass.seconds = elapsed.count();
+        last_pass.tail_seconds = std::chrono::duration<double>(last_idle - first_idle).count();
+        last_pass.work_items = tile_count;
+        last_pass.samples = samples_taken;
+        last_pass.cancelled = tiles_done < tile_count;
+        if (metrics)
+            metrics->tiles_queued(-(tile_count - tiles_done)); // left unclaimed by a cancelled pass
+
+        // A cancelled or cropped pass has holes; keep the history of the last complete one
+        if (schedule && !last_pass.cancelled && !cropped)
+            schedule->record(tiles, tile_seconds);
+        if (stats)
+            stats->add_wall("render pass", elapsed.count());
+
+        if (reporter)
+            reporter->end(last_pass.cancelled);
+    }
+
+    /** @brief The pixels a pass renders: `crop` clipped to the image, or the whole image. */
+    tile_rect render_area() const
+    {
+        if (crop.x1 <= crop.x0 || crop.y1 <= crop.y0)
+            return tile_rect{0, 0, image_width, image_height};
+        tile_rect area{std::max(crop.x0, 0), std::max(crop.y0, 0), std::min(crop.x1, image_width),
+                       std::min(crop.y1, image_height)};
+        area.x1 = std::max(area.x1, area.x0);
+        area.y1 = std::max(area.y1, area.y0);
+        return area;
+    }
+
+    /** Returns the number of worker threads a render will use. */
+    int thread_count() const
+    {
+        if (num_threads > 0)
+            return num_threads;
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    /** @brief Computes the image height and view geometry without rendering. */
+    void prepare() { initialize(); }
+
+    /** @brief Image height in pixels, valid after `prepare()` or a render. */
+    int height() const { return image_height; }
+
+    /** @brief World-to-pixel mapping of the current pose, valid after `prepare()` or a render. */
+    camera_projection projection() const
+    {
+        camera_projection p;
+        p.center = center;
+        p.pixel00 = pixel00_loc;
+        p.delta_u = pixel_delta_u;
+        p.delta_v = pixel_delta_v;
+        p.w = w;
+        p.focus_dist = focus_dist;
+        return p;
+    }
+
+    /**
+     * @brief Fills `aov` with the first hit of the ray through every pixel centre,
+     * from the camera centre (no lens sampling); one ray per pixel, on all threads.
+     */
+    void render_geometry(const hittable &world, geometry_aov &aov)
+    {
+        RAYCRAFT_TRACE_SCOPE("geometry pass", "render");
+        initialize();
+        aov.resize(image_width, image_height);
+
+        std::atomic<int> next_row{0};
+        auto worker = [&]()
+        {
+            for (int j = next_row++; j < image_height; j = next_row++)
+            {
+                for (int i = 0; i < image_width; i++)
+                {
+                    ray r(center, pixel00_loc + i * pixel_delta_u + j * pixel_delta_v - center);
+                    hit_record rec;
+                    if (world.hit(r, interval(0.001, infinity), rec))
+                        aov.set_hit(i, j, rec.p, (rec.p - center).length(), rec.normal, rec.object);
+                    else
+                        aov.set_background(i, j, r.direction());
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for (int n = 1; n < thread_count(); n++)
+            pool.emplace_back(worker);
+        worker();
+        for (auto &t : pool)
+            t.join();
+    }
+
+    /**
+     * @brief Renders every sample of one tile; `t` is its index in the work list (for tracing).
+     *
+     * Call `prepare()` first. Tiles are independent, so callers with their own
+     * scheduler may render disjoint tiles of one framebuffer from any threads.
+     *
+     * With a reconstruction filter other than box, samples are splatted into
+     * `overlap`: the pixels no other tile reaches go to `fb` right away, and the
+     * caller merges the rest with `overlap->merge_border(fb)` once no tile is being
+     * rendered any more. Without `overlap`, splats are clipped to the tile.
+     */
+    void render_tile(const hittable &world, framebuffer &fb, const tile_rect &tile, [[maybe_unused]] int t,
+                     int first_sample, int spp, splat_tile *overlap = nullptr) const
+    {
+        RAYCRAFT_TRACE_SCOPE_ARG("tile", "render", t);
+
+        bool splatting = filter.type != filter_type::box;
+        bool median = estimator == estimator_type::median_of_means && !splatting;
+        std::vector<color> samples;
+        uint64_t clamped_before = thread_counters().clamped;
+        splat_tile clipped;
+        splat_tile &splats = overlap ? *overlap : clipped;
+        if (splatting)
+            splats.reset(tile, filter.border());
+
+        for (int j = tile.y0; j < tile.y1; j++)
+        {
+            for (int i = tile.x0; i < tile.x1; i++)
+            {
+                uint64_t pixel = uint64_t(j) * image_width + i;
+                seed_random(mix_bits(seed ^ mix_bits(pixel << 32 | uint32_t(first_sample))));
+
+                ray_counters counters_before;
+                uint64_t cycles_before = 0;
+                if (cost)
+                {
+                    counters_before = thread_counters();
+                    cycles_before = read_cycle_counter();
+                }
+
+                int n = budget ? budget->samples(i, j, image_width, image_height, spp) : spp;
                 color pixel_color(0, 0, 0);
-                for (int sample = 0; sample < samples_per_pixel; sample++)
+                int valid = 0;
+                samples.clear();
+                for (int sample = 0; sample < n; sample++)
+                {
+                    vec3 offset = sample_offset(sample, n);
+                    color c = ray_color(get_ray(i, j, offset), max_depth, world);
+                    // One NaN or Inf would poison the pixel for good: drop it, keep a record
+                    if (!is_finite(c))
+                    {
+                        if (guard)
+                            guard->record(i, j, first_sample, sample, c);
+                        continue;
+                    }
+                    valid++;
+                    if (splatting)
+                        splats.splat(filter, i + offset.x(), j + offset.y(), c);
+                    else if (median)
+                        samples.push_back(c);
+                    else
+                        pixel_color += c;
+                }
+                if (!splatting && valid > 0)
+                    fb.add_sample(i, j, median ? median_of_means(samples, mom_groups) : pixel_color / valid, valid);
+
+                if (cost)
                 {
-                    ray r = get_ray(i, j);
-                    pixel_color += ray_color(r, max_depth, world);
+                    auto spent = thread_counters() - counters_before;
+                    cost->add(i, j, read_cycle_counter() - cycles_before, spent.rays, spent.isect_tests, n);
                 }
-                write_color(std::cout, pixel_samples_scale * pixel_color);
             }
         }
 
-        std::clog << "\rDone.                 \n";
+        if (splatting && overlap)
+            splats.write_interior(fb);
+        else if (splatting)
+            splats.write_tile(fb);
+        if (guard)
+            guard->add_clamped(thread_counters().clamped - clamped_before);
+    }
+
+    /** @brief Samples a pass of `spp` takes in `tile`, after the sample budget. */
+    uint64_t tile_samples(const tile_rect &tile, int spp) const
+    {
+        if (!budget)
+            return uint64_t(tile.pixels()) * spp;
+        uint64_t total = 0;
+        for (int j = tile.y0; j < tile.y1; j++)
+            for (int i = tile.x0; i < tile.x1; i++)
+                total += budget->samples(i, j, image_width, image_height, spp);
+        return total;
     }
 
 private:
@@ -123,7 +489,12 @@ private:
     {
         // construct a camera ray originating from the origin and directed at randomly sampled
         // points around the pixel location at i, j
-        auto offset = sample_square();
+        return get_ray(i, j, sample_square());
+    }
+
+    /** Generates a ray through pixel (i, j) at the sub-pixel `offset` in [-0.5, 0.5]^2. */
+    ray get_ray(int i, int j, const vec3 &offset) const
+    {
         auto pixel_sample = pixel00_loc + ((i + offset.x()) * pixel_delta_u) + ((j + offset.y()) * pixel_delta_v);
 
         auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample();
@@ -139,6 +510,23 @@ private:
         return vec3(random_double() - 0.5, random_double() - 0.5, 0);
     }
 
+    /**
+     * Returns the sub-pixel offset of sample `s` out of `spp` taken in one pass.
+     *
+     * With the stratified sampler the first n*n samples (n = floor(sqrt(spp))) are
+     * jittered within the cells of an n x n grid; any remainder is independent.
+     */
+    vec3 sample_offset(int s, int spp) const
+    {
+        if (sampler == sampler_type::stratified)
+        {
+            int n = int(std::sqrt(double(spp)));
+            if (s < n * n)
+                return vec3((s % n + random_double()) / n - 0.5, (s / n + random_double()) / n - 0.5, 0);
+        }
+        return sample_square();
+    }
+
     /** Returns a random point on the lens' defoucs disk for depth of field blur */
     point3 defocus_disk_sample() const
     {
@@ -162,6 +550,8 @@ private:
     // this function determines the color seen in the direction of ray r
     color ray_color(const ray &r, int depth, const hittable &world) const
     {
+        thread_counters().rays++;
+
         // base condition
         // if we have exceeded the max ray bounce limit, no more light is gethered
         if (depth <= 0)
@@ -177,7 +567,26 @@ private:
             color attenuation;
             if (rec.mat->scatter(r, rec, attenuation, scattered))
             {
-                return attenuation * ray_color(scattered, depth - 1, world);
+                if (integrator == integrator_type::russian_roulette && max_depth - depth >= rr_min_bounces)
+                {
+                    // Continue with probability q and divide by q, which keeps the estimate unbiased
+                    double q = std::fmin(0.95, std::fmax(attenuation.x(), std::fmax(attenuation.y(), attenuation.z())));
+                    if (random_double() >= q)
+                        return color(0, 0, 0);
+                    attenuation /= q;
+                }
+                color result = attenuation * ray_color(scattered, depth - 1, world);
+                // Only camera rays arrive with the full depth, and a hit means the light came via a bounce
+                if (clamp_indirect > 0 && depth == max_depth)
+                {
+                    double peak = std::fmax(result.x(), std::fmax(result.y(), result.z()));
+                    if (peak > clamp_indirect)
+                    {
+                        result *= clamp_indirect / peak;
+                        thread_counters().clamped++;
+                    }
+                }
+                return result;
             }
             return color(0, 0, 0);
         }
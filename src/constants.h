@@ -11,6 +11,7 @@
 #define CONSTANTS_H
 
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <ostream>
@@ -42,13 +43,55 @@ inline double degrees_to_radians(double degrees)
     return degrees * pi / 180.0;
 }
 
+/**
+ * @brief Returns the calling thread's random generator state.
+ *
+ * Every thread owns its own state so render workers never contend on a
+ * shared generator (`std::rand` serialises all callers behind one lock).
+ */
+inline uint64_t &random_state()
+{
+    thread_local uint64_t state = 0x853c49e6748fea9bULL;
+    return state;
+}
+
+/**
+ * @brief Mixes a 64-bit value into a well distributed hash (SplitMix64 finaliser).
+ * @param x Value to mix.
+ * @return Hashed value.
+ */
+inline uint64_t mix_bits(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * @brief Reseeds the calling thread's random generator.
+ *
+ * The renderer reseeds per tile so an image only depends on the seed and
+ * not on which worker thread happened to pick up which tile.
+ *
+ * @param seed Seed value.
+ */
+inline void seed_random(uint64_t seed)
+{
+    random_state() = mix_bits(seed + 0x9e3779b97f4a7c15ULL);
+}
+
 /**
  * @brief Returns a random real number in the range [0, 1).
  * @return Random double between 0 (inclusive) and 1 (exclusive).
  */
 inline double random_double()
 {
-    return std::rand() / (RAND_MAX + 1.0);
+    // SplitMix64 step, top 53 bits mapped onto [0, 1)
+    uint64_t z = (random_state() += 0x9e3779b97f4a7c15ULL);
+    return (mix_bits(z) >> 11) * (1.0 / 9007199254740992.0);
 }
 
 /**
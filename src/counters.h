@@ -0,0 +1,75 @@
+/**
+ * @file counters.h
+ * @brief Cheap per-thread work counters (rays traced, intersection tests) and a cycle clock.
+ *
+ * Counters live in thread-local storage so the hot paths increment them without any
+ * atomics. Callers that want totals take a snapshot before and after a piece of work
+ * on the same thread and subtract.
+ */
+
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * @class ray_counters
+ * @brief Work done by one thread since it started.
+ */
+struct ray_counters
+{
+    uint64_t rays = 0;        ///< Rays passed to `camera::ray_color` (camera and scattered rays)
+    uint64_t isect_tests = 0; ///< Ray/primitive intersection tests performed
+    uint64_t clamped = 0;     ///< Camera samples capped by `camera::clamp_indirect`
+
+    ray_counters &operator+=(const ray_counters &o)
+    {
+        rays += o.rays;
+        isect_tests += o.isect_tests;
+        clamped += o.clamped;
+        return *this;
+    }
+};
+
+/** @brief Returns the difference between two counter snapshots. */
+inline ray_counters operator-(const ray_counters &a, const ray_counters &b)
+{
+    ray_counters d;
+    d.rays = a.rays - b.rays;
+    d.isect_tests = a.isect_tests - b.isect_tests;
+    d.clamped = a.clamped - b.clamped;
+    return d;
+}
+
+/** @brief Returns the calling thread's counters. */
+inline ray_counters &thread_counters()
+{
+    thread_local ray_counters counters;
+    return counters;
+}
+
+/**
+ * @brief Reads a fast, monotonically increasing cycle counter.
+ *
+ * Uses the time stamp counter on x86 (`rdtsc`), which costs a few dozen cycles,
+ * and falls back to steady_clock nanoseconds elsewhere.
+ */
+inline uint64_t read_cycle_counter()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch())
+                        .count());
+#endif
+}
+
+#endif
@@ -0,0 +1,285 @@
+/**
+ * @file delta_frames.h
+ * @brief Animation files that store only the tiles that changed since the previous frame.
+ *
+ * With a static camera, most of the image stays the same from one frame to the next,
+ * and pixels are seeded individually, so unchanged regions render to identical
+ * bytes. Each frame is cut into square tiles. A tile is written only if it differs
+ * from the same tile of the previous frame: first the 64-bit FNV-1a hashes are
+ * compared, and equal hashes are confirmed byte by byte, so a collision can never
+ * drop a change.
+ *
+ * Layout (all values little-endian):
+ *
+ *     header  "RCDELTA1", uint32 width, uint32 height, uint32 tile_size, uint32 reserved (0)
+ *     frames  { uint32 changed_tiles, uint8 changed[ceil(tiles / 8)],
+ *               changed_tiles x 8-bit RGB tile pixels (rows top to bottom) }
+ *
+ * Bit t of `changed` (LSB first) marks tile t, counting tiles row by row. The first
+ * frame has every tile set; a frame identical to its predecessor costs 4 bytes plus
+ * the bitmap. `delta_reader` rebuilds the frames by replaying the tiles in order.
+ */
+
+#ifndef DELTA_FRAMES_H
+#define DELTA_FRAMES_H
+
+#include "scene_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+static const char delta_file_magic[8] = {'R', 'C', 'D', 'E', 'L', 'T', 'A', '1'};
+
+/**
+ * @class delta_layout
+ * @brief Tile grid shared by the writer and the reader.
+ */
+struct delta_layout
+{
+    int width = 0, height = 0, tile_size = 32;
+
+    int tiles_x() const { return (width + tile_size - 1) / tile_size; }
+    int tiles_y() const { return (height + tile_size - 1) / tile_size; }
+    int tile_count() const { return tiles_x() * tiles_y(); }
+    size_t bitmap_bytes() const { return (size_t(tile_count()) + 7) / 8; }
+
+    /** @brief Pixel rectangle of tile `t`. */
+    void tile_rect(int t, int &x0, int &y0, int &w, int &h) const
+    {
+        x0 = (t % tiles_x()) * tile_size;
+        y0 = (t / tiles_x()) * tile_size;
+        w = std::min(tile_size, width - x0);
+        h = std::min(tile_size, height - y0);
+    }
+};
+
+/**
+ * @class delta_writer
+ * @brief Appends frames to a delta file, writing only changed tiles.
+ */
+class delta_writer
+{
+public:
+    /** @brief Totals over the frames written so far. */
+    struct report
+    {
+        int frames = 0;
+        uint64_t tiles = 0;          ///< Tiles in all frames
+        uint64_t tiles_written = 0;  ///< Tiles that changed and were stored
+        uint64_t hash_matches = 0;   ///< Tiles whose hash matched (then compared exactly)
+        uint64_t collisions = 0;     ///< Equal hashes over different pixels
+        uint64_t bytes = 0;          ///< File size
+        uint64_t raw_bytes = 0;      ///< Size of the same frames stored in full
+    };
+
+    delta_writer(std::ostream &out, int width, int height, int tile_size = 32) : out(out)
+    {
+        layout.width = width;
+        layout.height = height;
+        layout.tile_size = std::max(1, tile_size);
+        hashes.assign(size_t(layout.tile_count()), 0);
+
+        std::vector<unsigned char> header(delta_file_magic, delta_file_magic + 8);
+        put_u32(header, uint32_t(width));
+        put_u32(header, uint32_t(height));
+        put_u32(header, uint32_t(layout.tile_size));
+        put_u32(header, 0);
+        write(header);
+    }
+
+    std::string error; ///< Why `add_frame` rejected a frame
+
+    /**
+     * @brief Appends a frame of 8-bit RGB pixels (`width * height * 3` bytes).
+     * @return Number of tiles that changed and were written, or -1 with `error` set
+     * (and nothing written) if the frame has another size.
+     */
+    int add_frame(const std::vector<unsigned char> &rgb)
+    {
+        if (rgb.size() != size_t(layout.width) * layout.height * 3)
+        {
+            error = "frame " + std::to_string(stats.frames) + " has " + std::to_string(rgb.size()) +
+                    " bytes, expected " + std::to_string(size_t(layout.width) * layout.height * 3);
+            return -1;
+        }
+
+        int count = layout.tile_count();
+        std::vector<unsigned char> bitmap(layout.bitmap_bytes(), 0), pixels;
+        std::vector<unsigned char> tile;
+        uint32_t changed = 0;
+        for (int t = 0; t < count; t++)
+        {
+            copy_tile(rgb, t, tile);
+            uint64_t hash = fnv1a(tile);
+            bool same = false;
+            if (!previous.empty() && hash == hashes[size_t(t)])
+            {
+                stats.hash_matches++;
+                same = tile_equal(rgb, previous, t);
+                if (!same)
+                    stats.collisions++;
+            }
+            if (same)
+                continue;
+            hashes[size_t(t)] = hash;
+            bitmap[size_t(t) / 8] |= (unsigned char)(1u << (t % 8));
+            pixels.insert(pixels.end(), tile.begin(), tile.end());
+            changed++;
+        }
+
+        std::vector<unsigned char> record;
+        put_u32(record, changed);
+        record.insert(record.end(), bitmap.begin(), bitmap.end());
+        write(record);
+        write(pixels);
+
+        previous = rgb;
+        stats.frames++;
+        stats.tiles += uint64_t(count);
+        stats.tiles_written += changed;
+        stats.raw_bytes += rgb.size();
+        return int(changed);
+    }
+
+    const report &totals() const { return stats; }
+
+private:
+    std::ostream &out;
+    delta_layout layout;
+    std::vector<uint64_t> hashes;        ///< Hash of every tile as last written
+    std::vector<unsigned char> previous; ///< Previous frame, for the exact comparison
+    report stats;
+
+    void write(const std::vector<unsigned char> &bytes)
+    {
+        out.write(reinterpret_cast<const char *>(bytes.data()), std::streamsize(bytes.size()));
+        stats.bytes += bytes.size();
+    }
+
+    static uint64_t fnv1a(const std::vector<unsigned char> &bytes)
+    {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (unsigned char b : bytes)
+            hash = (hash ^ b) * 0x100000001b3ULL;
+        return hash;
+    }
+
+    void copy_tile(const std::vector<unsigned char> &rgb, int t, std::vector<unsigned char> &tile) const
+    {
+        int x0, y0, w, h;
+        layout.tile_rect(t, x0, y0, w, h);
+        tile.resize(size_t(w) * h * 3);
+        for (int y = 0; y < h; y++)
+            std::memcpy(&tile[size_t(y) * w * 3], &rgb[(size_t(y0 + y) * layout.width + x0) * 3], size_t(w) * 3);
+    }
+
+    bool tile_equal(const std::vector<unsigned char> &a, const std::vector<unsigned char> &b, int t) const
+    {
+        int x0, y0, w, h;
+        layout.tile_rect(t, x0, y0, w, h);
+        for (int y = 0; y < h; y++)
+        {
+            size_t offset = (size_t(y0 + y) * layout.width + x0) * 3;
+            if (std::memcmp(&a[offset], &b[offset], size_t(w) * 3) != 0)
+                return false;
+        }
+        return true;
+    }
+};
+
+/**
+ * @class delta_reader
+ * @brief Reconstructs the frames of a delta file one after the other.
+ */
+class delta_reader
+{
+public:
+    delta_layout layout;
+    std::string error; ///< Why `open` or `next_frame` failed
+
+    explicit delta_reader(std::istream &in) : in(in) {}
+
+    /** @brief Reads the header; false with `error` set if this is not a delta file. */
+    bool open()
+    {
+        unsigned char header[24];
+        if (!in.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+            std::memcmp(header, delta_file_magic, sizeof(delta_file_magic)) != 0)
+        {
+            error = "not a RayCraft delta file";
+            return false;
+        }
+        layout.width = int(get_u32(header + 8));
+        layout.height = int(get_u32(header + 12));
+        layout.tile_size = int(get_u32(header + 16));
+        if (layout.width <= 0 || layout.height <= 0 || layout.tile_size <= 0)
+        {
+            error = "invalid image or tile size";
+            return false;
+        }
+        frame.assign(size_t(layout.width) * layout.height * 3, 0);
+        return true;
+    }
+
+    /**
+     * @brief Reads the next frame into `rgb` (8-bit RGB, rows top to bottom).
+     * @param changed Receives the number of tiles the frame replaced.
+     * @return False at the end of the file, or with `error` set on a damaged file.
+     */
+    bool next_frame(std::vector<unsigned char> &rgb, int *changed = nullptr)
+    {
+        unsigned char count_bytes[4];
+        if (!in.read(reinterpret_cast<char *>(count_bytes), 4))
+            return false; // clean end of file
+        uint32_t count = get_u32(count_bytes);
+        std::vector<unsigned char> bitmap(layout.bitmap_bytes());
+        if (!in.read(reinterpret_cast<char *>(bitmap.data()), std::streamsize(bitmap.size())))
+        {
+            error = "truncated frame index";
+            return false;
+        }
+
+        uint32_t seen = 0;
+        std::vector<unsigned char> tile;
+        for (int t = 0; t < layout.tile_count(); t++)
+        {
+            if (!(bitmap[size_t(t) / 8] & (1u << (t % 8))))
+                continue;
+            int x0, y0, w, h;
+            layout.tile_rect(t, x0, y0, w, h);
+            tile.resize(size_t(w) * h * 3);
+            if (!in.read(reinterpret_cast<char *>(tile.data()), std::streamsize(tile.size())))
+            {
+                error = "truncated tile data";
+                return false;
+            }
+            for (int y = 0; y < h; y++)
+                std::memcpy(&frame[(size_t(y0 + y) * layout.width + x0) * 3], &tile[size_t(y) * w * 3],
+                            size_t(w) * 3);
+            seen++;
+        }
+        if (seen != count || (frames == 0 && count != uint32_t(layout.tile_count())))
+        {
+            error = "frame index does not match its tiles";
+            return false;
+        }
+
+        frames++;
+        rgb = frame;
+        if (changed)
+            *changed = int(count);
+        return true;
+    }
+
+private:
+    std::istream &in;
+    std::vector<unsigned char> frame;
+    int frames = 0;
+};
+
+#endif
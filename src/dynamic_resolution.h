@@ -0,0 +1,270 @@
+/**
+ * @file dynamic_resolution.h
+ * @brief Holds a target frame time by rendering animation frames at a reduced internal
+ * resolution (and, as a last resort, fewer samples) and upscaling them.
+ *
+ * The cost of a frame is roughly proportional to pixels x samples, so the
+ * controller keeps one work factor, `scale^2 * spp / full_spp`, and multiplies it by
+ * `(aim / measured)^gain` after frames outside the band, where the aim is the
+ * middle of the band. Resolution goes down
+ * first; the sample count drops only once the scale reaches `min_scale`, and is
+ * restored before the resolution grows again.
+ *
+ * A frame time jitters by several percent even when nothing changes, so the loop is
+ * damped in three ways: frames inside the band [lower, upper] x target change
+ * nothing; the resolution grows only after `patience` consecutive frames under the
+ * band (but shrinks after a single frame over it, since a late frame is the visible
+ * failure); and the internal width moves in steps of `granularity` pixels.
+ *
+ * Reduced frames are upscaled with a joint bilateral filter guided by geometry AOVs
+ * (see geometry_aov.h): a geometry pass at the output resolution gives every output
+ * pixel its visible point, which is projected into the reduced image. The
+ * neighbouring reduced pixels are weighted bilinearly and by how well their own
+ * geometry matches (same object, similar depth and normal), so colours do not bleed
+ * across silhouettes the way they do with plain bilinear upscaling. The guide is
+ * rendered through the lens centre, so silhouettes blurred by depth of field gain
+ * little.
+ */
+
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include "constants.h"
+#include "framebuffer.h"
+#include "geometry_aov.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+/**
+ * @brief Upscales `low` to the size of `guide` with geometry-aware weights.
+ *
+ * @param low Reduced-resolution frame.
+ * @param low_geometry Geometry AOV of the reduced frame.
+ * @param low_view Camera projection of the reduced frame (same pose as `guide`).
+ * @param guide Geometry AOV at the output resolution.
+ * @param out Receives the output frame (resized to the guide).
+ * @param depth_sigma Relative depth difference at which a tap's weight falls to 1/e.
+ */
+inline void edge_aware_upsample(const framebuffer &low, const geometry_aov &low_geometry,
+                                const camera_projection &low_view, const geometry_aov &guide, framebuffer &out,
+                                double depth_sigma = 0.05)
+{
+    out.resize(guide.width, guide.height);
+    for (int j = 0; j < guide.height; j++)
+        for (int i = 0; i < guide.width; i++)
+        {
+            size_t idx = out.index(i, j);
+            uint32_t id = guide.object[idx];
+            double x, y;
+            bool in_front = id ? low_view.project(guide.position[idx], x, y)
+                               : low_view.project_direction(guide.position[idx], x, y);
+            if (!in_front)
+            {
+                x = (i + 0.5) * low.width / guide.width - 0.5;
+                y = (j + 0.5) * low.height / guide.height - 0.5;
+            }
+
+            // Tent filter of the given radius (in reduced pixels) over the 4x4 taps around
+            // (x, y); with `guided`, taps are also weighted by how well their geometry matches
+            auto gather = [&](double radius, bool guided, color &result)
+            {
+                int x0 = int(std::floor(x)) - 1, y0 = int(std::floor(y)) - 1;
+                color sum(0, 0, 0);
+                double weight = 0;
+                for (int ty = y0; ty < y0 + 4; ty++)
+                    for (int tx = x0; tx < x0 + 4; tx++)
+                    {
+                        double w = std::max(0.0, radius - std::fabs(tx - x)) * std::max(0.0, radius - std::fabs(ty - y));
+                        if (w <= 0)
+                            continue;
+                        int cx = std::clamp(tx, 0, low.width - 1), cy = std::clamp(ty, 0, low.height - 1);
+                        size_t tap = low.index(cx, cy);
+                        if (guided && low_geometry.object[tap] != id)
+                            continue;
+                        if (guided && id)
+                        {
+                            double d = (low_geometry.distance[tap] - guide.distance[idx]) /
+                                       (depth_sigma * guide.distance[idx]);
+                            double n = std::max(0.0, dot(low_geometry.normal[tap], guide.normal[idx]));
+                            w *= std::exp(-d * d) * n * n * n * n;
+                        }
+                        sum += w * low.resolve(cx, cy);
+                        weight += w;
+                    }
+                if (weight <= 1e-6)
+                    return false;
+                result = sum / weight;
+                return true;
+            };
+
+            // Bilinear taps first (sharpest); a pixel whose surface none of them saw looks
+            // further out, and a feature the reduced frame missed entirely (thin, or
+            // seen only between reduced pixel centres) falls back to plain bilinear
+            color c;
+            if (!gather(1.0, true, c) && !gather(2.0, true, c))
+                gather(1.0, false, c);
+            out.add_sample(i, j, c);
+        }
+}
+
+/**
+ * @class dynamic_resolution
+ * @brief Chooses the internal resolution and sample count of each frame from the
+ * time the previous frames took.
+ */
+class dynamic_resolution
+{
+public:
+    double target_seconds = 0; ///< Frame time to hold
+    double min_scale = 0.25;   ///< Smallest internal resolution, as a fraction of the output width
+    double max_scale = 1.0;    ///< Largest internal resolution
+    int min_spp = 1;           ///< Fewest samples per pixel once the scale is at its minimum
+    double lower = 0.8;        ///< Frames faster than lower x target (for `patience` frames) raise the quality
+    double upper = 1.1;        ///< Frames slower than upper x target lower the quality at once
+    int patience = 3;          ///< Consecutive fast frames needed before raising the quality
+    double gain = 0.5;         ///< Exponent of the correction applied per step (1 = jump to the estimate)
+    int granularity = 8;       ///< Internal widths are multiples of this many pixels
+
+    /** @brief What the last frame rendered with and how long it took. */
+    struct report
+    {
+        double seconds = 0; ///< Geometry passes, render pass and upscaling
+        int width = 0;      ///< Internal resolution
+        int height = 0;
+        int spp = 0;
+        bool changed = false; ///< The controller picked a different setting for the next frame
+    };
+
+    /** @brief Totals over all frames. */
+    struct totals
+    {
+        int frames = 0;
+        int changes = 0;      ///< Frames after which the setting changed
+        int within_band = 0;  ///< Frames that took between lower and upper x target
+        double seconds = 0;   ///< Sum of the frame times
+        double squares = 0;   ///< Sum of the squared frame times
+
+        double mean() const { return frames ? seconds / frames : 0; }
+        double stddev() const { return frames ? std::sqrt(std::max(0.0, squares / frames - mean() * mean())) : 0; }
+    };
+
+    report last;
+    totals total;
+
+    /**
+     * @brief Starts at the full quality of `full_width` pixels and `full_spp` samples.
+     *
+     * `render_frame` calls this on its first frame with the camera's settings.
+     */
+    void reset(int full_width, int full_spp)
+    {
+        output_width = full_width;
+        samples = full_spp;
+        work = max_scale * max_scale;
+        fast_frames = 0;
+        total = totals();
+    }
+
+    /** @brief Internal width the next frame is rendered at. */
+    int width() const
+    {
+        int w = int(std::lround(output_width * scale() / granularity)) * granularity;
+        return std::clamp(w, std::min(granularity, output_width), output_width);
+    }
+
+    /** @brief Samples per pixel of the next frame. */
+    int spp() const
+    {
+        double min_work = min_scale * min_scale;
+        if (work >= min_work)
+            return samples;
+        return std::clamp(int(std::lround(samples * work / min_work)), min_spp, samples);
+    }
+
+    /** @brief Internal resolution of the next frame, as a fraction of the output width. */
+    double scale() const { return std::clamp(std::sqrt(work), min_scale, max_scale); }
+
+    /**
+     * @brief Feeds the time of a finished frame into the controller.
+     * @return True if the next frame uses a different resolution or sample count.
+     */
+    bool update(double seconds)
+    {
+        total.frames++;
+        total.seconds += seconds;
+        total.squares += seconds * seconds;
+
+        int old_width = width(), old_spp = spp();
+        double ratio = seconds / target_seconds;
+        if (ratio >= lower && ratio <= upper)
+        {
+            total.within_band++;
+            fast_frames = 0;
+            return false;
+        }
+        if (ratio < lower && ++fast_frames < patience)
+            return false;
+        fast_frames = 0;
+
+        double min_work = min_scale * min_scale * double(min_spp) / samples;
+        // Aim at the middle of the band, so the next small drift does not leave it again
+        double aim = (lower + upper) / 2;
+        work = std::clamp(work * std::pow(aim / ratio, gain), min_work, max_scale * max_scale);
+        bool changed = width() != old_width || spp() != old_spp;
+        if (changed)
+            total.changes++;
+        return changed;
+    }
+
+    /**
+     * @brief Renders the next frame of `cam` into `fb` at the output resolution and
+     * updates the controller with its time.
+     *
+     * The camera's `image_width` and `samples_per_pixel` define the output and are
+     * left unchanged.
+     */
+    void render_frame(camera &cam, const hittable &world, framebuffer &fb)
+    {
+        if (output_width != cam.image_width)
+            reset(cam.image_width, cam.samples_per_pixel);
+        auto start = std::chrono::steady_clock::now();
+
+        last = report();
+        last.width = width();
+        last.spp = spp();
+        if (last.width == output_width)
+        {
+            cam.render_pass(world, fb, 0, last.spp);
+            last.height = fb.height;
+        }
+        else
+        {
+            int full_width = cam.image_width;
+            cam.image_width = last.width;
+            cam.render_geometry(world, low_geometry);
+            low.clear(); // render_pass only clears on a size change; keep earlier poses out
+            cam.render_pass(world, low, 0, last.spp);
+            camera_projection low_view = cam.projection();
+            last.height = low.height;
+
+            cam.image_width = full_width;
+            cam.render_geometry(world, guide);
+            edge_aware_upsample(low, low_geometry, low_view, guide, fb);
+        }
+
+        last.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        last.changed = update(last.seconds);
+    }
+
+private:
+    int output_width = 0;
+    int samples = 1;         ///< Full sample count
+    double work = 1;         ///< scale^2 x spp / full spp of the next frame
+    int fast_frames = 0;     ///< Consecutive frames under the band
+    framebuffer low;
+    geometry_aov low_geometry, guide;
+};
+
+#endif
@@ -0,0 +1,288 @@
+/**
+ * @file float_codec.h
+ * @brief Lossless compression of float and double streams: XOR prediction, byte-plane
+ * shuffling and a Huffman coder per plane.
+ *
+ * General purpose compressors do poorly on floating point data because the bytes
+ * of one value have nothing in common with each other. Neighbouring values do,
+ * however: sign, exponent and the top of the mantissa are mostly the same. Each
+ * value is therefore XORed with its predecessor, which turns those shared bits into
+ * zeros, and the results are split into byte planes (byte k of every value in one
+ * plane). The top planes are then highly skewed and compress to a fraction of a bit
+ * per value, and a plane that never changes (the weight of a box-filtered pass,
+ * sky pixels that sum exactly) costs two bytes.
+ *
+ * Every plane is stored in the cheapest of three forms: constant (one byte), raw,
+ * or Huffman coded with at most 12-bit codes (built with the PNG encoder's
+ * `huffman_lengths`). The low mantissa bytes of accumulated radiance are noise and
+ * stay raw, which bounds the ratio at about 1.7 for double accumulation buffers.
+ *
+ * Plane layout:
+ *
+ *     raw       uint8 0, n bytes
+ *     constant  uint8 1, uint8 value
+ *     huffman   uint8 2, 128 bytes of 4-bit code lengths (symbol 2k in the low
+ *               nibble of byte k), uint32 m, m bytes of codes (LSB first)
+ */
+
+#ifndef FLOAT_CODEC_H
+#define FLOAT_CODEC_H
+
+#include "png_encoder.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+/** @brief How a byte plane is stored. */
+enum class plane_mode : uint8_t
+{
+    raw = 0,
+    constant = 1,
+    huffman = 2,
+};
+
+static const int plane_code_bits = 12; ///< Longest Huffman code (and decoder table index width)
+
+/**
+ * @brief Appends byte plane `plane[0, n)` in its cheapest form to `out`.
+ * @param freq Histogram of the plane's bytes (256 entries).
+ */
+inline void encode_byte_plane(const unsigned char *plane, size_t n, const uint32_t *freq,
+                              std::vector<unsigned char> &out)
+{
+    if (n > 0 && freq[plane[0]] == n)
+    {
+        out.push_back(uint8_t(plane_mode::constant));
+        out.push_back(plane[0]);
+        return;
+    }
+
+    // Noise planes (the low mantissa bytes) stay raw; the order-0 entropy bounds
+    // what Huffman could save, so the code is only built when it can win
+    double entropy_bits = 0;
+    for (int b = 0; b < 256; b++)
+        if (freq[b])
+            entropy_bits -= freq[b] * std::log2(double(freq[b]) / n);
+    if (n == 0 || 128 + 4 + entropy_bits / 8 >= n)
+    {
+        out.push_back(uint8_t(plane_mode::raw));
+        out.insert(out.end(), plane, plane + n);
+        return;
+    }
+
+    std::vector<uint8_t> lengths;
+    huffman_lengths(std::vector<uint32_t>(freq, freq + 256), plane_code_bits, lengths);
+    uint64_t bits = 0;
+    for (int s = 0; s < 256; s++)
+        bits += uint64_t(freq[s]) * lengths[s];
+    size_t coded = size_t((bits + 7) / 8);
+    if (128 + 4 + coded >= n)
+    {
+        out.push_back(uint8_t(plane_mode::raw));
+        out.insert(out.end(), plane, plane + n);
+        return;
+    }
+
+    std::vector<uint16_t> codes;
+    huffman_codes(lengths, codes);
+    out.push_back(uint8_t(plane_mode::huffman));
+    for (int s = 0; s < 256; s += 2)
+        out.push_back(uint8_t(lengths[s] | lengths[s + 1] << 4));
+    for (int b = 0; b < 4; b++)
+        out.push_back((unsigned char)(coded >> (8 * b)));
+
+    size_t start = out.size();
+    out.resize(start + coded + 8); // slack for the 32-bit flushes below
+    unsigned char *dst = out.data() + start;
+    uint64_t buffer = 0;
+    int used = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        buffer |= uint64_t(codes[plane[i]]) << used;
+        used += lengths[plane[i]];
+        if (used >= 32)
+        {
+            for (int b = 0; b < 4; b++)
+                *dst++ = (unsigned char)(buffer >> (8 * b));
+            buffer >>= 32;
+            used -= 32;
+        }
+    }
+    while (used > 0)
+    {
+        *dst++ = (unsigned char)buffer;
+        buffer >>= 8;
+        used -= 8;
+    }
+    out.resize(start + coded);
+}
+
+/** @brief Appends byte plane `plane[0, n)` in its cheapest form to `out`. */
+inline void encode_byte_plane(const unsigned char *plane, size_t n, std::vector<unsigned char> &out)
+{
+    // Four histograms, so consecutive increments do not wait for each other
+    uint32_t freq[4][256] = {};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        freq[0][plane[i]]++;
+        freq[1][plane[i + 1]]++;
+        freq[2][plane[i + 2]]++;
+        freq[3][plane[i + 3]]++;
+    }
+    for (; i < n; i++)
+        freq[0][plane[i]]++;
+    for (int b = 0; b < 256; b++)
+        freq[0][b] += freq[1][b] + freq[2][b] + freq[3][b];
+    encode_byte_plane(plane, n, freq[0], out);
+}
+
+/**
+ * @brief Decodes one byte plane of `n` bytes from `[p, end)` and advances `p`.
+ * @return False if the data is truncated or not a valid plane.
+ */
+inline bool decode_byte_plane(const unsigned char *&p, const unsigned char *end, unsigned char *plane, size_t n)
+{
+    if (p >= end)
+        return false;
+    auto mode = plane_mode(*p++);
+    if (mode == plane_mode::raw)
+    {
+        if (size_t(end - p) < n)
+            return false;
+        std::memcpy(plane, p, n);
+        p += n;
+        return true;
+    }
+    if (mode == plane_mode::constant)
+    {
+        if (p >= end)
+            return false;
+        std::memset(plane, *p++, n);
+        return true;
+    }
+    if (mode != plane_mode::huffman || size_t(end - p) < 128 + 4)
+        return false;
+
+    // Canonical codes from the lengths; reject over-subscribed sets, which would
+    // overwrite table entries, and leave unused entries 0 (invalid)
+    std::vector<uint8_t> lengths(256);
+    uint32_t kraft = 0;
+    for (int s = 0; s < 256; s++)
+    {
+        lengths[s] = (p[s / 2] >> (4 * (s & 1))) & 15;
+        if (lengths[s] > plane_code_bits)
+            return false;
+        if (lengths[s])
+            kraft += 1u << (plane_code_bits - lengths[s]);
+    }
+    if (kraft > (1u << plane_code_bits))
+        return false;
+    p += 128;
+    size_t coded = size_t(p[0]) | size_t(p[1]) << 8 | size_t(p[2]) << 16 | size_t(p[3]) << 24;
+    p += 4;
+    if (size_t(end - p) < coded)
+        return false;
+
+    std::vector<uint16_t> codes;
+    huffman_codes(lengths, codes);
+    std::vector<uint16_t> table(size_t(1) << plane_code_bits, 0); // symbol << 4 | length
+    for (int s = 0; s < 256; s++)
+        for (uint32_t k = codes[s]; lengths[s] && k < table.size(); k += 1u << lengths[s])
+            table[k] = uint16_t(s << 4 | lengths[s]);
+
+    const unsigned char *q = p, *q_end = p + coded;
+    uint64_t buffer = 0;
+    int bits = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (bits < plane_code_bits)
+        {
+            if (q_end - q >= 4)
+            {
+                // 32 bits at a time (assembled bytewise, so independent of endianness)
+                buffer |= (uint64_t(q[0]) | uint64_t(q[1]) << 8 | uint64_t(q[2]) << 16 | uint64_t(q[3]) << 24) << bits;
+                q += 4;
+                bits += 32;
+            }
+            else
+                while (bits <= 56 && q < q_end)
+                {
+                    buffer |= uint64_t(*q++) << bits;
+                    bits += 8;
+                }
+        }
+        uint16_t entry = table[buffer & ((1u << plane_code_bits) - 1)];
+        int length = entry & 15;
+        if (length == 0 || length > bits)
+            return false;
+        plane[i] = (unsigned char)(entry >> 4);
+        buffer >>= length;
+        bits -= length;
+    }
+    p = q_end;
+    return true;
+}
+
+/** @brief Unsigned integer with the bits of a float (uint32_t) or double (uint64_t). */
+template <typename T>
+using float_bits = typename std::conditional<sizeof(T) == 8, uint64_t, uint32_t>::type;
+
+/** @brief Appends `n` floats or doubles to `out`, predicted, shuffled and plane coded. */
+template <typename T>
+inline void encode_float_stream(const T *values, size_t n, std::vector<unsigned char> &out)
+{
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8, "float or double");
+    std::vector<float_bits<T>> deltas(n);
+    float_bits<T> previous = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        float_bits<T> v;
+        std::memcpy(&v, &values[i], sizeof(T));
+        deltas[i] = v ^ previous;
+        previous = v;
+    }
+
+    // One plane at a time: sequential writes, and reads that stay in cache
+    out.reserve(out.size() + n * sizeof(T) + 16 * sizeof(T));
+    std::vector<unsigned char> plane(n);
+    for (size_t k = 0; k < sizeof(T); k++)
+    {
+        for (size_t i = 0; i < n; i++)
+            plane[i] = (unsigned char)(deltas[i] >> (8 * k));
+        encode_byte_plane(plane.data(), n, out);
+    }
+}
+
+/**
+ * @brief Decodes `n` values written by `encode_float_stream` from `[p, end)` and
+ * advances `p`.
+ * @return False if the data is truncated or damaged.
+ */
+template <typename T>
+inline bool decode_float_stream(const unsigned char *&p, const unsigned char *end, T *values, size_t n)
+{
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8, "float or double");
+    std::vector<float_bits<T>> deltas(n, 0);
+    std::vector<unsigned char> plane(n);
+    for (size_t k = 0; k < sizeof(T); k++)
+    {
+        if (!decode_byte_plane(p, end, plane.data(), n))
+            return false;
+        for (size_t i = 0; i < n; i++)
+            deltas[i] |= float_bits<T>(plane[i]) << (8 * k);
+    }
+
+    float_bits<T> previous = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        previous ^= deltas[i];
+        std::memcpy(&values[i], &previous, sizeof(T));
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,190 @@
+/**
+ * @file framebuffer.h
+ * @brief Defines the `framebuffer` class that accumulates pixel samples before output.
+ *
+ * Rendering is split into tiles that worker threads fill in any order, so pixels can
+ * no longer be streamed straight to the output as they are computed. The framebuffer
+ * keeps the running sum of radiance and the total sample weight for every pixel, and
+ * the image is resolved and written once all tiles of a pass have finished.
+ *
+ * An embedding application can attach its own float buffer with `attach_output`;
+ * every pixel is then resolved straight into that buffer as soon as it is
+ * rendered, so no intermediate image is made or copied.
+ */
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "constants.h"
+#include "color.h"
+#include "image_io.h"
+#include <vector>
+
+/**
+ * @class framebuffer
+ * @brief Per-pixel radiance accumulator for a rendered image.
+ *
+ * Pixels are stored row-major starting from the upper-left corner, matching the
+ * order in which the PPM output is written.
+ */
+class framebuffer
+{
+public:
+    int width = 0;  ///< Image width in pixels
+    int height = 0; ///< Image height in pixels
+
+    framebuffer() {}
+
+    /**
+     * @brief Constructs a cleared framebuffer of the given size.
+     * @param width Image width in pixels.
+     * @param height Image height in pixels.
+     */
+    framebuffer(int width, int height) { resize(width, height); }
+
+    /** @brief Resizes the framebuffer and clears every pixel. */
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        sum.assign(size_t(w) * h, color(0, 0, 0));
+        weight.assign(size_t(w) * h, 0.0);
+    }
+
+    /** @brief Resets all accumulated samples without changing the size. */
+    void clear()
+    {
+        std::fill(sum.begin(), sum.end(), color(0, 0, 0));
+        std::fill(weight.begin(), weight.end(), 0.0);
+    }
+
+    /**
+     * @brief Adds a weighted radiance sample to pixel (i, j).
+     *
+     * Tiles never overlap, so concurrent workers write disjoint pixels and no
+     * synchronisation is needed.
+     */
+    void add_sample(int i, int j, const color &c, double w = 1.0) { add_weighted(i, j, w * c, w); }
+
+    /**
+     * @brief Adds an already weighted radiance sum and its total weight to pixel (i, j),
+     * e.g. filtered samples splatted from a tile (see pixel_filter.h).
+     */
+    void add_weighted(int i, int j, const color &weighted_sum, double w)
+    {
+        size_t idx = index(i, j);
+        sum[idx] += weighted_sum;
+        weight[idx] += w;
+
+        if (output && weight[idx] > 0)
+        {
+            color resolved = sum[idx] / weight[idx];
+            float *p = output + size_t(j) * output_stride + size_t(i) * output_channels;
+            p[0] = float(resolved.x());
+            p[1] = float(resolved.y());
+            p[2] = float(resolved.z());
+            if (output_channels == 4)
+                p[3] = 1.0f;
+        }
+    }
+
+    /**
+     * @brief Resolves pixels into a caller-owned buffer as they are rendered.
+     * @param pixels Linear RGB (channels = 3) or RGBA (channels = 4) floats, or
+     *               nullptr to detach.
+     * @param channels 3 or 4; alpha is written as 1.
+     * @param row_stride Floats between the starts of consecutive rows
+     *                   (0 = width * channels).
+     */
+    void attach_output(float *pixels, int channels = 3, size_t row_stride = 0)
+    {
+        output = pixels;
+        output_channels = channels;
+        output_stride = row_stride ? row_stride : size_t(width) * channels;
+    }
+
+    /** @brief Returns the resolved (averaged) color of pixel (i, j). */
+    color resolve(int i, int j) const
+    {
+        size_t idx = index(i, j);
+        return weight[idx] > 0 ? sum[idx] / weight[idx] : color(0, 0, 0);
+    }
+
+    /** @brief Returns the whole resolved image. */
+    float_image resolved() const
+    {
+        float_image img(width, height);
+        for (int j = 0; j < height; j++)
+            for (int i = 0; i < width; i++)
+                img.at(i, j) = resolve(i, j);
+        return img;
+    }
+
+    /** @brief Returns the resolved image as 8-bit RGB, quantised like `write_color`. */
+    std::vector<unsigned char> resolved_rgb8() const
+    {
+        static const interval intensity(0.000, 0.999);
+        std::vector<unsigned char> rgb(size_t(width) * height * 3);
+        for (int j = 0; j < height; j++)
+            for (int i = 0; i < width; i++)
+            {
+                color c = resolve(i, j);
+                for (int k = 0; k < 3; k++)
+                    rgb[index(i, j) * 3 + k] = (unsigned char)(256 * intensity.clamp(c[k]));
+            }
+        return rgb;
+    }
+
+    /** @brief Returns the linear index of pixel (i, j). */
+    size_t index(int i, int j) const { return size_t(j) * width + i; }
+
+    std::vector<color> sum;     ///< Weighted radiance sum per pixel
+    std::vector<double> weight; ///< Total sample weight per pixel
+
+private:
+    float *output = nullptr;  ///< Optional caller-owned output buffer
+    int output_channels = 3;  ///< Floats per pixel in `output`
+    size_t output_stride = 0; ///< Floats per row in `output`
+};
+
+/**
+ * @brief Writes the resolved framebuffer as an ASCII PPM (P3) image.
+ * @param out Output stream (typically an image file or console).
+ * @param fb The framebuffer to write.
+ */
+inline void write_ppm(std::ostream &out, const framebuffer &fb)
+{
+    out << "P3\n"
+        << fb.width << ' ' << fb.height << "\n255\n";
+
+    for (int j = 0; j < fb.height; j++)
+        for (int i = 0; i < fb.width; i++)
+            write_color(out, fb.resolve(i, j));
+}
+
+/**
+ * @brief Writes the resolved framebuffer as a binary PPM (P6) image.
+ *
+ * Same quantisation as `write_ppm`, but a third of the size and no text parsing
+ * for the reader.
+ */
+inline void write_ppm_binary(std::ostream &out, const framebuffer &fb)
+{
+    out << "P6\n"
+        << fb.width << ' ' << fb.height << "\n255\n";
+
+    static const interval intensity(0.000, 0.999);
+    std::vector<unsigned char> row(size_t(fb.width) * 3);
+    for (int j = 0; j < fb.height; j++)
+    {
+        for (int i = 0; i < fb.width; i++)
+        {
+            color c = fb.resolve(i, j);
+            for (int k = 0; k < 3; k++)
+                row[size_t(i) * 3 + k] = (unsigned char)(256 * intensity.clamp(c[k]));
+        }
+        out.write(reinterpret_cast<const char *>(row.data()), row.size());
+    }
+}
+
+#endif
@@ -0,0 +1,100 @@
+/**
+ * @file geometry_aov.h
+ * @brief Per-pixel primary hit geometry (position, distance, normal, object) and the
+ * world-to-pixel projection of a camera pose.
+ *
+ * Both exist for temporal reprojection (see temporal.h): to reuse the samples of
+ * the previous frame, every pixel's visible point is projected into the previous
+ * camera (which gives its motion vector), and the previous frame's geometry at that
+ * spot tells whether the same surface was visible there.
+ */
+
+#ifndef GEOMETRY_AOV_H
+#define GEOMETRY_AOV_H
+
+#include "vec3.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/**
+ * @class geometry_aov
+ * @brief What the ray through each pixel centre hit first.
+ */
+class geometry_aov
+{
+public:
+    int width = 0;
+    int height = 0;
+    std::vector<point3> position;  ///< Hit point, or the unit ray direction for background pixels
+    std::vector<float> distance;   ///< Distance from the camera centre (infinity for background)
+    std::vector<vec3> normal;      ///< Surface normal facing the camera (zero for background)
+    std::vector<uint32_t> object;  ///< Object identifier, 0 for background
+
+    /** @brief Resizes all buffers. */
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        size_t n = size_t(w) * h;
+        position.assign(n, point3());
+        distance.assign(n, 0.0f);
+        normal.assign(n, vec3());
+        object.assign(n, 0);
+    }
+
+    /** @brief Records a surface hit at pixel (i, j). */
+    void set_hit(int i, int j, const point3 &p, double dist, const vec3 &n, uint32_t id)
+    {
+        size_t idx = size_t(j) * width + i;
+        position[idx] = p;
+        distance[idx] = float(dist);
+        normal[idx] = n;
+        object[idx] = id;
+    }
+
+    /** @brief Records that the ray through pixel (i, j) escaped along `direction`. */
+    void set_background(int i, int j, const vec3 &direction)
+    {
+        size_t idx = size_t(j) * width + i;
+        position[idx] = unit_vector(direction);
+        distance[idx] = std::numeric_limits<float>::infinity();
+        normal[idx] = vec3();
+        object[idx] = 0;
+    }
+};
+
+/**
+ * @class camera_projection
+ * @brief Maps world points to continuous pixel coordinates for one camera pose.
+ *
+ * Pixel centres are at integer coordinates. Lens offsets (defocus) are ignored:
+ * points are projected through the camera centre.
+ */
+struct camera_projection
+{
+    point3 center;  ///< Camera centre
+    point3 pixel00; ///< Centre of pixel (0, 0) on the focus plane
+    vec3 delta_u;   ///< Offset to the next pixel to the right
+    vec3 delta_v;   ///< Offset to the next pixel down
+    vec3 w;         ///< Unit vector pointing backwards out of the camera
+    double focus_dist = 1;
+
+    /** @brief Pixel coordinates of point `p`; false if it is behind the camera. */
+    bool project(const point3 &p, double &i, double &j) const { return project_direction(p - center, i, j); }
+
+    /** @brief Pixel coordinates of the point at infinity along `direction`. */
+    bool project_direction(const vec3 &direction, double &i, double &j) const
+    {
+        double depth = -dot(direction, w);
+        if (depth <= 1e-12)
+            return false;
+        vec3 on_plane = center + direction * (focus_dist / depth) - pixel00;
+        i = dot(on_plane, delta_u) / delta_u.length_squared();
+        j = dot(on_plane, delta_v) / delta_v.length_squared();
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,126 @@
+/**
+ * @file heatmap.h
+ * @brief Per-pixel render cost AOV and its false-colour / raw float output.
+ *
+ * When a `cost_aov` is attached to the camera, every pixel records how many cycles
+ * were spent on it, how many rays it traced, how many ray/primitive
+ * intersection tests those rays needed and how many camera samples it took (which
+ * varies per pixel with a sample budget, see sample_budget.h). Each metric is written twice:
+ *  - `<prefix>_<metric>.ppm`: false-colour heatmap (Turbo colormap) for viewing
+ *  - `<prefix>_<metric>.pfm`: raw 32-bit float values (Portable Float Map)
+ *
+ * Glass edges and deep metal reflections stand out immediately, which is what
+ * adaptive sampling and scene optimisation decisions are based on.
+ */
+
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include "constants.h"
+#include "color.h"
+#include "image_io.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @class cost_aov
+ * @brief Per-pixel cost buffers, accumulated over all passes of a render.
+ */
+class cost_aov
+{
+public:
+    int width = 0;
+    int height = 0;
+    std::vector<float> cycles;      ///< CPU cycles (or ns without a cycle counter) spent per pixel
+    std::vector<float> rays;        ///< Rays traced per pixel
+    std::vector<float> isect_tests; ///< Intersection tests per pixel
+    std::vector<float> samples;     ///< Camera samples per pixel (the effective spp)
+
+    /** @brief Resizes and clears all buffers. */
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        cycles.assign(size_t(w) * h, 0.0f);
+        rays.assign(size_t(w) * h, 0.0f);
+        isect_tests.assign(size_t(w) * h, 0.0f);
+        samples.assign(size_t(w) * h, 0.0f);
+    }
+
+    /** @brief Adds the cost of rendering some samples of pixel (i, j). */
+    void add(int i, int j, uint64_t pixel_cycles, uint64_t pixel_rays, uint64_t pixel_tests, int pixel_samples)
+    {
+        size_t idx = size_t(j) * width + i;
+        cycles[idx] += float(pixel_cycles);
+        rays[idx] += float(pixel_rays);
+        isect_tests[idx] += float(pixel_tests);
+        samples[idx] += float(pixel_samples);
+    }
+};
+
+/**
+ * @brief Maps t in [0, 1] to the Turbo colormap (polynomial approximation).
+ *
+ * Dark blue for cheap pixels through green and yellow to dark red for hot ones.
+ */
+inline color turbo_colormap(double t)
+{
+    t = std::clamp(t, 0.0, 1.0);
+    double t2 = t * t, t3 = t2 * t, t4 = t3 * t, t5 = t4 * t;
+    double r = 0.13572138 + 4.61539260 * t - 42.66032258 * t2 + 132.13108234 * t3 - 152.94239396 * t4 + 59.28637943 * t5;
+    double g = 0.09140261 + 2.19418839 * t + 4.84296658 * t2 - 14.18503333 * t3 + 4.27729857 * t4 + 2.82956604 * t5;
+    double b = 0.10667330 + 12.64194608 * t - 60.58204836 * t2 + 110.36276771 * t3 - 89.90310912 * t4 + 27.34824973 * t5;
+    return color(std::clamp(r, 0.0, 1.0), std::clamp(g, 0.0, 1.0), std::clamp(b, 0.0, 1.0));
+}
+
+/**
+ * @brief Writes `values` as a false-colour PPM heatmap.
+ *
+ * Values are normalised to the 99th percentile so a handful of extreme pixels do
+ * not wash out the rest of the image.
+ */
+inline void write_heatmap_ppm(std::ostream &out, const std::vector<float> &values, int width, int height)
+{
+    std::vector<float> sorted(values);
+    float scale = 0;
+    if (!sorted.empty())
+    {
+        auto nth = sorted.begin() + (sorted.size() - 1) * 99 / 100;
+        std::nth_element(sorted.begin(), nth, sorted.end());
+        scale = *nth;
+    }
+
+    out << "P3\n"
+        << width << ' ' << height << "\n255\n";
+    for (float v : values)
+        write_color(out, turbo_colormap(scale > 0 ? v / scale : 0));
+}
+
+/**
+ * @brief Writes heatmap and raw float files for every metric of `aov`.
+ * @param aov The recorded cost buffers.
+ * @param prefix Output path prefix, e.g. "cost" gives cost_cycles.ppm, cost_cycles.pfm, ...
+ */
+inline void write_cost_aov(const cost_aov &aov, const std::string &prefix)
+{
+    const std::pair<const char *, const std::vector<float> *> metrics[] = {
+        {"cycles", &aov.cycles},
+        {"rays", &aov.rays},
+        {"isect_tests", &aov.isect_tests},
+        {"samples", &aov.samples},
+    };
+
+    for (const auto &metric : metrics)
+    {
+        std::ofstream ppm(prefix + "_" + metric.first + ".ppm");
+        write_heatmap_ppm(ppm, *metric.second, aov.width, aov.height);
+
+        std::ofstream pfm(prefix + "_" + metric.first + ".pfm", std::ios::binary);
+        write_pfm(pfm, *metric.second, aov.width, aov.height);
+    }
+}
+
+#endif
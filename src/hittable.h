@@ -18,6 +18,9 @@
 #include "constants.h"
 #include "ray.h"
 #include "interval.h"
+#include "aabb.h"
+
+#include <atomic>
 
 class material;
 
@@ -46,6 +49,9 @@ public:
 
   bool front_face;
 
+  /** @brief Identifies the object that was hit (see `allocate_object_ids`) */
+  uint32_t object = 0;
+
   void set_face_normal(const ray &r, const vec3 &outward_normal)
   {
     // Sets the hit record normal vector.
@@ -56,6 +62,18 @@ public:
   }
 };
 
+/**
+ * @brief Reserves `count` consecutive object identifiers and returns the first.
+ *
+ * Identifiers are unique within the process and never 0, so per-pixel object IDs
+ * (see geometry_aov.h) can tell surfaces apart even when they share a material.
+ */
+inline uint32_t allocate_object_ids(uint32_t count)
+{
+  static std::atomic<uint32_t> next{1};
+  return next.fetch_add(count, std::memory_order_relaxed);
+}
+
 /**
  * @class hittable
  * @brief Abstract base class representing any object that can be hit by a ray.
@@ -82,6 +100,13 @@ public:
    * @note This is a pure virtual function and must be overridden in all derived classes.
    */
   virtual bool hit(const ray &r, interval ray_t, hit_record &rec) const = 0;
+
+  /**
+   * @brief Returns an axis-aligned box enclosing the whole object.
+   *
+   * Used to build the bounding volume hierarchy (see `bvh.h`).
+   */
+  virtual aabb bounding_box() const = 0;
 };
 
 #endif
\ No newline at end of file
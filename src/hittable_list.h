@@ -40,13 +40,21 @@ public:
     /**
      * @brief Removes all objects from the list.
      */
-    void clear() { objects.clear(); }
+    void clear()
+    {
+        objects.clear();
+        bbox = aabb();
+    }
 
     /**
      * @brief Adds a new hittable object to the list.
      * @param object Shared pointer to the hittable object.
      */
-    void add(shared_ptr<hittable> object) { objects.push_back(object); }
+    void add(shared_ptr<hittable> object)
+    {
+        objects.push_back(object);
+        bbox = aabb(bbox, object->bounding_box());
+    }
 
     /**
      * @brief Checks for the nearest intersection of a ray with any object in the list.
@@ -77,6 +85,12 @@ public:
 
         return hit_anything;
     }
+
+    /** @brief Returns the box enclosing every object in the list. */
+    aabb bounding_box() const override { return bbox; }
+
+private:
+    aabb bbox; ///< Union of the bounding boxes of all objects
 };
 
 #endif
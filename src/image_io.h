@@ -0,0 +1,119 @@
+/**
+ * @file image_io.h
+ * @brief Reading and writing floating point images (Portable Float Map).
+ *
+ * PFM is the simplest lossless float format: a short text header followed by raw
+ * little- or big-endian 32-bit floats, rows stored bottom-to-top. "Pf" holds one
+ * channel, "PF" holds RGB. It is used for raw AOV data and for the reference
+ * images of the image quality regression test.
+ */
+
+#ifndef IMAGE_IO_H
+#define IMAGE_IO_H
+
+#include "color.h"
+
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @class float_image
+ * @brief A row-major RGB float image, first row at the top.
+ */
+struct float_image
+{
+    int width = 0;
+    int height = 0;
+    std::vector<color> pixels;
+
+    float_image() {}
+    float_image(int w, int h) : width(w), height(h), pixels(size_t(w) * h) {}
+
+    color &at(int i, int j) { return pixels[size_t(j) * width + i]; }
+    const color &at(int i, int j) const { return pixels[size_t(j) * width + i]; }
+};
+
+/** @brief Writes one float as 4 little-endian bytes. */
+inline void write_float_le(std::ostream &out, float v)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &v, 4);
+    unsigned char bytes[4];
+    for (int b = 0; b < 4; b++)
+        bytes[b] = (unsigned char)(bits >> (8 * b));
+    out.write(reinterpret_cast<const char *>(bytes), 4);
+}
+
+/**
+ * @brief Writes `values` as a single channel little-endian Portable Float Map.
+ *
+ * PFM stores rows bottom-to-top; the negative scale marks little-endian data.
+ */
+inline void write_pfm(std::ostream &out, const std::vector<float> &values, int width, int height)
+{
+    out << "Pf\n"
+        << width << ' ' << height << "\n-1.0\n";
+    for (int j = height - 1; j >= 0; j--)
+        for (int i = 0; i < width; i++)
+            write_float_le(out, values[size_t(j) * width + i]);
+}
+
+/** @brief Writes an RGB image as a little-endian "PF" Portable Float Map. */
+inline void write_pfm(std::ostream &out, const float_image &img)
+{
+    out << "PF\n"
+        << img.width << ' ' << img.height << "\n-1.0\n";
+    for (int j = img.height - 1; j >= 0; j--)
+        for (int i = 0; i < img.width; i++)
+            for (int c = 0; c < 3; c++)
+                write_float_le(out, float(img.at(i, j)[c]));
+}
+
+/**
+ * @brief Reads an RGB ("PF") or greyscale ("Pf") Portable Float Map.
+ *
+ * Greyscale data is replicated into all three channels.
+ *
+ * @return false when the stream is not a valid PFM file.
+ */
+inline bool read_pfm(std::istream &in, float_image &img)
+{
+    std::string magic;
+    int w = 0, h = 0;
+    double scale = 0;
+    if (!(in >> magic >> w >> h >> scale) || (magic != "PF" && magic != "Pf") || w <= 0 || h <= 0)
+        return false;
+    in.get(); // single whitespace byte before the data
+
+    int channels = magic == "PF" ? 3 : 1;
+    bool little_endian = scale < 0;
+    img = float_image(w, h);
+
+    for (int j = h - 1; j >= 0; j--)
+    {
+        for (int i = 0; i < w; i++)
+        {
+            color &c = img.at(i, j);
+            for (int ch = 0; ch < channels; ch++)
+            {
+                unsigned char bytes[4];
+                if (!in.read(reinterpret_cast<char *>(bytes), 4))
+                    return false;
+                uint32_t bits = 0;
+                for (int b = 0; b < 4; b++)
+                    bits |= uint32_t(bytes[little_endian ? b : 3 - b]) << (8 * b);
+                float v;
+                std::memcpy(&v, &bits, 4);
+                c[ch] = v;
+            }
+            if (channels == 1)
+                c = color(c[0], c[0], c[0]);
+        }
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,115 @@
+/**
+ * @file image_metrics.h
+ * @brief Image error metrics: MSE, relative MSE and SSIM.
+ *
+ * - MSE weighs all errors equally and is dominated by bright pixels.
+ * - relMSE divides each squared error by the squared reference value, so dark and
+ *   bright regions count alike (the usual metric for Monte Carlo renders).
+ * - SSIM compares local luminance, contrast and structure and tracks perceived
+ *   similarity much better than either; 1 means identical.
+ */
+
+#ifndef IMAGE_METRICS_H
+#define IMAGE_METRICS_H
+
+#include "image_io.h"
+
+#include <cmath>
+#include <vector>
+
+/** @brief Mean squared error over all pixels and channels. */
+inline double image_mse(const float_image &a, const float_image &ref)
+{
+    double sum = 0;
+    for (size_t n = 0; n < ref.pixels.size(); n++)
+        sum += (a.pixels[n] - ref.pixels[n]).length_squared();
+    return sum / (3.0 * ref.pixels.size());
+}
+
+/**
+ * @brief Relative mean squared error, (a - ref)^2 / (ref^2 + eps) averaged.
+ * @param eps Keeps near-black reference pixels from dominating.
+ */
+inline double image_relmse(const float_image &a, const float_image &ref, double eps = 1e-2)
+{
+    double sum = 0;
+    for (size_t n = 0; n < ref.pixels.size(); n++)
+        for (int c = 0; c < 3; c++)
+        {
+            double d = a.pixels[n][c] - ref.pixels[n][c];
+            double r = ref.pixels[n][c];
+            sum += d * d / (r * r + eps);
+        }
+    return sum / (3.0 * ref.pixels.size());
+}
+
+/** @brief Rec. 709 luminance of a linear color. */
+inline double luminance(const color &c)
+{
+    return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+}
+
+/**
+ * @brief Mean structural similarity (SSIM) of the luminance channels.
+ *
+ * Uses the standard 11x11 Gaussian window (sigma 1.5) and constants for a dynamic
+ * range of 1. Values are clamped to [0, 1] first so a few fireflies do not
+ * dominate the statistics.
+ */
+inline double image_ssim(const float_image &a, const float_image &ref)
+{
+    const int radius = 5;
+    const double sigma = 1.5;
+    const double c1 = 0.01 * 0.01, c2 = 0.03 * 0.03;
+
+    int w = ref.width, h = ref.height;
+    std::vector<double> x(size_t(w) * h), y(size_t(w) * h);
+    for (size_t n = 0; n < x.size(); n++)
+    {
+        x[n] = std::fmin(std::fmax(luminance(a.pixels[n]), 0.0), 1.0);
+        y[n] = std::fmin(std::fmax(luminance(ref.pixels[n]), 0.0), 1.0);
+    }
+
+    double kernel[2 * radius + 1];
+    for (int k = -radius; k <= radius; k++)
+        kernel[k + radius] = std::exp(-k * k / (2 * sigma * sigma));
+
+    double total = 0;
+    for (int j = 0; j < h; j++)
+    {
+        for (int i = 0; i < w; i++)
+        {
+            // Window statistics, renormalised where the window leaves the image
+            double sw = 0, mx = 0, my = 0, sxx = 0, syy = 0, sxy = 0;
+            for (int dj = -radius; dj <= radius; dj++)
+            {
+                int jj = j + dj;
+                if (jj < 0 || jj >= h)
+                    continue;
+                for (int di = -radius; di <= radius; di++)
+                {
+                    int ii = i + di;
+                    if (ii < 0 || ii >= w)
+                        continue;
+                    double k = kernel[di + radius] * kernel[dj + radius];
+                    double xv = x[size_t(jj) * w + ii], yv = y[size_t(jj) * w + ii];
+                    sw += k;
+                    mx += k * xv;
+                    my += k * yv;
+                    sxx += k * xv * xv;
+                    syy += k * yv * yv;
+                    sxy += k * xv * yv;
+                }
+            }
+            mx /= sw;
+            my /= sw;
+            double vx = sxx / sw - mx * mx;
+            double vy = syy / sw - my * my;
+            double cov = sxy / sw - mx * my;
+            total += ((2 * mx * my + c1) * (2 * cov + c2)) / ((mx * mx + my * my + c1) * (vx + vy + c2));
+        }
+    }
+    return total / (double(w) * h);
+}
+
+#endif
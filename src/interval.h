@@ -40,6 +40,14 @@ public:
      */
     interval(double min, double max) : min(min), max(max) {}
 
+    /**
+     * @brief Constructs the tightest interval enclosing two intervals.
+     * @param a First interval.
+     * @param b Second interval.
+     */
+    interval(const interval &a, const interval &b)
+        : min(a.min <= b.min ? a.min : b.min), max(a.max >= b.max ? a.max : b.max) {}
+
     /**
      * @brief Returns the size (width) of the interval.
      * @return max - min
@@ -72,6 +80,16 @@ public:
         return x;
     }
 
+    /**
+     * @brief Returns the interval padded by `delta` (half on each side).
+     * @param delta Total amount to grow by.
+     */
+    interval expand(double delta) const
+    {
+        auto padding = delta / 2;
+        return interval(min - padding, max + padding);
+    }
+
     static const interval empty;     ///< Represents no valid range (min > max)
     static const interval universe;  ///< Represents full numeric range (-∞, +∞)
 };
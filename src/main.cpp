@@ -7,10 +7,32 @@
  */
 
 #include "constants.h"
+#include "accum_file.h"
 #include "hittable.h"
 #include "hittable_list.h"
 #include "sphere.h"
 #include "color.h"
+#include "scenes.h"
+#include "autotune.h"
+#include "bvh.h"
+#include "delta_frames.h"
+#include "dynamic_resolution.h"
+#include "metrics_server.h"
+#include "output_pipeline.h"
+#include "sample_budget.h"
+#include "scene_gen.h"
+#include "shared_scene.h"
+#include "temporal.h"
+#include "trace.h"
+#include "video_stream.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
 
 /**
  * @brief Computes the intersection between a ray and a sphere.
@@ -39,86 +61,906 @@ double hit_sphere(const point3 &center, double radius, const ray &r)
     return (h - std::sqrt(discriminant)) / a;
 }
 
+/**
+ * @brief Reports how many samples a sample budget saved compared with spending
+ * `samples_per_pixel` on every pixel of `frames` frames.
+ */
+void report_sample_budget(const camera &cam, uint64_t samples, int frames)
+{
+    uint64_t uniform = uint64_t(cam.image_width) * cam.height() * cam.samples_per_pixel * frames;
+    std::clog << "Sample budget: " << samples << " samples instead of " << uniform << " ("
+              << 100.0 * (1 - double(samples) / uniform) << "% saved), " << double(samples) / uniform * cam.samples_per_pixel
+              << " spp on average\n";
+}
+
+/**
+ * @class turntable_options
+ * @brief How a turntable animation is rendered and where its frames go.
+ */
+struct turntable_options
+{
+    int frames = 0;
+    double orbit = 2.0;                    ///< Degrees the camera moves per frame
+    const char *pattern = "frame_%04d.ppm"; ///< printf pattern of the frame files
+    bool use_schedule = true;              ///< Plan tiles from the previous frame's costs
+    video_stream *video = nullptr;         ///< Stream frames here instead of writing files
+    const char *delta_path = nullptr;      ///< Write one delta file instead of frame files
+    std::ostream *delta_file = nullptr;    ///< The opened `delta_path`
+    int temporal_spp = 0;                  ///< New samples per frame on top of reprojected history (0 = off)
+    double target_seconds = 0;             ///< Frame time to hold by scaling the internal resolution (0 = off)
+};
+
+/**
+ * @brief Renders a turntable animation: the camera orbits its look-at point around
+ * the vertical axis by `orbit` degrees per frame.
+ *
+ * With `use_schedule`, each frame's tiles are planned from the cost of the
+ * previous frame. Prints the wall time and the tail (time between the first and
+ * the last thread running out of work) of every frame. Frames are written by an
+ * `output_pipeline`, so encoding and writing frame N overlap rendering frame N+1,
+ * or, with a `video` stream, appended to it instead of written as files. With a
+ * `delta_path`, frames go into one delta file (opened by the caller as `delta_file`)
+ * that stores only changed tiles.
+ *
+ * With `temporal_spp`, every frame after the first starts from the reprojected
+ * samples of the previous one (see temporal.h) and adds only `temporal_spp` new
+ * samples per pixel; the history is capped at `samples_per_pixel`.
+ *
+ * With `target_seconds`, every frame is rendered at the internal resolution (and
+ * sample count) a `dynamic_resolution` controller picks from the previous frame
+ * times, and upscaled to the output size (see dynamic_resolution.h).
+ */
+void render_turntable(camera &cam, const hittable &scene, const turntable_options &options)
+{
+    int frames = options.frames;
+    double orbit = options.orbit;
+    bool use_schedule = options.use_schedule;
+    video_stream *video = options.video;
+    const char *delta_path = options.delta_path;
+
+    tile_schedule schedule;
+    cam.schedule = use_schedule ? &schedule : nullptr;
+    cam.show_progress = false;
+
+    temporal_accumulator temporal;
+    temporal.max_history = cam.samples_per_pixel;
+
+    dynamic_resolution dynamic;
+    dynamic.target_seconds = options.target_seconds;
+
+    output_pipeline output;
+    std::unique_ptr<delta_writer> delta;
+    vec3 offset = cam.lookfrom - cam.lookat;
+    double total = 0, total_tail = 0;
+    uint64_t samples = 0;
+    for (int f = 0; f < frames; f++)
+    {
+        double angle = degrees_to_radians(orbit * f);
+        cam.lookfrom = cam.lookat + vec3(std::cos(angle) * offset.x() + std::sin(angle) * offset.z(), offset.y(),
+                                         -std::sin(angle) * offset.x() + std::cos(angle) * offset.z());
+
+        if (cam.progress)
+            cam.progress->label = "frame " + std::to_string(f);
+        framebuffer fb;
+        if (options.temporal_spp > 0)
+        {
+            // Fresh samples must differ from the previous frames' ones, hence the first_sample offset
+            temporal.begin_frame(cam, scene, fb);
+            int spp = f == 0 ? cam.samples_per_pixel : options.temporal_spp;
+            cam.render_pass(scene, fb, f == 0 ? 0 : cam.samples_per_pixel + (f - 1) * options.temporal_spp, spp);
+            temporal.end_frame(fb);
+        }
+        else if (options.target_seconds > 0)
+            dynamic.render_frame(cam, scene, fb);
+        else
+            cam.render_pass(scene, fb, 0, cam.samples_per_pixel);
+
+        char name[1024];
+        if (video)
+        {
+            std::snprintf(name, sizeof(name), "video frame %d", f);
+            video->submit(f, std::move(fb));
+        }
+        else if (delta_path)
+        {
+            if (!delta)
+                delta = std::make_unique<delta_writer>(*options.delta_file, fb.width, fb.height);
+            int changed = delta->add_frame(fb.resolved_rgb8());
+            if (changed < 0)
+                std::cerr << "Cannot add to " << delta_path << ": " << delta->error << "\n";
+            std::snprintf(name, sizeof(name), "%s (%d tiles changed)", delta_path, std::max(changed, 0));
+        }
+        else
+        {
+            std::snprintf(name, sizeof(name), options.pattern, f);
+            output.submit(std::move(fb), name);
+        }
+
+        total += cam.last_pass.seconds;
+        samples += cam.last_pass.samples;
+        total_tail += cam.last_pass.tail_seconds;
+        std::clog << "Frame " << f << ": " << cam.last_pass.seconds << " s, tail " << cam.last_pass.tail_seconds
+                  << " s, " << cam.last_pass.work_items << " work items";
+        if (use_schedule && f > 0)
+            std::clog << " (" << schedule.splits << " tiles split)";
+        if (options.temporal_spp > 0 && f > 0)
+            std::clog << ", " << int(100 * temporal.last.reused_fraction() + 0.5) << "% reused (motion "
+                      << temporal.last.mean_motion << " px, history " << temporal.last.mean_history
+                      << " spp; rejected " << temporal.last.rejected_offscreen << " off screen, "
+                      << temporal.last.rejected_object << " object, " << temporal.last.rejected_depth << " depth, "
+                      << temporal.last.rejected_normal << " normal)";
+        if (options.target_seconds > 0)
+            std::clog << ", frame " << dynamic.last.seconds << " s at " << dynamic.last.width << "x"
+                      << dynamic.last.height << ", " << dynamic.last.spp << " spp"
+                      << (dynamic.last.changed ? " (adjusting)" : "");
+        std::clog << " -> " << name << "\n";
+    }
+    std::clog << "Average: " << total / frames << " s per frame, tail " << total_tail / frames << " s\n";
+    if (cam.budget && options.temporal_spp <= 0 && options.target_seconds <= 0)
+        report_sample_budget(cam, samples, frames);
+    if (options.target_seconds > 0)
+        std::clog << "Frame time: " << dynamic.total.mean() << " s mean (target " << options.target_seconds
+                  << " s), " << dynamic.total.stddev() << " s deviation, " << dynamic.total.within_band << " of "
+                  << dynamic.total.frames << " frames within the band, " << dynamic.total.changes
+                  << " adjustments\n";
+
+    if (delta)
+    {
+        const auto &d = delta->totals();
+        std::clog << "Delta: " << d.frames << " frames, " << d.tiles_written << " of " << d.tiles
+                  << " tiles written, " << d.bytes / 1e6 << " MB instead of " << d.raw_bytes / 1e6 << " MB, "
+                  << d.hash_matches << " hash matches (" << d.collisions << " collisions)\n";
+        if (!options.delta_file->flush())
+            std::cerr << "Cannot write " << delta_path << "\n";
+        return;
+    }
+
+    if (video)
+    {
+        const auto &streamed = video->finish();
+        std::clog << "Video: " << streamed.frames << " frames, " << streamed.bytes / 1e6 << " MB; convert "
+                  << streamed.convert_seconds << " s, write " << streamed.write_seconds << " s, renderer blocked "
+                  << streamed.blocked_seconds << " s, at most " << streamed.max_reordered << " frames reordered\n";
+        if (!streamed.error.empty())
+            std::cerr << "Video stream failed: " << streamed.error << "\n";
+        return;
+    }
+
+    const auto &written = output.finish();
+    std::clog << "Output: " << written.frames << " frames, " << written.bytes / 1e6 << " MB; resolve "
+              << written.resolve_seconds << " s, encode " << written.encode_seconds << " s, write "
+              << written.write_seconds << " s, renderer blocked " << written.blocked_seconds << " s\n";
+    for (const auto &error : written.errors)
+        std::cerr << "Cannot write " << error << "\n";
+}
+
+/**
+ * @class accum_options
+ * @brief Checkpoints and partial renders whose sums go to accumulation files.
+ */
+struct accum_options
+{
+    const char *checkpoint_path = nullptr; ///< Rewritten after every `checkpoint_every` samples
+    int checkpoint_every = 0;              ///< Samples per checkpoint (0 = an eighth of the total)
+    const char *resume_path = nullptr;     ///< Checkpoint to continue from
+    const char *save_path = nullptr;       ///< Where the sums of a sample range or region go
+    int first_sample = 0;                  ///< Sample range [first_sample, end_sample)
+    int end_sample = 0;                    ///< 0 = samples_per_pixel
+    tile_rect region{0, 0, 0, 0};          ///< Pixels to render (empty = all)
+
+    bool active() const { return checkpoint_path || resume_path || save_path; }
+};
+
+/** @brief Logs the size and codec speed of one accumulation file. */
+void report_accumulation(const char *verb, const std::string &path, const accum_info &info, const codec_report &report)
+{
+    std::clog << "Accumulation: " << verb << " " << path << " (samples " << info.first_sample << "-"
+              << info.end_sample() << ", pixels " << info.rect.x0 << "," << info.rect.y0 << "-" << info.rect.x1 << ","
+              << info.rect.y1 << "), " << report.raw_bytes / 1e6 << " MB -> " << report.bytes / 1e6 << " MB (ratio "
+              << report.ratio() << "), " << report.gigabytes_per_second() << " GB/s\n";
+}
+
+/**
+ * @brief Writes an accumulation file next to `path` and renames it into place, so an
+ * interrupted write never replaces the previous checkpoint with a damaged one.
+ */
+bool save_accumulation(const std::string &path, const framebuffer &fb, const accum_info &info, int threads)
+{
+    std::string temporary = path + ".tmp";
+    codec_report report;
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        if (!write_accumulation(out, fb, info, threads, &report) || !out.flush())
+        {
+            std::cerr << "Cannot write " << temporary << "\n";
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::cerr << "Cannot rename " << temporary << " to " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    report_accumulation("wrote", path, info, report);
+    return true;
+}
+
+/** @brief Adds the accumulation file `path` into `fb`, reporting errors. */
+bool load_accumulation(const std::string &path, framebuffer &fb, accum_info &info, int threads)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::string error;
+    codec_report report;
+    if (!in || !read_accumulation(in, fb, info, error, threads, &report))
+    {
+        std::cerr << "Cannot read " << path << ": " << (in ? error : std::strerror(errno)) << "\n";
+        return false;
+    }
+    report_accumulation("read", path, info, report);
+    return true;
+}
+
+/**
+ * @brief Sums the accumulation files in the comma-separated list `paths` and writes
+ * the resolved image to stdout.
+ *
+ * The files are the sample ranges or regions of one render, e.g. from several
+ * machines; they are added in the order given. Files whose samples overlap are
+ * rejected, since the same samples would be counted twice. Regions saved with a
+ * wide filter share the filter border with their neighbours, so overlaps up to
+ * that width are allowed.
+ */
+int merge_accumulations(const std::string &paths, int threads)
+{
+    int border = 0;
+    for (filter_type type : {filter_type::gaussian, filter_type::mitchell, filter_type::blackman_harris})
+        border = std::max(border, pixel_filter(type).border());
+
+    framebuffer fb;
+    std::stringstream list(paths);
+    std::vector<std::pair<std::string, accum_info>> merged;
+    uint64_t covered = 0;
+    for (std::string path; std::getline(list, path, ',');)
+    {
+        accum_info info;
+        if (!load_accumulation(path, fb, info, threads))
+            return 1;
+        for (const auto &[other_path, other] : merged)
+        {
+            int overlap_x = std::min(info.rect.x1, other.rect.x1) - std::max(info.rect.x0, other.rect.x0);
+            int overlap_y = std::min(info.rect.y1, other.rect.y1) - std::max(info.rect.y0, other.rect.y0);
+            bool same_samples = info.first_sample < other.end_sample() && other.first_sample < info.end_sample();
+            if (same_samples && overlap_x > 2 * border && overlap_y > 2 * border)
+            {
+                std::cerr << path << " overlaps " << other_path << ": both hold samples from "
+                          << std::max(info.first_sample, other.first_sample) << " of the same pixels\n";
+                return 1;
+            }
+        }
+        merged.push_back({path, info});
+        covered += uint64_t(info.rect.pixels()) * info.samples;
+    }
+    if (merged.empty())
+    {
+        std::cerr << "--merge needs at least one accumulation file\n";
+        return 1;
+    }
+    std::clog << "Merged " << double(covered) / (uint64_t(fb.width) * fb.height) << " samples per pixel on average\n";
+    write_ppm(std::cout, fb);
+    return 0;
+}
+
+/**
+ * @brief Renders with checkpoints, or one sample range or region of a distributed
+ * render (see accum_file.h).
+ *
+ * The samples are taken in passes of `checkpoint_every` (one pass without
+ * checkpoints), and every pass reseeds from its first sample, so a resumed render
+ * equals one that was never interrupted. A region is saved with the filter border
+ * around it, where its splats land. Without `save_path` the resolved image goes to
+ * stdout, like a plain render.
+ *
+ * @return The exit status.
+ */
+int render_accumulated(camera &cam, const hittable &scene, const accum_options &options)
+{
+    cam.prepare();
+    cam.crop = options.region;
+    int threads = cam.num_threads;
+    int end = options.end_sample > 0 ? options.end_sample : cam.samples_per_pixel;
+
+    framebuffer fb;
+    accum_info info;
+    info.first_sample = options.first_sample;
+    int next = options.first_sample;
+    if (options.resume_path)
+    {
+        accum_info resumed;
+        if (!load_accumulation(options.resume_path, fb, resumed, threads))
+            return 1;
+        if (resumed.width != cam.image_width || resumed.height != cam.height() ||
+            resumed.rect.pixels() != resumed.width * resumed.height)
+        {
+            std::cerr << options.resume_path << " is not a checkpoint of this " << cam.image_width << "x"
+                      << cam.height() << " render\n";
+            return 1;
+        }
+        info.first_sample = resumed.first_sample;
+        next = resumed.end_sample();
+        std::clog << "Resuming at sample " << next << " of " << end << "\n";
+    }
+
+    tile_rect area = cam.render_area();
+    int border = cam.filter.border();
+    info.width = cam.image_width;
+    info.height = cam.height();
+    info.rect = tile_rect{std::max(area.x0 - border, 0), std::max(area.y0 - border, 0),
+                          std::min(area.x1 + border, info.width), std::min(area.y1 + border, info.height)};
+
+    // Pass boundaries depend only on the total, so resuming keeps them
+    int step = options.checkpoint_path
+                   ? (options.checkpoint_every > 0 ? options.checkpoint_every : std::max(1, cam.samples_per_pixel / 8))
+                   : std::max(1, end - next);
+    while (next < end)
+    {
+        int spp = std::min(step, end - next);
+        cam.render_pass(scene, fb, next, spp);
+        next += spp;
+        info.samples = next - info.first_sample;
+        if (options.checkpoint_path && !save_accumulation(options.checkpoint_path, fb, info, threads))
+            return 1;
+    }
+    info.samples = next - info.first_sample;
+
+    if (options.save_path)
+        return save_accumulation(options.save_path, fb, info, threads) ? 0 : 1;
+    if (fb.width == 0)
+        fb.resize(info.width, info.height);
+    write_ppm(std::cout, fb);
+    return 0;
+}
+
 /**
  * @brief Program entry point.
  *
  * Builds a random 3D scene consisting of diffuse, metal, and glass spheres
  * over a large ground plane, sets up a camera with depth of field, and renders
  * the scene using path tracing.
+ *
+ * Options:
+ *  - `--threads N`   number of render worker threads (default: all hardware threads)
+ *  - `--trace FILE`  write a Chrome trace_event timeline of the render to FILE
+ *                    (needs a build with RAYCRAFT_ENABLE_TRACE)
+ *  - `--heatmap PREFIX` write per-pixel cost heatmaps (cycles, rays, intersection
+ *                    tests, samples) as PREFIX_<metric>.ppm plus raw PREFIX_<metric>.pfm
+ *                    (summed over all frames of an animation)
+ *  - `--stats`       print per-phase / per-thread statistics, including hardware
+ *                    counters (IPC, cache and branch misses) where available
+ *  - `--stats-json FILE` write the same statistics as JSON
+ *  - `--scene FILE`  render a generated scene file (see `raycraft_scenegen`)
+ *                    instead of the random spheres scene
+ *  - `--publish-scene NAME` read `--scene FILE`, build it once into the POSIX
+ *                    shared-memory segment NAME (e.g. /raycraft-city) and exit
+ *  - `--shared-scene NAME` render the scene published as NAME, mapped read-only
+ *                    instead of read and built (needs no `--scene`)
+ *  - `--shared-scene-fd N` same, from an inherited descriptor (e.g. a sealed memfd
+ *                    created with `create_shared_scene_memfd`)
+ *  - `--unlink-scene NAME` remove the segment NAME and exit (processes that mapped
+ *                    it keep their mapping)
+ *  - `--autotune`    calibrate tile size, BVH leaf size and thread count for this
+ *                    machine and scene, save them as the machine profile and exit
+ *  - `--profile FILE` machine profile to load / save (default: see `default_profile_path`)
+ *  - `--no-profile`  ignore the machine profile and use the built-in defaults
+ *  - `--frames N`    render an N-frame turntable animation (the camera orbits the
+ *                    look-at point by `--orbit DEG` per frame, default 2) into the
+ *                    files named by `--output PATTERN` (default frame_%04d.ppm;
+ *                    .pfm and .png patterns select those formats)
+ *  - `--video PATH`  stream the animation frames as one video to PATH (a file or
+ *                    FIFO, `-` for stdout) instead of writing an image per frame
+ *  - `--video-format y4m|rgb` Y4M (YUV 4:2:0, default) or headerless rgb24 frames
+ *  - `--fps N`       frame rate recorded in the Y4M header (default 30)
+ *  - `--delta FILE`  write the animation as one delta file that stores only the
+ *                    tiles that changed since the previous frame (read it back
+ *                    with `raycraft_deltaview`)
+ *  - `--temporal`    reuse samples across animation frames: each frame starts from
+ *                    the previous one reprojected (rejected where depth, normal or
+ *                    object differ) and adds `--temporal-spp N` new samples per pixel
+ *                    (default an eighth of the full sample count)
+ *  - `--target-ms N` hold a frame time of N milliseconds: each frame is rendered at
+ *                    a reduced internal resolution (and, below a quarter of the
+ *                    width, fewer samples) chosen from the previous frame times, then
+ *                    upscaled with an edge-aware filter guided by geometry AOVs
+ *  - `--foveate R`   spend the full sample count only within R (a fraction of half
+ *                    the image diagonal) of the focus point, falling off smoothly to
+ *                    `--min-spp N` (default spp / 16) at 3R
+ *  - `--focus X,Y`   focus point as fractions of the width and height (default 0.5,0.5)
+ *  - `--importance FILE` per-pixel sample density from the luminance of a PFM image
+ *                    (0 = `--min-spp`, 1 = full) instead of the radial profile
+ *  - `--filter NAME` pixel reconstruction filter: box (default), gaussian, mitchell
+ *                    or blackman-harris; the wider filters splat every sample into
+ *                    the neighbouring pixels
+ *  - `--estimator mean|median-of-means` combine each pixel's samples of a pass by
+ *                    their average (default) or by the median of `--mom-groups N`
+ *                    group means (default 5, at most 64), which rejects fireflies;
+ *                    the median needs the box filter
+ *  - `--clamp-indirect X` cap every channel of samples that bounced at least once at X
+ *  - `--no-schedule` render animation frames with the plain row-major tile order
+ *                    instead of scheduling from the previous frame's tile costs
+ *  - `--metrics-port N` serve live Prometheus metrics (rays, samples, tiles in
+ *                    flight, memory, per-thread busy time) on
+ *                    http://127.0.0.1:N/metrics while rendering
+ *  - `--progress-json` write progress as rate-limited JSON lines (percent,
+ *                    samples/s, ETA, memory) to stderr instead of the status line
+ *  - `--progress-fd N` same, to file descriptor N (e.g. a pipe set up by an orchestrator)
+ *  - `--checkpoint FILE` save the accumulated sums to FILE every `--checkpoint-every N`
+ *                    samples per pixel (default an eighth of them)
+ *  - `--resume FILE` continue the render saved in checkpoint FILE
+ *  - `--sample-range A:B` render only samples [A, B) of every pixel
+ *  - `--region X0,Y0,X1,Y1` render only the pixels [X0, X1) x [Y0, Y1)
+ *  - `--save-accum FILE` write the sums of a sample range or region to FILE instead
+ *                    of an image to stdout
+ *  - `--merge F1,F2,...` add up the accumulation files of one render and write the
+ *                    image to stdout
  */
-int main()
+int main(int argc, char *argv[])
 {
-    hittable_list world;
+    int threads = 0;
+    const char *trace_path = nullptr;
+    const char *heatmap_prefix = nullptr;
+    bool print_stats = false;
+    const char *stats_path = nullptr;
+    const char *scene_path = nullptr;
+    const char *publish_name = nullptr;
+    const char *shared_name = nullptr;
+    int shared_fd = -1;
+    bool tune = false;
+    bool use_profile = true;
+    std::string profile_path = default_profile_path();
+    turntable_options turntable;
+    bool temporal = false;
+    int metrics_port = 0;
+    int progress_fd = -1;
+    const char *video_path = nullptr;
+    video_format video_kind = video_format::y4m;
+    int fps = 30;
+    double foveate = 0;
+    double focus_x = 0.5, focus_y = 0.5;
+    const char *importance_path = nullptr;
+    int min_spp = 0;
+    filter_type filter = filter_type::box;
+    bool median_of_means = false;
+    int mom_groups = 5;
+    double clamp_indirect = 0;
+    accum_options accum;
+    bool sample_range = false;
+    const char *merge_paths = nullptr;
 
-    // Ground plane (large sphere under the scene)
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, ground_material));
-
-    // Generate random small spheres
-    for (int a = -11; a < 11; a++)
+    for (int n = 1; n < argc; n++)
     {
-        for (int b = -11; b < 11; b++)
+        if (!std::strcmp(argv[n], "--threads") && n + 1 < argc)
+            threads = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--trace") && n + 1 < argc)
+            trace_path = argv[++n];
+        else if (!std::strcmp(argv[n], "--heatmap") && n + 1 < argc)
+            heatmap_prefix = argv[++n];
+        else if (!std::strcmp(argv[n], "--stats"))
+            print_stats = true;
+        else if (!std::strcmp(argv[n], "--stats-json") && n + 1 < argc)
+            stats_path = argv[++n];
+        else if (!std::strcmp(argv[n], "--scene") && n + 1 < argc)
+            scene_path = argv[++n];
+        else if (!std::strcmp(argv[n], "--publish-scene") && n + 1 < argc)
+            publish_name = argv[++n];
+        else if (!std::strcmp(argv[n], "--shared-scene") && n + 1 < argc)
+            shared_name = argv[++n];
+        else if (!std::strcmp(argv[n], "--shared-scene-fd") && n + 1 < argc)
+            shared_fd = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--unlink-scene") && n + 1 < argc)
+        {
+            const char *name = argv[++n];
+            if (!unlink_shared_scene(name))
+            {
+                std::cerr << "Cannot remove " << name << ": " << std::strerror(errno) << "\n";
+                return 1;
+            }
+            return 0;
+        }
+        else if (!std::strcmp(argv[n], "--autotune"))
+            tune = true;
+        else if (!std::strcmp(argv[n], "--profile") && n + 1 < argc)
+            profile_path = argv[++n];
+        else if (!std::strcmp(argv[n], "--no-profile"))
+            use_profile = false;
+        else if (!std::strcmp(argv[n], "--frames") && n + 1 < argc)
+            turntable.frames = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--orbit") && n + 1 < argc)
+            turntable.orbit = std::atof(argv[++n]);
+        else if (!std::strcmp(argv[n], "--output") && n + 1 < argc)
+            turntable.pattern = argv[++n];
+        else if (!std::strcmp(argv[n], "--video") && n + 1 < argc)
+            video_path = argv[++n];
+        else if (!std::strcmp(argv[n], "--video-format") && n + 1 < argc &&
+                 parse_video_format(argv[n + 1], video_kind))
+            n++;
+        else if (!std::strcmp(argv[n], "--fps") && n + 1 < argc)
+            fps = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--delta") && n + 1 < argc)
+            turntable.delta_path = argv[++n];
+        else if (!std::strcmp(argv[n], "--temporal"))
+            temporal = true;
+        else if (!std::strcmp(argv[n], "--temporal-spp") && n + 1 < argc)
+            turntable.temporal_spp = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--target-ms") && n + 1 < argc)
+            turntable.target_seconds = std::atof(argv[++n]) / 1000;
+        else if (!std::strcmp(argv[n], "--foveate") && n + 1 < argc)
+            foveate = std::atof(argv[++n]);
+        else if (!std::strcmp(argv[n], "--focus") && n + 1 < argc &&
+                 std::sscanf(argv[n + 1], "%lf,%lf", &focus_x, &focus_y) == 2)
+            n++;
+        else if (!std::strcmp(argv[n], "--importance") && n + 1 < argc)
+            importance_path = argv[++n];
+        else if (!std::strcmp(argv[n], "--min-spp") && n + 1 < argc)
+            min_spp = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--filter") && n + 1 < argc && parse_filter_type(argv[n + 1], filter))
+            n++;
+        else if (!std::strcmp(argv[n], "--estimator") && n + 1 < argc &&
+                 (!std::strcmp(argv[n + 1], "mean") || !std::strcmp(argv[n + 1], "median-of-means")))
+            median_of_means = !std::strcmp(argv[++n], "median-of-means");
+        else if (!std::strcmp(argv[n], "--mom-groups") && n + 1 < argc)
+            mom_groups = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--clamp-indirect") && n + 1 < argc)
+            clamp_indirect = std::atof(argv[++n]);
+        else if (!std::strcmp(argv[n], "--no-schedule"))
+            turntable.use_schedule = false;
+        else if (!std::strcmp(argv[n], "--metrics-port") && n + 1 < argc)
+            metrics_port = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--progress-json"))
+            progress_fd = 2;
+        else if (!std::strcmp(argv[n], "--progress-fd") && n + 1 < argc)
+            progress_fd = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--checkpoint") && n + 1 < argc)
+            accum.checkpoint_path = argv[++n];
+        else if (!std::strcmp(argv[n], "--checkpoint-every") && n + 1 < argc)
+            accum.checkpoint_every = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--resume") && n + 1 < argc)
+            accum.resume_path = argv[++n];
+        else if (!std::strcmp(argv[n], "--sample-range") && n + 1 < argc &&
+                 std::sscanf(argv[n + 1], "%d:%d", &accum.first_sample, &accum.end_sample) == 2 &&
+                 0 <= accum.first_sample && accum.first_sample < accum.end_sample)
+            n++, sample_range = true;
+        else if (!std::strcmp(argv[n], "--region") && n + 1 < argc &&
+                 std::sscanf(argv[n + 1], "%d,%d,%d,%d", &accum.region.x0, &accum.region.y0, &accum.region.x1,
+                             &accum.region.y1) == 4)
+            n++;
+        else if (!std::strcmp(argv[n], "--save-accum") && n + 1 < argc)
+            accum.save_path = argv[++n];
+        else if (!std::strcmp(argv[n], "--merge") && n + 1 < argc)
+            merge_paths = argv[++n];
+        else
         {
-            auto choose_mat = random_double();
-            point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+            std::cerr << "Usage: " << argv[0]
+                      << " [--threads N] [--trace FILE] [--heatmap PREFIX] [--stats] [--stats-json FILE]"
+                         " [--scene FILE] [--autotune] [--profile FILE] [--no-profile]\n"
+                         "       [--frames N] [--orbit DEG] [--output PATTERN] [--no-schedule] [--metrics-port N]\n"
+                         "       [--progress-json] [--progress-fd N] [--video PATH|-] [--video-format y4m|rgb]"
+                         " [--fps N] [--delta FILE]\n"
+                         "       [--temporal] [--temporal-spp N] [--target-ms N]\n"
+                         "       [--foveate R] [--focus X,Y] [--importance FILE.pfm] [--min-spp N]\n"
+                         "       [--filter box|gaussian|mitchell|blackman-harris] [--estimator mean|median-of-means]"
+                         " [--mom-groups N]\n"
+                         "       [--clamp-indirect X] [--publish-scene NAME] [--shared-scene NAME]"
+                         " [--shared-scene-fd N] [--unlink-scene NAME]\n"
+                         "       [--checkpoint FILE] [--checkpoint-every N] [--resume FILE] [--sample-range A:B]"
+                         " [--region X0,Y0,X1,Y1]\n"
+                         "       [--save-accum FILE] [--merge FILE,FILE,...]\n";
+            return 1;
+        }
+    }
+
+#ifdef RAYCRAFT_ENABLE_TRACE
+    if (trace_path)
+        trace::enable();
+#else
+    if (trace_path)
+        std::cerr << "Warning: tracing was compiled out, rebuild with RAYCRAFT_ENABLE_TRACE to use --trace\n";
+#endif
+
+    // Merging needs no scene
+    if (merge_paths)
+        return merge_accumulations(merge_paths, threads);
+
+    render_stats stats;
+    render_stats *stats_ptr = (print_stats || stats_path) ? &stats : nullptr;
+
+    if (mom_groups < 1 || mom_groups > max_mom_groups)
+    {
+        std::cerr << "--mom-groups must be between 1 and " << max_mom_groups << "\n";
+        return 1;
+    }
+    // Splatted samples are spread over several pixels, which have no groups to take a median of
+    if (median_of_means && filter != filter_type::box)
+    {
+        std::cerr << "--estimator median-of-means needs the box filter (--filter box)\n";
+        return 1;
+    }
 
-            // Ensure spheres don't overlap with the main center area
-            if ((center - point3(4, 0.2, 0)).length() > 0.9)
+    bool shared = shared_name || shared_fd >= 0;
+    if (publish_name && !scene_path)
+    {
+        std::cerr << "--publish-scene needs a scene file (--scene FILE)\n";
+        return 1;
+    }
+    if (shared && (scene_path || tune))
+    {
+        std::cerr << "--shared-scene cannot be combined with --scene or --autotune\n";
+        return 1;
+    }
+
+    hittable_list world;
+    sphere_set generated;
+    shared_scene mapped;
+    {
+        RAYCRAFT_TRACE_SCOPE("scene build", "scene");
+        phase_scope scene_phase(stats_ptr, "scene build");
+        if (shared)
+        {
+            auto start = std::chrono::steady_clock::now();
+            std::string error;
+            if (shared_name ? !mapped.attach(shared_name, error) : !mapped.attach_fd(shared_fd, error))
+            {
+                std::cerr << "Cannot map shared scene: " << error << "\n";
+                return 1;
+            }
+            std::clog << "Mapped shared scene: " << mapped.sphere_count() << " spheres, " << mapped.mapped_bytes() / 1e6
+                      << " MB in "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                      << " ms\n";
+        }
+        else if (scene_path)
+        {
+            std::ifstream scene_file(scene_path, std::ios::binary);
+            std::string error;
+            if (!read_scene(scene_file, generated, error))
             {
-                shared_ptr<material> sphere_material;
-
-                if (choose_mat < 0.8)
-                {
-                    // Diffuse (Lambertian)
-                    auto albedo = color::random() * color::random();
-                    sphere_material = make_shared<lambertian>(albedo);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-                else if (choose_mat < 0.95)
-                {
-                    // Metal
-                    auto albedo = color::random(0.5, 1);
-                    auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-                else
-                {
-                    // Glass (Dielectric)
-                    sphere_material = make_shared<dielectric>(1.5);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
+                std::cerr << "Cannot read scene " << scene_path << ": " << error << "\n";
+                return 1;
             }
         }
+        else
+            world = random_spheres_scene();
     }
 
-    // Three main large spheres
-    auto material1 = make_shared<dielectric>(1.5);             // Glass sphere
-    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
+    // Machine profile written by --autotune; an explicit --threads still wins
+    tuning_profile profile;
+    if (use_profile && !tune && load_profile(profile_path, profile))
+        std::clog << "Using machine profile " << profile_path << " (" << profile.describe() << ")\n";
+    if (threads > 0)
+        profile.threads = threads;
 
-    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1)); // Diffuse sphere
-    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+    // Acceleration structure
+    shared_ptr<hittable> accel;
+    auto build_accel = [&](int leaf_size) -> const hittable &
+    {
+        RAYCRAFT_TRACE_SCOPE("acceleration build", "scene");
+        phase_scope accel_phase(stats_ptr, "acceleration build");
+        if (shared)
+            return mapped; // built by the publisher
+        if (scene_path)
+        {
+            generated.build(leaf_size, profile.threads);
+            return generated;
+        }
+        accel = make_shared<bvh>(world, leaf_size, profile.threads);
+        return *accel;
+    };
+    const hittable &scene = build_accel(profile.leaf_size);
 
-    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0); // Mirror-like sphere
-    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+    if (publish_name)
+    {
+        std::string error;
+        if (!publish_shared_scene(generated, publish_name, error))
+        {
+            std::cerr << "Cannot publish " << publish_name << ": " << error << "\n";
+            return 1;
+        }
+        std::clog << "Published " << generated.spheres.size() << " spheres as " << publish_name << " ("
+                  << shared_scene_layout(generated).total_bytes / 1e6 << " MB)\n";
+        return 0;
+    }
 
     // Camera setup
     camera cam;
-    cam.aspect_ratio = 16.0 / 9.0;
+    if (shared)
+        generated_scene_view(cam, mapped);
+    else if (scene_path)
+        generated_scene_view(cam, generated);
+    else
+        random_spheres_view(cam);
     cam.image_width = 400;
     cam.samples_per_pixel = 50;
     cam.max_depth = 10;
 
-    // Camera position and orientation
-    cam.vfov = 20;
-    cam.lookfrom = point3(13, 2, 3);
-    cam.lookat = point3(0, 0, 0);
-    cam.vup = vec3(0, 1, 0);
+    if (tune)
+    {
+        std::clog << "Autotuning on " << machine_id() << "\n";
+        auto result = autotune(cam, build_accel);
+        std::clog << "Best: " << result.best.describe() << " after " << result.renders << " calibration renders\n"
+                  << "Defaults: " << result.default_seconds << " s, tuned: " << result.best_seconds << " s ("
+                  << (result.gain() - 1) * 100 << "% faster)\n";
+        if (!save_profile(profile_path, result.best, result.gain()))
+        {
+            std::cerr << "Cannot write profile " << profile_path << "\n";
+            return 1;
+        }
+        std::clog << "Saved profile to " << profile_path << "\n";
+        return 0;
+    }
+
+    // Render configuration
+    cam.tile_size = profile.tile_size;
+    cam.num_threads = profile.threads;
+    cam.stats = stats_ptr;
+    cam.filter = pixel_filter(filter);
+    cam.estimator = median_of_means ? estimator_type::median_of_means : estimator_type::mean;
+    cam.mom_groups = mom_groups;
+    cam.clamp_indirect = clamp_indirect;
+    sample_guard guard;
+    cam.guard = &guard;
 
-    // Depth of field configuration
-    cam.defocus_angle = 0.6;
-    cam.focus_dist = 10.0;
+    cost_aov cost;
+    if (heatmap_prefix)
+        cam.cost = &cost;
 
-    // Render the final image
-    cam.render(world);
+    // Per-pixel sample budget; each pixel is stratified over its own sample count
+    sample_budget budget;
+    if (foveate > 0 || importance_path)
+    {
+        cam.prepare();
+        double floor = double(min_spp > 0 ? std::min(min_spp, cam.samples_per_pixel)
+                                          : std::max(1, cam.samples_per_pixel / 16)) /
+                       cam.samples_per_pixel;
+        if (importance_path)
+        {
+            std::ifstream importance_file(importance_path, std::ios::binary);
+            float_image importance;
+            if (!read_pfm(importance_file, importance))
+            {
+                std::cerr << "Cannot read importance image " << importance_path << " (expected PFM)\n";
+                return 1;
+            }
+            budget.from_importance(importance, floor);
+        }
+        else
+            budget.foveated(cam.image_width, cam.height(), focus_x, focus_y, foveate, 3 * foveate, floor);
+        cam.budget = &budget;
+        cam.sampler = sampler_type::stratified;
+    }
+
+    render_metrics metrics;
+    std::unique_ptr<metrics_server> metrics_endpoint;
+    if (metrics_port > 0)
+    {
+        metrics_endpoint = std::make_unique<metrics_server>(metrics_port, [&metrics](std::ostream &out)
+                                                            { metrics.write_prometheus(out); });
+        if (!metrics_endpoint->ok())
+        {
+            std::cerr << "Cannot serve metrics on port " << metrics_port << ": " << metrics_endpoint->error << "\n";
+            return 1;
+        }
+        std::clog << "Metrics on http://127.0.0.1:" << metrics_port << "/metrics\n";
+        cam.metrics = &metrics;
+    }
+
+    progress_reporter progress(progress_format::json, progress_fd);
+    if (progress_fd >= 0)
+    {
+        // An orchestrator that stops reading must not kill the render
+        std::signal(SIGPIPE, SIG_IGN);
+        cam.progress = &progress;
+    }
+
+    bool reuse = temporal || turntable.temporal_spp > 0;
+    if ((video_path || turntable.delta_path || reuse || turntable.target_seconds > 0) && turntable.frames <= 0)
+    {
+        std::cerr << "--video, --delta, --temporal and --target-ms need an animation (--frames N)\n";
+        return 1;
+    }
+    if (reuse && turntable.target_seconds > 0)
+    {
+        std::cerr << "--temporal and --target-ms cannot be combined\n";
+        return 1;
+    }
+    if (video_path && turntable.delta_path)
+    {
+        std::cerr << "--video and --delta cannot be combined\n";
+        return 1;
+    }
+    bool region = accum.region.x1 > accum.region.x0 && accum.region.y1 > accum.region.y0;
+    if ((sample_range || region) && !accum.save_path)
+    {
+        std::cerr << "--sample-range and --region need --save-accum FILE\n";
+        return 1;
+    }
+    if (accum.resume_path && (sample_range || region))
+    {
+        std::cerr << "--resume cannot be combined with --sample-range or --region\n";
+        return 1;
+    }
+    if (accum.active() && turntable.frames > 0)
+    {
+        std::cerr << "--checkpoint, --resume and --save-accum cannot be combined with --frames\n";
+        return 1;
+    }
+
+    int status = 0;
+    if (accum.active())
+        status = render_accumulated(cam, scene, accum);
+    else if (turntable.frames > 0)
+    {
+        if (temporal && turntable.temporal_spp <= 0)
+            turntable.temporal_spp = std::max(1, cam.samples_per_pixel / 8);
+        std::unique_ptr<video_stream> video;
+        int video_fd = -1;
+        if (video_path)
+        {
+            video_fd = std::strcmp(video_path, "-") ? open(video_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)
+                                                    : STDOUT_FILENO;
+            if (video_fd < 0)
+            {
+                std::cerr << "Cannot open " << video_path << ": " << std::strerror(errno) << "\n";
+                return 1;
+            }
+            // A reader that exits (e.g. ffmpeg on an error) must fail the writes, which
+            // the stream reports, instead of killing the renderer
+            std::signal(SIGPIPE, SIG_IGN);
+            video = std::make_unique<video_stream>(video_fd, video_kind, fps);
+        }
+        std::ofstream delta_file;
+        if (turntable.delta_path)
+        {
+            delta_file.open(turntable.delta_path, std::ios::binary);
+            if (!delta_file)
+            {
+                std::cerr << "Cannot open " << turntable.delta_path << ": " << std::strerror(errno) << "\n";
+                return 1;
+            }
+            turntable.delta_file = &delta_file;
+        }
+        turntable.video = video.get();
+        render_turntable(cam, scene, turntable);
+        if (video_fd > STDOUT_FILENO)
+            close(video_fd);
+    }
+    else
+    {
+        // Render the final image
+        cam.render(scene);
+        if (cam.budget)
+            report_sample_budget(cam, cam.last_pass.samples, 1);
+    }
+
+    // Reports and exports, for stills and animations alike
+    if (guard.nans() || guard.infs() || guard.clamped())
+        guard.write_report(std::clog);
+
+    if (heatmap_prefix && cost.width > 0)
+        write_cost_aov(cost, heatmap_prefix);
+
+    if (print_stats)
+        stats.print(std::clog);
+    if (stats_path)
+    {
+        std::ofstream stats_file(stats_path);
+        stats.write_json(stats_file);
+    }
+
+#ifdef RAYCRAFT_ENABLE_TRACE
+    if (trace_path)
+    {
+        std::ofstream trace_file(trace_path);
+        trace::write_chrome_json(trace_file);
+    }
+#endif
+    return status;
 }
@@ -0,0 +1,217 @@
+/**
+ * @file metrics.h
+ * @brief Lock-free live telemetry of a render process, in Prometheus text format.
+ *
+ * The render loop reports once per finished tile, never per ray or sample: rays come
+ * from the per-thread counters the renderer keeps anyway (see counters.h), and each
+ * worker adds them to its own cache-line-sized slot with relaxed atomics, so workers
+ * never write to a shared line. Readers (the metrics endpoint) sum the slots when
+ * scraped. Rates such as rays/s are left to Prometheus (`rate(raycraft_rays_total[1m])`).
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <unistd.h>
+
+/** @brief Writes the `# HELP` and `# TYPE` lines of a metric. */
+inline void prometheus_header(std::ostream &out, const char *name, const char *type, const char *help)
+{
+    out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << "\n";
+}
+
+/** @brief Writes a metric without labels, with its header. */
+template <typename T>
+void prometheus_metric(std::ostream &out, const char *name, const char *type, const char *help, T value)
+{
+    prometheus_header(out, name, type, help);
+    out << name << ' ' << value << "\n";
+}
+
+/** @brief Returns the resident memory of this process in bytes (0 if unknown). */
+inline uint64_t process_resident_bytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    uint64_t pages = 0, resident = 0;
+    if (!(statm >> pages >> resident))
+        return 0;
+    return resident * uint64_t(sysconf(_SC_PAGESIZE));
+}
+
+/**
+ * @class render_metrics
+ * @brief Counters and gauges updated from the render loop.
+ */
+class render_metrics
+{
+public:
+    static constexpr int max_threads = 256; ///< Workers beyond this share slots
+
+    /** @brief Adds tiles that are waiting to be rendered. */
+    void tiles_queued(int64_t count) { queued.fetch_add(count, std::memory_order_relaxed); }
+
+    /** @brief A worker took a queued tile and starts rendering it. */
+    void tile_started()
+    {
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        in_flight.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief A tile is done.
+     * @param worker Index of the worker thread that rendered it.
+     * @param rays Rays traced for the tile.
+     * @param samples Pixel samples taken (pixels x spp).
+     * @param seconds Time spent on the tile.
+     */
+    void tile_finished(int worker, uint64_t rays, uint64_t samples, double seconds)
+    {
+        auto &s = slots[unsigned(worker) % max_threads];
+        s.rays.fetch_add(rays, std::memory_order_relaxed);
+        s.samples.fetch_add(samples, std::memory_order_relaxed);
+        s.tiles.fetch_add(1, std::memory_order_relaxed);
+        s.busy_ns.fetch_add(uint64_t(seconds * 1e9), std::memory_order_relaxed);
+        in_flight.fetch_sub(1, std::memory_order_relaxed);
+
+        int seen = workers.load(std::memory_order_relaxed);
+        while (worker >= seen && !workers.compare_exchange_weak(seen, worker + 1, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    /** @brief Writes the metrics (and the process memory) in Prometheus text format. */
+    void write_prometheus(std::ostream &out) const
+    {
+        uint64_t rays = 0, samples = 0, tiles = 0;
+        int count = std::min(workers.load(std::memory_order_relaxed), max_threads);
+        for (int n = 0; n < count; n++)
+        {
+            rays += slots[n].rays.load(std::memory_order_relaxed);
+            samples += slots[n].samples.load(std::memory_order_relaxed);
+            tiles += slots[n].tiles.load(std::memory_order_relaxed);
+        }
+
+        prometheus_metric(out, "raycraft_rays_total", "counter", "Rays traced (camera and scattered).", rays);
+        prometheus_metric(out, "raycraft_samples_total", "counter", "Pixel samples completed.", samples);
+        prometheus_metric(out, "raycraft_tiles_total", "counter", "Tiles completed.", tiles);
+        prometheus_metric(out, "raycraft_tiles_in_flight", "gauge", "Tiles being rendered right now.",
+                          in_flight.load(std::memory_order_relaxed));
+        prometheus_metric(out, "raycraft_tiles_queued", "gauge", "Tiles waiting for a worker.",
+                          queued.load(std::memory_order_relaxed));
+        prometheus_metric(out, "raycraft_resident_memory_bytes", "gauge", "Resident memory of the process.",
+                          process_resident_bytes());
+
+        prometheus_header(out, "raycraft_thread_busy_seconds_total", "counter",
+                          "Time each worker spent rendering tiles; rate() gives its utilisation.");
+        for (int n = 0; n < count; n++)
+            out << "raycraft_thread_busy_seconds_total{thread=\"" << n << "\"} "
+                << slots[n].busy_ns.load(std::memory_order_relaxed) * 1e-9 << "\n";
+    }
+
+private:
+    struct alignas(64) thread_slot
+    {
+        std::atomic<uint64_t> rays{0};
+        std::atomic<uint64_t> samples{0};
+        std::atomic<uint64_t> tiles{0};
+        std::atomic<uint64_t> busy_ns{0};
+    };
+
+    thread_slot slots[max_threads];
+    std::atomic<int> workers{0}; ///< Highest worker index seen + 1
+
+    alignas(64) std::atomic<int64_t> in_flight{0};
+    std::atomic<int64_t> queued{0};
+};
+
+/**
+ * @class latency_histogram
+ * @brief Lock-free latency distribution with fixed millisecond buckets.
+ *
+ * Exported as a Prometheus histogram; quantiles are estimated by interpolating
+ * within the bucket that contains them.
+ */
+class latency_histogram
+{
+public:
+    static constexpr int bucket_count = 16;
+
+    /** @brief Upper bounds of the buckets in milliseconds (the last one is +Inf). */
+    static const double *bounds()
+    {
+        static const double b[bucket_count] = {1,    2,    5,    10,    20,    50,    100,   200,
+                                               500, 1000, 2000, 5000, 10000, 30000, 60000, 1e300};
+        return b;
+    }
+
+    void add(double ms)
+    {
+        int k = 0;
+        while (k < bucket_count - 1 && ms > bounds()[k])
+            k++;
+        buckets[k].fetch_add(1, std::memory_order_relaxed);
+        sum_us.fetch_add(uint64_t(ms * 1000), std::memory_order_relaxed);
+    }
+
+    uint64_t count() const
+    {
+        uint64_t total = 0;
+        for (const auto &b : buckets)
+            total += b.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    /** @brief Estimates the `q` quantile (0..1) in milliseconds, 0 when empty. */
+    double quantile(double q) const
+    {
+        uint64_t counts[bucket_count], total = 0;
+        for (int k = 0; k < bucket_count; k++)
+            total += counts[k] = buckets[k].load(std::memory_order_relaxed);
+        if (total == 0)
+            return 0;
+
+        double rank = q * total, below = 0;
+        for (int k = 0; k < bucket_count; k++)
+        {
+            if (below + counts[k] >= rank && counts[k] > 0)
+            {
+                double lo = k > 0 ? bounds()[k - 1] : 0;
+                if (k == bucket_count - 1)
+                    return lo; // open-ended bucket: report its lower edge
+                return lo + (bounds()[k] - lo) * (rank - below) / counts[k];
+            }
+            below += counts[k];
+        }
+        return bounds()[bucket_count - 2];
+    }
+
+    /** @brief Writes the histogram in Prometheus text format (in seconds). */
+    void write_prometheus(std::ostream &out, const char *name, const char *help) const
+    {
+        prometheus_header(out, name, "histogram", help);
+        uint64_t cumulative = 0;
+        for (int k = 0; k < bucket_count; k++)
+        {
+            cumulative += buckets[k].load(std::memory_order_relaxed);
+            out << name << "_bucket{le=\"";
+            if (k == bucket_count - 1)
+                out << "+Inf";
+            else
+                out << bounds()[k] / 1000;
+            out << "\"} " << cumulative << "\n";
+        }
+        out << name << "_sum " << sum_us.load(std::memory_order_relaxed) * 1e-6 << "\n"
+            << name << "_count " << cumulative << "\n";
+    }
+
+private:
+    std::atomic<uint64_t> buckets[bucket_count] = {};
+    std::atomic<uint64_t> sum_us{0};
+};
+
+#endif
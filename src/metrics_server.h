@@ -0,0 +1,142 @@
+/**
+ * @file metrics_server.h
+ * @brief Minimal HTTP endpoint on localhost serving Prometheus metrics.
+ *
+ * One background thread answers `GET /metrics` with whatever the `collect`
+ * callback writes; anything else gets a 404. Scrapes are rare (seconds apart) and
+ * only read the lock-free counters of metrics.h, so the render loop is not slowed
+ * down by having the endpoint enabled.
+ */
+
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+/**
+ * @class metrics_server
+ * @brief Serves `/metrics` on 127.0.0.1:`port` until destroyed.
+ */
+class metrics_server
+{
+public:
+    using collect_fn = std::function<void(std::ostream &)>;
+
+    /** @brief Starts listening; check `ok()` / `error` afterwards. */
+    metrics_server(int port, collect_fn collect) : collect(std::move(collect))
+    {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(uint16_t(port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (listener < 0 || bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+            listen(listener, 16) != 0)
+        {
+            error = std::strerror(errno);
+            if (listener >= 0)
+                close(listener);
+            listener = -1;
+            return;
+        }
+        worker = std::thread([this]() { run(); });
+    }
+
+    ~metrics_server()
+    {
+        stopping = true;
+        if (worker.joinable())
+            worker.join();
+        if (listener >= 0)
+            close(listener);
+    }
+
+    metrics_server(const metrics_server &) = delete;
+    metrics_server &operator=(const metrics_server &) = delete;
+
+    bool ok() const { return listener >= 0; }
+
+    std::string error; ///< Why listening failed
+
+private:
+    collect_fn collect;
+    int listener = -1;
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+
+    void run()
+    {
+        pollfd p{listener, POLLIN, 0};
+        while (!stopping)
+        {
+            // Wake up regularly to notice `stopping`
+            if (poll(&p, 1, 200) <= 0)
+                continue;
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0)
+                continue;
+            timeval timeout{1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            respond(fd);
+            close(fd);
+        }
+    }
+
+    void respond(int fd)
+    {
+        std::string request;
+        char chunk[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192)
+        {
+            ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+            if (got <= 0)
+                return;
+            request.append(chunk, size_t(got));
+        }
+
+        std::string status = "200 OK", body;
+        if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 13, "GET /metrics?") == 0)
+        {
+            std::ostringstream out;
+            collect(out);
+            body = out.str();
+        }
+        else
+        {
+            status = "404 Not Found";
+            body = "try /metrics\n";
+        }
+
+        std::ostringstream response;
+        response << "HTTP/1.1 " << status << "\r\n"
+                 << "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                 << "Content-Length: " << body.size() << "\r\n"
+                 << "Connection: close\r\n\r\n"
+                 << body;
+        std::string bytes = response.str();
+        for (size_t sent = 0; sent < bytes.size();)
+        {
+            ssize_t n = send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+                return;
+            sent += size_t(n);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,306 @@
+/**
+ * @file output_pipeline.h
+ * @brief Asynchronous image output: resolve, encode and write on dedicated threads.
+ *
+ * Writing a frame used to block the renderer: resolving the framebuffer, formatting
+ * the image and the disk write all happened before the next frame could start.
+ * `output_pipeline` moves that work onto three threads connected by bounded queues:
+ *
+ *  1. post-process: resolves the accumulated framebuffer into display values
+ *     (8-bit for PPM and PNG, linear floats for PFM),
+ *  2. encode: formats the image into the bytes of the file (PNG with the parallel
+ *     deflate of png_encoder.h),
+ *  3. write: writes the bytes with `pwrite` in large chunks.
+ *
+ * The renderer hands a finished framebuffer over by move (no copy) and continues
+ * with the next frame while the stages work. The queues hold only a few frames;
+ * when the disk or encoder cannot keep up, `submit` blocks (backpressure) instead of
+ * letting finished frames pile up in memory, and the time spent blocked is reported.
+ */
+
+#ifndef OUTPUT_PIPELINE_H
+#define OUTPUT_PIPELINE_H
+
+#include "framebuffer.h"
+#include "image_io.h"
+#include "png_encoder.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @class bounded_queue
+ * @brief Blocking FIFO with a fixed capacity, closed by the producer when done.
+ */
+template <typename T>
+class bounded_queue
+{
+public:
+    explicit bounded_queue(size_t capacity) : capacity(capacity) {}
+
+    /** @brief Waits for room and appends `item`; returns the seconds spent waiting. */
+    double push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto start = std::chrono::steady_clock::now();
+        not_full.wait(lock, [&]() { return items.size() < capacity; });
+        std::chrono::duration<double> waited = std::chrono::steady_clock::now() - start;
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return waited.count();
+    }
+
+    /** @brief Waits for an item; false once the queue is closed and drained. */
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [&]() { return !items.empty() || closed; });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    /** @brief No more items will be pushed. */
+    void close()
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        closed = true;
+        not_empty.notify_all();
+    }
+
+private:
+    size_t capacity;
+    std::mutex mutex;
+    std::condition_variable not_full, not_empty;
+    std::deque<T> items;
+    bool closed = false;
+};
+
+/** @brief Image file formats the pipeline can encode. */
+enum class image_format
+{
+    ppm, ///< ASCII PPM (P3), the renderer's classic output
+    pfm, ///< Portable Float Map, linear radiance without quantisation
+    png  ///< 8-bit RGB PNG
+};
+
+/** @brief Picks the format from the file name extension (PPM unless it ends in .pfm or .png). */
+inline image_format format_for_path(const std::string &path)
+{
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".pfm") == 0)
+        return image_format::pfm;
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0)
+        return image_format::png;
+    return image_format::ppm;
+}
+
+/**
+ * @brief Writes `data` to `fd` with `pwrite` in large chunks, falling back to
+ * `write` for descriptors that cannot seek (pipes, terminals).
+ * @return False with `error` set on failure.
+ */
+inline bool write_file_data(int fd, const std::string &data, std::string &error)
+{
+    const size_t chunk = size_t(1) << 20;
+    bool seekable = true;
+    for (size_t offset = 0; offset < data.size();)
+    {
+        size_t size = std::min(chunk, data.size() - offset);
+        ssize_t n = seekable ? pwrite(fd, data.data() + offset, size, off_t(offset)) : -1;
+        if (n < 0 && seekable && errno == ESPIPE)
+        {
+            seekable = false;
+            continue;
+        }
+        if (!seekable)
+            n = write(fd, data.data() + offset, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            error = std::strerror(errno);
+            return false;
+        }
+        offset += size_t(n);
+    }
+    return true;
+}
+
+/**
+ * @class output_pipeline
+ * @brief Three-stage asynchronous writer of rendered frames.
+ */
+class output_pipeline
+{
+public:
+    /** @brief Time accounting of the pipeline, valid after `finish()`. */
+    struct report
+    {
+        int frames = 0;
+        double blocked_seconds = 0; ///< Renderer time spent waiting in `submit` (backpressure)
+        double resolve_seconds = 0; ///< Busy time of the post-process stage
+        double encode_seconds = 0;  ///< Busy time of the encode stage
+        double write_seconds = 0;   ///< Busy time of the write stage
+        uint64_t bytes = 0;         ///< Bytes written
+        std::vector<std::string> errors;
+    };
+
+    int png_threads = 0; ///< Threads compressing one PNG frame (0 = all hardware threads)
+
+    /** @param depth Frames each queue may hold before `submit` blocks. */
+    explicit output_pipeline(size_t depth = 2) : resolve_queue(depth), encode_queue(depth), write_queue(depth)
+    {
+        resolver = std::thread([this]() { resolve_stage(); });
+        encoder = std::thread([this]() { encode_stage(); });
+        writer = std::thread([this]() { write_stage(); });
+    }
+
+    ~output_pipeline() { finish(); }
+
+    output_pipeline(const output_pipeline &) = delete;
+    output_pipeline &operator=(const output_pipeline &) = delete;
+
+    /** @brief Queues a finished frame for writing to `path`; blocks while the queue is full. */
+    void submit(framebuffer &&fb, const std::string &path)
+    {
+        job j;
+        j.path = path;
+        j.format = format_for_path(path);
+        j.fb = std::move(fb);
+        stats.blocked_seconds += resolve_queue.push(std::move(j));
+        stats.frames++;
+    }
+
+    /** @brief Waits until every submitted frame is on disk and returns the statistics. */
+    const report &finish()
+    {
+        if (resolver.joinable())
+        {
+            resolve_queue.close();
+            resolver.join();
+            encoder.join();
+            writer.join();
+        }
+        return stats;
+    }
+
+private:
+    struct job
+    {
+        std::string path;
+        image_format format = image_format::ppm;
+        framebuffer fb;
+        int width = 0, height = 0;
+        std::vector<unsigned char> bytes8; ///< Quantised RGB (PPM, PNG)
+        float_image linear;                ///< Resolved radiance (PFM)
+        std::string encoded;
+    };
+
+    bounded_queue<job> resolve_queue, encode_queue, write_queue;
+    std::thread resolver, encoder, writer;
+    report stats; // stage fields are written by their own thread only, read after join
+
+    static double since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void resolve_stage()
+    {
+        job j;
+        while (resolve_queue.pop(j))
+        {
+            auto start = std::chrono::steady_clock::now();
+            j.width = j.fb.width;
+            j.height = j.fb.height;
+            if (j.format == image_format::pfm)
+                j.linear = j.fb.resolved();
+            else
+                j.bytes8 = j.fb.resolved_rgb8();
+            j.fb = framebuffer(); // release the accumulation buffers early
+            stats.resolve_seconds += since(start);
+            encode_queue.push(std::move(j));
+        }
+        encode_queue.close();
+    }
+
+    void encode_stage()
+    {
+        job j;
+        while (encode_queue.pop(j))
+        {
+            auto start = std::chrono::steady_clock::now();
+            std::ostringstream out;
+            if (j.format == image_format::pfm)
+            {
+                write_pfm(out, j.linear);
+                j.linear = float_image();
+            }
+            else if (j.format == image_format::png)
+            {
+                j.encoded = encode_png(j.bytes8.data(), j.width, j.height, png_threads);
+                j.bytes8.clear();
+                j.bytes8.shrink_to_fit();
+            }
+            else
+            {
+                out << "P3\n" << j.width << ' ' << j.height << "\n255\n";
+                char line[16];
+                for (size_t p = 0; p < j.bytes8.size(); p += 3)
+                {
+                    int n = std::snprintf(line, sizeof(line), "%d %d %d\n", j.bytes8[p], j.bytes8[p + 1],
+                                          j.bytes8[p + 2]);
+                    out.write(line, n);
+                }
+                j.bytes8.clear();
+                j.bytes8.shrink_to_fit();
+            }
+            if (j.format != image_format::png)
+                j.encoded = out.str();
+            stats.encode_seconds += since(start);
+            write_queue.push(std::move(j));
+        }
+        write_queue.close();
+    }
+
+    void write_stage()
+    {
+        job j;
+        while (write_queue.pop(j))
+        {
+            auto start = std::chrono::steady_clock::now();
+            std::string error;
+            int fd = open(j.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+                error = std::strerror(errno);
+            else
+            {
+                write_file_data(fd, j.encoded, error);
+                if (close(fd) != 0 && error.empty())
+                    error = std::strerror(errno);
+            }
+            if (error.empty())
+                stats.bytes += j.encoded.size();
+            else
+                stats.errors.push_back(j.path + ": " + error);
+            stats.write_seconds += since(start);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,195 @@
+/**
+ * @file perf_counters.h
+ * @brief Hardware performance counters (cycles, instructions, cache and branch misses).
+ *
+ * On Linux a `perf_counter_group` opens one `perf_event_open` group on the calling
+ * thread, so all events are scheduled onto the PMU together and their ratios (IPC,
+ * miss rates) are consistent. Counters are read with enabled/running times and
+ * scaled when the kernel had to multiplex them.
+ *
+ * Counters are frequently unavailable: containers without CAP_PERFMON, a strict
+ * `perf_event_paranoid`, virtual machines without a virtual PMU, or non-Linux
+ * platforms. In all those cases the group reports `available() == false` and every
+ * sample comes back with `valid == false`; callers simply leave the numbers out.
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @class perf_sample
+ * @brief Counter values for one measured interval (or a sum of intervals).
+ */
+struct perf_sample
+{
+    bool valid = false;         ///< False when counters could not be read
+    uint64_t cycles = 0;        ///< CPU cycles
+    uint64_t instructions = 0;  ///< Retired instructions
+    uint64_t cache_refs = 0;    ///< Last level cache references
+    uint64_t cache_misses = 0;  ///< Last level cache misses
+    uint64_t branches = 0;      ///< Retired branch instructions
+    uint64_t branch_misses = 0; ///< Mispredicted branches
+
+    /** @brief Accumulates another sample; the sum is valid if either part is. */
+    perf_sample &operator+=(const perf_sample &o)
+    {
+        if (!o.valid)
+            return *this;
+        valid = true;
+        cycles += o.cycles;
+        instructions += o.instructions;
+        cache_refs += o.cache_refs;
+        cache_misses += o.cache_misses;
+        branches += o.branches;
+        branch_misses += o.branch_misses;
+        return *this;
+    }
+
+    /** @brief Instructions per cycle. */
+    double ipc() const { return cycles ? double(instructions) / cycles : 0.0; }
+
+    /** @brief Fraction of cache references that missed. */
+    double cache_miss_rate() const { return cache_refs ? double(cache_misses) / cache_refs : 0.0; }
+
+    /** @brief Fraction of branches that were mispredicted. */
+    double branch_miss_rate() const { return branches ? double(branch_misses) / branches : 0.0; }
+};
+
+/**
+ * @class perf_counter_group
+ * @brief A group of hardware counters counting the calling thread only.
+ *
+ * The group must be started, stopped and read on the thread that created it.
+ *
+ * Example usage:
+ * @code
+ * perf_counter_group counters;
+ * counters.start();
+ * ... work ...
+ * perf_sample s = counters.stop();
+ * @endcode
+ */
+class perf_counter_group
+{
+public:
+    static const int event_count = 6;
+
+    perf_counter_group()
+    {
+#if defined(__linux__)
+        const uint64_t configs[event_count] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_REFERENCES,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES,
+        };
+
+        for (int n = 0; n < event_count; n++)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[n];
+            attr.disabled = (n == 0); // the leader starts the whole group
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            fds[n] = int(syscall(SYS_perf_event_open, &attr, 0, -1, n == 0 ? -1 : fds[0], 0));
+            if (fds[n] < 0)
+            {
+                error = std::strerror(errno);
+                close_all();
+                return;
+            }
+        }
+#else
+        error = "perf_event_open is only available on Linux";
+#endif
+    }
+
+    ~perf_counter_group() { close_all(); }
+
+    perf_counter_group(const perf_counter_group &) = delete;
+    perf_counter_group &operator=(const perf_counter_group &) = delete;
+
+    /** @brief True when every counter of the group could be opened. */
+    bool available() const { return fds[0] >= 0; }
+
+    /** @brief Reason the counters are unavailable (empty when available). */
+    const std::string &status() const { return error; }
+
+    /** @brief Resets and starts counting. */
+    void start()
+    {
+#if defined(__linux__)
+        if (!available())
+            return;
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    /** @brief Stops counting and returns the values since `start()`. */
+    perf_sample stop()
+    {
+        perf_sample s;
+#if defined(__linux__)
+        if (!available())
+            return s;
+        ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+        // Layout for PERF_FORMAT_GROUP: nr, time_enabled, time_running, values[nr]
+        uint64_t data[3 + event_count];
+        if (read(fds[0], data, sizeof(data)) != ssize_t(sizeof(data)) || data[0] != uint64_t(event_count))
+            return s;
+
+        // Scale up when the PMU was multiplexed between groups
+        double scale = (data[2] > 0 && data[2] < data[1]) ? double(data[1]) / data[2] : 1.0;
+        auto value = [&](int n)
+        { return uint64_t(double(data[3 + n]) * scale); };
+
+        s.valid = data[2] > 0;
+        s.cycles = value(0);
+        s.instructions = value(1);
+        s.cache_refs = value(2);
+        s.cache_misses = value(3);
+        s.branches = value(4);
+        s.branch_misses = value(5);
+#endif
+        return s;
+    }
+
+private:
+    int fds[event_count] = {-1, -1, -1, -1, -1, -1};
+    std::string error;
+
+    void close_all()
+    {
+#if defined(__linux__)
+        for (int &fd : fds)
+        {
+            if (fd >= 0)
+                close(fd);
+            fd = -1;
+        }
+#endif
+    }
+};
+
+#endif
@@ -0,0 +1,818 @@
+/**
+ * @file png_encoder.h
+ * @brief In-tree PNG writer with parallel deflate over row groups.
+ *
+ * A single deflate stream is inherently sequential, which makes the compression of
+ * large (8K) frames take longer than rendering them at low sample counts. Like
+ * pigz, the encoder instead cuts the filtered image into row groups and compresses
+ * each group on its own thread into a run of complete deflate blocks that ends on a
+ * byte boundary (an empty stored block, as zlib's sync flush does). Concatenated,
+ * the groups form one valid zlib stream. Matches may still reach back up to 32 KiB
+ * into the previous group, because the whole filtered image is known up front, so
+ * splitting costs almost no compression. The Adler-32 of each group is computed in
+ * parallel and combined; every group becomes one IDAT chunk whose CRC is computed on
+ * the same thread.
+ *
+ * Each row gets the PNG filter (None, Sub, Up, Average, Paeth) with the smallest
+ * sum of absolute filtered values, the usual heuristic. On x86 the filters and the
+ * sums are computed 16 bytes at a time with SSE2; the scalar path gives identical
+ * output.
+ *
+ * The compressor is a greedy LZ77 matcher with hash chains and dynamic Huffman
+ * blocks: about zlib level 3-4 in ratio, but parallel.
+ */
+
+#ifndef PNG_ENCODER_H
+#define PNG_ENCODER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define RAYCRAFT_PNG_SSE2 1
+#endif
+
+// ---------------------------------------------------------
+// Checksums
+// ---------------------------------------------------------
+
+/** @brief Updates a CRC-32 (as used by PNG chunks) with `size` bytes. */
+inline uint32_t crc32_update(uint32_t crc, const unsigned char *data, size_t size)
+{
+    static const struct table_t
+    {
+        uint32_t t[256];
+        table_t()
+        {
+            for (uint32_t n = 0; n < 256; n++)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                t[n] = c;
+            }
+        }
+    } table;
+
+    crc = ~crc;
+    for (size_t n = 0; n < size; n++)
+        crc = table.t[(crc ^ data[n]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+/** @brief Adler-32 of `size` bytes (the zlib stream checksum). */
+inline uint32_t adler32(const unsigned char *data, size_t size)
+{
+    const uint32_t base = 65521;
+    uint32_t a = 1, b = 0;
+    while (size > 0)
+    {
+        // 5552 bytes is the most that can be summed before b could overflow
+        size_t block = std::min(size, size_t(5552));
+        for (size_t n = 0; n < block; n++)
+        {
+            a += data[n];
+            b += a;
+        }
+        a %= base;
+        b %= base;
+        data += block;
+        size -= block;
+    }
+    return (b << 16) | a;
+}
+
+/** @brief Adler-32 of A followed by B, from adler(A), adler(B) and |B| (as zlib's adler32_combine). */
+inline uint32_t adler32_combine(uint32_t adler1, uint32_t adler2, uint64_t length2)
+{
+    const uint32_t base = 65521;
+    uint32_t rem = uint32_t(length2 % base);
+    uint32_t sum1 = adler1 & 0xffff;
+    uint32_t sum2 = uint32_t((uint64_t(rem) * sum1) % base);
+    sum1 += (adler2 & 0xffff) + base - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + base - rem;
+    if (sum1 >= base)
+        sum1 -= base;
+    if (sum1 >= base)
+        sum1 -= base;
+    if (sum2 >= 2 * base)
+        sum2 -= 2 * base;
+    if (sum2 >= base)
+        sum2 -= base;
+    return sum1 | (sum2 << 16);
+}
+
+// ---------------------------------------------------------
+// Row filters
+// ---------------------------------------------------------
+
+/** @brief The Paeth predictor of the PNG specification. */
+inline unsigned char paeth_predictor(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return (unsigned char)a;
+    return (unsigned char)(pb <= pc ? b : c);
+}
+
+/**
+ * @brief Applies PNG filter `type` to one row (scalar reference implementation).
+ * @param row Raw bytes of the row.
+ * @param up Raw bytes of the row above (all zero for the first row).
+ * @param out Filtered bytes.
+ * @return Sum of the filtered bytes taken as signed values, in absolute value.
+ */
+inline uint64_t png_filter_row_scalar(int type, const unsigned char *row, const unsigned char *up, unsigned char *out,
+                                      size_t size, int bpp)
+{
+    uint64_t cost = 0;
+    for (size_t x = 0; x < size; x++)
+    {
+        int a = x >= size_t(bpp) ? row[x - bpp] : 0;
+        int b = up[x];
+        int c = x >= size_t(bpp) ? up[x - bpp] : 0;
+        int pred = 0;
+        switch (type)
+        {
+        case 1:
+            pred = a;
+            break;
+        case 2:
+            pred = b;
+            break;
+        case 3:
+            pred = (a + b) >> 1;
+            break;
+        case 4:
+            pred = paeth_predictor(a, b, c);
+            break;
+        }
+        unsigned char f = (unsigned char)(row[x] - pred);
+        out[x] = f;
+        cost += f < 128 ? f : 256 - f;
+    }
+    return cost;
+}
+
+#ifdef RAYCRAFT_PNG_SSE2
+/** @brief SSE2 version of `png_filter_row_scalar` with identical output. */
+inline uint64_t png_filter_row_sse2(int type, const unsigned char *row, const unsigned char *up, unsigned char *out,
+                                    size_t size, int bpp)
+{
+    // The first pixel has no left neighbour and the tail is shorter than a vector
+    size_t head = std::min(size, size_t(bpp));
+    uint64_t cost = png_filter_row_scalar(type, row, up, out, head, bpp);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sums = zero;
+
+    size_t x = head;
+    for (; x + 16 <= size; x += 16)
+    {
+        __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x));
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x - bpp));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(up + x));
+        __m128i pred;
+        switch (type)
+        {
+        case 1:
+            pred = a;
+            break;
+        case 2:
+            pred = b;
+            break;
+        case 3:
+            // floor((a + b) / 2) = avg_epu8 rounds up, so subtract the rounding bit
+            pred = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+            break;
+        case 4:
+        {
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(up + x - bpp));
+            __m128i halves[2];
+            for (int h = 0; h < 2; h++)
+            {
+                __m128i a16 = h ? _mm_unpackhi_epi8(a, zero) : _mm_unpacklo_epi8(a, zero);
+                __m128i b16 = h ? _mm_unpackhi_epi8(b, zero) : _mm_unpacklo_epi8(b, zero);
+                __m128i c16 = h ? _mm_unpackhi_epi8(c, zero) : _mm_unpacklo_epi8(c, zero);
+                // pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|
+                __m128i bc = _mm_sub_epi16(b16, c16), ac = _mm_sub_epi16(a16, c16);
+                __m128i abc = _mm_add_epi16(bc, ac);
+                __m128i pa = _mm_max_epi16(bc, _mm_sub_epi16(zero, bc));
+                __m128i pb = _mm_max_epi16(ac, _mm_sub_epi16(zero, ac));
+                __m128i pc = _mm_max_epi16(abc, _mm_sub_epi16(zero, abc));
+                __m128i use_a = _mm_andnot_si128(_mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc)),
+                                                 _mm_set1_epi16(-1));
+                __m128i use_b = _mm_andnot_si128(_mm_cmpgt_epi16(pb, pc), _mm_set1_epi16(-1));
+                __m128i bc_pick = _mm_or_si128(_mm_and_si128(use_b, b16), _mm_andnot_si128(use_b, c16));
+                halves[h] = _mm_or_si128(_mm_and_si128(use_a, a16), _mm_andnot_si128(use_a, bc_pick));
+            }
+            pred = _mm_packus_epi16(halves[0], halves[1]);
+            break;
+        }
+        default:
+            pred = zero;
+        }
+        __m128i f = _mm_sub_epi8(r, pred);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), f);
+        // |signed byte| = min(f, -f) taken as unsigned bytes; psadbw sums them
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(_mm_min_epu8(f, _mm_sub_epi8(zero, f)), zero));
+    }
+
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), sums);
+    cost += lanes[0] + lanes[1];
+
+    // Tail: filter with the scalar code, offset so its left neighbours are real
+    for (; x < size; x++)
+    {
+        int a = row[x - bpp], b = up[x], c = up[x - bpp];
+        int pred = type == 1 ? a : type == 2 ? b : type == 3 ? (a + b) >> 1 : type == 4 ? paeth_predictor(a, b, c) : 0;
+        unsigned char f = (unsigned char)(row[x] - pred);
+        out[x] = f;
+        cost += f < 128 ? f : 256 - f;
+    }
+    return cost;
+}
+#endif
+
+/** @brief Filters one row with `type`, using SSE2 where available. */
+inline uint64_t png_filter_row(int type, const unsigned char *row, const unsigned char *up, unsigned char *out,
+                               size_t size, int bpp, bool simd = true)
+{
+#ifdef RAYCRAFT_PNG_SSE2
+    if (simd)
+        return png_filter_row_sse2(type, row, up, out, size, bpp);
+#endif
+    (void)simd;
+    return png_filter_row_scalar(type, row, up, out, size, bpp);
+}
+
+/**
+ * @brief Filters rows [y0, y1) of an image into `out` (filter byte + row each),
+ * choosing the cheapest filter per row.
+ */
+inline void png_filter_rows(const unsigned char *pixels, size_t stride, int y0, int y1, int bpp,
+                            unsigned char *out, bool simd = true)
+{
+    std::vector<unsigned char> zero_row(stride, 0), trial(stride);
+    for (int y = y0; y < y1; y++)
+    {
+        const unsigned char *row = pixels + size_t(y) * stride;
+        const unsigned char *up = y > 0 ? row - stride : zero_row.data();
+        unsigned char *dst = out + size_t(y - y0) * (stride + 1);
+
+        uint64_t best = png_filter_row(0, row, up, dst + 1, stride, bpp, simd);
+        dst[0] = 0;
+        for (int type = 1; type <= 4; type++)
+        {
+            uint64_t cost = png_filter_row(type, row, up, trial.data(), stride, bpp, simd);
+            if (cost < best)
+            {
+                best = cost;
+                dst[0] = (unsigned char)type;
+                std::memcpy(dst + 1, trial.data(), stride);
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------
+// Deflate
+// ---------------------------------------------------------
+
+/**
+ * @class deflate_bit_writer
+ * @brief Appends bits least significant first, as deflate requires.
+ */
+class deflate_bit_writer
+{
+public:
+    std::vector<unsigned char> bytes;
+
+    void put(uint32_t value, int count)
+    {
+        buffer |= uint64_t(value) << used;
+        used += count;
+        while (used >= 8)
+        {
+            bytes.push_back((unsigned char)buffer);
+            buffer >>= 8;
+            used -= 8;
+        }
+    }
+
+    /** @brief Pads to a byte boundary with zero bits. */
+    void align()
+    {
+        if (used > 0)
+            put(0, 8 - used);
+    }
+
+private:
+    uint64_t buffer = 0;
+    int used = 0;
+};
+
+/**
+ * @brief Computes Huffman code lengths of at most `limit` bits for `freq`.
+ *
+ * Builds a plain Huffman tree; while it is too deep, the frequencies are halved
+ * (keeping used symbols nonzero) and the tree is rebuilt, which flattens it.
+ */
+inline void huffman_lengths(std::vector<uint32_t> freq, int limit, std::vector<uint8_t> &lengths)
+{
+    size_t n = freq.size();
+    lengths.assign(n, 0);
+    while (true)
+    {
+        struct node
+        {
+            uint64_t weight;
+            int left, right; // -1 for leaves
+        };
+        std::vector<node> nodes;
+        std::vector<int> heap; // min-heap of node indices by weight
+        auto greater = [&](int x, int y) { return nodes[x].weight > nodes[y].weight; };
+        std::vector<int> leaf_of(n, -1);
+        for (size_t s = 0; s < n; s++)
+            if (freq[s])
+            {
+                leaf_of[s] = int(nodes.size());
+                heap.push_back(int(nodes.size()));
+                nodes.push_back(node{freq[s], -1, -1});
+            }
+        if (heap.empty())
+            return;
+        if (heap.size() == 1)
+        {
+            for (size_t s = 0; s < n; s++)
+                if (freq[s])
+                    lengths[s] = 1;
+            return;
+        }
+
+        std::make_heap(heap.begin(), heap.end(), greater);
+        while (heap.size() > 1)
+        {
+            std::pop_heap(heap.begin(), heap.end(), greater);
+            int x = heap.back();
+            heap.pop_back();
+            std::pop_heap(heap.begin(), heap.end(), greater);
+            int y = heap.back();
+            heap.pop_back();
+            nodes.push_back(node{nodes[x].weight + nodes[y].weight, x, y});
+            heap.push_back(int(nodes.size()) - 1);
+            std::push_heap(heap.begin(), heap.end(), greater);
+        }
+
+        // Depths, walking down from the root (children always precede their parent)
+        std::vector<int> depth(nodes.size(), 0);
+        int deepest = 0;
+        for (int k = int(nodes.size()) - 1; k >= 0; k--)
+            if (nodes[k].left >= 0)
+            {
+                depth[nodes[k].left] = depth[nodes[k].right] = depth[k] + 1;
+                deepest = std::max(deepest, depth[k] + 1);
+            }
+
+        if (deepest <= limit)
+        {
+            for (size_t s = 0; s < n; s++)
+                if (leaf_of[s] >= 0)
+                    lengths[s] = uint8_t(depth[leaf_of[s]]);
+            return;
+        }
+        for (auto &f : freq)
+            if (f)
+                f = (f >> 1) | 1;
+    }
+}
+
+/** @brief Canonical Huffman codes for `lengths`, bit-reversed for LSB-first output. */
+inline void huffman_codes(const std::vector<uint8_t> &lengths, std::vector<uint16_t> &codes)
+{
+    int count[16] = {0}, next[16] = {0};
+    for (uint8_t l : lengths)
+        count[l]++;
+    count[0] = 0;
+    for (int bits = 1, code = 0; bits < 16; bits++)
+    {
+        code = (code + count[bits - 1]) << 1;
+        next[bits] = code;
+    }
+    codes.assign(lengths.size(), 0);
+    for (size_t s = 0; s < lengths.size(); s++)
+    {
+        int l = lengths[s];
+        if (!l)
+            continue;
+        int code = next[l]++, reversed = 0;
+        for (int b = 0; b < l; b++)
+            reversed |= ((code >> b) & 1) << (l - 1 - b);
+        codes[s] = uint16_t(reversed);
+    }
+}
+
+/**
+ * @class deflate_block_coder
+ * @brief Collects LZ77 symbols and writes them as dynamic Huffman blocks.
+ */
+class deflate_block_coder
+{
+public:
+    explicit deflate_block_coder(deflate_bit_writer &out) : out(out) {}
+
+    void literal(unsigned char byte) { symbols.push_back(byte); }
+
+    void match(int length, int distance)
+    {
+        symbols.push_back(uint32_t(length) << 16 | uint32_t(distance) | 0x80000000u);
+    }
+
+    size_t pending() const { return symbols.size(); }
+
+    /** @brief Writes the collected symbols as one block (`final` sets BFINAL). */
+    void flush_block(bool final)
+    {
+        std::vector<uint32_t> lit_freq(286, 0), dist_freq(30, 0);
+        for (uint32_t s : symbols)
+        {
+            if (s & 0x80000000u)
+            {
+                lit_freq[257 + length_code((s >> 16) & 0x7fff)]++;
+                dist_freq[distance_code(s & 0xffff)]++;
+            }
+            else
+                lit_freq[s]++;
+        }
+        lit_freq[256] = 1;
+        // Both trees need two codes so that every decoder accepts them
+        if (std::count_if(dist_freq.begin(), dist_freq.end(), [](uint32_t f) { return f > 0; }) < 2)
+            dist_freq[0] = std::max(dist_freq[0], 1u), dist_freq[1] = std::max(dist_freq[1], 1u);
+        if (std::count_if(lit_freq.begin(), lit_freq.end(), [](uint32_t f) { return f > 0; }) < 2)
+            lit_freq[0] = 1;
+
+        std::vector<uint8_t> lit_len, dist_len;
+        huffman_lengths(lit_freq, 15, lit_len);
+        huffman_lengths(dist_freq, 15, dist_len);
+        std::vector<uint16_t> lit_code, dist_code;
+        huffman_codes(lit_len, lit_code);
+        huffman_codes(dist_len, dist_code);
+
+        int hlit = 286, hdist = 30;
+        while (hlit > 257 && lit_len[hlit - 1] == 0)
+            hlit--;
+        while (hdist > 1 && dist_len[hdist - 1] == 0)
+            hdist--;
+
+        // Run-length code the concatenated code lengths (symbols 16, 17, 18)
+        std::vector<uint8_t> all(lit_len.begin(), lit_len.begin() + hlit);
+        all.insert(all.end(), dist_len.begin(), dist_len.begin() + hdist);
+        std::vector<std::pair<uint8_t, uint8_t>> rle; // (symbol, extra value)
+        for (size_t i = 0; i < all.size();)
+        {
+            size_t run = 1;
+            while (i + run < all.size() && all[i + run] == all[i])
+                run++;
+            if (all[i] == 0 && run >= 3)
+            {
+                size_t r = std::min(run, size_t(138));
+                rle.push_back(r >= 11 ? std::make_pair(uint8_t(18), uint8_t(r - 11)) : std::make_pair(uint8_t(17), uint8_t(r - 3)));
+                i += r;
+            }
+            else if (all[i] != 0 && run >= 4)
+            {
+                rle.push_back({all[i], 0});
+                size_t r = std::min(run - 1, size_t(6));
+                rle.push_back({16, uint8_t(r - 3)});
+                i += 1 + r;
+            }
+            else
+            {
+                rle.push_back({all[i], 0});
+                i++;
+            }
+        }
+
+        std::vector<uint32_t> cl_freq(19, 0);
+        for (const auto &r : rle)
+            cl_freq[r.first]++;
+        std::vector<uint8_t> cl_len;
+        huffman_lengths(cl_freq, 7, cl_len);
+        std::vector<uint16_t> cl_code;
+        huffman_codes(cl_len, cl_code);
+        static const int order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+        int hclen = 19;
+        while (hclen > 4 && cl_len[order[hclen - 1]] == 0)
+            hclen--;
+
+        out.put(final ? 1 : 0, 1);
+        out.put(2, 2); // dynamic Huffman
+        out.put(uint32_t(hlit - 257), 5);
+        out.put(uint32_t(hdist - 1), 5);
+        out.put(uint32_t(hclen - 4), 4);
+        for (int k = 0; k < hclen; k++)
+            out.put(cl_len[order[k]], 3);
+        for (const auto &r : rle)
+        {
+            out.put(cl_code[r.first], cl_len[r.first]);
+            if (r.first == 16)
+                out.put(r.second, 2);
+            else if (r.first == 17)
+                out.put(r.second, 3);
+            else if (r.first == 18)
+                out.put(r.second, 7);
+        }
+
+        for (uint32_t s : symbols)
+        {
+            if (!(s & 0x80000000u))
+            {
+                out.put(lit_code[s], lit_len[s]);
+                continue;
+            }
+            int length = (s >> 16) & 0x7fff, distance = s & 0xffff;
+            int lc = length_code(length), dc = distance_code(distance);
+            out.put(lit_code[257 + lc], lit_len[257 + lc]);
+            if (length_extra[lc])
+                out.put(uint32_t(length - length_base[lc]), length_extra[lc]);
+            out.put(dist_code[dc], dist_len[dc]);
+            if (distance_extra[dc])
+                out.put(uint32_t(distance - distance_base[dc]), distance_extra[dc]);
+        }
+        out.put(lit_code[256], lit_len[256]);
+        symbols.clear();
+    }
+
+    /** @brief Ends a non-final run of blocks on a byte boundary (empty stored block). */
+    void sync_flush()
+    {
+        out.put(0, 1);
+        out.put(0, 2);
+        out.align();
+        out.put(0x0000, 16);
+        out.put(0xffff, 16);
+    }
+
+private:
+    deflate_bit_writer &out;
+    std::vector<uint32_t> symbols; ///< Literal byte, or 0x80000000 | length << 16 | distance
+
+    static constexpr int length_base[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                            31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static constexpr int length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                             2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static constexpr int distance_base[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                              33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                              1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    static constexpr int distance_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                               6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    static int length_code(int length)
+    {
+        int c = 0;
+        while (c < 28 && length_base[c + 1] <= length)
+            c++;
+        return c;
+    }
+
+    static int distance_code(int distance)
+    {
+        int c = 0;
+        while (c < 29 && distance_base[c + 1] <= distance)
+            c++;
+        return c;
+    }
+};
+
+/**
+ * @brief Compresses data[begin, end) into complete deflate blocks.
+ *
+ * Matches may reference data[begin - 32768, begin), so independently compressed
+ * neighbouring ranges lose almost nothing. Ends with BFINAL set if `final`,
+ * otherwise with a sync flush so the output can be concatenated with the next range.
+ */
+inline std::vector<unsigned char> deflate_range(const unsigned char *data, size_t begin, size_t end, bool final,
+                                                int max_chain = 32)
+{
+    const size_t window = 32768;
+    const int hash_bits = 15, min_match = 3, max_match = 258;
+    const size_t block_symbols = 1 << 16;
+
+    size_t origin = begin > window ? begin - window : 0;
+    std::vector<int32_t> head(size_t(1) << hash_bits, -1);
+    std::vector<int32_t> prev(end - origin, -1); // indexed by position - origin
+    auto hash = [&](size_t p)
+    { return ((uint32_t(data[p]) << 10) ^ (uint32_t(data[p + 1]) << 5) ^ data[p + 2]) & ((1u << hash_bits) - 1); };
+    auto insert = [&](size_t p)
+    {
+        if (p + min_match > end)
+            return;
+        uint32_t h = hash(p);
+        prev[p - origin] = head[h];
+        head[h] = int32_t(p - origin);
+    };
+
+    for (size_t p = origin; p < begin; p++)
+        insert(p);
+
+    deflate_bit_writer bits;
+    deflate_block_coder coder(bits);
+    for (size_t p = begin; p < end;)
+    {
+        int best_length = 0;
+        size_t best_distance = 0;
+        if (p + min_match <= end)
+        {
+            size_t limit = std::min(size_t(max_match), end - p);
+            int chain = max_chain;
+            for (int32_t candidate = head[hash(p)]; candidate >= 0 && chain-- > 0;
+                 candidate = prev[size_t(candidate)])
+            {
+                size_t q = origin + size_t(candidate);
+                if (p - q > window)
+                    break;
+                if (data[q + best_length] != data[p + best_length])
+                    continue;
+                size_t length = 0;
+                while (length < limit && data[q + length] == data[p + length])
+                    length++;
+                if (int(length) > best_length)
+                {
+                    best_length = int(length);
+                    best_distance = p - q;
+                    if (length == limit)
+                        break;
+                }
+            }
+        }
+
+        if (best_length >= min_match)
+        {
+            coder.match(best_length, int(best_distance));
+            for (int k = 0; k < best_length; k++)
+                insert(p + k);
+            p += size_t(best_length);
+        }
+        else
+        {
+            coder.literal(data[p]);
+            insert(p);
+            p++;
+        }
+        if (coder.pending() >= block_symbols && p < end)
+            coder.flush_block(false);
+    }
+
+    coder.flush_block(final);
+    if (!final)
+        coder.sync_flush();
+    bits.align();
+    return std::move(bits.bytes);
+}
+
+// ---------------------------------------------------------
+// PNG
+// ---------------------------------------------------------
+
+/**
+ * @class png_encode_stats
+ * @brief Where the time of one encode went.
+ */
+struct png_encode_stats
+{
+    double seconds = 0;     ///< Wall time of the whole encode
+    size_t raw_bytes = 0;   ///< Uncompressed pixel bytes
+    size_t png_bytes = 0;   ///< Size of the PNG file
+    int groups = 0;         ///< Row groups compressed independently
+    int threads = 0;        ///< Threads used
+
+    double megabytes_per_second() const { return seconds > 0 ? raw_bytes / seconds / 1e6 : 0; }
+};
+
+/** @brief Appends a big-endian 32-bit value. */
+inline void png_put_u32(std::string &out, uint32_t v)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back(char((v >> shift) & 0xff));
+}
+
+/** @brief Appends a PNG chunk (length, type, data, CRC). */
+inline void png_put_chunk(std::string &out, const char type[4], const unsigned char *data, size_t size,
+                          uint32_t crc)
+{
+    png_put_u32(out, uint32_t(size));
+    out.append(type, 4);
+    out.append(reinterpret_cast<const char *>(data), size);
+    png_put_u32(out, crc);
+}
+
+/**
+ * @brief Encodes 8-bit RGB pixels (rows top to bottom, `width * 3` bytes each) as PNG.
+ * @param threads Worker threads (0 = all hardware threads, 1 = single-threaded).
+ * @param simd Use the SSE2 filters where available.
+ */
+inline std::string encode_png(const unsigned char *rgb, int width, int height, int threads = 0,
+                              png_encode_stats *stats = nullptr, bool simd = true)
+{
+    auto start = std::chrono::steady_clock::now();
+    if (threads <= 0)
+        threads = int(std::max(1u, std::thread::hardware_concurrency()));
+
+    const int bpp = 3;
+    size_t stride = size_t(width) * bpp, filtered_stride = stride + 1;
+
+    // Row groups of about 256 KiB of filtered data. The split does not depend on the
+    // thread count, so neither does the file.
+    int rows_per_group = int(std::max<size_t>(1, (size_t(256) << 10) / filtered_stride));
+    int groups = (height + rows_per_group - 1) / rows_per_group;
+
+    std::vector<unsigned char> filtered(filtered_stride * height);
+    std::vector<std::vector<unsigned char>> compressed(groups);
+    std::vector<uint32_t> adlers(groups), crcs(groups);
+
+    auto run_parallel = [&](auto &&body)
+    {
+        std::atomic<int> next{0};
+        auto worker = [&]()
+        {
+            for (int g = next++; g < groups; g = next++)
+                body(g);
+        };
+        std::vector<std::thread> pool;
+        for (int t = 1; t < std::min(threads, groups); t++)
+            pool.emplace_back(worker);
+        worker();
+        for (auto &t : pool)
+            t.join();
+    };
+
+    // Filtering first, since compression of a group looks back into the previous one
+    run_parallel([&](int g)
+                 {
+                     int y0 = g * rows_per_group, y1 = std::min(height, y0 + rows_per_group);
+                     png_filter_rows(rgb, stride, y0, y1, bpp, &filtered[size_t(y0) * filtered_stride], simd);
+                 });
+    run_parallel([&](int g)
+                 {
+                     size_t begin = size_t(g) * rows_per_group * filtered_stride;
+                     size_t end = std::min(filtered.size(), begin + size_t(rows_per_group) * filtered_stride);
+                     adlers[g] = adler32(&filtered[begin], end - begin);
+                     compressed[g] = deflate_range(filtered.data(), begin, end, g == groups - 1);
+                     crcs[g] = crc32_update(crc32_update(0, reinterpret_cast<const unsigned char *>("IDAT"), 4),
+                                            compressed[g].data(), compressed[g].size());
+                 });
+
+    std::string png("\x89PNG\r\n\x1a\n", 8);
+    unsigned char ihdr[13];
+    for (int k = 0; k < 4; k++)
+    {
+        ihdr[k] = (unsigned char)(uint32_t(width) >> (24 - 8 * k));
+        ihdr[4 + k] = (unsigned char)(uint32_t(height) >> (24 - 8 * k));
+    }
+    ihdr[8] = 8;  // bit depth
+    ihdr[9] = 2;  // truecolour
+    ihdr[10] = 0; // deflate
+    ihdr[11] = 0; // adaptive filtering
+    ihdr[12] = 0; // no interlace
+    png_put_chunk(png, "IHDR", ihdr, 13,
+                  crc32_update(crc32_update(0, reinterpret_cast<const unsigned char *>("IHDR"), 4), ihdr, 13));
+
+    // The zlib header and the combined Adler-32 go into IDAT chunks of their own
+    const unsigned char zlib_header[2] = {0x78, 0x9c};
+    png_put_chunk(png, "IDAT", zlib_header, 2,
+                  crc32_update(crc32_update(0, reinterpret_cast<const unsigned char *>("IDAT"), 4), zlib_header, 2));
+    uint32_t adler = 1;
+    for (int g = 0; g < groups; g++)
+    {
+        size_t begin = size_t(g) * rows_per_group * filtered_stride;
+        size_t size = std::min(filtered.size(), begin + size_t(rows_per_group) * filtered_stride) - begin;
+        adler = g == 0 ? adlers[0] : adler32_combine(adler, adlers[g], size);
+        png_put_chunk(png, "IDAT", compressed[g].data(), compressed[g].size(), crcs[g]);
+    }
+    unsigned char trailer[4] = {(unsigned char)(adler >> 24), (unsigned char)(adler >> 16),
+                                (unsigned char)(adler >> 8), (unsigned char)adler};
+    png_put_chunk(png, "IDAT", trailer, 4,
+                  crc32_update(crc32_update(0, reinterpret_cast<const unsigned char *>("IDAT"), 4), trailer, 4));
+    png_put_chunk(png, "IEND", nullptr, 0, crc32_update(0, reinterpret_cast<const unsigned char *>("IEND"), 4));
+
+    if (stats)
+    {
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats->raw_bytes = stride * height;
+        stats->png_bytes = png.size();
+        stats->groups = groups;
+        stats->threads = threads;
+    }
+    return png;
+}
+
+#endif
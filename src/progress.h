@@ -0,0 +1,179 @@
+/**
+ * @file progress.h
+ * @brief Rate-limited progress reporting for render passes.
+ *
+ * Tiles finish in any order on many threads, so a "remaining" counter rewritten on
+ * every tile says little and floods the terminal. `progress_reporter` instead emits
+ * at most one update per `interval` with the completed fraction, the sample
+ * throughput, an ETA and the process memory, either as a human-readable status line
+ * or as JSON lines for an orchestrator:
+ *
+ * @code
+ * {"event":"start","pid":123,"label":"frame 0","tiles":375,"samples":4500000,"threads":8}
+ * {"event":"progress","pid":123,"label":"frame 0","percent":41.3,"tiles_done":155,"tiles_total":375,
+ *  "samples_per_sec":2.1e6,"elapsed":0.88,"eta":1.25,"rss_bytes":7081984}
+ * {"event":"done","pid":123,"label":"frame 0","elapsed":2.13,"samples_per_sec":2.1e6,"cancelled":false}
+ * @endcode
+ *
+ * The ETA comes from the measured cost of the finished tiles: busy seconds per
+ * sample so far, times the samples left, spread over the worker threads. Unlike
+ * extrapolating the elapsed time it stays right when the expensive tiles are
+ * rendered first (see tile_schedule.h) or some threads sit idle at the end.
+ *
+ * Every event is one `write` to a file descriptor, so lines from several reporters
+ * sharing stderr are never interleaved. A reader that goes away must not kill the
+ * render: callers writing to a pipe ignore SIGPIPE, and failed writes are dropped.
+ */
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include "metrics.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+/** @brief How progress is written. */
+enum class progress_format
+{
+    text, ///< Status line rewritten in place with '\r'
+    json  ///< One JSON object per line
+};
+
+/**
+ * @class progress_reporter
+ * @brief Turns per-tile completions into rate-limited progress events.
+ *
+ * Not thread-safe: the camera calls it from one thread at a time.
+ */
+class progress_reporter
+{
+public:
+    progress_format format;
+    int fd;                ///< Where events are written (2 = stderr)
+    double interval = 0.5; ///< Minimum seconds between two progress events
+    std::string label;     ///< Included in every event, e.g. a job or frame name
+
+    progress_reporter(progress_format format = progress_format::text, int fd = STDERR_FILENO)
+        : format(format), fd(fd) {}
+
+    /** @brief A pass of `tiles` tiles and `samples` pixel samples starts on `threads` workers. */
+    void begin(int tiles, uint64_t samples, int threads)
+    {
+        tiles_total = tiles;
+        samples_total = samples;
+        worker_threads = threads > 0 ? threads : 1;
+        tiles_done = 0;
+        samples_done = 0;
+        busy_seconds = 0;
+        start = last_event = std::chrono::steady_clock::now();
+
+        if (format == progress_format::json)
+        {
+            std::ostringstream e;
+            open_event(e, "start");
+            e << ",\"tiles\":" << tiles << ",\"samples\":" << samples << ",\"threads\":" << worker_threads << "}\n";
+            emit(e.str());
+        }
+    }
+
+    /** @brief A tile with `samples` pixel samples finished after `seconds` of work. */
+    void tile_done(uint64_t samples, double seconds)
+    {
+        tiles_done++;
+        samples_done += samples;
+        busy_seconds += seconds;
+
+        auto now = std::chrono::steady_clock::now();
+        if (std::chrono::duration<double>(now - last_event).count() < interval || tiles_done == tiles_total)
+            return;
+        last_event = now;
+
+        double elapsed = seconds_since_start(now);
+        double percent = samples_total ? 100.0 * samples_done / samples_total : 100.0;
+        double rate = elapsed > 0 ? samples_done / elapsed : 0;
+        double eta = samples_done ? busy_seconds / samples_done * (samples_total - samples_done) / worker_threads : 0;
+
+        std::ostringstream e;
+        if (format == progress_format::json)
+        {
+            open_event(e, "progress");
+            e << ",\"percent\":" << percent << ",\"tiles_done\":" << tiles_done << ",\"tiles_total\":" << tiles_total
+              << ",\"samples_per_sec\":" << rate << ",\"elapsed\":" << elapsed << ",\"eta\":" << eta
+              << ",\"rss_bytes\":" << process_resident_bytes() << "}\n";
+        }
+        else
+        {
+            e.precision(3);
+            e << "\r" << (label.empty() ? "" : label + ": ") << int(percent) << "%, " << rate / 1e6
+              << " Msamples/s, ETA " << eta << " s      ";
+        }
+        emit(e.str());
+    }
+
+    /** @brief The pass is over (possibly cancelled before every tile was done). */
+    void end(bool cancelled)
+    {
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = seconds_since_start(now);
+        double rate = elapsed > 0 ? samples_done / elapsed : 0;
+
+        std::ostringstream e;
+        if (format == progress_format::json)
+        {
+            open_event(e, "done");
+            e << ",\"elapsed\":" << elapsed << ",\"samples_per_sec\":" << rate
+              << ",\"cancelled\":" << (cancelled ? "true" : "false") << "}\n";
+        }
+        else
+        {
+            e.precision(3);
+            e << "\r" << (label.empty() ? "" : label + ": ") << (cancelled ? "Cancelled" : "Done") << " in "
+              << elapsed << " s, " << rate / 1e6 << " Msamples/s      \n";
+        }
+        emit(e.str());
+    }
+
+private:
+    int tiles_total = 0, tiles_done = 0, worker_threads = 1;
+    uint64_t samples_total = 0, samples_done = 0;
+    double busy_seconds = 0; ///< Sum of the finished tiles' render times
+    std::chrono::steady_clock::time_point start, last_event;
+
+    double seconds_since_start(std::chrono::steady_clock::time_point now) const
+    {
+        return std::chrono::duration<double>(now - start).count();
+    }
+
+    void open_event(std::ostringstream &e, const char *event) const
+    {
+        e << "{\"event\":\"" << event << "\",\"pid\":" << getpid() << ",\"label\":\"";
+        for (char c : label)
+        {
+            if (c == '"' || c == '\\')
+                e << '\\';
+            if (c >= 0x20)
+                e << c;
+        }
+        e << '"';
+    }
+
+    void emit(const std::string &line) const
+    {
+        for (size_t written = 0; written < line.size();)
+        {
+            ssize_t n = ::write(fd, line.data() + written, line.size() - written);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return; // a closed progress channel must not stop the render (SIGPIPE is ignored)
+            written += size_t(n);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,315 @@
+/**
+ * @file raycraft.cpp
+ * @brief Implementation of the C API declared in raycraft.h.
+ *
+ * A thin layer over the header-only renderer: `rc_scene` wraps a `sphere_set`,
+ * `rc_renderer` owns the cancellation flag and the statistics of its renders.
+ * Every entry point catches exceptions so none cross the C boundary.
+ */
+
+#include "raycraft.h"
+
+#include "constants.h"
+#include "scene_file.h"
+#include "sphere_set.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <new>
+
+struct rc_scene
+{
+    sphere_set spheres;
+    bool committed = false;
+};
+
+struct rc_renderer
+{
+    std::atomic<bool> cancel{false};
+    std::atomic<bool> busy{false};      // claimed by rc_render, guards against concurrent use
+    std::atomic<bool> rendering{false}; // published once the progress counters are reset
+    std::atomic<int> tiles_done{0};
+    std::atomic<int> tiles_total{0};
+
+    mutable std::mutex stats_lock; // guards the fields below
+    double seconds = 0;
+    uint64_t rays = 0;
+    uint64_t isect_tests = 0;
+};
+
+/** @brief Runs `body`, translating exceptions into status codes. */
+template <typename Body>
+static rc_status guarded(Body body)
+{
+    try
+    {
+        return body();
+    }
+    catch (const std::bad_alloc &)
+    {
+        return RC_ERROR_OUT_OF_MEMORY;
+    }
+    catch (...)
+    {
+        return RC_ERROR_INTERNAL;
+    }
+}
+
+/** @brief Adds a material to the table and reports its id. */
+static rc_status add_material(rc_scene *scene, const material_desc &m, uint32_t *material_id)
+{
+    if (!scene || !material_id)
+        return RC_ERROR_INVALID_ARGUMENT;
+    return guarded([&]()
+                   {
+                       *material_id = uint32_t(scene->spheres.materials.size());
+                       scene->spheres.materials.push_back(m);
+                       scene->committed = false;
+                       return RC_OK; });
+}
+
+extern "C"
+{
+
+uint32_t rc_version(void) { return RAYCRAFT_API_VERSION; }
+
+const char *rc_status_string(rc_status status)
+{
+    switch (status)
+    {
+    case RC_OK:
+        return "ok";
+    case RC_ERROR_INVALID_ARGUMENT:
+        return "invalid argument";
+    case RC_ERROR_INVALID_STATE:
+        return "invalid state";
+    case RC_ERROR_CANCELLED:
+        return "cancelled";
+    case RC_ERROR_IO:
+        return "i/o error";
+    case RC_ERROR_OUT_OF_MEMORY:
+        return "out of memory";
+    case RC_ERROR_INTERNAL:
+        return "internal error";
+    }
+    return "unknown status";
+}
+
+rc_scene *rc_scene_create(void) { return new (std::nothrow) rc_scene(); }
+
+void rc_scene_destroy(rc_scene *scene) { delete scene; }
+
+rc_status rc_scene_add_lambertian(rc_scene *scene, float r, float g, float b, uint32_t *material_id)
+{
+    material_desc m;
+    m.kind = material_kind::lambertian;
+    m.albedo[0] = r;
+    m.albedo[1] = g;
+    m.albedo[2] = b;
+    return add_material(scene, m, material_id);
+}
+
+rc_status rc_scene_add_metal(rc_scene *scene, float r, float g, float b, float fuzz, uint32_t *material_id)
+{
+    if (!(fuzz >= 0 && fuzz <= 1))
+        return RC_ERROR_INVALID_ARGUMENT;
+    material_desc m;
+    m.kind = material_kind::metal;
+    m.albedo[0] = r;
+    m.albedo[1] = g;
+    m.albedo[2] = b;
+    m.param = fuzz;
+    return add_material(scene, m, material_id);
+}
+
+rc_status rc_scene_add_dielectric(rc_scene *scene, float refraction_index, uint32_t *material_id)
+{
+    if (!(refraction_index > 0))
+        return RC_ERROR_INVALID_ARGUMENT;
+    material_desc m;
+    m.kind = material_kind::dielectric;
+    m.param = refraction_index;
+    return add_material(scene, m, material_id);
+}
+
+rc_status rc_scene_add_sphere(rc_scene *scene, float x, float y, float z, float radius, uint32_t material_id)
+{
+    if (!scene || !(radius > 0) || material_id >= scene->spheres.materials.size())
+        return RC_ERROR_INVALID_ARGUMENT;
+    return guarded([&]()
+                   {
+                       scene->spheres.spheres.push_back(packed_sphere{{x, y, z}, radius, material_id});
+                       scene->committed = false;
+                       return RC_OK; });
+}
+
+rc_status rc_scene_load(rc_scene *scene, const char *path)
+{
+    if (!scene || !path)
+        return RC_ERROR_INVALID_ARGUMENT;
+    return guarded([&]()
+                   {
+                       std::ifstream in(path, std::ios::binary);
+                       sphere_set loaded;
+                       std::string error;
+                       if (!in || !read_scene(in, loaded, error))
+                           return RC_ERROR_IO;
+
+                       // Append, shifting the loaded material ids past the existing ones
+                       auto &target = scene->spheres;
+                       uint32_t material_base = uint32_t(target.materials.size());
+                       target.materials.insert(target.materials.end(), loaded.materials.begin(), loaded.materials.end());
+                       target.spheres.reserve(target.spheres.size() + loaded.spheres.size());
+                       for (auto s : loaded.spheres)
+                       {
+                           s.material += material_base;
+                           target.spheres.push_back(s);
+                       }
+                       scene->committed = false;
+                       return RC_OK; });
+}
+
+uint64_t rc_scene_sphere_count(const rc_scene *scene) { return scene ? scene->spheres.spheres.size() : 0; }
+
+rc_status rc_scene_commit(rc_scene *scene, int leaf_size, int threads)
+{
+    if (!scene || leaf_size < 0 || threads < 0)
+        return RC_ERROR_INVALID_ARGUMENT;
+    return guarded([&]()
+                   {
+                       scene->spheres.build(leaf_size > 0 ? leaf_size : 4, threads);
+                       scene->committed = true;
+                       return RC_OK; });
+}
+
+void rc_render_settings_init(rc_render_settings *settings)
+{
+    if (!settings)
+        return;
+    std::memset(settings, 0, sizeof(*settings));
+    settings->struct_size = sizeof(*settings);
+    settings->width = 400;
+    settings->height = 225;
+    settings->samples_per_pixel = 50;
+    settings->max_depth = 10;
+    settings->tile_size = 16;
+    settings->lookfrom[0] = 13;
+    settings->lookfrom[1] = 2;
+    settings->lookfrom[2] = 3;
+    settings->vup[1] = 1;
+    settings->vfov = 20;
+    settings->focus_dist = 10;
+}
+
+rc_renderer *rc_renderer_create(void) { return new (std::nothrow) rc_renderer(); }
+
+void rc_renderer_destroy(rc_renderer *renderer) { delete renderer; }
+
+rc_status rc_render(rc_renderer *renderer, const rc_scene *scene, const rc_render_settings *settings,
+                    float *pixels, int channels, size_t row_stride)
+{
+    if (!renderer || !scene || !settings || !pixels || (channels != 3 && channels != 4) ||
+        settings->struct_size < sizeof(size_t))
+        return RC_ERROR_INVALID_ARGUMENT;
+
+    // Older callers may pass a shorter struct: missing fields keep their defaults
+    rc_render_settings s;
+    rc_render_settings_init(&s);
+    std::memcpy(&s, settings, std::min(settings->struct_size, sizeof(s)));
+    s.struct_size = sizeof(s);
+
+    if (s.width < 1 || s.height < 1 || s.samples_per_pixel < 1 || s.max_depth < 1 || s.threads < 0 ||
+        s.tile_size < 1 || (row_stride && row_stride < size_t(s.width) * channels))
+        return RC_ERROR_INVALID_ARGUMENT;
+    if (!scene->committed)
+        return RC_ERROR_INVALID_STATE;
+    if (renderer->busy.exchange(true))
+        return RC_ERROR_INVALID_STATE;
+
+    renderer->cancel = false;
+    renderer->tiles_done = 0;
+    renderer->tiles_total = 0;
+    renderer->rendering = true;
+
+    rc_status status = guarded([&]()
+                               {
+                                   camera cam;
+                                   cam.image_width = s.width;
+                                   // The camera truncates width / aspect to get the height; aim
+                                   // half a pixel high so rounding cannot lose a row
+                                   cam.aspect_ratio = double(s.width) / (s.height + 0.5);
+                                   cam.samples_per_pixel = s.samples_per_pixel;
+                                   cam.max_depth = s.max_depth;
+                                   cam.num_threads = s.threads;
+                                   cam.tile_size = s.tile_size;
+                                   cam.seed = s.seed;
+                                   cam.lookfrom = point3(s.lookfrom[0], s.lookfrom[1], s.lookfrom[2]);
+                                   cam.lookat = point3(s.lookat[0], s.lookat[1], s.lookat[2]);
+                                   cam.vup = vec3(s.vup[0], s.vup[1], s.vup[2]);
+                                   cam.vfov = s.vfov;
+                                   cam.defocus_angle = s.defocus_angle;
+                                   cam.focus_dist = s.focus_dist;
+                                   cam.show_progress = false;
+
+                                   render_stats stats;
+                                   stats.use_counters = false;
+                                   cam.stats = &stats;
+
+                                   cam.cancel = &renderer->cancel;
+                                   cam.on_progress = [renderer](int done, int total)
+                                   {
+                                       renderer->tiles_done = done;
+                                       renderer->tiles_total = total;
+                                   };
+
+                                   framebuffer fb(s.width, s.height);
+                                   fb.attach_output(pixels, channels, row_stride);
+                                   cam.render_pass(scene->spheres, fb, 0, s.samples_per_pixel);
+
+                                   auto total = stats.total();
+                                   std::lock_guard<std::mutex> guard(renderer->stats_lock);
+                                   renderer->seconds = cam.last_pass.seconds;
+                                   renderer->rays = total.work.rays;
+                                   renderer->isect_tests = total.work.isect_tests;
+                                   renderer->tiles_total = cam.last_pass.work_items;
+                                   return cam.last_pass.cancelled ? RC_ERROR_CANCELLED : RC_OK; });
+
+    renderer->rendering = false;
+    renderer->busy = false;
+    return status;
+}
+
+void rc_renderer_cancel(rc_renderer *renderer)
+{
+    if (renderer)
+        renderer->cancel = true;
+}
+
+rc_status rc_renderer_get_stats(const rc_renderer *renderer, rc_render_stats *stats)
+{
+    if (!renderer || !stats || stats->struct_size < sizeof(size_t))
+        return RC_ERROR_INVALID_ARGUMENT;
+
+    rc_render_stats s;
+    std::memset(&s, 0, sizeof(s));
+    s.struct_size = sizeof(s);
+    {
+        std::lock_guard<std::mutex> guard(renderer->stats_lock);
+        s.seconds = renderer->seconds;
+        s.rays = renderer->rays;
+        s.isect_tests = renderer->isect_tests;
+    }
+    s.tiles_done = renderer->tiles_done;
+    s.tiles_total = renderer->tiles_total;
+    s.rendering = renderer->rendering ? 1 : 0;
+
+    size_t size = std::min(stats->struct_size, sizeof(s));
+    std::memcpy(stats, &s, size);
+    stats->struct_size = size;
+    return RC_OK;
+}
+
+} // extern "C"
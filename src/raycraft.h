@@ -0,0 +1,192 @@
+/**
+ * @file raycraft.h
+ * @brief Stable C API of the `raycraft_core` library.
+ *
+ * Lets other programs render in-process instead of running the `RayCraft` binary
+ * and parsing its PPM output: the scene is built once and kept, and pixels are
+ * resolved straight into a caller-provided float buffer.
+ *
+ * Typical use:
+ * @code
+ * rc_scene *scene = rc_scene_create();
+ * uint32_t gray;
+ * rc_scene_add_lambertian(scene, 0.5f, 0.5f, 0.5f, &gray);
+ * rc_scene_add_sphere(scene, 0, -1000, 0, 1000, gray);
+ * rc_scene_commit(scene);
+ *
+ * rc_render_settings settings;
+ * rc_render_settings_init(&settings);
+ * settings.width = 640;
+ * settings.height = 360;
+ *
+ * rc_renderer *renderer = rc_renderer_create();
+ * float *rgb = malloc(640 * 360 * 3 * sizeof(float));
+ * rc_render(renderer, scene, &settings, rgb, 3, 0);
+ * @endcode
+ *
+ * Conventions:
+ *  - Every function returns an `rc_status`; nothing throws across the API.
+ *  - Settings structs start with `struct_size` and must be initialised with their
+ *    `_init` function, so fields can be appended in later versions without
+ *    breaking existing callers.
+ *  - A committed scene is read-only and may be rendered by several renderers on
+ *    different threads at once. `rc_renderer_cancel` and `rc_renderer_get_stats`
+ *    may be called from any thread while `rc_render` runs.
+ *  - Output pixels are linear (no gamma) floats, row 0 at the top.
+ */
+
+#ifndef RAYCRAFT_H
+#define RAYCRAFT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(RAYCRAFT_SHARED)
+#ifdef RAYCRAFT_BUILDING_LIBRARY
+#define RAYCRAFT_API __declspec(dllexport)
+#else
+#define RAYCRAFT_API __declspec(dllimport)
+#endif
+#elif defined(__GNUC__)
+#define RAYCRAFT_API __attribute__((visibility("default")))
+#else
+#define RAYCRAFT_API
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** @brief API version: major * 10000 + minor * 100 + patch. */
+#define RAYCRAFT_API_VERSION 10000
+
+/** @brief Result of every API call. */
+typedef enum rc_status
+{
+    RC_OK = 0,
+    RC_ERROR_INVALID_ARGUMENT = 1, /**< Null pointer, bad size or out of range value */
+    RC_ERROR_INVALID_STATE = 2,    /**< E.g. rendering a scene that was not committed */
+    RC_ERROR_CANCELLED = 3,        /**< The render was cancelled; the buffer is partially written */
+    RC_ERROR_IO = 4,               /**< A file could not be read */
+    RC_ERROR_OUT_OF_MEMORY = 5,
+    RC_ERROR_INTERNAL = 6
+} rc_status;
+
+typedef struct rc_scene rc_scene;       /**< Opaque scene: materials, spheres and acceleration structure */
+typedef struct rc_renderer rc_renderer; /**< Opaque renderer: cancellation flag and statistics */
+
+/** @brief Camera and image settings of one render. */
+typedef struct rc_render_settings
+{
+    size_t struct_size;    /**< Set by rc_render_settings_init */
+    int width;             /**< Image width in pixels (default 400) */
+    int height;            /**< Image height in pixels (default 225) */
+    int samples_per_pixel; /**< Default 50 */
+    int max_depth;         /**< Maximum bounces (default 10) */
+    int threads;           /**< Worker threads, 0 = all hardware threads */
+    int tile_size;         /**< Default 16 */
+    uint64_t seed;         /**< Default 0 */
+    double lookfrom[3];    /**< Camera position (default 13, 2, 3) */
+    double lookat[3];      /**< Point the camera looks at (default 0, 0, 0) */
+    double vup[3];         /**< Up direction (default 0, 1, 0) */
+    double vfov;           /**< Vertical field of view in degrees (default 20) */
+    double defocus_angle;  /**< Aperture cone angle in degrees, 0 = pinhole (default 0) */
+    double focus_dist;     /**< Distance of the focal plane (default 10) */
+} rc_render_settings;
+
+/** @brief Statistics of the last (or running) render of a renderer. */
+typedef struct rc_render_stats
+{
+    size_t struct_size;   /**< Set by the caller to sizeof(rc_render_stats) */
+    double seconds;       /**< Wall time of the last finished render */
+    uint64_t rays;        /**< Rays traced by the last finished render */
+    uint64_t isect_tests; /**< Ray-primitive intersection tests of the last finished render */
+    int tiles_done;       /**< Tiles finished so far (live while rendering) */
+    int tiles_total;      /**< Tiles of the current or last render */
+    int rendering;        /**< 1 while rc_render runs */
+} rc_render_stats;
+
+/** @brief Returns RAYCRAFT_API_VERSION of the library actually loaded. */
+RAYCRAFT_API uint32_t rc_version(void);
+
+/** @brief Returns a static description of a status code. */
+RAYCRAFT_API const char *rc_status_string(rc_status status);
+
+/* ----- Scenes ----- */
+
+/** @brief Creates an empty scene (NULL when out of memory). */
+RAYCRAFT_API rc_scene *rc_scene_create(void);
+
+/** @brief Destroys a scene; it must not be in use by a running render. */
+RAYCRAFT_API void rc_scene_destroy(rc_scene *scene);
+
+/** @brief Adds a diffuse material; its id is stored in `*material_id`. */
+RAYCRAFT_API rc_status rc_scene_add_lambertian(rc_scene *scene, float r, float g, float b, uint32_t *material_id);
+
+/** @brief Adds a metal material with fuzz in [0, 1]. */
+RAYCRAFT_API rc_status rc_scene_add_metal(rc_scene *scene, float r, float g, float b, float fuzz,
+                                          uint32_t *material_id);
+
+/** @brief Adds a glass material with the given refraction index. */
+RAYCRAFT_API rc_status rc_scene_add_dielectric(rc_scene *scene, float refraction_index, uint32_t *material_id);
+
+/** @brief Adds a sphere; invalidates a previous commit. */
+RAYCRAFT_API rc_status rc_scene_add_sphere(rc_scene *scene, float x, float y, float z, float radius,
+                                           uint32_t material_id);
+
+/**
+ * @brief Appends the materials and spheres of a scene file written by
+ * `raycraft_scenegen`; invalidates a previous commit.
+ */
+RAYCRAFT_API rc_status rc_scene_load(rc_scene *scene, const char *path);
+
+/** @brief Returns the number of spheres in the scene. */
+RAYCRAFT_API uint64_t rc_scene_sphere_count(const rc_scene *scene);
+
+/**
+ * @brief Builds the acceleration structure; the scene can then be rendered.
+ * @param leaf_size Maximum spheres per BVH leaf, 0 for the default.
+ * @param threads Build threads, 0 = all hardware threads.
+ */
+RAYCRAFT_API rc_status rc_scene_commit(rc_scene *scene, int leaf_size, int threads);
+
+/* ----- Rendering ----- */
+
+/** @brief Fills `settings` with the defaults and sets `struct_size`. */
+RAYCRAFT_API void rc_render_settings_init(rc_render_settings *settings);
+
+/** @brief Creates a renderer (NULL when out of memory). */
+RAYCRAFT_API rc_renderer *rc_renderer_create(void);
+
+/** @brief Destroys a renderer; it must not be rendering. */
+RAYCRAFT_API void rc_renderer_destroy(rc_renderer *renderer);
+
+/**
+ * @brief Renders a committed scene into a caller-provided buffer (blocking).
+ *
+ * Pixels are written into `pixels` directly as they are finished; there is no
+ * intermediate image.
+ *
+ * @param pixels `height` rows of `width` pixels with `channels` floats each.
+ * @param channels 3 (RGB) or 4 (RGBA, alpha written as 1).
+ * @param row_stride Floats from one row to the next, 0 = width * channels.
+ * @return RC_OK, or RC_ERROR_CANCELLED if `rc_renderer_cancel` stopped it.
+ */
+RAYCRAFT_API rc_status rc_render(rc_renderer *renderer, const rc_scene *scene, const rc_render_settings *settings,
+                                 float *pixels, int channels, size_t row_stride);
+
+/**
+ * @brief Asks a running render to stop; returns immediately. Tiles in progress are
+ * finished first. The flag is cleared when the next render starts.
+ */
+RAYCRAFT_API void rc_renderer_cancel(rc_renderer *renderer);
+
+/** @brief Copies the renderer's statistics into `stats` (set `stats->struct_size` first). */
+RAYCRAFT_API rc_status rc_renderer_get_stats(const rc_renderer *renderer, rc_render_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
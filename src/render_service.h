@@ -0,0 +1,700 @@
+/**
+ * @file render_service.h
+ * @brief Multi-tenant rendering: a priority job queue over one shared thread pool.
+ *
+ * Running many small renders as separate processes oversubscribes the cores: every
+ * process starts one thread per core and they all compete. `render_service` instead
+ * renders every job on one `work_stealing_pool`. Jobs wait in a queue ordered by
+ * priority, then deadline, then arrival, and the pool pulls a few tiles at a time
+ * from the job at the head of the queue, so an urgent job submitted while a large
+ * one is rendering starts after the tiles already handed out, not after the whole
+ * job.
+ *
+ * Scenes are loaded once and shared between jobs through `scene_cache`, keyed by a
+ * hash of the file contents (or the built-in scene's name) and evicted least
+ * recently used when the cache exceeds its memory budget.
+ */
+
+#ifndef RENDER_SERVICE_H
+#define RENDER_SERVICE_H
+
+#include "autotune.h"
+#include "bvh.h"
+#include "camera.h"
+#include "counters.h"
+#include "framebuffer.h"
+#include "metrics.h"
+#include "scene_file.h"
+#include "scene_gen.h"
+#include "scenes.h"
+#include "sphere_set.h"
+#include "thread_pool.h"
+#include "tile_schedule.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+using service_clock = std::chrono::steady_clock;
+
+/** @brief Milliseconds between two time points. */
+inline double elapsed_ms(service_clock::time_point from, service_clock::time_point to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+/**
+ * @class job_params
+ * @brief What a client asks for: scene, view and quality of one image.
+ *
+ * View fields that are not given keep the scene's default view.
+ */
+struct job_params
+{
+    std::string scene = "builtin:random_spheres"; ///< Scene file path or `builtin:<name>`
+    int width = 400;
+    int height = 225;
+    int spp = 16;
+    int depth = 10;
+    int priority = 0;       ///< Higher runs first
+    double deadline_ms = 0; ///< Relative to submission, 0 = none
+    uint64_t seed = 0;
+
+    std::optional<point3> lookfrom, lookat;
+    std::optional<double> vfov, aperture, focus;
+};
+
+/** @brief Parses "x,y,z" into `p`. */
+inline bool parse_point(const std::string &text, point3 &p)
+{
+    double x, y, z;
+    char c1, c2;
+    std::istringstream in(text);
+    if (!(in >> x >> c1 >> y >> c2 >> z) || c1 != ',' || c2 != ',')
+        return false;
+    p = point3(x, y, z);
+    return true;
+}
+
+/**
+ * @brief Parses the `key=value` fields of a RENDER request.
+ * @return False with `error` set on an unknown key or an invalid value.
+ */
+inline bool parse_job(const std::string &fields, job_params &job, std::string &error)
+{
+    std::istringstream in(fields);
+    std::string field;
+    while (in >> field)
+    {
+        auto eq = field.find('=');
+        if (eq == std::string::npos)
+        {
+            error = "expected key=value, got '" + field + "'";
+            return false;
+        }
+        std::string key = field.substr(0, eq), value = field.substr(eq + 1);
+        const char *v = value.c_str();
+        char *end = nullptr;
+        bool ok = true;
+        point3 p;
+
+        if (key == "scene")
+            job.scene = value;
+        else if (key == "width")
+            job.width = int(std::strtol(v, &end, 10));
+        else if (key == "height")
+            job.height = int(std::strtol(v, &end, 10));
+        else if (key == "spp")
+            job.spp = int(std::strtol(v, &end, 10));
+        else if (key == "depth")
+            job.depth = int(std::strtol(v, &end, 10));
+        else if (key == "priority")
+            job.priority = int(std::strtol(v, &end, 10));
+        else if (key == "deadline_ms")
+            job.deadline_ms = std::strtod(v, &end);
+        else if (key == "seed")
+            job.seed = std::strtoull(v, &end, 10);
+        else if (key == "vfov")
+            job.vfov = std::strtod(v, &end);
+        else if (key == "aperture")
+            job.aperture = std::strtod(v, &end);
+        else if (key == "focus")
+            job.focus = std::strtod(v, &end);
+        else if (key == "lookfrom" && (ok = parse_point(value, p)))
+            job.lookfrom = p;
+        else if (key == "lookat" && (ok = parse_point(value, p)))
+            job.lookat = p;
+        else if (ok)
+        {
+            error = "unknown field '" + key + "'";
+            return false;
+        }
+
+        if (!ok || value.empty() || (end && *end))
+        {
+            error = "invalid value for '" + key + "'";
+            return false;
+        }
+    }
+
+    if (job.width < 1 || job.height < 1 || job.width > 16384 || job.height > 16384 || job.spp < 1 || job.depth < 1 ||
+        job.deadline_ms < 0)
+    {
+        error = "width, height, spp and depth must be positive";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @class cached_scene
+ * @brief A loaded, accelerated scene and its default view.
+ */
+struct cached_scene
+{
+    std::string name;                         ///< Path or built-in name it was loaded as
+    std::shared_ptr<const hittable> world;    ///< Ready to render (BVH built)
+    std::function<void(camera &)> view;       ///< Sets the scene's default viewpoint
+    size_t bytes = 0;                         ///< Approximate memory held
+};
+
+/**
+ * @class scene_cache
+ * @brief Loaded scenes shared across jobs, keyed by content hash, LRU by memory.
+ *
+ * Scene files are hashed (FNV-1a over the contents) so a file copied under another
+ * name is still a hit; the hash is remembered per (path, size, mtime) so unchanged
+ * files are not reread. A scene requested again while it is still loading waits for
+ * that load instead of starting another one.
+ */
+class scene_cache
+{
+public:
+    size_t capacity_bytes; ///< Entries beyond this are evicted, least recently used first
+    int leaf_size;         ///< BVH leaf size for loaded scenes
+    int build_threads;     ///< BVH build threads (0 = all hardware threads)
+
+    scene_cache(size_t capacity_bytes, int leaf_size, int build_threads)
+        : capacity_bytes(capacity_bytes), leaf_size(leaf_size), build_threads(build_threads) {}
+
+    /**
+     * @brief Returns the scene `name` (a file path or `builtin:<scene>`), loading it on a miss.
+     * @return nullptr with `error` set if it cannot be loaded.
+     */
+    std::shared_ptr<const cached_scene> get(const std::string &name, std::string &error)
+    {
+        std::string key;
+        if (!scene_key(name, key, error))
+            return nullptr;
+
+        std::promise<std::shared_ptr<const cached_scene>> loading;
+        std::shared_future<std::shared_ptr<const cached_scene>> pending;
+        bool must_load = false;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto found = entries.find(key);
+            if (found != entries.end())
+            {
+                hits++;
+                lru.splice(lru.begin(), lru, found->second.lru_pos);
+                pending = found->second.scene;
+            }
+            else
+            {
+                misses++;
+                pending = loading.get_future().share();
+                must_load = true;
+                lru.push_front(key);
+                entries[key] = entry{pending, lru.begin(), 0};
+            }
+        }
+
+        if (!must_load)
+        {
+            auto scene = pending.get();
+            if (!scene)
+                error = "cannot load scene '" + name + "'";
+            return scene;
+        }
+
+        std::shared_ptr<const cached_scene> scene = load(name, error);
+        loading.set_value(scene);
+
+        std::lock_guard<std::mutex> guard(lock);
+        auto found = entries.find(key);
+        if (!scene)
+        {
+            // Do not cache failures: the file may appear or be fixed later
+            if (found != entries.end())
+            {
+                lru.erase(found->second.lru_pos);
+                entries.erase(found);
+            }
+            return nullptr;
+        }
+        if (found != entries.end())
+        {
+            found->second.bytes = scene->bytes;
+            used_bytes += scene->bytes;
+        }
+        evict();
+        return scene;
+    }
+
+    /** @brief Returns hits, misses, evictions, entries and bytes in use. */
+    void counts(uint64_t &hit_count, uint64_t &miss_count, uint64_t &eviction_count, size_t &entry_count,
+                size_t &bytes) const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        hit_count = hits;
+        miss_count = misses;
+        eviction_count = evictions;
+        entry_count = entries.size();
+        bytes = used_bytes;
+    }
+
+private:
+    struct entry
+    {
+        std::shared_future<std::shared_ptr<const cached_scene>> scene;
+        std::list<std::string>::iterator lru_pos;
+        size_t bytes; ///< 0 while loading
+    };
+
+    struct file_stamp
+    {
+        off_t size;
+        time_t mtime;
+        uint64_t hash;
+    };
+
+    mutable std::mutex lock; // guards everything below and the counters
+    std::map<std::string, entry> entries;
+    std::list<std::string> lru; ///< Most recently used first
+    size_t used_bytes = 0;
+    uint64_t hits = 0, misses = 0, evictions = 0;
+    std::map<std::string, file_stamp> file_hashes;
+
+    /** @brief Drops least recently used, fully loaded entries until within capacity. */
+    void evict()
+    {
+        // Never evict the most recent entry, even if it alone exceeds the budget
+        auto pos = lru.end();
+        while (used_bytes > capacity_bytes && pos != lru.begin() && std::prev(pos) != lru.begin())
+        {
+            --pos;
+            auto found = entries.find(*pos);
+            if (found->second.bytes == 0)
+                continue;
+            used_bytes -= found->second.bytes;
+            evictions++;
+            entries.erase(found);
+            pos = lru.erase(pos);
+        }
+    }
+
+    /** @brief Maps a scene name to its cache key: the content hash for files. */
+    bool scene_key(const std::string &name, std::string &key, std::string &error)
+    {
+        if (name.compare(0, 8, "builtin:") == 0)
+        {
+            key = name;
+            return true;
+        }
+
+        struct stat st;
+        if (stat(name.c_str(), &st) != 0)
+        {
+            error = "cannot open scene '" + name + "'";
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto found = file_hashes.find(name);
+            if (found != file_hashes.end() && found->second.size == st.st_size && found->second.mtime == st.st_mtime)
+            {
+                key = hash_key(found->second.hash);
+                return true;
+            }
+        }
+
+        std::ifstream in(name, std::ios::binary);
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        std::vector<char> buf(1 << 16);
+        while (in)
+        {
+            in.read(buf.data(), std::streamsize(buf.size()));
+            for (std::streamsize n = 0; n < in.gcount(); n++)
+                hash = (hash ^ (unsigned char)buf[size_t(n)]) * 0x100000001b3ULL;
+        }
+        if (in.bad())
+        {
+            error = "cannot read scene '" + name + "'";
+            return false;
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+        file_hashes[name] = file_stamp{st.st_size, st.st_mtime, hash};
+        key = hash_key(hash);
+        return true;
+    }
+
+    static std::string hash_key(uint64_t hash)
+    {
+        std::ostringstream s;
+        s << "file:" << std::hex << hash;
+        return s.str();
+    }
+
+    /** @brief Loads and accelerates a scene (no lock held). */
+    std::shared_ptr<const cached_scene> load(const std::string &name, std::string &error)
+    {
+        auto scene = std::make_shared<cached_scene>();
+        scene->name = name;
+
+        if (name.compare(0, 8, "builtin:") == 0)
+        {
+            std::string which = name.substr(8);
+            hittable_list (*make)() = nullptr;
+            if (which == "random_spheres")
+            {
+                make = random_spheres_scene;
+                scene->view = random_spheres_view;
+            }
+            else if (which == "material_spheres")
+            {
+                make = material_spheres_scene;
+                scene->view = material_spheres_view;
+            }
+            else if (which == "sphere_grid")
+            {
+                make = sphere_grid_scene;
+                scene->view = sphere_grid_view;
+            }
+            else
+            {
+                error = "unknown built-in scene '" + which + "'";
+                return nullptr;
+            }
+
+            // A fresh thread starts from the default random state, so the random
+            // spheres come out exactly as in RayCraft
+            hittable_list list;
+            std::thread([&]() { list = make(); }).join();
+            auto accel = std::make_shared<bvh>(list, leaf_size, build_threads);
+            // Per sphere: the object, its material and two control blocks, roughly
+            scene->bytes = list.objects.size() * 160 + accel->tree_data().memory_bytes();
+            scene->world = accel;
+            return scene;
+        }
+
+        auto set = std::make_shared<sphere_set>();
+        std::ifstream in(name, std::ios::binary);
+        if (!in || !read_scene(in, *set, error))
+        {
+            error = "cannot read scene '" + name + "'" + (error.empty() ? "" : ": " + error);
+            return nullptr;
+        }
+        set->build(leaf_size, build_threads);
+        scene->bytes = set->memory_bytes();
+        scene->view = [set](camera &cam) { generated_scene_view(cam, *set); };
+        scene->world = set;
+        return scene;
+    }
+};
+
+/**
+ * @class render_job
+ * @brief One queued or running image.
+ */
+struct render_job
+{
+    uint64_t id = 0;
+    job_params params;
+    service_clock::time_point deadline = service_clock::time_point::max();
+    std::shared_ptr<const cached_scene> scene;
+
+    camera cam;
+    framebuffer fb;
+    std::vector<tile_rect> tiles;
+    size_t next_tile = 0;            ///< Next tile to hand out (guarded by the queue lock)
+    std::atomic<size_t> remaining{0}; ///< Tiles not finished yet
+    std::atomic<uint64_t> rays{0};
+
+    service_clock::time_point submitted, started, finished;
+    bool deadline_missed = false;
+
+    std::promise<void> done; ///< Fulfilled when the last tile is finished
+
+    double queue_ms() const { return elapsed_ms(submitted, started); }
+    double render_ms() const { return elapsed_ms(started, finished); }
+    double total_ms() const { return elapsed_ms(submitted, finished); }
+};
+
+/**
+ * @class service_metrics
+ * @brief Job counters and latency distributions of a render service.
+ *
+ * Lock-free, so connection threads and pool workers update them without
+ * contending with each other or with a metrics scrape.
+ */
+class service_metrics
+{
+public:
+    std::atomic<uint64_t> submitted{0}, completed{0}, rejected{0}, deadline_misses{0};
+    std::atomic<int64_t> queued{0};  ///< Jobs with tiles not handed out yet
+    std::atomic<int64_t> running{0}; ///< Jobs with tiles handed out that are not finished
+    latency_histogram queue_wait, render_time, total_time;
+
+    void job_finished(const render_job &job)
+    {
+        completed.fetch_add(1, std::memory_order_relaxed);
+        if (job.deadline_missed)
+            deadline_misses.fetch_add(1, std::memory_order_relaxed);
+        queue_wait.add(job.queue_ms());
+        render_time.add(job.render_ms());
+        total_time.add(job.total_ms());
+    }
+
+    /** @brief Appends the metrics as `key value` lines. */
+    void report(std::ostream &out) const
+    {
+        out << "queue_depth " << queued << "\n"
+            << "jobs_running " << running << "\n"
+            << "jobs_submitted " << submitted << "\n"
+            << "jobs_completed " << completed << "\n"
+            << "jobs_rejected " << rejected << "\n"
+            << "deadline_misses " << deadline_misses << "\n";
+        const std::pair<const char *, const latency_histogram *> latencies[] = {
+            {"queue_ms", &queue_wait}, {"render_ms", &render_time}, {"total_ms", &total_time}};
+        for (const auto &l : latencies)
+            out << l.first << "_p50 " << l.second->quantile(0.50) << "\n"
+                << l.first << "_p95 " << l.second->quantile(0.95) << "\n"
+                << l.first << "_p99 " << l.second->quantile(0.99) << "\n";
+    }
+
+    /** @brief Writes the metrics in Prometheus text format. */
+    void write_prometheus(std::ostream &out) const
+    {
+        prometheus_metric(out, "raycraft_jobs_submitted_total", "counter", "Jobs accepted into the queue.",
+                          submitted.load());
+        prometheus_metric(out, "raycraft_jobs_completed_total", "counter", "Jobs rendered.", completed.load());
+        prometheus_metric(out, "raycraft_jobs_rejected_total", "counter", "Jobs whose scene could not be loaded.",
+                          rejected.load());
+        prometheus_metric(out, "raycraft_deadline_misses_total", "counter", "Jobs finished after their deadline.",
+                          deadline_misses.load());
+        prometheus_metric(out, "raycraft_queue_depth", "gauge", "Jobs waiting for their first or remaining tiles.",
+                          queued.load());
+        prometheus_metric(out, "raycraft_jobs_running", "gauge", "Jobs with tiles in the pool.", running.load());
+        queue_wait.write_prometheus(out, "raycraft_job_queue_seconds", "Time from submission to the first tile.");
+        render_time.write_prometheus(out, "raycraft_job_render_seconds", "Time from the first to the last tile.");
+        total_time.write_prometheus(out, "raycraft_job_total_seconds", "Time from submission to the last tile.");
+    }
+};
+
+/**
+ * @class render_service
+ * @brief Accepts render jobs and renders them on a shared work-stealing pool.
+ */
+class render_service
+{
+public:
+    /**
+     * @param threads Pool workers (0 = all hardware threads).
+     * @param profile Tile and BVH leaf size (see autotune.h).
+     * @param cache_bytes Memory budget of the scene cache.
+     */
+    render_service(int threads, const tuning_profile &profile, size_t cache_bytes)
+        : tile_size(profile.tile_size), scenes(cache_bytes, profile.leaf_size, threads),
+          pool(threads, [this](std::vector<work_stealing_pool::task> &batch, size_t max)
+               { return next_batch(batch, max); })
+    {
+    }
+
+    /**
+     * @brief Loads the scene and queues the job; wait on `job->done` for the image.
+     * @return nullptr with `error` set if the scene cannot be loaded.
+     */
+    std::shared_ptr<render_job> submit(const job_params &params, std::string &error)
+    {
+        auto job = std::make_shared<render_job>();
+        job->params = params;
+        job->submitted = service_clock::now();
+        if (params.deadline_ms > 0)
+            job->deadline = job->submitted + std::chrono::microseconds(int64_t(params.deadline_ms * 1000));
+
+        job->scene = scenes.get(params.scene, error);
+        if (!job->scene)
+        {
+            metrics.rejected++;
+            return nullptr;
+        }
+
+        camera &cam = job->cam;
+        job->scene->view(cam);
+        if (params.lookfrom)
+            cam.lookfrom = *params.lookfrom;
+        if (params.lookat)
+            cam.lookat = *params.lookat;
+        if (params.vfov)
+            cam.vfov = *params.vfov;
+        if (params.aperture)
+            cam.defocus_angle = *params.aperture;
+        if (params.focus)
+            cam.focus_dist = *params.focus;
+        cam.image_width = params.width;
+        // The camera truncates width / aspect; aim half a pixel high so no row is lost
+        cam.aspect_ratio = double(params.width) / (params.height + 0.5);
+        cam.samples_per_pixel = params.spp;
+        cam.max_depth = params.depth;
+        cam.seed = params.seed;
+        cam.show_progress = false;
+        cam.prepare();
+
+        job->fb.resize(params.width, cam.height());
+        job->tiles = grid_tiles(params.width, cam.height(), tile_size);
+        job->remaining = job->tiles.size();
+
+        {
+            std::lock_guard<std::mutex> guard(queue_lock);
+            job->id = ++last_id;
+            queue.push(job);
+        }
+        metrics.submitted++;
+        metrics.queued++;
+        render.tiles_queued(int64_t(job->tiles.size()));
+        pool.notify();
+        return job;
+    }
+
+    /** @brief Appends queue, pool, cache and job metrics as `key value` lines. */
+    void report(std::ostream &out) const
+    {
+        uint64_t hits, misses, evictions;
+        size_t entries, bytes;
+        scenes.counts(hits, misses, evictions, entries, bytes);
+        out << "pool_threads " << pool.size() << "\n"
+            << "pool_steals " << pool.steals() << "\n"
+            << "scene_cache_hits " << hits << "\n"
+            << "scene_cache_misses " << misses << "\n"
+            << "scene_cache_evictions " << evictions << "\n"
+            << "scene_cache_entries " << entries << "\n"
+            << "scene_cache_bytes " << bytes << "\n";
+        metrics.report(out);
+    }
+
+    /** @brief Writes render, job, pool and cache metrics in Prometheus text format. */
+    void write_prometheus(std::ostream &out) const
+    {
+        render.write_prometheus(out);
+        metrics.write_prometheus(out);
+
+        uint64_t hits, misses, evictions;
+        size_t entries, bytes;
+        scenes.counts(hits, misses, evictions, entries, bytes);
+        prometheus_metric(out, "raycraft_pool_threads", "gauge", "Workers of the shared pool.", pool.size());
+        prometheus_metric(out, "raycraft_pool_steals_total", "counter", "Tiles stolen between workers.",
+                          pool.steals());
+        prometheus_metric(out, "raycraft_scene_cache_hits_total", "counter", "Scene requests served from the cache.",
+                          hits);
+        prometheus_metric(out, "raycraft_scene_cache_misses_total", "counter", "Scene requests that loaded the scene.",
+                          misses);
+        prometheus_metric(out, "raycraft_scene_cache_evictions_total", "counter", "Scenes evicted from the cache.",
+                          evictions);
+        prometheus_metric(out, "raycraft_scene_cache_bytes", "gauge", "Approximate memory of the cached scenes.",
+                          bytes);
+    }
+
+private:
+    /** @brief Queue order: priority (high first), then deadline, then arrival. */
+    struct job_order
+    {
+        bool operator()(const std::shared_ptr<render_job> &a, const std::shared_ptr<render_job> &b) const
+        {
+            if (a->params.priority != b->params.priority)
+                return a->params.priority < b->params.priority;
+            if (a->deadline != b->deadline)
+                return a->deadline > b->deadline;
+            return a->id > b->id;
+        }
+    };
+
+    int tile_size;
+    scene_cache scenes;
+    service_metrics metrics;
+    render_metrics render;
+
+    std::mutex queue_lock; // guards the queue and the jobs' next_tile / started
+    std::priority_queue<std::shared_ptr<render_job>, std::vector<std::shared_ptr<render_job>>, job_order> queue;
+    uint64_t last_id = 0;
+
+    work_stealing_pool pool; // last: its workers use the members above
+
+    /** @brief Pool source: hands out up to `max` tiles from the head of the queue. */
+    bool next_batch(std::vector<work_stealing_pool::task> &batch, size_t max)
+    {
+        std::lock_guard<std::mutex> guard(queue_lock);
+        while (batch.size() < max && !queue.empty())
+        {
+            std::shared_ptr<render_job> job = queue.top();
+            if (job->next_tile == 0)
+            {
+                job->started = service_clock::now();
+                metrics.running++;
+            }
+            while (batch.size() < max && job->next_tile < job->tiles.size())
+            {
+                size_t t = job->next_tile++;
+                batch.push_back([this, job, t]() { render_tile(*job, t); });
+            }
+            // Fully handed out: leave the queue, its remaining tiles are in the pool
+            if (job->next_tile == job->tiles.size())
+            {
+                queue.pop();
+                metrics.queued--;
+            }
+        }
+        return !batch.empty();
+    }
+
+    void render_tile(render_job &job, size_t t)
+    {
+        render.tile_started();
+        uint64_t rays_before = thread_counters().rays;
+        auto start = service_clock::now();
+        job.cam.render_tile(*job.scene->world, job.fb, job.tiles[t], int(t), 0, job.params.spp);
+        uint64_t rays = thread_counters().rays - rays_before;
+        job.rays += rays;
+        render.tile_finished(work_stealing_pool::worker_index(), rays,
+                             uint64_t(job.tiles[t].pixels()) * job.params.spp,
+                             elapsed_ms(start, service_clock::now()) * 1e-3);
+
+        if (--job.remaining == 0)
+        {
+            job.finished = service_clock::now();
+            job.deadline_missed = job.finished > job.deadline;
+            metrics.running--;
+            metrics.job_finished(job);
+            job.done.set_value();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,233 @@
+/**
+ * @file render_stats.h
+ * @brief Collects per-phase and per-thread render statistics and reports them.
+ *
+ * A render is split into phases (scene build, render pass, output, ...). Every
+ * thread working on a phase measures its own wall time, ray counters and hardware
+ * counters with a `phase_scope`, and the results are summed both per phase and per
+ * thread. The report is printed as text to std::clog or written as JSON.
+ */
+
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include "counters.h"
+#include "perf_counters.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @class stats_record
+ * @brief Totals for one phase or one thread.
+ */
+struct stats_record
+{
+    double seconds = 0;   ///< Busy time summed over the threads that contributed
+    int intervals = 0;    ///< Number of measured intervals
+    ray_counters work;    ///< Rays and intersection tests
+    perf_sample counters; ///< Hardware counters (valid == false when unavailable)
+
+    void add(double s, const ray_counters &w, const perf_sample &c)
+    {
+        seconds += s;
+        intervals++;
+        work += w;
+        counters += c;
+    }
+};
+
+/**
+ * @class render_stats
+ * @brief Thread-safe collector for a render's statistics.
+ */
+class render_stats
+{
+public:
+    bool use_counters = true; ///< Sample hardware counters around phases
+
+    std::vector<std::string> phase_order;       ///< Phases in first-seen order
+    std::map<std::string, stats_record> phases; ///< Totals per phase
+    std::map<std::string, double> phase_wall;   ///< Wall clock per phase (from the coordinating thread)
+    std::map<int, stats_record> threads;        ///< Totals per worker thread index
+    std::string counters_status;                ///< Why counters are missing (empty if they worked)
+
+    /** @brief Adds one thread's measurement of a phase. */
+    void add(const std::string &phase, int thread, double seconds, const ray_counters &work,
+             const perf_sample &counters)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!phases.count(phase))
+            phase_order.push_back(phase);
+        phases[phase].add(seconds, work, counters);
+        threads[thread].add(seconds, work, counters);
+    }
+
+    /** @brief Adds wall clock time for a phase that may have run on several threads. */
+    void add_wall(const std::string &phase, double seconds)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        phase_wall[phase] += seconds;
+    }
+
+    /** @brief Records that hardware counters could not be opened (first reason wins). */
+    void counters_unavailable(const std::string &reason)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (counters_status.empty())
+            counters_status = reason;
+    }
+
+    /** @brief Returns the totals over all phases. */
+    stats_record total() const
+    {
+        stats_record t;
+        for (const auto &p : phases)
+        {
+            t.seconds += p.second.seconds;
+            t.intervals += p.second.intervals;
+            t.work += p.second.work;
+            t.counters += p.second.counters;
+        }
+        return t;
+    }
+
+    /** @brief Prints a human readable report. */
+    void print(std::ostream &out) const
+    {
+        out << "Render statistics\n";
+        if (!counters_status.empty())
+            out << "  hardware counters unavailable: " << counters_status << "\n";
+
+        auto line = [&](const std::string &label, const stats_record &r, double wall)
+        {
+            out << "  " << label << ": " << (wall > 0 ? wall : r.seconds) << " s";
+            if (r.work.rays)
+            {
+                out << ", " << r.work.rays << " rays";
+                if (wall > 0)
+                    out << " (" << r.work.rays / wall / 1e6 << " Mrays/s)";
+                out << ", " << r.work.isect_tests << " isect tests";
+            }
+            if (r.counters.valid)
+                out << ", IPC " << r.counters.ipc()
+                    << ", cache miss " << 100 * r.counters.cache_miss_rate() << "%"
+                    << ", branch miss " << 100 * r.counters.branch_miss_rate() << "%";
+            out << "\n";
+        };
+
+        for (const auto &name : phase_order)
+        {
+            auto wall = phase_wall.find(name);
+            line(name, phases.at(name), wall == phase_wall.end() ? 0 : wall->second);
+        }
+        for (const auto &t : threads)
+            line("thread " + std::to_string(t.first), t.second, 0);
+    }
+
+    /** @brief Writes the report as a JSON object. */
+    void write_json(std::ostream &out) const
+    {
+        auto record = [&](const stats_record &r)
+        {
+            out << "{\"seconds\":" << r.seconds << ",\"intervals\":" << r.intervals
+                << ",\"rays\":" << r.work.rays << ",\"isect_tests\":" << r.work.isect_tests;
+            if (r.counters.valid)
+                out << ",\"counters\":{\"cycles\":" << r.counters.cycles
+                    << ",\"instructions\":" << r.counters.instructions
+                    << ",\"cache_references\":" << r.counters.cache_refs
+                    << ",\"cache_misses\":" << r.counters.cache_misses
+                    << ",\"branches\":" << r.counters.branches
+                    << ",\"branch_misses\":" << r.counters.branch_misses
+                    << ",\"ipc\":" << r.counters.ipc() << '}';
+            out << '}';
+        };
+
+        out << "{\"counters_available\":" << (counters_status.empty() ? "true" : "false");
+        if (!counters_status.empty())
+            out << ",\"counters_status\":\"" << counters_status << '"';
+
+        out << ",\"phases\":[";
+        for (size_t n = 0; n < phase_order.size(); n++)
+        {
+            const auto &name = phase_order[n];
+            auto wall = phase_wall.find(name);
+            out << (n ? "," : "") << "{\"name\":\"" << name << "\",\"wall_seconds\":"
+                << (wall == phase_wall.end() ? phases.at(name).seconds : wall->second) << ",\"totals\":";
+            record(phases.at(name));
+            out << '}';
+        }
+
+        out << "],\"threads\":[";
+        bool first = true;
+        for (const auto &t : threads)
+        {
+            out << (first ? "" : ",") << "{\"thread\":" << t.first << ",\"totals\":";
+            record(t.second);
+            out << '}';
+            first = false;
+        }
+        out << "],\"total\":";
+        record(total());
+        out << "}";
+    }
+
+private:
+    mutable std::mutex lock;
+};
+
+/**
+ * @class phase_scope
+ * @brief Measures the calling thread's share of a phase and reports it on destruction.
+ *
+ * Does nothing when `stats` is null, so call sites need no branching.
+ */
+class phase_scope
+{
+public:
+    phase_scope(render_stats *stats, const char *phase, int thread = 0)
+        : stats(stats), phase(phase), thread(thread)
+    {
+        if (!stats)
+            return;
+        if (stats->use_counters)
+        {
+            counters.reset(new perf_counter_group());
+            if (counters->available())
+                counters->start();
+            else
+                stats->counters_unavailable(counters->status());
+        }
+        work_before = thread_counters();
+        start = std::chrono::steady_clock::now();
+    }
+
+    ~phase_scope()
+    {
+        if (!stats)
+            return;
+        perf_sample sample;
+        if (counters && counters->available())
+            sample = counters->stop();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        stats->add(phase, thread, elapsed.count(), thread_counters() - work_before, sample);
+    }
+
+    phase_scope(const phase_scope &) = delete;
+    phase_scope &operator=(const phase_scope &) = delete;
+
+private:
+    render_stats *stats;
+    const char *phase;
+    int thread;
+    std::unique_ptr<perf_counter_group> counters;
+    ray_counters work_before;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif
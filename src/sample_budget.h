@@ -0,0 +1,100 @@
+/**
+ * @file sample_budget.h
+ * @brief Per-pixel sample budgets: spend the samples where the viewer looks.
+ *
+ * A `sample_budget` holds a density in (0, 1] per pixel; a pass of `spp` samples
+ * takes `round(spp * density)` samples (at least one) in each pixel. Two profiles
+ * are provided:
+ *  - foveated: full density inside a circle around the focus point, falling off
+ *    smoothly to a floor at the outer radius (VR previews, product shots)
+ *  - importance image: the luminance of a user-supplied image, e.g. a painted
+ *    mask, scaled between the floor and 1
+ *
+ * The density grid is looked up by relative position, so one budget serves any
+ * image resolution. Every pixel is still stratified over its own sample count by
+ * the stratified sampler, and the count a pixel received ends up in its
+ * framebuffer weight and in the `samples` channel of the cost AOV.
+ */
+
+#ifndef SAMPLE_BUDGET_H
+#define SAMPLE_BUDGET_H
+
+#include "image_io.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class sample_budget
+ * @brief Relative sample density per pixel.
+ */
+class sample_budget
+{
+public:
+    int width = 0;
+    int height = 0;
+    std::vector<float> density; ///< Fraction of the pass's samples per pixel, row-major
+
+    /**
+     * @brief Radial foveation profile on a `w` x `h` grid.
+     *
+     * @param focus_x Focus point, as a fraction of the width (0.5 = centre).
+     * @param focus_y Focus point, as a fraction of the height.
+     * @param inner Radius of full density, as a fraction of half the image diagonal.
+     * @param outer Radius from which on the density is `floor`.
+     * @param floor Density of the periphery.
+     */
+    void foveated(int w, int h, double focus_x, double focus_y, double inner, double outer, double floor)
+    {
+        resize(w, h);
+        double half_diagonal = 0.5 * std::hypot(double(w), double(h));
+        for (int j = 0; j < h; j++)
+            for (int i = 0; i < w; i++)
+            {
+                double r = std::hypot(i + 0.5 - focus_x * w, j + 0.5 - focus_y * h) / half_diagonal;
+                double t = std::clamp((r - inner) / std::max(outer - inner, 1e-9), 0.0, 1.0);
+                double falloff = t * t * (3 - 2 * t); // smoothstep, no visible ring at either radius
+                density[size_t(j) * w + i] = float(1 - (1 - floor) * falloff);
+            }
+    }
+
+    /**
+     * @brief Densities from the luminance of `importance` (values clamped to [0, 1]),
+     * mapped linearly onto [floor, 1].
+     */
+    void from_importance(const float_image &importance, double floor)
+    {
+        resize(importance.width, importance.height);
+        for (int j = 0; j < height; j++)
+            for (int i = 0; i < width; i++)
+            {
+                const color &c = importance.at(i, j);
+                double y = std::clamp(0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z(), 0.0, 1.0);
+                density[size_t(j) * width + i] = float(floor + (1 - floor) * y);
+            }
+    }
+
+    /**
+     * @brief Samples pixel (i, j) of a `image_width` x `image_height` image takes in a
+     * pass of `spp` samples; `spp` if the budget is empty.
+     */
+    int samples(int i, int j, int image_width, int image_height, int spp) const
+    {
+        if (density.empty())
+            return spp;
+        int x = int(int64_t(i) * width / image_width), y = int(int64_t(j) * height / image_height);
+        return std::clamp(int(std::lround(spp * density[size_t(y) * width + x])), 1, spp);
+    }
+
+private:
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        density.assign(size_t(w) * h, 1.0f);
+    }
+};
+
+#endif
@@ -0,0 +1,130 @@
+/**
+ * @file sample_guard.h
+ * @brief Robust accumulation: non-finite sample detection and the median-of-means
+ * pixel estimator.
+ *
+ * A single NaN (say from a degenerate `refract`) added to a pixel's sum makes the
+ * pixel NaN for good, and an infinity does the same. The camera therefore checks
+ * every sample and drops non-finite ones; when a `sample_guard` is attached it also
+ * counts them and records where the first few came from (pixel and sample index, so
+ * the path can be replayed), along with how many samples indirect clamping capped.
+ *
+ * Fireflies are rare samples far brighter than the pixel's mean, e.g. a glass
+ * caustic path that reaches the sky from a dark corner. With the mean estimator one
+ * of them needs thousands of ordinary samples to average out. The median of means
+ * splits a pixel's samples into groups, averages each group and keeps the median
+ * group mean (by luminance): a firefly can spoil only its own group. The estimate is
+ * biased towards darker values where bright samples are genuinely common, and it is
+ * noisier than the mean when samples are bounded (the bundled scenes, lit only by a
+ * sky of at most 1, have no fireflies), so it is opt-in.
+ */
+
+#ifndef SAMPLE_GUARD_H
+#define SAMPLE_GUARD_H
+
+#include "image_metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+/** @brief True if all channels of `c` are finite. */
+inline bool is_finite(const color &c) { return std::isfinite(c.x()) && std::isfinite(c.y()) && std::isfinite(c.z()); }
+
+static const int max_mom_groups = 64; ///< Most groups `median_of_means` splits a pixel's samples into
+
+/**
+ * @brief Median of the means of `groups` consecutive groups of `samples`.
+ *
+ * With fewer samples than groups, or one group, this is the plain mean. The group
+ * means are ordered by luminance; for an even group count the two middle ones are
+ * averaged. `groups` is capped at `max_mom_groups`, so the means stay on the stack.
+ */
+inline color median_of_means(const std::vector<color> &samples, int groups)
+{
+    size_t n = samples.size();
+    if (n == 0)
+        return color(0, 0, 0);
+    groups = std::max(1, std::min(groups, int(n)));
+
+    color means[max_mom_groups];
+    groups = std::min(groups, max_mom_groups);
+    for (int g = 0; g < groups; g++)
+    {
+        size_t begin = n * g / groups, end = n * (g + 1) / groups;
+        color sum(0, 0, 0);
+        for (size_t s = begin; s < end; s++)
+            sum += samples[s];
+        means[g] = sum / double(end - begin);
+    }
+    std::sort(means, means + groups, [](const color &a, const color &b) { return luminance(a) < luminance(b); });
+    if (groups % 2)
+        return means[groups / 2];
+    return 0.5 * (means[groups / 2 - 1] + means[groups / 2]);
+}
+
+/**
+ * @class sample_guard
+ * @brief Counts dropped and clamped samples and remembers where non-finite ones came from.
+ */
+class sample_guard
+{
+public:
+    /**
+     * @brief A non-finite sample: pixel, the pass's first sample (which seeds the
+     * pixel), the sample's index within the pass and its value.
+     */
+    struct offender
+    {
+        int x = 0, y = 0;
+        int first_sample = 0;
+        int sample = 0;
+        color value;
+    };
+
+    size_t max_offenders = 16; ///< Offenders recorded in detail; all of them are counted
+
+    /** @brief Records a dropped non-finite sample of pixel (x, y). */
+    void record(int x, int y, int first_sample, int sample, const color &value)
+    {
+        bool nan = std::isnan(value.x()) || std::isnan(value.y()) || std::isnan(value.z());
+        (nan ? nan_samples : inf_samples)++;
+        std::lock_guard<std::mutex> guard(lock);
+        if (recorded.size() < max_offenders)
+            recorded.push_back(offender{x, y, first_sample, sample, value});
+    }
+
+    /** @brief Adds samples whose indirect contribution was clamped. */
+    void add_clamped(uint64_t count) { clamped_samples += count; }
+
+    uint64_t nans() const { return nan_samples; }
+    uint64_t infs() const { return inf_samples; }
+    uint64_t clamped() const { return clamped_samples; }
+
+    /** @brief The first `max_offenders` non-finite samples found (by any thread). */
+    std::vector<offender> offenders() const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return recorded;
+    }
+
+    /** @brief Writes the counters and the recorded offenders. */
+    void write_report(std::ostream &out) const
+    {
+        out << "Sample guard: " << nans() << " NaN and " << infs() << " infinite samples dropped, " << clamped()
+            << " samples clamped\n";
+        for (const auto &o : offenders())
+            out << "  pixel (" << o.x << ", " << o.y << ") pass from sample " << o.first_sample << ", sample "
+                << o.sample << ": " << o.value.x() << ' ' << o.value.y() << ' ' << o.value.z() << "\n";
+    }
+
+private:
+    std::atomic<uint64_t> nan_samples{0}, inf_samples{0}, clamped_samples{0};
+    mutable std::mutex lock;
+    std::vector<offender> recorded;
+};
+
+#endif
@@ -0,0 +1,217 @@
+/**
+ * @file scene_file.h
+ * @brief Compact binary scene files for generated sphere scenes.
+ *
+ * Layout (all values little-endian):
+ *
+ *     header     "RCSCENE1", uint32 material_count, uint32 reserved (0), uint64 sphere_count
+ *     materials  material_count x { uint32 kind, float albedo[3], float param }   (20 bytes each)
+ *     spheres    sphere_count   x { float center[3], float radius, uint32 material } (20 bytes each)
+ *
+ * The sphere records match `packed_sphere`, so a file is barely larger than the
+ * scene in memory and can be written in chunks while it is being generated.
+ */
+
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include "sphere_set.h"
+
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+static const char scene_file_magic[8] = {'R', 'C', 'S', 'C', 'E', 'N', 'E', '1'};
+static const size_t scene_record_bytes = 20; ///< Size of one material or sphere record
+
+/** @brief Appends a little-endian 32-bit value to `buf`. */
+inline void put_u32(std::vector<unsigned char> &buf, uint32_t v)
+{
+    for (int b = 0; b < 4; b++)
+        buf.push_back((unsigned char)(v >> (8 * b)));
+}
+
+/** @brief Appends a float as its little-endian IEEE bit pattern. */
+inline void put_f32(std::vector<unsigned char> &buf, float f)
+{
+    uint32_t v;
+    std::memcpy(&v, &f, 4);
+    put_u32(buf, v);
+}
+
+/** @brief Reads a little-endian 32-bit value from `p`. */
+inline uint32_t get_u32(const unsigned char *p)
+{
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+/** @brief Reads a little-endian float from `p`. */
+inline float get_f32(const unsigned char *p)
+{
+    uint32_t v = get_u32(p);
+    float f;
+    std::memcpy(&f, &v, 4);
+    return f;
+}
+
+/** @brief Appends the encoded sphere records to `buf`. */
+inline void encode_spheres(std::vector<unsigned char> &buf, const packed_sphere *spheres, size_t count)
+{
+    buf.reserve(buf.size() + count * scene_record_bytes);
+    for (size_t n = 0; n < count; n++)
+    {
+        const auto &s = spheres[n];
+        put_f32(buf, s.center[0]);
+        put_f32(buf, s.center[1]);
+        put_f32(buf, s.center[2]);
+        put_f32(buf, s.radius);
+        put_u32(buf, s.material);
+    }
+}
+
+/**
+ * @brief Writes the header and material table of a scene file.
+ *
+ * Exactly `sphere_count` sphere records (see `encode_spheres`) must follow.
+ */
+inline void write_scene_header(std::ostream &out, const std::vector<material_desc> &materials, uint64_t sphere_count)
+{
+    std::vector<unsigned char> buf(scene_file_magic, scene_file_magic + 8);
+    put_u32(buf, uint32_t(materials.size()));
+    put_u32(buf, 0);
+    put_u32(buf, uint32_t(sphere_count));
+    put_u32(buf, uint32_t(sphere_count >> 32));
+    for (const auto &m : materials)
+    {
+        put_u32(buf, uint32_t(m.kind));
+        put_f32(buf, m.albedo[0]);
+        put_f32(buf, m.albedo[1]);
+        put_f32(buf, m.albedo[2]);
+        put_f32(buf, m.param);
+    }
+    out.write(reinterpret_cast<const char *>(buf.data()), buf.size());
+}
+
+/** @brief Writes a whole `sphere_set` as a scene file. */
+inline void write_scene(std::ostream &out, const sphere_set &scene)
+{
+    write_scene_header(out, scene.materials, scene.spheres.size());
+    const size_t chunk = 1 << 16;
+    std::vector<unsigned char> buf;
+    for (size_t first = 0; first < scene.spheres.size(); first += chunk)
+    {
+        buf.clear();
+        encode_spheres(buf, scene.spheres.data() + first, std::min(chunk, scene.spheres.size() - first));
+        out.write(reinterpret_cast<const char *>(buf.data()), buf.size());
+    }
+}
+
+/**
+ * @brief Reads a scene file into `scene` (without building the BVH).
+ * @param error Receives a description when reading fails.
+ * @return True on success.
+ */
+inline bool read_scene(std::istream &in, sphere_set &scene, std::string &error)
+{
+    unsigned char header[24];
+    if (!in.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+        std::memcmp(header, scene_file_magic, sizeof(scene_file_magic)) != 0)
+    {
+        error = "not a RayCraft scene file";
+        return false;
+    }
+    uint32_t material_count = get_u32(header + 8);
+    uint64_t sphere_count = uint64_t(get_u32(header + 16)) | uint64_t(get_u32(header + 20)) << 32;
+    if (sphere_count > std::numeric_limits<uint32_t>::max())
+    {
+        error = "too many spheres for one BVH (at most 2^32 - 1)";
+        return false;
+    }
+
+    // Check the counts against the file size before allocating for them, so a damaged
+    // header fails cleanly instead of asking for gigabytes; streams of unknown size
+    // grow the arrays as the records arrive
+    uint64_t needed = (uint64_t(material_count) + sphere_count) * scene_record_bytes;
+    std::streampos here = in.tellg();
+    bool sized = here != std::streampos(-1) && in.seekg(0, std::ios::end);
+    if (sized)
+    {
+        uint64_t remaining = uint64_t(in.tellg() - here);
+        in.seekg(here);
+        if (remaining < needed)
+        {
+            error = "file holds " + std::to_string(remaining) + " bytes of records, header promises " +
+                    std::to_string(needed);
+            return false;
+        }
+    }
+    in.clear();
+
+    // Reads `count` records in chunks, calling `decode(index, record)` for each
+    std::vector<unsigned char> buf;
+    auto read_records = [&](uint64_t count, const char *what, auto decode)
+    {
+        const uint64_t chunk = 1 << 16;
+        for (uint64_t first = 0; first < count; first += chunk)
+        {
+            size_t n = size_t(std::min(chunk, count - first));
+            buf.resize(n * scene_record_bytes);
+            if (!in.read(reinterpret_cast<char *>(buf.data()), buf.size()))
+            {
+                error = std::string("truncated ") + what;
+                return false;
+            }
+            for (size_t k = 0; k < n; k++)
+                if (!decode(size_t(first + k), buf.data() + k * scene_record_bytes))
+                    return false;
+        }
+        return true;
+    };
+
+    scene.materials.clear();
+    if (sized)
+        scene.materials.reserve(material_count);
+    bool materials_read = read_records(material_count, "material table",
+                                       [&](size_t m, const unsigned char *p)
+                                       {
+                                           uint32_t kind = get_u32(p);
+                                           if (kind > uint32_t(material_kind::dielectric))
+                                           {
+                                               error = "unknown material kind " + std::to_string(kind);
+                                               return false;
+                                           }
+                                           scene.materials.resize(m + 1);
+                                           scene.materials[m].kind = material_kind(kind);
+                                           for (int c = 0; c < 3; c++)
+                                               scene.materials[m].albedo[c] = get_f32(p + 4 + 4 * c);
+                                           scene.materials[m].param = get_f32(p + 16);
+                                           return true;
+                                       });
+    if (!materials_read)
+        return false;
+
+    scene.spheres.clear();
+    if (sized)
+        scene.spheres.reserve(sphere_count);
+    return read_records(sphere_count, "sphere records",
+                        [&](size_t n, const unsigned char *p)
+                        {
+                            packed_sphere s;
+                            s.center[0] = get_f32(p);
+                            s.center[1] = get_f32(p + 4);
+                            s.center[2] = get_f32(p + 8);
+                            s.radius = get_f32(p + 12);
+                            s.material = get_u32(p + 16);
+                            if (s.material >= material_count)
+                            {
+                                error = "sphere " + std::to_string(n) + " references a missing material";
+                                return false;
+                            }
+                            scene.spheres.push_back(s);
+                            return true;
+                        });
+}
+
+#endif
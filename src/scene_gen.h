@@ -0,0 +1,398 @@
+/**
+ * @file scene_gen.h
+ * @brief Seeded, parallel procedural generator for sphere stress scenes.
+ *
+ * The random spheres scene is fixed at a 22x22 grid. For stress and scaling tests
+ * the generator produces anything from 10^2 to 10^8 spheres with a chosen spatial
+ * distribution, material mix and amount of overlap:
+ *
+ *  - uniform:   spheres spread evenly through a flat box above the ground
+ *  - clustered: spheres concentrated in Gaussian blobs around random centres
+ *  - layered:   spheres in thin horizontal slabs, so boxes overlap heavily when
+ *               seen from above
+ *
+ * The domain grows with the sphere count so the average spacing stays at 1 unit.
+ * Spheres are generated in fixed-size chunks, each seeded from the scene seed and
+ * its chunk index, so the scene only depends on the parameters and never on the
+ * number of threads. `write_generated_scene` streams chunks straight to a scene
+ * file, so files larger than memory can be produced.
+ */
+
+#ifndef SCENE_GEN_H
+#define SCENE_GEN_H
+
+#include "camera.h"
+#include "constants.h"
+#include "scene_file.h"
+#include "sphere_set.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+/** @brief Spatial distribution of generated spheres. */
+enum class scene_distribution
+{
+    uniform,
+    clustered,
+    layered,
+};
+
+/** @brief Returns the command line name of a distribution. */
+inline const char *distribution_name(scene_distribution d)
+{
+    switch (d)
+    {
+    case scene_distribution::clustered:
+        return "clustered";
+    case scene_distribution::layered:
+        return "layered";
+    default:
+        return "uniform";
+    }
+}
+
+/** @brief Parses a distribution name; returns false if it is unknown. */
+inline bool parse_distribution(const char *name, scene_distribution &d)
+{
+    for (auto candidate : {scene_distribution::uniform, scene_distribution::clustered, scene_distribution::layered})
+    {
+        if (!std::strcmp(name, distribution_name(candidate)))
+        {
+            d = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @class scene_gen_params
+ * @brief Parameters of a generated scene.
+ */
+struct scene_gen_params
+{
+    uint64_t count = 10000;                                  ///< Number of spheres (excluding the ground)
+    scene_distribution distribution = scene_distribution::uniform;
+    double mix[3] = {0.8, 0.15, 0.05};                       ///< Lambertian, metal and glass fractions
+    double overlap = 0.0;                                    ///< 0: sparse (radius 0.2 x spacing), 1: heavy overlap (radius 1.0 x spacing)
+    int palette = 64;                                        ///< Number of distinct materials
+    int clusters = 32;                                       ///< Blob count of the clustered distribution
+    int layers = 8;                                          ///< Slab count of the layered distribution
+    bool ground = true;                                      ///< Add a large ground sphere
+    uint64_t seed = 1;                                       ///< Scene seed
+    int threads = 0;                                         ///< Generator threads (0 = all hardware threads)
+
+    /** @brief Half width of the square domain. */
+    double extent() const
+    {
+        // Domain is (2E) x H x (2E) with H = 0.2 E, sized for one sphere per unit volume
+        return std::cbrt(std::max<double>(double(count), 1.0) / 0.8);
+    }
+
+    /** @brief Height of the domain above the ground. */
+    double height() const { return 0.2 * extent(); }
+};
+
+static const size_t scene_gen_chunk = 1 << 16; ///< Spheres per independently seeded chunk
+
+/**
+ * @brief Builds the material table: the ground material first (if any), then the
+ * palette split between the three kinds according to the mix.
+ *
+ * @param first_of_kind Receives the first palette index of each kind.
+ * @param count_of_kind Receives the number of palette entries of each kind.
+ */
+inline std::vector<material_desc> generate_materials(const scene_gen_params &params, int first_of_kind[3],
+                                                     int count_of_kind[3])
+{
+    std::vector<material_desc> materials;
+    if (params.ground)
+        materials.push_back(material_desc{}); // gray lambertian
+
+    double total = params.mix[0] + params.mix[1] + params.mix[2];
+    int palette = std::max(params.palette, 3);
+    seed_random(mix_bits(params.seed ^ 0x6d6174657269616cULL));
+
+    for (int kind = 0; kind < 3; kind++)
+    {
+        double fraction = total > 0 ? params.mix[kind] / total : (kind == 0 ? 1 : 0);
+        count_of_kind[kind] = fraction > 0 ? std::max(1, int(fraction * palette + 0.5)) : 0;
+        first_of_kind[kind] = int(materials.size());
+
+        for (int n = 0; n < count_of_kind[kind]; n++)
+        {
+            material_desc m;
+            m.kind = material_kind(kind);
+            if (m.kind == material_kind::lambertian)
+            {
+                auto albedo = color::random() * color::random();
+                for (int c = 0; c < 3; c++)
+                    m.albedo[c] = float(albedo[c]);
+            }
+            else if (m.kind == material_kind::metal)
+            {
+                auto albedo = color::random(0.5, 1);
+                for (int c = 0; c < 3; c++)
+                    m.albedo[c] = float(albedo[c]);
+                m.param = float(random_double(0, 0.5));
+            }
+            else
+            {
+                m.param = 1.5f;
+            }
+            materials.push_back(m);
+        }
+    }
+    return materials;
+}
+
+/** @brief Returns the cluster centres of the clustered distribution. */
+inline std::vector<point3> generate_cluster_centres(const scene_gen_params &params)
+{
+    seed_random(mix_bits(params.seed ^ 0x636c757374657273ULL));
+    double e = params.extent(), h = params.height();
+    std::vector<point3> centres;
+    for (int n = 0; n < std::max(params.clusters, 1); n++)
+        centres.push_back(point3(random_double(-e, e), random_double(0, h), random_double(-e, e)));
+    return centres;
+}
+
+/**
+ * @class scene_generator
+ * @brief Produces the spheres of one generated scene chunk by chunk.
+ */
+class scene_generator
+{
+public:
+    scene_gen_params params;
+    std::vector<material_desc> materials;
+
+    explicit scene_generator(const scene_gen_params &p) : params(p)
+    {
+        materials = generate_materials(params, first_of_kind, count_of_kind);
+        centres = generate_cluster_centres(params);
+        mix_total = params.mix[0] + params.mix[1] + params.mix[2];
+        if (!(mix_total > 0))
+            mix_total = 1;
+    }
+
+    /** @brief Total number of spheres, including the ground. */
+    uint64_t total_count() const { return params.count + (params.ground ? 1 : 0); }
+
+    /** @brief Number of chunks. */
+    uint64_t chunk_count() const { return (total_count() + scene_gen_chunk - 1) / scene_gen_chunk; }
+
+    /**
+     * @brief Generates chunk `c` into `out` (which must hold `scene_gen_chunk` records).
+     * @return Number of spheres written.
+     */
+    size_t generate_chunk(uint64_t c, packed_sphere *out) const
+    {
+        uint64_t first = c * scene_gen_chunk;
+        size_t count = size_t(std::min<uint64_t>(scene_gen_chunk, total_count() - first));
+        seed_random(mix_bits(params.seed ^ mix_bits(c + 1)));
+
+        double e = params.extent(), h = params.height();
+        double base_radius = 0.2 + 0.8 * std::clamp(params.overlap, 0.0, 1.0);
+        double sigma = e / std::sqrt(double(centres.size())) * 0.25;
+
+        for (size_t n = 0; n < count; n++)
+        {
+            packed_sphere &s = out[n];
+            if (params.ground && first + n == 0)
+            {
+                // Large enough that the horizon stays flat over the whole domain
+                double ground_radius = std::max(1000.0, 100 * e);
+                s = packed_sphere{{0, float(-ground_radius), 0}, float(ground_radius), 0};
+                continue;
+            }
+
+            double radius = base_radius * random_double(0.5, 1.5);
+            point3 p;
+            switch (params.distribution)
+            {
+            case scene_distribution::clustered:
+            {
+                const point3 &c0 = centres[size_t(random_double() * centres.size()) % centres.size()];
+                p = c0 + sigma * gaussian3();
+                break;
+            }
+            case scene_distribution::layered:
+            {
+                int layer = int(random_double() * params.layers) % std::max(params.layers, 1);
+                double y = h * (layer + 0.5) / std::max(params.layers, 1) + random_double(-0.1, 0.1);
+                p = point3(random_double(-e, e), y, random_double(-e, e));
+                break;
+            }
+            default:
+                p = point3(random_double(-e, e), random_double(0, h), random_double(-e, e));
+                break;
+            }
+            p = point3(p.x(), std::max(p.y(), radius), p.z());
+
+            s.center[0] = float(p.x());
+            s.center[1] = float(p.y());
+            s.center[2] = float(p.z());
+            s.radius = float(radius);
+            s.material = pick_material();
+        }
+        return count;
+    }
+
+private:
+    int first_of_kind[3];
+    int count_of_kind[3];
+    double mix_total;
+    std::vector<point3> centres;
+
+    /** @brief Standard normal 3D offset (Box-Muller). */
+    static vec3 gaussian3()
+    {
+        double v[4];
+        for (int k = 0; k < 4; k += 2)
+        {
+            double r = std::sqrt(-2 * std::log(1 - random_double()));
+            double phi = 2 * pi * random_double();
+            v[k] = r * std::cos(phi);
+            v[k + 1] = r * std::sin(phi);
+        }
+        return vec3(v[0], v[1], v[2]);
+    }
+
+    /** @brief Picks a material kind by the mix, then an entry of that kind. */
+    uint32_t pick_material() const
+    {
+        double u = random_double() * mix_total;
+        int kind = 0;
+        while (kind < 2 && (u >= params.mix[kind] || count_of_kind[kind] == 0))
+        {
+            u -= params.mix[kind];
+            kind++;
+        }
+        if (count_of_kind[kind] == 0)
+            kind = 0;
+        int n = std::min(int(random_double() * count_of_kind[kind]), count_of_kind[kind] - 1);
+        return uint32_t(first_of_kind[kind] + n);
+    }
+};
+
+/** @brief Resolves a thread count of 0 to the hardware thread count. */
+inline int generator_threads(int threads)
+{
+    return threads > 0 ? threads : int(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+/**
+ * @brief Generates the scene into memory (without building the BVH).
+ */
+inline sphere_set generate_scene(const scene_gen_params &params)
+{
+    scene_generator gen(params);
+    sphere_set scene;
+    scene.materials = gen.materials;
+    scene.spheres.resize(gen.total_count());
+
+    std::atomic<uint64_t> next_chunk{0};
+    auto worker = [&]()
+    {
+        for (uint64_t c; (c = next_chunk++) < gen.chunk_count();)
+            gen.generate_chunk(c, scene.spheres.data() + c * scene_gen_chunk);
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 1; t < generator_threads(params.threads); t++)
+        workers.emplace_back(worker);
+    worker();
+    for (auto &w : workers)
+        w.join();
+    return scene;
+}
+
+/**
+ * @brief Generates the scene straight into a scene file.
+ *
+ * Chunks are generated in parallel in batches and written in order, so memory use
+ * stays bounded by the batch size regardless of the sphere count.
+ *
+ * @return True if every write succeeded.
+ */
+inline bool write_generated_scene(std::ostream &out, const scene_gen_params &params)
+{
+    scene_generator gen(params);
+    write_scene_header(out, gen.materials, gen.total_count());
+
+    int threads = generator_threads(params.threads);
+    uint64_t batch = uint64_t(threads) * 4;
+    std::vector<std::vector<unsigned char>> encoded(batch);
+
+    for (uint64_t batch_first = 0; batch_first < gen.chunk_count() && out; batch_first += batch)
+    {
+        uint64_t batch_end = std::min(gen.chunk_count(), batch_first + batch);
+        std::atomic<uint64_t> next_chunk{batch_first};
+        auto worker = [&]()
+        {
+            std::vector<packed_sphere> spheres(scene_gen_chunk);
+            for (uint64_t c; (c = next_chunk++) < batch_end;)
+            {
+                size_t count = gen.generate_chunk(c, spheres.data());
+                auto &buf = encoded[c - batch_first];
+                buf.clear();
+                encode_spheres(buf, spheres.data(), count);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++)
+            workers.emplace_back(worker);
+        worker();
+        for (auto &w : workers)
+            w.join();
+
+        for (uint64_t c = batch_first; c < batch_end; c++)
+            out.write(reinterpret_cast<const char *>(encoded[c - batch_first].data()), encoded[c - batch_first].size());
+    }
+    return bool(out);
+}
+
+/**
+ * @brief Sets up a camera that overlooks the whole domain of a generated scene.
+ * @param extent Half width of the domain (`scene_gen_params::extent()`).
+ */
+inline void generated_scene_view(camera &cam, double extent)
+{
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.vfov = 40;
+    cam.lookfrom = point3(1.3 * extent, 0.7 * extent, 1.3 * extent);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+    cam.defocus_angle = 0;
+    cam.focus_dist = 10.0;
+}
+
+/**
+ * @brief Half width of the domain of a loaded generated scene, taken from the
+ * bounds of the spheres (ignoring the ground, which is by far the largest sphere).
+ */
+inline double generated_scene_extent(const sphere_set &scene)
+{
+    double extent = 1;
+    for (const auto &s : scene.spheres)
+    {
+        if (s.center[1] + s.radius <= 0 && s.radius > 100)
+            continue;
+        extent = std::max({extent, double(std::fabs(s.center[0])), double(std::fabs(s.center[2]))});
+    }
+    return extent;
+}
+
+/** @brief Sets up the generated scene view for a loaded `sphere_set`. */
+inline void generated_scene_view(camera &cam, const sphere_set &scene)
+{
+    generated_scene_view(cam, generated_scene_extent(scene));
+}
+
+#endif
@@ -0,0 +1,228 @@
+/**
+ * @file scenegen.cpp
+ * @brief Command line front end of the procedural scene generator.
+ *
+ * Two modes:
+ *
+ *  - Generate a scene file:
+ *    `raycraft_scenegen --count 1000000 --distribution clustered --output big.rcs`
+ *    The file is streamed chunk by chunk, so even 10^8 spheres (about 2 GB) need
+ *    only a few hundred MB of memory. Render it with `RayCraft --scene big.rcs`.
+ *
+ *  - Scaling curves:
+ *    `raycraft_scenegen --scaling scaling.csv --counts 100,10000,1000000`
+ *    For every count, distribution and thread count the scene is generated in
+ *    memory, the BVH is built and a small image is traced; generation, build and
+ *    trace times, BVH size and intersection tests per ray go to the CSV.
+ *
+ * Generator options (both modes): `--distribution uniform|clustered|layered`,
+ * `--mix L,M,G` (lambertian, metal and glass fractions), `--overlap 0..1`,
+ * `--palette N`, `--clusters N`, `--layers N`, `--no-ground`, `--seed S`,
+ * `--threads N`.
+ *
+ * Scaling options: `--counts LIST`, `--distributions LIST`, `--threads-list LIST`,
+ * `--leaf-size N`, `--width N`, `--spp N`, `--depth N`.
+ */
+
+#include "constants.h"
+#include "render_stats.h"
+#include "scene_gen.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/** @brief Splits a comma separated list. */
+static std::vector<std::string> split_list(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::istringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+/** @brief Seconds elapsed since `start`. */
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Runs one point of the scaling curves and appends it to `csv`.
+ */
+static void scaling_point(std::ostream &csv, scene_gen_params params, int threads, int leaf_size, int width, int spp,
+                          int depth)
+{
+    params.threads = threads;
+
+    auto start = std::chrono::steady_clock::now();
+    sphere_set scene = generate_scene(params);
+    double generate_seconds = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    scene.build(leaf_size, threads);
+    double build_seconds = seconds_since(start);
+
+    render_stats stats;
+    stats.use_counters = false;
+    camera cam;
+    generated_scene_view(cam, params.extent());
+    cam.image_width = width;
+    cam.max_depth = depth;
+    cam.num_threads = threads;
+    cam.show_progress = false;
+    cam.stats = &stats;
+
+    framebuffer fb;
+    cam.render_pass(scene, fb, 0, spp);
+
+    const auto &work = stats.phases.at("render pass").work;
+    double trace_seconds = stats.phase_wall.at("render pass");
+    double rays = double(work.rays);
+
+    csv << scene.spheres.size() << ',' << distribution_name(params.distribution) << ',' << threads << ','
+        << generate_seconds << ',' << build_seconds << ',' << scene.tree_data().nodes.size() << ','
+        << scene.memory_bytes() << ',' << trace_seconds << ',' << work.rays << ','
+        << rays / trace_seconds / 1e6 << ',' << (rays > 0 ? double(work.isect_tests) / rays : 0) << std::endl;
+
+    std::clog << scene.spheres.size() << " " << distribution_name(params.distribution) << " spheres, " << threads
+              << " threads: generate " << generate_seconds << " s, build " << build_seconds << " s, trace "
+              << rays / trace_seconds / 1e6 << " Mrays/s\n";
+}
+
+int main(int argc, char *argv[])
+{
+    scene_gen_params params;
+    const char *output = nullptr;
+    const char *scaling = nullptr;
+    std::vector<std::string> counts = {"100", "1000", "10000", "100000", "1000000"};
+    std::vector<std::string> distributions;
+    std::vector<std::string> thread_list;
+    int leaf_size = 4, width = 160, spp = 2, depth = 4;
+
+    for (int n = 1; n < argc; n++)
+    {
+        bool has_value = n + 1 < argc;
+        if (!std::strcmp(argv[n], "--count") && has_value)
+            params.count = std::strtoull(argv[++n], nullptr, 10);
+        else if (!std::strcmp(argv[n], "--distribution") && has_value)
+        {
+            distributions = {argv[++n]};
+            if (!parse_distribution(argv[n], params.distribution))
+            {
+                std::cerr << "Unknown distribution " << argv[n] << "\n";
+                return 1;
+            }
+        }
+        else if (!std::strcmp(argv[n], "--mix") && has_value)
+        {
+            auto parts = split_list(argv[++n]);
+            if (parts.size() != 3)
+            {
+                std::cerr << "--mix needs three fractions: lambertian,metal,glass\n";
+                return 1;
+            }
+            for (int k = 0; k < 3; k++)
+                params.mix[k] = std::atof(parts[k].c_str());
+        }
+        else if (!std::strcmp(argv[n], "--overlap") && has_value)
+            params.overlap = std::atof(argv[++n]);
+        else if (!std::strcmp(argv[n], "--palette") && has_value)
+            params.palette = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--clusters") && has_value)
+            params.clusters = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--layers") && has_value)
+            params.layers = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--no-ground"))
+            params.ground = false;
+        else if (!std::strcmp(argv[n], "--seed") && has_value)
+            params.seed = std::strtoull(argv[++n], nullptr, 0);
+        else if (!std::strcmp(argv[n], "--threads") && has_value)
+            params.threads = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--output") && has_value)
+            output = argv[++n];
+        else if (!std::strcmp(argv[n], "--scaling") && has_value)
+            scaling = argv[++n];
+        else if (!std::strcmp(argv[n], "--counts") && has_value)
+            counts = split_list(argv[++n]);
+        else if (!std::strcmp(argv[n], "--distributions") && has_value)
+            distributions = split_list(argv[++n]);
+        else if (!std::strcmp(argv[n], "--threads-list") && has_value)
+            thread_list = split_list(argv[++n]);
+        else if (!std::strcmp(argv[n], "--leaf-size") && has_value)
+            leaf_size = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--width") && has_value)
+            width = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--spp") && has_value)
+            spp = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--depth") && has_value)
+            depth = std::atoi(argv[++n]);
+        else
+        {
+            output = scaling = nullptr;
+            break;
+        }
+    }
+
+    if (!output && !scaling)
+    {
+        std::cerr << "Usage: " << argv[0] << " --output FILE [--count N] [generator options]\n"
+                  << "       " << argv[0] << " --scaling FILE.csv [--counts LIST] [--distributions LIST]\n"
+                  << "           [--threads-list LIST] [--leaf-size N] [--width N] [--spp N] [--depth N]\n"
+                  << "Generator options: --distribution uniform|clustered|layered --mix L,M,G --overlap X\n"
+                  << "           --palette N --clusters N --layers N --no-ground --seed S --threads N\n";
+        return 1;
+    }
+
+    if (output)
+    {
+        std::ofstream out(output, std::ios::binary);
+        auto start = std::chrono::steady_clock::now();
+        if (!out || !write_generated_scene(out, params))
+        {
+            std::cerr << "Cannot write " << output << "\n";
+            return 1;
+        }
+        std::clog << "Wrote " << params.count << " " << distribution_name(params.distribution) << " spheres to "
+                  << output << " in " << seconds_since(start) << " s\n";
+    }
+
+    if (scaling)
+    {
+        std::ofstream csv(scaling);
+        if (!csv)
+        {
+            std::cerr << "Cannot write " << scaling << "\n";
+            return 1;
+        }
+        csv << "spheres,distribution,threads,generate_seconds,build_seconds,bvh_nodes,scene_bytes,"
+               "trace_seconds,rays,mrays_per_sec,isect_tests_per_ray\n";
+
+        if (distributions.empty())
+            distributions = {"uniform", "clustered", "layered"};
+        if (thread_list.empty())
+            thread_list = {std::to_string(generator_threads(params.threads))};
+
+        for (const auto &d : distributions)
+        {
+            if (!parse_distribution(d.c_str(), params.distribution))
+            {
+                std::cerr << "Unknown distribution " << d << "\n";
+                return 1;
+            }
+            for (const auto &c : counts)
+            {
+                params.count = std::strtoull(c.c_str(), nullptr, 10);
+                for (const auto &t : thread_list)
+                    scaling_point(csv, params, std::max(1, std::atoi(t.c_str())), leaf_size, width, spp, depth);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * @file scenes.h
+ * @brief Canonical scenes shared by the renderer, the benchmark and the regression tools.
+ *
+ * Keeping scene construction in one place guarantees that the benchmark measures
+ * exactly the image `main.cpp` renders.
+ */
+
+#ifndef SCENES_H
+#define SCENES_H
+
+#include "constants.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "sphere.h"
+
+/**
+ * @brief Builds the random spheres scene.
+ *
+ * A large ground sphere, a 22x22 grid of small randomly placed diffuse, metal
+ * and glass spheres, and three large feature spheres.
+ */
+inline hittable_list random_spheres_scene()
+{
+    hittable_list world;
+
+    // Ground plane (large sphere under the scene)
+    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, ground_material));
+
+    // Generate random small spheres
+    for (int a = -11; a < 11; a++)
+    {
+        for (int b = -11; b < 11; b++)
+        {
+            auto choose_mat = random_double();
+            point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+
+            // Ensure spheres don't overlap with the main center area
+            if ((center - point3(4, 0.2, 0)).length() > 0.9)
+            {
+                shared_ptr<material> sphere_material;
+
+                if (choose_mat < 0.8)
+                {
+                    // Diffuse (Lambertian)
+                    auto albedo = color::random() * color::random();
+                    sphere_material = make_shared<lambertian>(albedo);
+                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+                else if (choose_mat < 0.95)
+                {
+                    // Metal
+                    auto albedo = color::random(0.5, 1);
+                    auto fuzz = random_double(0, 0.5);
+                    sphere_material = make_shared<metal>(albedo, fuzz);
+                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+                else
+                {
+                    // Glass (Dielectric)
+                    sphere_material = make_shared<dielectric>(1.5);
+                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+            }
+        }
+    }
+
+    // Three main large spheres
+    auto material1 = make_shared<dielectric>(1.5);             // Glass sphere
+    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
+
+    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1)); // Diffuse sphere
+    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+
+    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0); // Mirror-like sphere
+    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+
+    return world;
+}
+
+/**
+ * @brief Configures `cam` with the viewpoint used for the random spheres scene.
+ *
+ * Only the view is set; resolution, sampling and depth are left to the caller.
+ */
+inline void random_spheres_view(camera &cam)
+{
+    cam.aspect_ratio = 16.0 / 9.0;
+
+    // Camera position and orientation
+    cam.vfov = 20;
+    cam.lookfrom = point3(13, 2, 3);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+
+    // Depth of field configuration
+    cam.defocus_angle = 0.6;
+    cam.focus_dist = 10.0;
+}
+
+/**
+ * @brief Builds the material showcase scene: ground, a diffuse sphere, a hollow
+ * glass sphere and a fuzzy metal sphere side by side.
+ *
+ * Fully deterministic (no random placement), so it is safe to use for stored
+ * reference images even if the random number generator changes.
+ */
+inline hittable_list material_spheres_scene()
+{
+    hittable_list world;
+
+    auto material_ground = make_shared<lambertian>(color(0.8, 0.8, 0.0));
+    auto material_center = make_shared<lambertian>(color(0.1, 0.2, 0.5));
+    auto material_left = make_shared<dielectric>(1.50);
+    auto material_bubble = make_shared<dielectric>(1.00 / 1.50);
+    auto material_right = make_shared<metal>(color(0.8, 0.6, 0.2), 0.3);
+
+    world.add(make_shared<sphere>(point3(0.0, -100.5, -1.0), 100.0, material_ground));
+    world.add(make_shared<sphere>(point3(0.0, 0.0, -1.2), 0.5, material_center));
+    world.add(make_shared<sphere>(point3(-1.0, 0.0, -1.0), 0.5, material_left));
+    world.add(make_shared<sphere>(point3(-1.0, 0.0, -1.0), 0.4, material_bubble));
+    world.add(make_shared<sphere>(point3(1.0, 0.0, -1.0), 0.5, material_right));
+
+    return world;
+}
+
+/** @brief Configures `cam` with the viewpoint used for the material showcase scene. */
+inline void material_spheres_view(camera &cam)
+{
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.vfov = 30;
+    cam.lookfrom = point3(-2, 2, 1);
+    cam.lookat = point3(0, 0, -1);
+    cam.vup = vec3(0, 1, 0);
+    cam.defocus_angle = 0;
+    cam.focus_dist = 3.4;
+}
+
+/**
+ * @brief Builds a deterministic 7x7 grid of small spheres cycling through diffuse,
+ * metal and glass materials, plus a mirror sphere, on a grey ground.
+ *
+ * Rendered with depth of field it exercises every material and the defocus disk.
+ */
+inline hittable_list sphere_grid_scene()
+{
+    hittable_list world;
+
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, make_shared<lambertian>(color(0.5, 0.5, 0.5))));
+
+    for (int a = -3; a <= 3; a++)
+    {
+        for (int b = -3; b <= 3; b++)
+        {
+            point3 center(1.2 * a, 0.3, 1.2 * b);
+            shared_ptr<material> sphere_material;
+            switch ((a + 3 + 2 * (b + 3)) % 3)
+            {
+            case 0:
+                sphere_material = make_shared<lambertian>(color(0.2 + 0.1 * (a + 3), 0.3, 0.8 - 0.1 * (b + 3)));
+                break;
+            case 1:
+                sphere_material = make_shared<metal>(color(0.8, 0.7, 0.6), 0.05 * (a + 3));
+                break;
+            default:
+                sphere_material = make_shared<dielectric>(1.5);
+                break;
+            }
+            world.add(make_shared<sphere>(center, 0.3, sphere_material));
+        }
+    }
+
+    world.add(make_shared<sphere>(point3(0, 1.5, -5), 1.5, make_shared<metal>(color(0.7, 0.6, 0.5), 0.0)));
+
+    return world;
+}
+
+/** @brief Configures `cam` with the viewpoint used for the sphere grid scene. */
+inline void sphere_grid_view(camera &cam)
+{
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.vfov = 35;
+    cam.lookfrom = point3(8, 4, 8);
+    cam.lookat = point3(0, 0.3, 0);
+    cam.vup = vec3(0, 1, 0);
+    cam.defocus_angle = 1.0;
+    cam.focus_dist = (cam.lookfrom - cam.lookat).length();
+}
+
+#endif
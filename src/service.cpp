@@ -0,0 +1,230 @@
+/**
+ * @file service.cpp
+ * @brief Render service: accepts jobs over a local socket and renders them on one
+ * shared thread pool.
+ *
+ * `raycraft_service --socket /tmp/raycraft.sock` listens on a Unix domain socket.
+ * Each connection sends one request per line and gets one response per request:
+ *
+ *  - `RENDER key=value ...` with any of `scene` (a scene file or
+ *    `builtin:random_spheres|material_spheres|sphere_grid`), `width`, `height`,
+ *    `spp`, `depth`, `seed`, `priority` (higher first), `deadline_ms`,
+ *    `lookfrom=x,y,z`, `lookat=x,y,z`, `vfov`, `aperture`, `focus`.
+ *    Answer: `OK id=N width=W height=H queue_ms=.. render_ms=.. total_ms=..
+ *    bytes=B` followed by B bytes of binary PPM (P6), or `ERR message`.
+ *  - `STATS`: `key value` lines with queue, pool, scene cache and latency metrics,
+ *    terminated by an empty line.
+ *
+ * Options: `--socket PATH`, `--threads N` (pool size, default all hardware
+ * threads), `--cache-mb N` (scene cache budget, default 1024), `--profile FILE` /
+ * `--no-profile` (tile and BVH leaf size from the `--autotune` profile),
+ * `--metrics-port N` (Prometheus metrics on http://127.0.0.1:N/metrics).
+ */
+
+#include "autotune.h"
+#include "framebuffer.h"
+#include "metrics_server.h"
+#include "render_service.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+/** @brief Writes all of `data`; false if the client went away. */
+static bool send_all(int fd, const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent <= 0)
+            return false;
+        data += sent;
+        size -= size_t(sent);
+    }
+    return true;
+}
+
+static bool send_all(int fd, const std::string &text) { return send_all(fd, text.data(), text.size()); }
+
+/** @brief Reads one '\n' terminated line (without the newline); false at end of stream. */
+static bool read_line(int fd, std::string &buffer, std::string &line)
+{
+    while (true)
+    {
+        auto newline = buffer.find('\n');
+        if (newline != std::string::npos)
+        {
+            line = buffer.substr(0, newline);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            buffer.erase(0, newline + 1);
+            return true;
+        }
+        if (buffer.size() > 65536)
+            return false; // not a request line
+        char chunk[4096];
+        ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+        if (got <= 0)
+            return false;
+        buffer.append(chunk, size_t(got));
+    }
+}
+
+/** @brief Serves one client connection until it closes. */
+static void serve_connection(render_service &service, int fd)
+{
+    std::string buffer, line;
+    while (read_line(fd, buffer, line))
+    {
+        std::istringstream words(line);
+        std::string command;
+        words >> command;
+
+        if (command == "STATS")
+        {
+            std::ostringstream out;
+            service.report(out);
+            out << "\n";
+            if (!send_all(fd, out.str()))
+                break;
+            continue;
+        }
+        if (command != "RENDER")
+        {
+            if (!send_all(fd, "ERR unknown command '" + command + "'\n"))
+                break;
+            continue;
+        }
+
+        job_params params;
+        std::string rest, error;
+        std::getline(words, rest);
+        std::shared_ptr<render_job> job;
+        if (parse_job(rest, params, error))
+            job = service.submit(params, error);
+        if (!job)
+        {
+            if (!send_all(fd, "ERR " + error + "\n"))
+                break;
+            continue;
+        }
+
+        job->done.get_future().wait();
+
+        std::ostringstream image;
+        write_ppm_binary(image, job->fb);
+        std::string bytes = image.str();
+
+        std::ostringstream header;
+        header << "OK id=" << job->id << " width=" << job->fb.width << " height=" << job->fb.height
+               << " queue_ms=" << job->queue_ms() << " render_ms=" << job->render_ms()
+               << " total_ms=" << job->total_ms() << " bytes=" << bytes.size() << "\n";
+
+        std::clog << "job " << job->id << ": " << params.scene << " " << job->fb.width << "x" << job->fb.height
+                  << " " << params.spp << " spp, priority " << params.priority << ", queue " << job->queue_ms()
+                  << " ms, render " << job->render_ms() << " ms, total " << job->total_ms() << " ms"
+                  << (job->deadline_missed ? " (missed deadline)" : "") << "\n";
+
+        if (!send_all(fd, header.str()) || !send_all(fd, bytes))
+            break;
+    }
+    close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *socket_path = "/tmp/raycraft.sock";
+    int threads = 0;
+    size_t cache_mb = 1024;
+    std::string profile_path = default_profile_path();
+    bool use_profile = true;
+    int metrics_port = 0;
+
+    for (int n = 1; n < argc; n++)
+    {
+        bool has_value = n + 1 < argc;
+        if (!std::strcmp(argv[n], "--socket") && has_value)
+            socket_path = argv[++n];
+        else if (!std::strcmp(argv[n], "--threads") && has_value)
+            threads = std::atoi(argv[++n]);
+        else if (!std::strcmp(argv[n], "--cache-mb") && has_value)
+            cache_mb = std::strtoull(argv[++n], nullptr, 10);
+        else if (!std::strcmp(argv[n], "--profile") && has_value)
+            profile_path = argv[++n];
+        else if (!std::strcmp(argv[n], "--no-profile"))
+            use_profile = false;
+        else if (!std::strcmp(argv[n], "--metrics-port") && has_value)
+            metrics_port = std::atoi(argv[++n]);
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--socket PATH] [--threads N] [--cache-mb N] [--profile FILE] [--no-profile]"
+                         " [--metrics-port N]\n";
+            return 1;
+        }
+    }
+
+    tuning_profile profile;
+    if (use_profile && load_profile(profile_path, profile))
+        std::clog << "Using machine profile " << profile_path << " (" << profile.describe() << ")\n";
+    if (threads > 0)
+        profile.threads = threads;
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (std::strlen(socket_path) >= sizeof(address.sun_path))
+    {
+        std::cerr << "Socket path too long: " << socket_path << "\n";
+        return 1;
+    }
+    std::strcpy(address.sun_path, socket_path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path);
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(listener, 64) != 0)
+    {
+        std::cerr << "Cannot listen on " << socket_path << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+
+    render_service service(profile.threads, profile, cache_mb << 20);
+    std::clog << "Listening on " << socket_path << " (" << profile.describe() << ", scene cache " << cache_mb
+              << " MB)\n";
+
+    std::unique_ptr<metrics_server> metrics;
+    if (metrics_port > 0)
+    {
+        metrics = std::make_unique<metrics_server>(metrics_port,
+                                                   [&service](std::ostream &out) { service.write_prometheus(out); });
+        if (!metrics->ok())
+        {
+            std::cerr << "Cannot serve metrics on port " << metrics_port << ": " << metrics->error << "\n";
+            return 1;
+        }
+        std::clog << "Metrics on http://127.0.0.1:" << metrics_port << "/metrics\n";
+    }
+
+    while (true)
+    {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "accept failed: " << std::strerror(errno) << "\n";
+            break;
+        }
+        std::thread(serve_connection, std::ref(service), fd).detach();
+    }
+    close(listener);
+    unlink(socket_path);
+    return 1;
+}
@@ -0,0 +1,368 @@
+/**
+ * @file shared_scene.h
+ * @brief Compiled scenes in shared memory, built once and mapped by several renderer
+ * processes on one host.
+ *
+ * Every RayCraft process normally reads its scene file and builds its own BVH, so N
+ * processes on a node pay for the build N times and hold N copies of the scene. A
+ * compiled scene image holds everything rendering needs (material table, sphere
+ * records, BVH nodes and leaf indices, bounds and view extent) in one block that
+ * refers to its parts only by offsets from its start, so it works at whatever
+ * address a process maps it. One process publishes the image into a POSIX
+ * shared-memory segment (or a memfd inherited by child processes); the others map it
+ * read-only, check the header and render straight from it: no parsing, no build, and
+ * the pages are shared by all of them.
+ *
+ * Layout (native byte order, as the image never leaves the host):
+ *
+ *     header     shared_scene_header
+ *     materials  material_count x material_desc
+ *     spheres    sphere_count   x packed_sphere
+ *     nodes      node_count     x bvh_node
+ *     indices    index_count    x uint32
+ *
+ * Every section starts at a multiple of 64 bytes. The publisher writes the magic
+ * last, so a process that maps a segment still being written rejects it instead of
+ * reading half a scene. Memfd images are sealed against writes and resizes. The
+ * sections themselves are trusted like the process's own memory: checking every
+ * record would touch the whole image and cost what mapping it saves.
+ */
+
+#ifndef SHARED_SCENE_H
+#define SHARED_SCENE_H
+
+#include "scene_gen.h"
+#include "sphere_set.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char shared_scene_magic[8] = {'R', 'C', 'S', 'H', 'A', 'R', 'E', '1'};
+
+/**
+ * @class shared_scene_header
+ * @brief Start of a compiled scene image. Offsets are in bytes from the image start.
+ */
+struct shared_scene_header
+{
+    char magic[8];            ///< `shared_scene_magic`, written last
+    uint32_t header_bytes;    ///< sizeof(shared_scene_header)
+    uint32_t record_bytes[3]; ///< sizeof material_desc, packed_sphere and bvh_node (layout check)
+    uint64_t total_bytes;     ///< Size of the whole image
+    uint64_t material_offset, material_count;
+    uint64_t sphere_offset, sphere_count;
+    uint64_t node_offset, node_count;
+    uint64_t index_offset, index_count;
+    double bounds[6]; ///< Scene bounding box: min x, y, z, then max x, y, z
+    double extent;    ///< Half width of the generated scene domain (see `generated_scene_extent`)
+};
+
+/** @brief Fills in the header of the image of a built `sphere_set` (all but the magic). */
+inline shared_scene_header shared_scene_layout(const sphere_set &scene)
+{
+    shared_scene_header h;
+    std::memset(&h, 0, sizeof(h));
+    h.header_bytes = sizeof(shared_scene_header);
+    h.record_bytes[0] = sizeof(material_desc);
+    h.record_bytes[1] = sizeof(packed_sphere);
+    h.record_bytes[2] = sizeof(bvh_node);
+
+    auto align = [](uint64_t offset) { return (offset + 63) / 64 * 64; };
+    const bvh_tree &tree = scene.tree_data();
+    h.material_count = scene.materials.size();
+    h.sphere_count = scene.spheres.size();
+    h.node_count = tree.nodes.size();
+    h.index_count = tree.indices.size();
+    h.material_offset = align(sizeof(shared_scene_header));
+    h.sphere_offset = align(h.material_offset + h.material_count * sizeof(material_desc));
+    h.node_offset = align(h.sphere_offset + h.sphere_count * sizeof(packed_sphere));
+    h.index_offset = align(h.node_offset + h.node_count * sizeof(bvh_node));
+    h.total_bytes = h.index_offset + h.index_count * sizeof(uint32_t);
+
+    aabb box = scene.bounding_box();
+    for (int a = 0; a < 3; a++)
+    {
+        h.bounds[a] = box.axis_interval(a).min;
+        h.bounds[3 + a] = box.axis_interval(a).max;
+    }
+    h.extent = generated_scene_extent(scene);
+    return h;
+}
+
+/**
+ * @brief Sizes the file behind `fd` and writes the image of a built `sphere_set`
+ * into it through a temporary mapping.
+ */
+inline bool write_shared_scene(int fd, const sphere_set &scene, std::string &error)
+{
+    shared_scene_header h = shared_scene_layout(scene);
+    // posix_fallocate rather than ftruncate: a full /dev/shm must fail here, not
+    // with SIGBUS while the image is copied
+    int rc = posix_fallocate(fd, 0, off_t(h.total_bytes));
+    if (rc != 0)
+    {
+        error = std::string("cannot size the segment: ") + std::strerror(rc);
+        return false;
+    }
+    void *base = mmap(nullptr, h.total_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        error = std::string("cannot map the segment: ") + std::strerror(errno);
+        return false;
+    }
+
+    char *p = static_cast<char *>(base);
+    const bvh_tree &tree = scene.tree_data();
+    std::memcpy(p + h.material_offset, scene.materials.data(), h.material_count * sizeof(material_desc));
+    std::memcpy(p + h.sphere_offset, scene.spheres.data(), h.sphere_count * sizeof(packed_sphere));
+    std::memcpy(p + h.node_offset, tree.nodes.data(), h.node_count * sizeof(bvh_node));
+    std::memcpy(p + h.index_offset, tree.indices.data(), h.index_count * sizeof(uint32_t));
+    std::memcpy(p, &h, sizeof(h));
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(p, shared_scene_magic, sizeof(shared_scene_magic));
+    munmap(base, h.total_bytes);
+    return true;
+}
+
+/**
+ * @brief Publishes a built `sphere_set` as the POSIX shared-memory segment `name`
+ * (e.g. "/raycraft-city"), replacing any segment of that name.
+ *
+ * Processes that mapped a replaced segment keep rendering from it until they
+ * detach. The segment outlives the publisher; remove it with `unlink_shared_scene`.
+ */
+inline bool publish_shared_scene(const sphere_set &scene, const std::string &name, std::string &error)
+{
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        error = "cannot create " + name + ": " + std::strerror(errno);
+        return false;
+    }
+    bool ok = write_shared_scene(fd, scene, error);
+    close(fd);
+    if (!ok)
+        shm_unlink(name.c_str());
+    return ok;
+}
+
+/** @brief Removes the shared-memory segment `name`; mappings stay valid. */
+inline bool unlink_shared_scene(const std::string &name) { return shm_unlink(name.c_str()) == 0; }
+
+#if defined(__linux__)
+/**
+ * @brief Writes the image of a built `sphere_set` into a new memfd, seals it and
+ * returns the descriptor (-1 on failure).
+ *
+ * The descriptor is inherited across fork and exec (pass it to workers as
+ * `--shared-scene-fd N`); the seals guarantee that nobody can change the scene
+ * under them.
+ */
+inline int create_shared_scene_memfd(const sphere_set &scene, std::string &error)
+{
+    int fd = memfd_create("raycraft-scene", MFD_ALLOW_SEALING);
+    if (fd < 0)
+    {
+        error = std::string("cannot create a memfd: ") + std::strerror(errno);
+        return -1;
+    }
+    if (!write_shared_scene(fd, scene, error))
+    {
+        close(fd);
+        return -1;
+    }
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0)
+    {
+        error = std::string("cannot seal the memfd: ") + std::strerror(errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+#endif
+
+/**
+ * @class shared_scene
+ * @brief A `hittable` that renders from a compiled scene image mapped read-only.
+ *
+ * Example usage:
+ * @code
+ * shared_scene scene;
+ * std::string error;
+ * if (!scene.attach("/raycraft-city", error))
+ *     std::cerr << error << "\n";
+ * generated_scene_view(cam, scene);
+ * cam.render(scene);
+ * @endcode
+ */
+class shared_scene : public hittable
+{
+public:
+    shared_scene() {}
+    shared_scene(const shared_scene &) = delete;
+    shared_scene &operator=(const shared_scene &) = delete;
+    ~shared_scene() { detach(); }
+
+    /** @brief Maps the POSIX shared-memory segment `name`. */
+    bool attach(const std::string &name, std::string &error)
+    {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+        {
+            error = "cannot open " + name + ": " + std::strerror(errno);
+            return false;
+        }
+        bool ok = attach_fd(fd, error);
+        close(fd); // the mapping keeps the segment alive
+        return ok;
+    }
+
+    /** @brief Maps the image behind `fd` (a shared-memory segment or memfd); `fd` stays open. */
+    bool attach_fd(int fd, std::string &error)
+    {
+        detach();
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            error = std::string("cannot stat the segment: ") + std::strerror(errno);
+            return false;
+        }
+        if (size_t(st.st_size) < sizeof(shared_scene_header))
+        {
+            error = "segment too small to hold a scene";
+            return false;
+        }
+        void *p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            error = std::string("cannot map the segment: ") + std::strerror(errno);
+            return false;
+        }
+        base = static_cast<const char *>(p);
+        bytes = size_t(st.st_size);
+        if (!validate(error))
+        {
+            detach();
+            return false;
+        }
+
+        const auto &h = header();
+        spheres = reinterpret_cast<const packed_sphere *>(base + h.sphere_offset);
+        nodes = reinterpret_cast<const bvh_node *>(base + h.node_offset);
+        indices = reinterpret_cast<const uint32_t *>(base + h.index_offset);
+        auto materials = reinterpret_cast<const material_desc *>(base + h.material_offset);
+        for (uint64_t m = 0; m < h.material_count; m++)
+            material_objects.push_back(materials[m].create());
+        first_object = allocate_object_ids(uint32_t(h.sphere_count));
+        bbox = aabb(point3(h.bounds[0], h.bounds[1], h.bounds[2]), point3(h.bounds[3], h.bounds[4], h.bounds[5]));
+        return true;
+    }
+
+    /** @brief Unmaps the image. */
+    void detach()
+    {
+        if (base)
+            munmap(const_cast<char *>(base), bytes);
+        base = nullptr;
+        bytes = 0;
+        spheres = nullptr;
+        nodes = nullptr;
+        indices = nullptr;
+        material_objects.clear();
+        bbox = aabb();
+    }
+
+    bool attached() const { return base != nullptr; }
+
+    bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+    {
+        if (!base || header().node_count == 0)
+            return false;
+        return bvh_tree::traverse_nodes(nodes, indices, r, ray_t,
+                                        [&](uint32_t index, const interval &t, double &t_hit)
+                                        {
+                                            if (!hit_packed_sphere(spheres[index], material_objects.data(), r, t, rec))
+                                                return false;
+                                            rec.object = first_object + index;
+                                            t_hit = rec.t;
+                                            return true;
+                                        });
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    /** @brief Number of spheres in the image. */
+    uint64_t sphere_count() const { return base ? header().sphere_count : 0; }
+
+    /** @brief Bytes mapped (shared with every other process using the image). */
+    size_t mapped_bytes() const { return bytes; }
+
+    /** @brief Half width of the generated scene domain, stored by the publisher. */
+    double extent() const { return base ? header().extent : 1; }
+
+private:
+    const char *base = nullptr;
+    size_t bytes = 0;
+    const packed_sphere *spheres = nullptr;
+    const bvh_node *nodes = nullptr;
+    const uint32_t *indices = nullptr;
+    std::vector<shared_ptr<material>> material_objects;
+    uint32_t first_object = 0;
+    aabb bbox;
+
+    const shared_scene_header &header() const { return *reinterpret_cast<const shared_scene_header *>(base); }
+
+    /** @brief Checks the header: complete, same record layout, sections inside the image. */
+    bool validate(std::string &error) const
+    {
+        const auto &h = header();
+        if (std::memcmp(h.magic, shared_scene_magic, sizeof(shared_scene_magic)) != 0)
+        {
+            error = "not a compiled RayCraft scene, or still being written";
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (h.header_bytes != sizeof(shared_scene_header) || h.record_bytes[0] != sizeof(material_desc) ||
+            h.record_bytes[1] != sizeof(packed_sphere) || h.record_bytes[2] != sizeof(bvh_node))
+        {
+            error = "scene image was compiled with a different record layout";
+            return false;
+        }
+        if (h.total_bytes > bytes)
+        {
+            error = "scene image is truncated";
+            return false;
+        }
+        auto inside = [&](uint64_t offset, uint64_t count, uint64_t record)
+        { return offset % 64 == 0 && offset <= h.total_bytes && count <= (h.total_bytes - offset) / record; };
+        if (!inside(h.material_offset, h.material_count, sizeof(material_desc)) ||
+            !inside(h.sphere_offset, h.sphere_count, sizeof(packed_sphere)) ||
+            !inside(h.node_offset, h.node_count, sizeof(bvh_node)) ||
+            !inside(h.index_offset, h.index_count, sizeof(uint32_t)) || h.index_count != h.sphere_count ||
+            h.sphere_count > std::numeric_limits<uint32_t>::max() || (h.sphere_count > 0 && h.node_count == 0))
+        {
+            error = "scene image has inconsistent sections";
+            return false;
+        }
+        auto materials = reinterpret_cast<const material_desc *>(base + h.material_offset);
+        for (uint64_t m = 0; m < h.material_count; m++)
+            if (uint32_t(materials[m].kind) > uint32_t(material_kind::dielectric))
+            {
+                error = "unknown material kind " + std::to_string(uint32_t(materials[m].kind));
+                return false;
+            }
+        return true;
+    }
+};
+
+/** @brief Sets up the generated scene view for a mapped scene image. */
+inline void generated_scene_view(camera &cam, const shared_scene &scene) { generated_scene_view(cam, scene.extent()); }
+
+#endif
@@ -15,6 +15,7 @@
 #include "ray.h"
 #include "vec3.h"
 #include "color.h"
+#include "counters.h"
 
 /**
  * @class sphere
@@ -47,7 +48,11 @@ public:
    * 
    */
   sphere(const point3 &center, double radius, shared_ptr<material> mat)
-      : center(center), radius(std::fmax(0, radius)), mat(mat) {}
+      : center(center), radius(std::fmax(0, radius)), mat(mat), object_id(allocate_object_ids(1))
+  {
+    auto rvec = vec3(radius, radius, radius);
+    bbox = aabb(center - rvec, center + rvec);
+  }
       
   /**
    * @brief Determines whether a ray intersects the sphere within a valid range.
@@ -65,6 +70,8 @@ public:
 
   bool hit(const ray &r, interval ray_t, hit_record &rec) const override
   {
+    thread_counters().isect_tests++;
+
     vec3 oc = center - r.origin();
     auto a = r.direction().length_squared();
     auto h = dot(r.direction(), oc);
@@ -92,14 +99,19 @@ public:
     vec3 outward_normal = (rec.p - center) / radius;
     rec.set_face_normal(r, outward_normal);
     rec.mat = mat;
+    rec.object = object_id;
 
     return true;
   }
 
+  aabb bounding_box() const override { return bbox; }
+
 private:
   point3 center;                   // <- the center of the sphere
   double radius;                   // <- the radius of the sphere
   shared_ptr<material> mat;        // <- the material associated with the sphere
+  aabb bbox;                       // <- the bounding box of the sphere
+  uint32_t object_id;              // <- identifier reported in hit records
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,183 @@
+/**
+ * @file sphere_set.h
+ * @brief Packed storage for very large sphere scenes.
+ *
+ * A `sphere` object behind a `shared_ptr` costs close to 100 bytes (vtable, double
+ * precision center, bounding box, material pointer and control block). Generated
+ * stress scenes hold up to 10^8 spheres, so they are stored instead as 20-byte
+ * records (float center and radius, material index) in one array, with a material
+ * table and a `bvh_tree` over the records.
+ */
+
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include "bvh.h"
+#include "constants.h"
+#include "counters.h"
+#include "hittable.h"
+#include "material.h"
+
+#include <vector>
+
+/**
+ * @class packed_sphere
+ * @brief One sphere of a `sphere_set` (20 bytes).
+ */
+struct packed_sphere
+{
+    float center[3];
+    float radius;
+    uint32_t material; ///< Index into the material table
+};
+
+/** @brief Material kinds that can be stored in a material table. */
+enum class material_kind : uint32_t
+{
+    lambertian = 0,
+    metal = 1,
+    dielectric = 2,
+};
+
+/**
+ * @class material_desc
+ * @brief Plain description of a material, as stored in scene files.
+ */
+struct material_desc
+{
+    material_kind kind = material_kind::lambertian;
+    float albedo[3] = {0.5f, 0.5f, 0.5f};
+    float param = 0; ///< Fuzz for metal, refraction index for dielectric
+
+    /** @brief Creates the corresponding material object. */
+    shared_ptr<material> create() const
+    {
+        color c(albedo[0], albedo[1], albedo[2]);
+        switch (kind)
+        {
+        case material_kind::metal:
+            return make_shared<metal>(c, param);
+        case material_kind::dielectric:
+            return make_shared<dielectric>(param);
+        default:
+            return make_shared<lambertian>(c);
+        }
+    }
+};
+
+/**
+ * @brief Ray-sphere intersection of a packed record, identical to `sphere::hit`.
+ * @param materials Material objects indexed by `packed_sphere::material`.
+ */
+inline bool hit_packed_sphere(const packed_sphere &s, const shared_ptr<material> *materials, const ray &r,
+                              const interval &ray_t, hit_record &rec)
+{
+    thread_counters().isect_tests++;
+
+    point3 center(s.center[0], s.center[1], s.center[2]);
+    double radius = s.radius;
+
+    vec3 oc = center - r.origin();
+    auto a = r.direction().length_squared();
+    auto h = dot(r.direction(), oc);
+    auto c = oc.length_squared() - radius * radius;
+
+    auto discriminant = h * h - a * c;
+    if (discriminant < 0)
+        return false;
+
+    auto sqrtd = std::sqrt(discriminant);
+
+    auto root = (h - sqrtd) / a;
+    if (!ray_t.surrounds(root))
+    {
+        root = (h + sqrtd) / a;
+        if (!ray_t.surrounds(root))
+            return false;
+    }
+
+    rec.t = root;
+    rec.p = r.at(rec.t);
+    rec.set_face_normal(r, (rec.p - center) / radius);
+    rec.mat = materials[s.material];
+    return true;
+}
+
+/**
+ * @class sphere_set
+ * @brief A `hittable` holding many spheres in packed form, accelerated by a BVH.
+ *
+ * Fill `spheres` and `materials`, then call `build()` before rendering.
+ */
+class sphere_set : public hittable
+{
+public:
+    std::vector<packed_sphere> spheres;   ///< Sphere records
+    std::vector<material_desc> materials; ///< Material table referenced by the records
+
+    /**
+     * @brief Creates the material objects and builds the BVH.
+     * @param leaf_size Maximum number of spheres per leaf.
+     * @param threads Build threads (0 = all hardware threads).
+     */
+    void build(int leaf_size = 4, int threads = 0)
+    {
+        material_objects.clear();
+        for (const auto &m : materials)
+            material_objects.push_back(m.create());
+        if (object_count != spheres.size())
+        {
+            first_object = allocate_object_ids(uint32_t(spheres.size()));
+            object_count = spheres.size();
+        }
+
+        std::vector<bvh_box> boxes(spheres.size());
+        bbox = aabb();
+        for (size_t n = 0; n < spheres.size(); n++)
+        {
+            const auto &s = spheres[n];
+            for (int a = 0; a < 3; a++)
+            {
+                // Round outwards so the float box encloses the sphere
+                boxes[n].lo[a] = std::nextafter(s.center[a] - s.radius, -std::numeric_limits<float>::infinity());
+                boxes[n].hi[a] = std::nextafter(s.center[a] + s.radius, +std::numeric_limits<float>::infinity());
+            }
+            bbox = aabb(bbox, aabb(point3(boxes[n].lo[0], boxes[n].lo[1], boxes[n].lo[2]),
+                                   point3(boxes[n].hi[0], boxes[n].hi[1], boxes[n].hi[2])));
+        }
+        tree.build(boxes, leaf_size, threads);
+    }
+
+    bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+    {
+        return tree.traverse(r, ray_t,
+                             [&](uint32_t index, const interval &t, double &t_hit)
+                             {
+                                 if (!hit_packed_sphere(spheres[index], material_objects.data(), r, t, rec))
+                                     return false;
+                                 rec.object = first_object + index;
+                                 t_hit = rec.t;
+                                 return true;
+                             });
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    /** @brief Returns the BVH (for statistics). */
+    const bvh_tree &tree_data() const { return tree; }
+
+    /** @brief Returns the bytes held by the records, material table and BVH. */
+    size_t memory_bytes() const
+    {
+        return spheres.size() * sizeof(packed_sphere) + materials.size() * sizeof(material_desc) + tree.memory_bytes();
+    }
+
+private:
+    std::vector<shared_ptr<material>> material_objects;
+    uint32_t first_object = 0; ///< Object identifier of spheres[0]; the others follow
+    size_t object_count = 0;   ///< Spheres the identifiers were allocated for
+    bvh_tree tree;
+    aabb bbox;
+};
+
+#endif
@@ -0,0 +1,275 @@
+/**
+ * @file statistics.h
+ * @brief Small statistics toolkit for the benchmark and regression tools.
+ *
+ * Provides sample moments and the special functions needed for significance
+ * tests (regularised incomplete beta and gamma, Student's t, chi-square and
+ * Kolmogorov distributions) without pulling in any external dependency.
+ */
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/** @brief Arithmetic mean of `x` (0 for an empty sample). */
+inline double sample_mean(const std::vector<double> &x)
+{
+    if (x.empty())
+        return 0;
+    double s = 0;
+    for (double v : x)
+        s += v;
+    return s / x.size();
+}
+
+/** @brief Unbiased sample variance of `x` (0 for fewer than two values). */
+inline double sample_variance(const std::vector<double> &x)
+{
+    if (x.size() < 2)
+        return 0;
+    double m = sample_mean(x);
+    double s = 0;
+    for (double v : x)
+        s += (v - m) * (v - m);
+    return s / (x.size() - 1);
+}
+
+/**
+ * @brief Continued fraction for the incomplete beta function (modified Lentz).
+ */
+inline double incomplete_beta_cf(double a, double b, double x)
+{
+    const double tiny = 1e-300;
+    double qab = a + b, qap = a + 1, qam = a - 1;
+    double c = 1, d = 1 - qab * x / qap;
+    if (std::fabs(d) < tiny)
+        d = tiny;
+    d = 1 / d;
+    double h = d;
+
+    for (int m = 1; m <= 300; m++)
+    {
+        int m2 = 2 * m;
+        double aa = m * (b - m) * x / ((qam + m2) * (a + m2));
+        d = 1 + aa * d;
+        if (std::fabs(d) < tiny)
+            d = tiny;
+        c = 1 + aa / c;
+        if (std::fabs(c) < tiny)
+            c = tiny;
+        d = 1 / d;
+        h *= d * c;
+
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2));
+        d = 1 + aa * d;
+        if (std::fabs(d) < tiny)
+            d = tiny;
+        c = 1 + aa / c;
+        if (std::fabs(c) < tiny)
+            c = tiny;
+        d = 1 / d;
+        double del = d * c;
+        h *= del;
+        if (std::fabs(del - 1) < 1e-14)
+            break;
+    }
+    return h;
+}
+
+/**
+ * @brief Regularised incomplete beta function I_x(a, b).
+ */
+inline double incomplete_beta(double a, double b, double x)
+{
+    if (x <= 0)
+        return 0;
+    if (x >= 1)
+        return 1;
+    double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) + b * std::log(1 - x));
+    if (x < (a + 1) / (a + b + 2))
+        return front * incomplete_beta_cf(a, b, x) / a;
+    return 1 - front * incomplete_beta_cf(b, a, 1 - x) / b;
+}
+
+/**
+ * @brief Cumulative distribution function of Student's t distribution.
+ * @param t Test statistic.
+ * @param df Degrees of freedom (need not be an integer).
+ */
+inline double student_t_cdf(double t, double df)
+{
+    double tail = 0.5 * incomplete_beta(df / 2, 0.5, df / (df + t * t));
+    return t > 0 ? 1 - tail : tail;
+}
+
+/**
+ * @class welch_result
+ * @brief Outcome of Welch's unequal-variance t-test.
+ */
+struct welch_result
+{
+    double t = 0;          ///< t statistic for mean(b) - mean(a)
+    double df = 0;         ///< Welch–Satterthwaite degrees of freedom
+    double p_less = 1;     ///< One-sided p-value for "mean(b) < mean(a)"
+    double p_greater = 1;  ///< One-sided p-value for "mean(b) > mean(a)"
+};
+
+/**
+ * @brief Welch's t-test comparing sample `b` against reference sample `a`.
+ *
+ * Both samples need at least two values; otherwise the result reports no evidence
+ * (p-values of 1).
+ */
+inline welch_result welch_t_test(const std::vector<double> &a, const std::vector<double> &b)
+{
+    welch_result r;
+    if (a.size() < 2 || b.size() < 2)
+        return r;
+
+    double va = sample_variance(a) / a.size();
+    double vb = sample_variance(b) / b.size();
+    double diff = sample_mean(b) - sample_mean(a);
+
+    if (va + vb <= 0)
+    {
+        // Identical constant samples: any difference is infinitely significant
+        r.p_less = diff < 0 ? 0 : 1;
+        r.p_greater = diff > 0 ? 0 : 1;
+        return r;
+    }
+
+    r.t = diff / std::sqrt(va + vb);
+    r.df = (va + vb) * (va + vb) / (va * va / (a.size() - 1) + vb * vb / (b.size() - 1));
+    r.p_less = student_t_cdf(r.t, r.df);
+    r.p_greater = 1 - r.p_less;
+    return r;
+}
+
+/**
+ * @brief Regularised upper incomplete gamma function Q(a, x) = 1 - P(a, x).
+ *
+ * Series expansion below x < a + 1, continued fraction above.
+ */
+inline double incomplete_gamma_upper(double a, double x)
+{
+    if (x <= 0)
+        return 1;
+    double log_front = -x + a * std::log(x) - std::lgamma(a);
+
+    if (x < a + 1)
+    {
+        double ap = a, sum = 1 / a, del = sum;
+        for (int n = 0; n < 1000; n++)
+        {
+            ap += 1;
+            del *= x / ap;
+            sum += del;
+            if (std::fabs(del) < std::fabs(sum) * 1e-15)
+                break;
+        }
+        return 1 - sum * std::exp(log_front);
+    }
+
+    const double tiny = 1e-300;
+    double b = x + 1 - a, c = 1 / tiny, d = 1 / b, h = d;
+    for (int n = 1; n < 1000; n++)
+    {
+        double an = -n * (n - a);
+        b += 2;
+        d = an * d + b;
+        if (std::fabs(d) < tiny)
+            d = tiny;
+        c = b + an / c;
+        if (std::fabs(c) < tiny)
+            c = tiny;
+        d = 1 / d;
+        double del = d * c;
+        h *= del;
+        if (std::fabs(del - 1) < 1e-15)
+            break;
+    }
+    return std::exp(log_front) * h;
+}
+
+/** @brief Survival function (upper tail p-value) of the chi-square distribution. */
+inline double chi_square_sf(double x, double df)
+{
+    return incomplete_gamma_upper(df / 2, x / 2);
+}
+
+/**
+ * @brief Pearson's chi-square statistic of observed counts against expected counts.
+ *
+ * Bins with a tiny expectation are merged into their neighbour so the statistic
+ * stays approximately chi-square distributed (every merged bin expects >= 5).
+ *
+ * @param df Receives the degrees of freedom (merged bins - 1).
+ */
+inline double chi_square_statistic(const std::vector<double> &observed, const std::vector<double> &expected, int &df)
+{
+    double chi2 = 0, obs = 0, exp = 0;
+    int bins = 0;
+    for (size_t n = 0; n < observed.size(); n++)
+    {
+        obs += observed[n];
+        exp += expected[n];
+        if (exp >= 5 || n + 1 == observed.size())
+        {
+            if (exp > 0)
+            {
+                chi2 += (obs - exp) * (obs - exp) / exp;
+                bins++;
+            }
+            obs = exp = 0;
+        }
+    }
+    df = bins - 1;
+    return chi2;
+}
+
+/**
+ * @brief Asymptotic p-value of the one-sample Kolmogorov–Smirnov test.
+ * @param d The KS statistic (largest CDF distance).
+ * @param n Sample size.
+ */
+inline double kolmogorov_smirnov_pvalue(double d, size_t n)
+{
+    double sn = std::sqrt(double(n));
+    double lambda = (sn + 0.12 + 0.11 / sn) * d;
+    if (lambda < 0.2)
+        return 1;
+
+    double sum = 0, sign = 1;
+    for (int k = 1; k <= 100; k++)
+    {
+        double term = sign * std::exp(-2 * k * k * lambda * lambda);
+        sum += term;
+        if (std::fabs(term) < 1e-16)
+            break;
+        sign = -sign;
+    }
+    return std::min(1.0, std::max(0.0, 2 * sum));
+}
+
+/**
+ * @brief One-sample Kolmogorov–Smirnov statistic of `samples` against `cdf`.
+ *
+ * Sorts `samples` in place.
+ */
+template <typename Cdf>
+double kolmogorov_smirnov_statistic(std::vector<double> &samples, Cdf cdf)
+{
+    std::sort(samples.begin(), samples.end());
+    double n = double(samples.size()), d = 0;
+    for (size_t k = 0; k < samples.size(); k++)
+    {
+        double f = cdf(samples[k]);
+        d = std::max(d, std::max(f - k / n, (k + 1) / n - f));
+    }
+    return d;
+}
+
+#endif
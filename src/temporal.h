@@ -0,0 +1,211 @@
+/**
+ * @file temporal.h
+ * @brief Temporal accumulation: animation frames start from the reprojected samples
+ * of the previous frame instead of from zero.
+ *
+ * Before a frame is rendered, a geometry pass records what every pixel centre sees
+ * (see geometry_aov.h). Each visible point is projected into the previous frame's
+ * camera; the difference of the two pixel positions is the pixel's motion vector.
+ * The previous frame's accumulated radiance sum and sample weight are fetched there
+ * with bilinear weights, and each of the four taps is used only if the previous
+ * frame saw the same surface there: same object, a distance from the previous
+ * camera that matches within `depth_tolerance`, and a normal within
+ * `normal_cos_min`. Pixels that were hidden or off screen in the previous frame
+ * start from zero. The new frame then adds only a few fresh samples per pixel.
+ *
+ * The reused weight is capped at `max_history` samples. Beyond that, old samples
+ * fade out like an exponential moving average, which bounds the lag of
+ * view-dependent shading (metal, glass) that the geometric tests cannot catch.
+ *
+ * The scenes are static, so motion comes only from the camera; moving objects would
+ * need their per-object transform applied to the visible point before projecting.
+ */
+
+#ifndef TEMPORAL_H
+#define TEMPORAL_H
+
+#include "constants.h"
+#include "framebuffer.h"
+#include "geometry_aov.h"
+
+#include <cmath>
+#include <cstdint>
+
+/**
+ * @class temporal_accumulator
+ * @brief Carries accumulated samples from one animation frame to the next.
+ */
+class temporal_accumulator
+{
+public:
+    double depth_tolerance = 0.03; ///< Relative distance mismatch that rejects a history tap
+    double normal_cos_min = 0.9;   ///< Smallest cosine between normals that keeps a history tap
+    double max_history = 64;       ///< Sample weight the reprojected history is capped at
+
+    /** @brief Reprojection statistics of the last `begin_frame`. */
+    struct report
+    {
+        int pixels = 0;
+        int reused = 0;            ///< Pixels that kept some history
+        int rejected_offscreen = 0; ///< Visible point was outside (or behind) the previous view
+        int rejected_object = 0;    ///< Nearest tap showed another object
+        int rejected_depth = 0;     ///< Same object, but at another distance (occluded)
+        int rejected_normal = 0;    ///< Same object and distance, normal too different
+        double mean_motion = 0;     ///< Average motion vector length in pixels
+        double mean_history = 0;    ///< Average reused sample weight per pixel
+
+        double reused_fraction() const { return pixels ? double(reused) / pixels : 0; }
+    };
+
+    report last;
+
+    /**
+     * @brief Prepares `fb` for the frame `cam` is about to render.
+     *
+     * Renders the geometry pass and fills `fb` with the reprojected history (or
+     * clears it for the first frame), so a following `render_pass` into `fb` adds
+     * its samples on top.
+     */
+    void begin_frame(camera &cam, const hittable &world, framebuffer &fb)
+    {
+        std::swap(current, previous);
+        cam.render_geometry(world, current);
+        previous_view = current_view;
+        current_view = cam.projection();
+
+        fb.resize(current.width, current.height);
+        last = report();
+        last.pixels = current.width * current.height;
+        if (!has_history || history.width != current.width || history.height != current.height)
+            return;
+
+        double motion_sum = 0, weight_sum = 0;
+        for (int j = 0; j < current.height; j++)
+            for (int i = 0; i < current.width; i++)
+            {
+                double motion = 0;
+                if (reproject(i, j, fb, motion))
+                {
+                    last.reused++;
+                    motion_sum += motion;
+                    weight_sum += fb.weight[fb.index(i, j)];
+                }
+            }
+        if (last.reused)
+        {
+            last.mean_motion = motion_sum / last.reused;
+            last.mean_history = weight_sum / last.pixels;
+        }
+    }
+
+    /** @brief Keeps the finished frame as the history of the next one. */
+    void end_frame(const framebuffer &fb)
+    {
+        history.width = fb.width;
+        history.height = fb.height;
+        history.sum = fb.sum;
+        history.weight = fb.weight;
+        has_history = true;
+    }
+
+    /** @brief Geometry AOV of the current frame. */
+    const geometry_aov &geometry() const { return current; }
+
+private:
+    geometry_aov current, previous;
+    camera_projection current_view, previous_view;
+    framebuffer history;
+    bool has_history = false;
+
+    /** @brief Outcome of checking one history tap. */
+    enum rejection
+    {
+        accept,
+        offscreen,
+        other_object,
+        other_depth,
+        other_normal
+    };
+
+    /** @brief Whether history pixel (x, y) saw the surface that pixel `idx` sees now. */
+    rejection check_tap(size_t idx, int x, int y) const
+    {
+        if (x < 0 || y < 0 || x >= previous.width || y >= previous.height)
+            return offscreen;
+        size_t tap = size_t(y) * previous.width + x;
+        uint32_t id = current.object[idx];
+        if (previous.object[tap] != id)
+            return other_object;
+        if (id == 0)
+            return accept; // background depends on the direction only
+        double expected = (current.position[idx] - previous_view.center).length();
+        if (std::fabs(previous.distance[tap] - expected) > depth_tolerance * expected)
+            return other_depth;
+        if (dot(previous.normal[tap], current.normal[idx]) < normal_cos_min)
+            return other_normal;
+        return accept;
+    }
+
+    /** @brief Fills pixel (i, j) of `fb` from the history; false if no tap is usable. */
+    bool reproject(int i, int j, framebuffer &fb, double &motion)
+    {
+        size_t idx = fb.index(i, j);
+        double x, y;
+        bool in_front = current.object[idx] ? previous_view.project(current.position[idx], x, y)
+                                            : previous_view.project_direction(current.position[idx], x, y);
+        if (!in_front || x < -0.5 || y < -0.5 || x > previous.width - 0.5 || y > previous.height - 0.5)
+        {
+            last.rejected_offscreen++;
+            return false;
+        }
+        motion = std::hypot(x - i, y - j);
+
+        int x0 = int(std::floor(x)), y0 = int(std::floor(y));
+        double fx = x - x0, fy = y - y0;
+        color sum(0, 0, 0);
+        double weight = 0, taps = 0;
+        for (int k = 0; k < 4; k++)
+        {
+            int tx = x0 + (k & 1), ty = y0 + (k >> 1);
+            double w = ((k & 1) ? fx : 1 - fx) * ((k >> 1) ? fy : 1 - fy);
+            if (w <= 0 || check_tap(idx, tx, ty) != accept)
+                continue;
+            size_t tap = history.index(tx, ty);
+            sum += w * history.sum[tap];
+            weight += w * history.weight[tap];
+            taps += w;
+        }
+        if (taps <= 0 || weight <= 0)
+        {
+            // Attribute the rejection to the nearest tap
+            switch (check_tap(idx, int(std::lround(x)), int(std::lround(y))))
+            {
+            case other_object:
+                last.rejected_object++;
+                break;
+            case other_depth:
+                last.rejected_depth++;
+                break;
+            case other_normal:
+                last.rejected_normal++;
+                break;
+            default:
+                last.rejected_offscreen++;
+            }
+            return false;
+        }
+
+        sum /= taps;
+        weight /= taps;
+        if (weight > max_history)
+        {
+            sum *= max_history / weight;
+            weight = max_history;
+        }
+        fb.sum[idx] = sum;
+        fb.weight[idx] = weight;
+        return true;
+    }
+};
+
+#endif
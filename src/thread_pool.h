@@ -0,0 +1,186 @@
+/**
+ * @file thread_pool.h
+ * @brief Work-stealing thread pool fed by a pull-based work source.
+ *
+ * Every worker owns a deque of tasks. It pops from the back of its own deque and,
+ * when that is empty, steals from the front of the others, so a batch of tiles
+ * pulled by one worker is quickly spread over the idle ones. When no deque has
+ * work left, the worker asks the `source` for a new batch. Pulling small batches
+ * on demand (instead of pushing whole jobs into the deques) lets the source decide
+ * what runs next at tile granularity, e.g. to let an urgent job overtake a large
+ * one that is already running.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class work_stealing_pool
+ * @brief Fixed set of workers with per-worker deques and work stealing.
+ */
+class work_stealing_pool
+{
+public:
+    using task = std::function<void()>;
+
+    /**
+     * @brief Fills `batch` with up to `max` tasks; returns false when there is no work.
+     * Called concurrently from idle workers.
+     */
+    using source_fn = std::function<bool(std::vector<task> &batch, size_t max)>;
+
+    /**
+     * @brief Starts the workers.
+     * @param threads Worker count (0 = all hardware threads).
+     * @param source Where idle workers pull new batches from.
+     * @param batch_size Tasks pulled per call to `source` (0 = one per worker).
+     */
+    work_stealing_pool(int threads, source_fn source, size_t batch_size = 0) : source(std::move(source))
+    {
+        if (threads <= 0)
+            threads = int(std::max(1u, std::thread::hardware_concurrency()));
+        this->batch_size = batch_size ? batch_size : size_t(threads);
+
+        for (int n = 0; n < threads; n++)
+            queues.push_back(std::make_unique<worker_queue>());
+        for (int n = 0; n < threads; n++)
+            workers.emplace_back([this, n]() { run(n); });
+    }
+
+    /** @brief Stops the workers; tasks that have not started yet are discarded. */
+    ~work_stealing_pool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(idle_lock);
+            stopping = true;
+        }
+        idle_cv.notify_all();
+        for (auto &w : workers)
+            w.join();
+    }
+
+    work_stealing_pool(const work_stealing_pool &) = delete;
+    work_stealing_pool &operator=(const work_stealing_pool &) = delete;
+
+    /** @brief Wakes idle workers because the source has new work. */
+    void notify()
+    {
+        {
+            std::lock_guard<std::mutex> guard(idle_lock);
+            epoch++;
+        }
+        idle_cv.notify_all();
+    }
+
+    /** @brief Number of workers. */
+    int size() const { return int(workers.size()); }
+
+    /** @brief Index of the pool worker running the calling thread, -1 outside any pool. */
+    static int worker_index() { return current_worker(); }
+
+    /** @brief Tasks taken from another worker's deque so far. */
+    uint64_t steals() const { return steal_count.load(std::memory_order_relaxed); }
+
+private:
+    struct worker_queue
+    {
+        std::mutex lock;
+        std::deque<task> tasks;
+    };
+
+    source_fn source;
+    size_t batch_size;
+    std::vector<std::unique_ptr<worker_queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<uint64_t> steal_count{0};
+
+    std::mutex idle_lock; // guards epoch and stopping
+    std::condition_variable idle_cv;
+    uint64_t epoch = 0; ///< Bumped whenever new work may be available
+    bool stopping = false;
+
+    static int &current_worker()
+    {
+        thread_local int index = -1;
+        return index;
+    }
+
+    bool pop_local(int id, task &t)
+    {
+        auto &q = *queues[id];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (q.tasks.empty())
+            return false;
+        t = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(int id, task &t)
+    {
+        for (size_t k = 1; k < queues.size(); k++)
+        {
+            auto &q = *queues[(id + k) % queues.size()];
+            std::lock_guard<std::mutex> guard(q.lock);
+            if (q.tasks.empty())
+                continue;
+            t = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            steal_count.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void run(int id)
+    {
+        current_worker() = id;
+        while (true)
+        {
+            // Read the epoch before looking for work so a notify() in between is not lost
+            uint64_t seen;
+            {
+                std::lock_guard<std::mutex> guard(idle_lock);
+                if (stopping)
+                    return;
+                seen = epoch;
+            }
+
+            task t;
+            if (pop_local(id, t) || steal(id, t))
+            {
+                t();
+                continue;
+            }
+
+            std::vector<task> batch;
+            if (source(batch, batch_size) && !batch.empty())
+            {
+                {
+                    auto &q = *queues[id];
+                    std::lock_guard<std::mutex> guard(q.lock);
+                    // Reversed, so this worker pops the batch in order and thieves take its tail
+                    for (auto it = batch.rbegin(); it != batch.rend(); ++it)
+                        q.tasks.push_back(std::move(*it));
+                }
+                if (batch.size() > 1)
+                    notify(); // let idle workers steal from the new batch
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(idle_lock);
+            idle_cv.wait(lock, [&]() { return stopping || epoch != seen; });
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,155 @@
+/**
+ * @file tile_schedule.h
+ * @brief Predictive tile scheduling from the cost history of previous frames.
+ *
+ * Tiles are claimed in row-major order by default, so an expensive tile (glass
+ * spheres, deep reflections) that happens to be claimed last keeps one thread busy
+ * long after the others have run out of work. Consecutive frames of an animation
+ * are nearly identical, so the cost of every tile in frame N is a good predictor
+ * for frame N+1. `tile_schedule` records the measured cost per tile and plans the
+ * next frame from it:
+ *
+ *  - tiles predicted to take more than a fair share of the frame are split into
+ *    quadrants (recursively, down to `min_split` pixels), and
+ *  - the resulting work items are handed out most expensive first (longest
+ *    processing time first), so the cheap ones fill the gaps at the end.
+ */
+
+#ifndef TILE_SCHEDULE_H
+#define TILE_SCHEDULE_H
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * @class tile_rect
+ * @brief A rectangle of pixels [x0, x1) x [y0, y1) rendered as one work item.
+ */
+struct tile_rect
+{
+    int x0, y0, x1, y1;
+
+    int pixels() const { return (x1 - x0) * (y1 - y0); }
+};
+
+/** @brief Cuts the image into `tile_size` squares in row-major order. */
+inline std::vector<tile_rect> grid_tiles(int width, int height, int tile_size)
+{
+    std::vector<tile_rect> tiles;
+    for (int y = 0; y < height; y += tile_size)
+        for (int x = 0; x < width; x += tile_size)
+            tiles.push_back(tile_rect{x, y, std::min(x + tile_size, width), std::min(y + tile_size, height)});
+    return tiles;
+}
+
+/**
+ * @class tile_schedule
+ * @brief Per-tile cost history and the work plan derived from it.
+ */
+class tile_schedule
+{
+public:
+    int min_split = 4;        ///< Smallest edge length of a split tile
+    int items_per_thread = 4; ///< A work item should take at most 1 / (threads * items_per_thread) of the frame
+    double blend = 0.75;      ///< Weight of the newest frame in the cost history
+
+    int splits = 0; ///< Tiles split in the last plan
+
+    /** @brief True once a frame of the current size has been recorded. */
+    bool has_history() const { return !cost.empty(); }
+
+    /**
+     * @brief Returns the work items for the next frame, most expensive first.
+     *
+     * Without history (first frame, or the image or tile size changed) this is the
+     * plain row-major tile grid.
+     */
+    std::vector<tile_rect> plan(int w, int h, int ts, int threads)
+    {
+        if (w != width || h != height || ts != tile_size)
+        {
+            width = w;
+            height = h;
+            tile_size = ts;
+            cost.clear();
+        }
+
+        splits = 0;
+        std::vector<tile_rect> tiles = grid_tiles(width, height, tile_size);
+        if (!has_history())
+            return tiles;
+
+        double total = 0;
+        for (double c : cost)
+            total += c;
+        double target = total / (std::max(threads, 1) * items_per_thread);
+
+        std::vector<std::pair<double, tile_rect>> items;
+        for (size_t t = 0; t < tiles.size(); t++)
+        {
+            if (cost[t] > target)
+                splits++;
+            split(tiles[t], cost[t], target, items);
+        }
+
+        std::stable_sort(items.begin(), items.end(),
+                         [](const std::pair<double, tile_rect> &a, const std::pair<double, tile_rect> &b)
+                         { return a.first > b.first; });
+
+        std::vector<tile_rect> planned;
+        for (const auto &item : items)
+            planned.push_back(item.second);
+        return planned;
+    }
+
+    /**
+     * @brief Records the measured cost of every work item of a finished frame.
+     * @param items The plan that was rendered.
+     * @param seconds Render time of each item.
+     */
+    void record(const std::vector<tile_rect> &items, const std::vector<double> &seconds)
+    {
+        int tiles_x = (width + tile_size - 1) / tile_size;
+        int tiles_y = (height + tile_size - 1) / tile_size;
+        std::vector<double> frame(size_t(tiles_x) * tiles_y, 0.0);
+
+        // Split items never cross tile borders, so each maps back to one tile
+        for (size_t n = 0; n < items.size(); n++)
+            frame[size_t(items[n].y0 / tile_size) * tiles_x + items[n].x0 / tile_size] += seconds[n];
+
+        if (cost.size() != frame.size())
+        {
+            cost = frame;
+            return;
+        }
+        for (size_t t = 0; t < cost.size(); t++)
+            cost[t] = blend * frame[t] + (1 - blend) * cost[t];
+    }
+
+private:
+    int width = 0, height = 0, tile_size = 0;
+    std::vector<double> cost; ///< Predicted seconds per grid tile
+
+    /** @brief Splits `r` into quadrants until each is predicted below `target`. */
+    void split(const tile_rect &r, double estimate, double target, std::vector<std::pair<double, tile_rect>> &out)
+    {
+        int w = r.x1 - r.x0, h = r.y1 - r.y0;
+        if (estimate <= target || (w < 2 * min_split && h < 2 * min_split))
+        {
+            out.push_back({estimate, r});
+            return;
+        }
+
+        int xm = w >= 2 * min_split ? r.x0 + w / 2 : r.x1;
+        int ym = h >= 2 * min_split ? r.y0 + h / 2 : r.y1;
+        tile_rect parts[4] = {{r.x0, r.y0, xm, ym}, {xm, r.y0, r.x1, ym}, {r.x0, ym, xm, r.y1}, {xm, ym, r.x1, r.y1}};
+        for (const auto &p : parts)
+        {
+            // Without finer history, assume cost is spread evenly over the pixels
+            if (p.pixels() > 0)
+                split(p, estimate * p.pixels() / r.pixels(), target, out);
+        }
+    }
+};
+
+#endif
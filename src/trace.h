@@ -0,0 +1,275 @@
+/**
+ * @file trace.h
+ * @brief Low-overhead timeline tracing exported as Chrome `trace_event` JSON.
+ *
+ * Each thread records begin/end events into its own fixed-size ring buffer, so
+ * recording never takes a lock and never allocates. When the render is done the
+ * buffers are exported as JSON that can be opened in Perfetto (ui.perfetto.dev)
+ * or chrome://tracing to see which thread was doing what.
+ *
+ * Tracing is compiled in only when `RAYCRAFT_ENABLE_TRACE` is defined. Without it
+ * the `RAYCRAFT_TRACE_*` macros expand to nothing and cost exactly zero; with it,
+ * recording is still skipped until `trace::enable()` is called at runtime.
+ *
+ * Example usage:
+ * @code
+ * trace::enable();
+ * {
+ *     RAYCRAFT_TRACE_SCOPE("render pass", "render");
+ *     ...
+ * }
+ * trace::write_chrome_json(file);
+ * @endcode
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace trace
+{
+
+/**
+ * @class event
+ * @brief A single begin ('B') or end ('E') timeline record.
+ *
+ * Names and categories must be string literals (or otherwise outlive the trace),
+ * only the pointer is stored.
+ */
+struct event
+{
+    const char *name;  ///< Event name, e.g. "tile"
+    const char *cat;   ///< Event category, e.g. "render"
+    uint64_t ts_ns;    ///< Timestamp in nanoseconds since the trace epoch
+    int64_t arg;       ///< Optional integer argument (tile index, pass number), -1 if unused
+    char phase;        ///< 'B' for begin, 'E' for end
+};
+
+/**
+ * @class ring_buffer
+ * @brief Fixed-capacity per-thread event storage; the oldest events are overwritten.
+ */
+class ring_buffer
+{
+public:
+    static const size_t capacity = size_t(1) << 16; ///< Events kept per thread (power of two)
+
+    explicit ring_buffer(int tid) : tid(tid), events(capacity) {}
+
+    /** @brief Appends an event, overwriting the oldest one once the buffer is full. */
+    void push(const event &e)
+    {
+        events[count & (capacity - 1)] = e;
+        count++;
+    }
+
+    int tid;                   ///< Thread lane id used in the exported trace
+    uint64_t count = 0;        ///< Total events ever pushed (may exceed capacity)
+    std::vector<event> events; ///< Ring storage
+};
+
+/** @brief Global tracer state shared by every thread. */
+struct registry
+{
+    std::atomic<bool> enabled{false};
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    std::mutex lock;                                  ///< Guards the buffer lists (registration only)
+    std::vector<std::unique_ptr<ring_buffer>> buffers; ///< Every buffer ever created
+    std::vector<ring_buffer *> free_buffers;          ///< Buffers released by exited threads
+};
+
+/** @brief Returns the process-wide tracer registry. */
+inline registry &global()
+{
+    static registry r;
+    return r;
+}
+
+/**
+ * @brief Owns the calling thread's ring buffer for the lifetime of the thread.
+ *
+ * Buffers of exited threads are handed to the next new thread, so short-lived
+ * render workers reuse the same lanes (and memory) pass after pass.
+ */
+class thread_handle
+{
+public:
+    thread_handle()
+    {
+        auto &r = global();
+        std::lock_guard<std::mutex> guard(r.lock);
+        if (!r.free_buffers.empty())
+        {
+            buffer = r.free_buffers.back();
+            r.free_buffers.pop_back();
+        }
+        else
+        {
+            r.buffers.push_back(std::make_unique<ring_buffer>(int(r.buffers.size())));
+            buffer = r.buffers.back().get();
+        }
+    }
+
+    ~thread_handle()
+    {
+        auto &r = global();
+        std::lock_guard<std::mutex> guard(r.lock);
+        r.free_buffers.push_back(buffer);
+    }
+
+    ring_buffer *buffer;
+};
+
+/** @brief Returns the calling thread's ring buffer, creating it on first use. */
+inline ring_buffer &local_buffer()
+{
+    thread_local thread_handle handle;
+    return *handle.buffer;
+}
+
+/** @brief Returns nanoseconds elapsed since the trace epoch. */
+inline uint64_t now_ns()
+{
+    auto d = std::chrono::steady_clock::now() - global().epoch;
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+}
+
+/** @brief Turns recording on for all threads. */
+inline void enable() { global().enabled.store(true, std::memory_order_relaxed); }
+
+/** @brief Returns true when events are being recorded. */
+inline bool enabled() { return global().enabled.load(std::memory_order_relaxed); }
+
+/** @brief Records a begin event on the calling thread. */
+inline void begin(const char *name, const char *cat, int64_t arg = -1)
+{
+    local_buffer().push(event{name, cat, now_ns(), arg, 'B'});
+}
+
+/** @brief Records an end event on the calling thread. */
+inline void end(const char *name, const char *cat)
+{
+    local_buffer().push(event{name, cat, now_ns(), -1, 'E'});
+}
+
+/**
+ * @class scope
+ * @brief RAII helper recording a begin event on construction and an end event on destruction.
+ */
+class scope
+{
+public:
+    scope(const char *name, const char *cat, int64_t arg = -1)
+        : name(name), cat(cat), active(enabled())
+    {
+        if (active)
+            begin(name, cat, arg);
+    }
+
+    ~scope()
+    {
+        if (active)
+            end(name, cat);
+    }
+
+    scope(const scope &) = delete;
+    scope &operator=(const scope &) = delete;
+
+private:
+    const char *name;
+    const char *cat;
+    bool active; ///< Latched so a scope never emits an unmatched end
+};
+
+/** @brief Writes `s` as a JSON string literal. */
+inline void write_json_string(std::ostream &out, const char *s)
+{
+    out << '"';
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            out << '\\';
+        out << *s;
+    }
+    out << '"';
+}
+
+/**
+ * @brief Exports every recorded event in Chrome `trace_event` JSON format.
+ *
+ * Must be called once the traced threads have stopped recording (after the
+ * render has joined its workers). When a ring buffer wrapped, end events whose
+ * begin was overwritten are dropped so the viewer sees balanced slices.
+ *
+ * @param out Destination stream, typically a `.json` file.
+ */
+inline void write_chrome_json(std::ostream &out)
+{
+    auto &r = global();
+    std::lock_guard<std::mutex> guard(r.lock);
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"RayCraft\"}}";
+
+    for (const auto &buffer : r.buffers)
+    {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+            << ",\"args\":{\"name\":\"" << (buffer->tid == 0 ? "main" : "worker ") ;
+        if (buffer->tid != 0)
+            out << buffer->tid;
+        out << "\"}}";
+
+        uint64_t first = buffer->count > ring_buffer::capacity ? buffer->count - ring_buffer::capacity : 0;
+        int depth = 0;
+        for (uint64_t n = first; n < buffer->count; n++)
+        {
+            const event &e = buffer->events[n & (ring_buffer::capacity - 1)];
+            if (e.phase == 'E')
+            {
+                if (depth == 0)
+                    continue;
+                depth--;
+            }
+            else
+                depth++;
+
+            out << ",\n{\"name\":";
+            write_json_string(out, e.name);
+            out << ",\"cat\":";
+            write_json_string(out, e.cat);
+            out << ",\"ph\":\"" << e.phase << "\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":" << (e.ts_ns / 1000) << '.' << char('0' + (e.ts_ns / 100) % 10);
+            if (e.arg >= 0)
+                out << ",\"args\":{\"index\":" << e.arg << '}';
+            out << '}';
+        }
+    }
+
+    out << "\n]}\n";
+}
+
+} // namespace trace
+
+#ifdef RAYCRAFT_ENABLE_TRACE
+#define RAYCRAFT_TRACE_CONCAT_(a, b) a##b
+#define RAYCRAFT_TRACE_CONCAT(a, b) RAYCRAFT_TRACE_CONCAT_(a, b)
+/// Traces the enclosing scope as a slice named `name` in category `cat`.
+#define RAYCRAFT_TRACE_SCOPE(name, cat) \
+    trace::scope RAYCRAFT_TRACE_CONCAT(trace_scope_, __LINE__)(name, cat)
+/// Same as RAYCRAFT_TRACE_SCOPE with an integer argument shown in the viewer.
+#define RAYCRAFT_TRACE_SCOPE_ARG(name, cat, arg) \
+    trace::scope RAYCRAFT_TRACE_CONCAT(trace_scope_, __LINE__)(name, cat, int64_t(arg))
+#else
+#define RAYCRAFT_TRACE_SCOPE(name, cat) ((void)0)
+#define RAYCRAFT_TRACE_SCOPE_ARG(name, cat, arg) ((void)0)
+#endif
+
+#endif
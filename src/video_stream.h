@@ -0,0 +1,359 @@
+/**
+ * @file video_stream.h
+ * @brief Streams animation frames as Y4M or raw RGB video to a file, pipe or stdout.
+ *
+ * Instead of one image file per frame that an encoder then has to read back, the
+ * frames of an animation are written as one continuous stream that tools such as
+ * ffmpeg read directly:
+ *
+ * @code
+ * RayCraft --frames 120 --video - | ffmpeg -i - turntable.mp4
+ * RayCraft --frames 120 --video - --video-format rgb | ffmpeg -f rawvideo -pix_fmt rgb24 -s 400x225 -r 30 -i - out.mp4
+ * @endcode
+ *
+ * Y4M carries 8-bit YUV 4:2:0 (BT.601, limited range, the format every encoder
+ * accepts); raw RGB is headerless rgb24. Frames are converted on several threads,
+ * so they can be finished out of order; a reorder buffer keyed by frame index makes
+ * the writer emit them strictly in order. The RGB to YUV conversion works on 16
+ * pixels at a time with SSE2 where available and gives the same bytes as the
+ * scalar path.
+ */
+
+#ifndef VIDEO_STREAM_H
+#define VIDEO_STREAM_H
+
+#include "framebuffer.h"
+#include "output_pipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/** @brief Stream formats. */
+enum class video_format
+{
+    y4m, ///< YUV4MPEG2, 4:2:0
+    rgb  ///< Raw rgb24 frames without a header
+};
+
+/** @brief Parses "y4m" or "rgb"; false for anything else. */
+inline bool parse_video_format(const std::string &name, video_format &format)
+{
+    if (name == "y4m")
+        format = video_format::y4m;
+    else if (name == "rgb")
+        format = video_format::rgb;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * @brief Converts `count` pixels from planar 8-bit RGB to full-resolution Y, U and V
+ * (BT.601 limited range, 8-bit fixed point as in the usual integer converters).
+ */
+inline void rgb_to_yuv_scalar(const unsigned char *r, const unsigned char *g, const unsigned char *b,
+                              unsigned char *y, unsigned char *u, unsigned char *v, size_t count)
+{
+    for (size_t n = 0; n < count; n++)
+    {
+        int R = r[n], G = g[n], B = b[n];
+        y[n] = (unsigned char)(((66 * R + 129 * G + 25 * B + 128) >> 8) + 16);
+        u[n] = (unsigned char)(((-38 * R - 74 * G + 112 * B + 128) >> 8) + 128);
+        v[n] = (unsigned char)(((112 * R - 94 * G - 18 * B + 128) >> 8) + 128);
+    }
+}
+
+/** @brief `rgb_to_yuv_scalar`, 16 pixels at a time with SSE2 where available. */
+inline void rgb_to_yuv(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *y,
+                       unsigned char *u, unsigned char *v, size_t count)
+{
+    size_t n = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    auto weighted = [](__m128i r16, __m128i g16, __m128i b16, short wr, short wg, short wb)
+    {
+        // Every partial sum fits in 16 bits: Y as unsigned (< 56400), U and V as signed
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r16, _mm_set1_epi16(wr)), _mm_mullo_epi16(g16, _mm_set1_epi16(wg)));
+        return _mm_add_epi16(_mm_add_epi16(sum, _mm_mullo_epi16(b16, _mm_set1_epi16(wb))), _mm_set1_epi16(128));
+    };
+    for (; n + 16 <= count; n += 16)
+    {
+        __m128i rv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(r + n));
+        __m128i gv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(g + n));
+        __m128i bv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + n));
+        __m128i out[3][2];
+        for (int h = 0; h < 2; h++)
+        {
+            __m128i r16 = h ? _mm_unpackhi_epi8(rv, zero) : _mm_unpacklo_epi8(rv, zero);
+            __m128i g16 = h ? _mm_unpackhi_epi8(gv, zero) : _mm_unpacklo_epi8(gv, zero);
+            __m128i b16 = h ? _mm_unpackhi_epi8(bv, zero) : _mm_unpacklo_epi8(bv, zero);
+            out[0][h] = _mm_add_epi16(_mm_srli_epi16(weighted(r16, g16, b16, 66, 129, 25), 8), _mm_set1_epi16(16));
+            out[1][h] = _mm_add_epi16(_mm_srai_epi16(weighted(r16, g16, b16, -38, -74, 112), 8), _mm_set1_epi16(128));
+            out[2][h] = _mm_add_epi16(_mm_srai_epi16(weighted(r16, g16, b16, 112, -94, -18), 8), _mm_set1_epi16(128));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(y + n), _mm_packus_epi16(out[0][0], out[0][1]));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(u + n), _mm_packus_epi16(out[1][0], out[1][1]));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(v + n), _mm_packus_epi16(out[2][0], out[2][1]));
+    }
+#endif
+    rgb_to_yuv_scalar(r + n, g + n, b + n, y + n, u + n, v + n, count - n);
+}
+
+/** @brief Averages 2x2 blocks of a full-resolution chroma plane (edges replicate). */
+inline void downsample_chroma_420(const unsigned char *full, int width, int height, unsigned char *half)
+{
+    int half_width = (width + 1) / 2, half_height = (height + 1) / 2;
+    for (int y = 0; y < half_height; y++)
+    {
+        const unsigned char *row0 = full + size_t(2 * y) * width;
+        const unsigned char *row1 = full + size_t(std::min(2 * y + 1, height - 1)) * width;
+        for (int x = 0; x < half_width; x++)
+        {
+            int x1 = std::min(2 * x + 1, width - 1);
+            half[size_t(y) * half_width + x] =
+                (unsigned char)((row0[2 * x] + row0[x1] + row1[2 * x] + row1[x1] + 2) >> 2);
+        }
+    }
+}
+
+/** @brief Writes all of `size` bytes to `fd` sequentially; false with `error` set on failure. */
+inline bool write_all(int fd, const char *data, size_t size, std::string &error)
+{
+    while (size > 0)
+    {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            error = std::strerror(errno);
+            return false;
+        }
+        data += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+/**
+ * @class video_stream
+ * @brief Converts frames on worker threads and writes them in frame order to a descriptor.
+ */
+class video_stream
+{
+public:
+    /** @brief Statistics, valid after `finish()`. */
+    struct report
+    {
+        int frames = 0;
+        double blocked_seconds = 0; ///< Renderer time spent waiting in `submit`
+        double convert_seconds = 0; ///< Busy time of the converter threads
+        double write_seconds = 0;   ///< Busy time of the writer
+        uint64_t bytes = 0;         ///< Bytes written
+        size_t max_reordered = 0;   ///< Most frames held back waiting for an earlier one
+        std::string error;          ///< First write error, if any
+    };
+
+    /**
+     * @param fd Descriptor to write to (not closed by the stream).
+     * @param fps Frame rate recorded in the Y4M header.
+     * @param converters Conversion threads.
+     * @param depth Frames waiting for a converter before `submit` blocks.
+     */
+    video_stream(int fd, video_format format, int fps = 30, int converters = 2, size_t depth = 2)
+        : fd(fd), format(format), fps(fps), input(depth)
+    {
+        for (int n = 0; n < std::max(1, converters); n++)
+            workers.emplace_back([this]() { convert_stage(); });
+        writer = std::thread([this]() { write_stage(); });
+    }
+
+    ~video_stream() { finish(); }
+
+    video_stream(const video_stream &) = delete;
+    video_stream &operator=(const video_stream &) = delete;
+
+    /**
+     * @brief Queues frame `index` (0, 1, 2, ... in any order) for the stream.
+     * All frames must have the same size.
+     */
+    void submit(int index, framebuffer &&fb)
+    {
+        job j;
+        j.index = index;
+        j.fb = std::move(fb);
+        stats.blocked_seconds += input.push(std::move(j));
+        stats.frames++;
+    }
+
+    /** @brief Waits until every submitted frame is written and returns the statistics. */
+    const report &finish()
+    {
+        if (writer.joinable())
+        {
+            input.close();
+            for (auto &w : workers)
+                w.join();
+            {
+                std::lock_guard<std::mutex> guard(reorder_lock);
+                converting_done = true;
+            }
+            frame_ready.notify_all();
+            writer.join();
+            stats.convert_seconds = convert_nanoseconds * 1e-9;
+        }
+        return stats;
+    }
+
+private:
+    struct job
+    {
+        int index = 0;
+        framebuffer fb;
+    };
+
+    struct converted
+    {
+        int width = 0, height = 0;
+        std::string bytes;
+    };
+
+    int fd;
+    video_format format;
+    int fps;
+    bounded_queue<job> input;
+    std::vector<std::thread> workers;
+    std::thread writer;
+    report stats;
+    std::atomic<uint64_t> convert_nanoseconds{0};
+
+    std::mutex reorder_lock;
+    std::condition_variable frame_ready;
+    std::map<int, converted> pending; ///< Converted frames not yet written, by index
+    bool converting_done = false;
+
+    /** @brief The bytes of one frame in the stream format (without the Y4M stream header). */
+    converted convert(const framebuffer &fb) const
+    {
+        converted out;
+        out.width = fb.width;
+        out.height = fb.height;
+        size_t pixels = size_t(fb.width) * fb.height;
+
+        // Same quantisation as write_color, into planes so the conversion vectorises
+        static const interval intensity(0.000, 0.999);
+        std::vector<unsigned char> planes(pixels * 3);
+        unsigned char *r = planes.data(), *g = r + pixels, *b = g + pixels;
+        for (int y = 0; y < fb.height; y++)
+            for (int x = 0; x < fb.width; x++)
+            {
+                color c = fb.resolve(x, y);
+                size_t p = size_t(y) * fb.width + x;
+                r[p] = (unsigned char)(256 * intensity.clamp(c.x()));
+                g[p] = (unsigned char)(256 * intensity.clamp(c.y()));
+                b[p] = (unsigned char)(256 * intensity.clamp(c.z()));
+            }
+
+        if (format == video_format::rgb)
+        {
+            out.bytes.resize(pixels * 3);
+            for (size_t p = 0; p < pixels; p++)
+            {
+                out.bytes[3 * p] = char(r[p]);
+                out.bytes[3 * p + 1] = char(g[p]);
+                out.bytes[3 * p + 2] = char(b[p]);
+            }
+            return out;
+        }
+
+        size_t chroma = size_t((fb.width + 1) / 2) * ((fb.height + 1) / 2);
+        std::vector<unsigned char> full_u(pixels), full_v(pixels);
+        out.bytes = "FRAME\n";
+        size_t header = out.bytes.size();
+        out.bytes.resize(header + pixels + 2 * chroma);
+        auto *luma = reinterpret_cast<unsigned char *>(&out.bytes[header]);
+        rgb_to_yuv(r, g, b, luma, full_u.data(), full_v.data(), pixels);
+        downsample_chroma_420(full_u.data(), fb.width, fb.height, luma + pixels);
+        downsample_chroma_420(full_v.data(), fb.width, fb.height, luma + pixels + chroma);
+        return out;
+    }
+
+    void convert_stage()
+    {
+        job j;
+        while (input.pop(j))
+        {
+            auto start = std::chrono::steady_clock::now();
+            converted frame = convert(j.fb);
+            j.fb = framebuffer();
+            convert_nanoseconds += uint64_t(std::chrono::duration<double, std::nano>(
+                                                std::chrono::steady_clock::now() - start)
+                                                .count());
+            {
+                std::lock_guard<std::mutex> guard(reorder_lock);
+                pending.emplace(j.index, std::move(frame));
+            }
+            frame_ready.notify_all();
+        }
+    }
+
+    void write_stage()
+    {
+        int next = 0, width = 0, height = 0;
+        while (true)
+        {
+            converted frame;
+            {
+                std::unique_lock<std::mutex> lock(reorder_lock);
+                frame_ready.wait(lock, [&]() { return pending.count(next) || converting_done; });
+                stats.max_reordered = std::max(stats.max_reordered, pending.size() - pending.count(next));
+                auto it = pending.find(next);
+                if (it == pending.end())
+                {
+                    if (!pending.empty() && stats.error.empty())
+                        stats.error = "frame " + std::to_string(next) + " was never submitted";
+                    return;
+                }
+                frame = std::move(it->second);
+                pending.erase(it);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            std::string header;
+            if (next == 0)
+            {
+                width = frame.width;
+                height = frame.height;
+                if (format == video_format::y4m)
+                    header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height) + " F" +
+                             std::to_string(fps) + ":1 Ip A1:1 C420jpeg\n";
+            }
+            else if ((frame.width != width || frame.height != height) && stats.error.empty())
+                stats.error = "frame " + std::to_string(next) + " has a different size";
+
+            // After a failed write (e.g. the reader went away) frames are still drained, not written
+            if (stats.error.empty() && write_all(fd, header.data(), header.size(), stats.error) &&
+                write_all(fd, frame.bytes.data(), frame.bytes.size(), stats.error))
+                stats.bytes += header.size() + frame.bytes.size();
+            stats.write_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            next++;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,187 @@
+/**
+ * @file accum_file.cpp
+ * @brief Tests of the float codec and of accumulation files.
+ *
+ * The codec must round-trip float and double streams bit for bit, compress
+ * accumulated radiance, and reject damaged data. Accumulation files must reproduce
+ * a render exactly when merged: checkpointed passes, separately rendered sample
+ * ranges and a resumed render all equal the same passes rendered in one go, and
+ * regions rendered with a wide filter add up to the whole image (to rounding: the
+ * splats across region borders are added in a different order).
+ */
+
+#include "check.h"
+#include "constants.h"
+#include "accum_file.h"
+#include "scenes.h"
+
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/** @brief True if both streams hold the same bits. */
+template <typename T>
+static bool same_bits(const std::vector<T> &a, const std::vector<T> &b)
+{
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+}
+
+/** @brief Largest difference between two framebuffers, relative to the larger sum. */
+static double difference(const framebuffer &a, const framebuffer &b)
+{
+    if (a.sum.size() != b.sum.size())
+        return 1e30;
+    double worst = 0;
+    for (size_t p = 0; p < a.sum.size(); p++)
+    {
+        for (int c = 0; c < 3; c++)
+            worst = std::max(worst, std::fabs(a.sum[p][c] - b.sum[p][c]) /
+                                        std::max(1e-30, std::max(std::fabs(a.sum[p][c]), std::fabs(b.sum[p][c]))));
+        worst = std::max(worst, std::fabs(a.weight[p] - b.weight[p]) / std::max(1e-30, std::fabs(a.weight[p])));
+    }
+    return worst;
+}
+
+/** @brief Writes `fb` as an accumulation file and reads it back into `into`. */
+static bool round_trip(const framebuffer &fb, const accum_info &info, framebuffer &into, int threads,
+                       std::string *bytes = nullptr)
+{
+    std::stringstream file;
+    std::string error;
+    accum_info read;
+    if (!write_accumulation(file, fb, info, threads))
+        return false;
+    if (bytes)
+        *bytes = file.str();
+    return read_accumulation(file, into, read, error, threads) && read.first_sample == info.first_sample &&
+           read.samples == info.samples && read.rect.x0 == info.rect.x0 && read.rect.y1 == info.rect.y1;
+}
+
+int main()
+{
+    // Codec: awkward values and lengths, both widths
+    std::vector<double> doubles = {0.0, -0.0, 1.0, 1.0, 1.0, std::nan(""), INFINITY, -INFINITY, 5e-324, 1e308};
+    for (int i = 0; i < 5000; i++)
+        doubles.push_back(std::sin(i * 0.01) * 100 + (i % 7) * 1e-9);
+    std::vector<unsigned char> encoded;
+    encode_float_stream(doubles.data(), doubles.size(), encoded);
+    std::vector<double> decoded(doubles.size());
+    const unsigned char *p = encoded.data();
+    check("doubles round-trip bit for bit",
+          decode_float_stream(p, encoded.data() + encoded.size(), decoded.data(), decoded.size()) &&
+              same_bits(doubles, decoded) && p == encoded.data() + encoded.size());
+
+    std::vector<float> floats(doubles.begin(), doubles.end());
+    floats.resize(floats.size() - 3); // not a multiple of four
+    encoded.clear();
+    encode_float_stream(floats.data(), floats.size(), encoded);
+    std::vector<float> decoded_floats(floats.size());
+    p = encoded.data();
+    check("floats round-trip bit for bit",
+          decode_float_stream(p, encoded.data() + encoded.size(), decoded_floats.data(), decoded_floats.size()) &&
+              same_bits(floats, decoded_floats));
+
+    std::vector<double> constant(1000, 0.25);
+    encoded.clear();
+    encode_float_stream(constant.data(), constant.size(), encoded);
+    check("a constant stream compresses tenfold", encoded.size() * 10 < constant.size() * sizeof(double));
+
+    encoded.clear();
+    encode_float_stream(doubles.data(), size_t(0), encoded);
+    p = encoded.data();
+    check("an empty stream round-trips", decode_float_stream(p, encoded.data() + encoded.size(), decoded.data(), 0));
+
+    // A render to store
+    hittable_list world = random_spheres_scene();
+    bvh scene(world, 4, 2);
+    camera cam;
+    random_spheres_view(cam);
+    cam.image_width = 160;
+    cam.samples_per_pixel = 8;
+    cam.max_depth = 6;
+    cam.num_threads = 2;
+    cam.show_progress = false;
+    cam.prepare();
+    int width = cam.image_width, height = cam.height();
+    tile_rect whole{0, 0, width, height};
+
+    framebuffer rendered;
+    cam.render_pass(scene, rendered, 0, 4);
+    cam.render_pass(scene, rendered, 4, 4);
+    accum_info info{width, height, whole, 0, 8};
+    framebuffer restored;
+    std::string one_thread, four_threads;
+    check("a checkpoint round-trips bit for bit",
+          round_trip(rendered, info, restored, 1, &one_thread) && difference(rendered, restored) == 0);
+    framebuffer unused;
+    round_trip(rendered, info, unused, 4, &four_threads);
+    check("the file does not depend on the thread count", one_thread == four_threads);
+
+    codec_report report;
+    std::stringstream sized;
+    write_accumulation(sized, rendered, info, 2, &report);
+    std::clog << "ratio " << report.ratio() << ", " << report.gigabytes_per_second() << " GB/s\n";
+    check("accumulated radiance compresses", report.ratio() > 1.4 && report.bytes == sized.str().size());
+
+    // Sample ranges rendered separately merge into the checkpointed render
+    framebuffer first, second, merged;
+    cam.render_pass(scene, first, 0, 4);
+    cam.render_pass(scene, second, 4, 4);
+    round_trip(first, accum_info{width, height, whole, 0, 4}, merged, 2);
+    round_trip(second, accum_info{width, height, whole, 4, 4}, merged, 2);
+    check("merged sample ranges equal the render", difference(merged, rendered) == 0);
+
+    // Resuming from a checkpoint equals never stopping
+    framebuffer resumed;
+    round_trip(first, accum_info{width, height, whole, 0, 4}, resumed, 2);
+    cam.render_pass(scene, resumed, 4, 4);
+    check("a resumed render equals an uninterrupted one", difference(resumed, rendered) == 0);
+
+    // Regions with a wide filter, saved with the border their splats reach
+    cam.filter = pixel_filter(filter_type::blackman_harris);
+    int border = cam.filter.border();
+    framebuffer full;
+    cam.render_pass(scene, full, 0, 4);
+    framebuffer regions;
+    int split = 70; // not on a tile edge
+    for (tile_rect region : {tile_rect{0, 0, split, height}, tile_rect{split, 0, width, height}})
+    {
+        cam.crop = region;
+        framebuffer part;
+        cam.render_pass(scene, part, 0, 4);
+        tile_rect saved{std::max(region.x0 - border, 0), 0, std::min(region.x1 + border, width), height};
+        round_trip(part, accum_info{width, height, saved, 0, 4}, regions, 2);
+    }
+    cam.crop = tile_rect{0, 0, 0, 0};
+    std::clog << "region merge difference " << difference(regions, full) << "\n";
+    check("merged regions equal the whole image", difference(regions, full) < 1e-12);
+
+    // Damaged files
+    std::string file = one_thread;
+    auto rejects = [&](const std::string &what, std::string bad)
+    {
+        std::stringstream in(bad);
+        framebuffer fb;
+        accum_info read;
+        std::string error;
+        check("rejects " + what, !read_accumulation(in, fb, read, error) && !error.empty());
+    };
+    rejects("a wrong magic", "RCACCUM0" + file.substr(8));
+    rejects("a truncated file", file.substr(0, file.size() - 100));
+    std::string wide = file;
+    wide[8 + 16] = char(0xff); // x1 beyond the width
+    rejects("a rectangle outside the image", wide);
+    std::string damaged = file;
+    for (size_t i = file.size() / 2; i < file.size() / 2 + 64; i++)
+        damaged[i] = char(~damaged[i]);
+    rejects("damaged compressed data", damaged);
+
+    std::stringstream other_size(file);
+    framebuffer small(10, 10);
+    accum_info read;
+    std::string error;
+    check("rejects a file of another image size", !read_accumulation(other_size, small, read, error));
+
+    return check_summary();
+}
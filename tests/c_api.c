@@ -0,0 +1,143 @@
+/**
+ * @file c_api.c
+ * @brief Checks the raycraft.h C API from C: scene building, rendering into a
+ * strided caller buffer, statistics, cancellation and argument validation.
+ */
+
+#include "raycraft.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                    \
+    do                                                                 \
+    {                                                                  \
+        if (!(cond))                                                   \
+        {                                                              \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                \
+        }                                                              \
+    } while (0)
+
+/* Shared by the render and the thread that cancels it */
+typedef struct
+{
+    rc_renderer *renderer;
+    pthread_mutex_t lock;
+    int render_returned; /* guarded by lock */
+} cancel_state;
+
+static void *cancel_soon(void *arg)
+{
+    cancel_state *state = (cancel_state *)arg;
+    rc_render_stats stats;
+    stats.struct_size = sizeof(stats);
+    /* Wait until the render has started, then stop it; give up if it has already
+       returned (finished or failed), which the render's own check reports */
+    for (;;)
+    {
+        pthread_mutex_lock(&state->lock);
+        int returned = state->render_returned;
+        pthread_mutex_unlock(&state->lock);
+        if (returned)
+            break;
+        rc_renderer_get_stats(state->renderer, &stats);
+        if (stats.rendering && stats.tiles_done > 0)
+        {
+            rc_renderer_cancel(state->renderer);
+            break;
+        }
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    CHECK(rc_version() == RAYCRAFT_API_VERSION);
+
+    rc_scene *scene = rc_scene_create();
+    uint32_t gray, glass, gold;
+    CHECK(rc_scene_add_lambertian(scene, 0.5f, 0.5f, 0.5f, &gray) == RC_OK);
+    CHECK(rc_scene_add_dielectric(scene, 1.5f, &glass) == RC_OK);
+    CHECK(rc_scene_add_metal(scene, 0.8f, 0.6f, 0.2f, 0.1f, &gold) == RC_OK);
+    CHECK(rc_scene_add_metal(scene, 0.8f, 0.6f, 0.2f, 2.0f, &gold) == RC_ERROR_INVALID_ARGUMENT);
+    CHECK(rc_scene_add_sphere(scene, 0, -1000, 0, 1000, gray) == RC_OK);
+    CHECK(rc_scene_add_sphere(scene, 0, 1, 0, 1, glass) == RC_OK);
+    CHECK(rc_scene_add_sphere(scene, 4, 1, 0, 1, gold) == RC_OK);
+    CHECK(rc_scene_add_sphere(scene, 0, 0, 0, 1, 99) == RC_ERROR_INVALID_ARGUMENT);
+    CHECK(rc_scene_sphere_count(scene) == 3);
+
+    rc_render_settings settings;
+    rc_render_settings_init(&settings);
+    settings.width = 64;
+    settings.height = 37;
+    settings.samples_per_pixel = 4;
+    settings.seed = 42;
+
+    /* Strided RGBA buffer with a guard column that must stay untouched */
+    size_t stride = 65 * 4;
+    float *pixels = calloc(stride * 37, sizeof(float));
+    rc_renderer *renderer = rc_renderer_create();
+
+    CHECK(rc_render(renderer, scene, &settings, pixels, 4, stride) == RC_ERROR_INVALID_STATE);
+    CHECK(rc_scene_commit(scene, 0, 0) == RC_OK);
+    CHECK(rc_render(renderer, scene, &settings, pixels, 5, stride) == RC_ERROR_INVALID_ARGUMENT);
+    CHECK(rc_render(renderer, scene, &settings, pixels, 4, stride) == RC_OK);
+
+    int lit = 0, guard_ok = 1;
+    for (int j = 0; j < 37; j++)
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            const float *p = pixels + j * stride + i * 4;
+            lit += p[0] + p[1] + p[2] > 0;
+            CHECK(p[3] == 1.0f);
+        }
+        guard_ok &= pixels[j * stride + 64 * 4] == 0.0f;
+    }
+    CHECK(lit == 64 * 37);
+    CHECK(guard_ok);
+
+    rc_render_stats stats;
+    stats.struct_size = sizeof(stats);
+    CHECK(rc_renderer_get_stats(renderer, &stats) == RC_OK);
+    CHECK(stats.rays >= 64 * 37 * 4);
+    CHECK(stats.isect_tests > 0);
+    CHECK(stats.tiles_done == stats.tiles_total && stats.tiles_total > 0);
+    CHECK(!stats.rendering);
+
+    /* Cancellation from another thread */
+    settings.width = 256;
+    settings.height = 256;
+    settings.samples_per_pixel = 64;
+    settings.tile_size = 8;
+    float *big = malloc(sizeof(float) * 256 * 256 * 3);
+    cancel_state state;
+    state.renderer = renderer;
+    state.render_returned = 0;
+    pthread_mutex_init(&state.lock, NULL);
+    pthread_t canceller;
+    pthread_create(&canceller, NULL, cancel_soon, &state);
+    CHECK(rc_render(renderer, scene, &settings, big, 3, 0) == RC_ERROR_CANCELLED);
+    pthread_mutex_lock(&state.lock);
+    state.render_returned = 1;
+    pthread_mutex_unlock(&state.lock);
+    pthread_join(canceller, NULL);
+    pthread_mutex_destroy(&state.lock);
+    CHECK(rc_renderer_get_stats(renderer, &stats) == RC_OK);
+    CHECK(stats.tiles_done < stats.tiles_total);
+
+    rc_renderer_destroy(renderer);
+    rc_scene_destroy(scene);
+    free(pixels);
+    free(big);
+
+    if (failures)
+        fprintf(stderr, "%d check(s) failed\n", failures);
+    else
+        fprintf(stderr, "ok   c_api\n");
+    return failures ? 1 : 0;
+}
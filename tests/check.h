@@ -0,0 +1,33 @@
+/**
+ * @file check.h
+ * @brief Pass/fail reporting shared by the test programs.
+ *
+ * Every check prints one PASS or FAIL line; a test's `main` ends with
+ * `return check_summary();`, so ctest sees a failure as a non-zero exit status.
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <iostream>
+#include <string>
+
+inline int failures = 0; ///< Checks failed so far
+
+/** @brief Prints and records the outcome of one check. */
+inline void check(const std::string &name, bool pass)
+{
+    std::clog << (pass ? "PASS " : "FAIL ") << name << "\n";
+    if (!pass)
+        failures++;
+}
+
+/** @brief Reports how many checks failed; the test's exit status. */
+inline int check_summary()
+{
+    if (failures)
+        std::clog << failures << " check(s) failed\n";
+    return failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file delta_frames.cpp
+ * @brief Round-trip tests of the delta-encoded animation format.
+ *
+ * Synthetic frames change a few rectangles at a time (including partial edge
+ * tiles); the reader must rebuild every frame exactly, the writer must store only
+ * the tiles that changed, and a truncated file must be reported as damaged.
+ */
+
+#include "check.h"
+#include "constants.h"
+#include "delta_frames.h"
+
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+int main()
+{
+    const int width = 100, height = 70, tile = 16; // 7 x 5 tiles, partial ones on the right and bottom
+    std::mt19937 rng(11);
+    std::vector<std::vector<unsigned char>> frames;
+    std::vector<unsigned char> rgb(size_t(width) * height * 3);
+    for (auto &b : rgb)
+        b = (unsigned char)rng();
+    frames.push_back(rgb);
+    frames.push_back(rgb); // unchanged frame
+
+    // Change one pixel in the bottom-right (partial) tile
+    rgb[rgb.size() - 1] ^= 1;
+    frames.push_back(rgb);
+
+    // Change a rectangle spanning tiles (1..2, 1..2)
+    for (int y = 20; y < 40; y++)
+        for (int x = 30; x < 40; x++)
+            rgb[(size_t(y) * width + x) * 3] += 7;
+    frames.push_back(rgb);
+
+    std::stringstream file;
+    delta_writer writer(file, width, height, tile);
+    std::vector<int> written;
+    for (const auto &f : frames)
+        written.push_back(writer.add_frame(f));
+    check("first frame stores every tile", written[0] == 35);
+    check("unchanged frame stores nothing", written[1] == 0);
+    check("one-pixel change stores one tile", written[2] == 1);
+    check("rectangle stores the four tiles it touches", written[3] == 4);
+    check("file size matches the report", file.str().size() == writer.totals().bytes);
+
+    std::vector<unsigned char> small(size_t(width - 1) * height * 3);
+    uint64_t bytes = writer.totals().bytes;
+    check("a frame of another size is rejected", writer.add_frame(small) == -1 && !writer.error.empty() &&
+                                                     writer.totals().bytes == bytes &&
+                                                     writer.totals().frames == int(frames.size()));
+
+    delta_reader reader(file);
+    bool exact = reader.open() && reader.layout.width == width && reader.layout.height == height;
+    std::vector<unsigned char> decoded;
+    size_t count = 0;
+    int changed = 0;
+    while (reader.next_frame(decoded, &changed))
+    {
+        exact &= count < frames.size() && decoded == frames[count] && changed == written[count];
+        count++;
+    }
+    check("reader rebuilds every frame", exact && count == frames.size() && reader.error.empty());
+
+    std::string data = file.str();
+    std::istringstream truncated(data.substr(0, data.size() - 5));
+    delta_reader damaged(truncated);
+    damaged.open();
+    while (damaged.next_frame(decoded))
+    {
+    }
+    check("truncated file is reported", !damaged.error.empty());
+
+    return check_summary();
+}
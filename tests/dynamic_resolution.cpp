@@ -0,0 +1,162 @@
+/**
+ * @file dynamic_resolution.cpp
+ * @brief Tests of the dynamic resolution controller and the edge-aware upsampler.
+ *
+ * The controller is driven by a synthetic frame time proportional to pixels x
+ * samples (with jitter): it has to reach the band quickly, then stay put while the
+ * jitter stays inside it, drop samples only at the minimum scale, and wait
+ * `patience` frames before raising the quality again. The upsampler is given two
+ * objects at different depths whose silhouette runs through the middle of a reduced
+ * pixel; no output pixel may mix their colours. Consecutive reduced frames must not
+ * carry samples of earlier camera poses.
+ */
+
+#include "check.h"
+#include "constants.h"
+#include "dynamic_resolution.h"
+#include "hittable_list.h"
+#include "sphere.h"
+
+#include <iostream>
+#include <random>
+#include <string>
+
+/** @brief Frame time of `dr`'s next setting when the full frame takes `full_seconds`. */
+static double frame_time(const dynamic_resolution &dr, int width, int spp, double full_seconds, double jitter)
+{
+    double pixels = double(dr.width()) / width;
+    return full_seconds * pixels * pixels * dr.spp() / spp * jitter;
+}
+
+/**
+ * @brief Fills a geometry AOV and framebuffer for `cam`'s view of two walls: a red
+ * one at distance 2 left of the view direction tangent `edge`, a blue one at 10.
+ */
+static void two_walls(camera &cam, double edge, geometry_aov &aov, framebuffer &fb)
+{
+    cam.prepare();
+    camera_projection view = cam.projection();
+    aov.resize(cam.image_width, cam.height());
+    fb.resize(cam.image_width, cam.height());
+    for (int j = 0; j < aov.height; j++)
+        for (int i = 0; i < aov.width; i++)
+        {
+            vec3 dir = unit_vector(view.pixel00 + i * view.delta_u + j * view.delta_v - view.center);
+            bool near = dir.x() / -dir.z() < edge;
+            double dist = near ? 2 : 10;
+            aov.set_hit(i, j, view.center + dist * dir, dist, vec3(0, 0, 1), near ? 1 : 2);
+            fb.add_sample(i, j, near ? color(1, 0, 0) : color(0, 0, 1));
+        }
+}
+
+int main()
+{
+    const int width = 400, spp = 64;
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> jitter(0.96, 1.04);
+
+    // Full frames take 3x the target: quality must drop into the band and stay there
+    dynamic_resolution dr;
+    dr.target_seconds = 1.0;
+    dr.reset(width, spp);
+    int settled = -1, changes_after = 0;
+    for (int f = 0; f < 60; f++)
+    {
+        double t = frame_time(dr, width, spp, 3.0, jitter(rng));
+        bool in_band = t >= dr.lower * dr.target_seconds && t <= dr.upper * dr.target_seconds;
+        if (settled < 0 && in_band)
+            settled = f;
+        if (dr.update(t) && settled >= 0)
+            changes_after++;
+    }
+    check("reaches the band within 8 frames", settled >= 0 && settled <= 8);
+    check("no oscillation once settled (jitter inside the band)", changes_after <= 1);
+    check("keeps the full sample count while scaling", dr.spp() == spp);
+    check("internal width is a multiple of the granularity", dr.width() % dr.granularity == 0);
+
+    // Even the minimum scale is too slow: the sample count drops as well
+    dynamic_resolution slow;
+    slow.target_seconds = 1.0;
+    slow.reset(width, spp);
+    for (int f = 0; f < 40; f++)
+        slow.update(frame_time(slow, width, spp, 60.0, 1.0));
+    check("drops samples only at the minimum scale",
+          slow.scale() == slow.min_scale && slow.spp() < spp && slow.spp() >= slow.min_spp);
+
+    // The scene gets cheaper: quality goes back up, but only after `patience` fast frames
+    for (int f = 1; f < slow.patience; f++)
+        check("waits for patience frames before raising quality (" + std::to_string(f) + ")",
+              !slow.update(0.1));
+    check("raises quality after patience fast frames", slow.update(0.1));
+    for (int f = 0; f < 60; f++)
+        slow.update(frame_time(slow, width, spp, 0.5, 1.0));
+    check("returns to full quality when there is headroom", slow.width() == width && slow.spp() == spp);
+
+    // Silhouette through the middle of a reduced pixel
+    camera cam;
+    cam.aspect_ratio = 1.0;
+    const double edge = 0.03;
+    cam.image_width = 16;
+    geometry_aov low_geometry, guide;
+    framebuffer low, out;
+    two_walls(cam, edge, low_geometry, low);
+    camera_projection low_view = cam.projection();
+    cam.image_width = 64;
+    framebuffer expected;
+    two_walls(cam, edge, guide, expected);
+
+    edge_aware_upsample(low, low_geometry, low_view, guide, out);
+    int mixed = 0, wrong = 0;
+    for (int j = 0; j < out.height; j++)
+        for (int i = 0; i < out.width; i++)
+        {
+            color c = out.resolve(i, j);
+            if (c.x() > 1e-9 && c.z() > 1e-9)
+                mixed++;
+            if ((c - expected.resolve(i, j)).length() > 1e-9)
+                wrong++;
+        }
+    check("upsampled size matches the guide", out.width == 64 && out.height == 64);
+    check("no colour bleeds across the silhouette", mixed == 0 && wrong == 0);
+
+    edge_aware_upsample(expected, guide, cam.projection(), guide, out);
+    bool identity = true;
+    for (int j = 0; j < out.height; j++)
+        for (int i = 0; i < out.width; i++)
+            identity = identity && (out.resolve(i, j) - expected.resolve(i, j)).length() < 1e-9;
+    check("same resolution is the identity", identity);
+
+    // Reduced frames from a moving camera: the second frame must equal the same pose
+    // rendered first, so nothing of the first pose remains in the reduced buffer
+    hittable_list world;
+    world.add(make_shared<sphere>(point3(0, 0, -1), 0.5, make_shared<lambertian>(color(0.7, 0.3, 0.3))));
+    world.add(make_shared<sphere>(point3(0, -100.5, -1), 100, make_shared<lambertian>(color(0.5, 0.5, 0.5))));
+    camera moving;
+    moving.image_width = 48;
+    moving.samples_per_pixel = 4;
+    moving.max_depth = 4;
+    moving.num_threads = 1;
+    moving.show_progress = false;
+    auto pinned = []()
+    {
+        dynamic_resolution d;
+        d.target_seconds = 1e6; // always fast, and the scale cannot rise above half
+        d.min_scale = d.max_scale = 0.5;
+        return d;
+    };
+    dynamic_resolution animated = pinned(), fresh = pinned();
+    framebuffer first, second, expected_second;
+    moving.lookfrom = point3(-1, 0.5, 1);
+    animated.render_frame(moving, world, first);
+    moving.lookfrom = point3(1, 0.5, 1);
+    animated.render_frame(moving, world, second);
+    fresh.render_frame(moving, world, expected_second);
+    check("reduced frames render at the reduced width", animated.last.width == 24);
+    bool same = second.sum.size() == expected_second.sum.size();
+    for (size_t p = 0; same && p < second.sum.size(); p++)
+        same = (second.sum[p] - expected_second.sum[p]).length() < 1e-12 &&
+               second.weight[p] == expected_second.weight[p];
+    check("a reduced frame holds only its own pose (no ghosting)", same);
+
+    return check_summary();
+}
@@ -0,0 +1,273 @@
+/**
+ * @file image_quality.cpp
+ * @brief Image quality regression test against stored high-spp reference renders.
+ *
+ * Optimisations such as faster math, a different random number generator or
+ * approximated functions can silently change the image. This test renders the
+ * canonical scenes at fixed seeds and low spp and compares them with references
+ * rendered at high spp, in three ways:
+ *
+ *  - Bias: the image is split into 8x8 blocks. For every block and channel the
+ *    mean difference to the reference is tested against its standard error, which
+ *    comes from the per-pixel sample variance recorded with the reference. Noise
+ *    averages out, a systematic shift (darker glass, brighter metal) does not.
+ *  - Noise: relMSE of the test render must stay within 1.5x of the value recorded
+ *    when the references were made, so a change may trade noise patterns but not
+ *    noticeably increase variance.
+ *  - Perceptual: SSIM may drop by at most 0.03 from the recorded value.
+ *
+ * References live in tests/references as `<scene>.pfm` (mean), `<scene>_variance.pfm`
+ * (per-sample variance) and `<scene>.txt` with the recorded metrics. Regenerate them (after an intentional change) with
+ * `raycraft_image_quality --references tests/references --update`.
+ */
+
+#include "constants.h"
+#include "hittable_list.h"
+#include "image_io.h"
+#include "image_metrics.h"
+#include "scenes.h"
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @class quality_case
+ * @brief A canonical scene with its fixed render settings.
+ */
+struct quality_case
+{
+    const char *name;
+    hittable_list (*scene)();
+    void (*view)(camera &);
+    int width;
+    int max_depth;
+};
+
+static const quality_case cases[] = {
+    {"material_spheres", material_spheres_scene, material_spheres_view, 96, 20},
+    {"sphere_grid", sphere_grid_scene, sphere_grid_view, 96, 10},
+};
+
+static const int reference_passes = 64;
+static const int reference_pass_spp = 64; // 4096 spp in total
+static const uint64_t reference_seed = 0x5eedf00dULL;
+static const int test_spp = 64;
+static const uint64_t test_seed = 1;
+static const int block_size = 8;
+static const double max_block_z = 6.0;      // per block and channel; radiance noise is heavy tailed
+static const double max_relmse_ratio = 1.5; // allowed noise increase over the recorded value
+static const double max_ssim_drop = 0.03;   // allowed SSIM decrease from the recorded value
+
+/** @brief Returns a camera for `qc` with the given seed. */
+static camera case_camera(const quality_case &qc, uint64_t seed)
+{
+    camera cam;
+    qc.view(cam);
+    cam.image_width = qc.width;
+    cam.max_depth = qc.max_depth;
+    cam.seed = seed;
+    cam.show_progress = false;
+    return cam;
+}
+
+/**
+ * @class reference_image
+ * @brief High-spp mean image plus the per-sample variance of every pixel.
+ */
+struct reference_image
+{
+    float_image mean;
+    float_image variance; ///< Variance of a single sample, per pixel and channel
+    int spp = 0;
+};
+
+/**
+ * @brief Renders the reference as independent passes; the spread of the pass means
+ * gives the per-sample variance (pass variance times samples per pass).
+ */
+static reference_image render_reference(const quality_case &qc, const hittable &world)
+{
+    camera cam = case_camera(qc, reference_seed);
+    std::vector<float_image> passes;
+    for (int p = 0; p < reference_passes; p++)
+    {
+        framebuffer fb;
+        cam.render_pass(world, fb, p * reference_pass_spp, reference_pass_spp);
+        passes.push_back(fb.resolved());
+    }
+
+    reference_image ref;
+    ref.spp = reference_passes * reference_pass_spp;
+    ref.mean = float_image(passes[0].width, passes[0].height);
+    ref.variance = float_image(passes[0].width, passes[0].height);
+    for (size_t n = 0; n < ref.mean.pixels.size(); n++)
+    {
+        color m(0, 0, 0);
+        for (const auto &img : passes)
+            m += img.pixels[n];
+        m /= reference_passes;
+
+        color v(0, 0, 0);
+        for (const auto &img : passes)
+            v += (img.pixels[n] - m) * (img.pixels[n] - m);
+        ref.mean.pixels[n] = m;
+        ref.variance.pixels[n] = v * (double(reference_pass_spp) / (reference_passes - 1));
+    }
+    return ref;
+}
+
+/**
+ * @brief Returns the largest |z| over all blocks and channels of the bias test.
+ *
+ * For a block of n pixels, D = mean(test - ref) and
+ * Var(D) = sum(var * (1 / test_spp + 1 / ref_spp)) / n^2.
+ */
+static double max_bias_z(const float_image &test, const reference_image &ref, int &worst_x, int &worst_y)
+{
+    double worst = 0;
+    double var_scale = 1.0 / test_spp + 1.0 / ref.spp;
+    for (int by = 0; by < test.height; by += block_size)
+    {
+        for (int bx = 0; bx < test.width; bx += block_size)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                double diff = 0, var = 0;
+                for (int j = by; j < std::min(by + block_size, test.height); j++)
+                {
+                    for (int i = bx; i < std::min(bx + block_size, test.width); i++)
+                    {
+                        diff += test.at(i, j)[c] - ref.mean.at(i, j)[c];
+                        var += ref.variance.at(i, j)[c] * var_scale;
+                    }
+                }
+                // Flat regions (sky, blocks fully in shadow) have no noise to compare against
+                if (var <= 1e-12)
+                    continue;
+                double z = std::fabs(diff) / std::sqrt(var);
+                if (z > worst)
+                {
+                    worst = z;
+                    worst_x = bx;
+                    worst_y = by;
+                }
+            }
+        }
+    }
+    return worst;
+}
+
+/** @brief Reads `key value` lines from a reference metadata file. */
+static std::map<std::string, double> read_metadata(const std::string &path)
+{
+    std::map<std::string, double> meta;
+    std::ifstream in(path);
+    std::string key;
+    double value;
+    while (in >> key >> value)
+        meta[key] = value;
+    return meta;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string references = "tests/references";
+    bool update = false;
+
+    for (int n = 1; n < argc; n++)
+    {
+        if (!std::strcmp(argv[n], "--references") && n + 1 < argc)
+            references = argv[++n];
+        else if (!std::strcmp(argv[n], "--update"))
+            update = true;
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--references DIR] [--update]\n";
+            return 2;
+        }
+    }
+
+    bool failed = false;
+    for (const auto &qc : cases)
+    {
+        hittable_list world = qc.scene();
+        std::string base = references + "/" + qc.name;
+
+        reference_image ref;
+        if (update)
+        {
+            ref = render_reference(qc, world);
+            std::ofstream mean_out(base + ".pfm", std::ios::binary);
+            write_pfm(mean_out, ref.mean);
+            std::ofstream variance_out(base + "_variance.pfm", std::ios::binary);
+            write_pfm(variance_out, ref.variance);
+        }
+        else
+        {
+            std::ifstream mean_in(base + ".pfm", std::ios::binary);
+            std::ifstream variance_in(base + "_variance.pfm", std::ios::binary);
+            if (!read_pfm(mean_in, ref.mean) || !read_pfm(variance_in, ref.variance))
+            {
+                std::cerr << qc.name << ": cannot read reference " << base << ".pfm\n";
+                failed = true;
+                continue;
+            }
+            auto meta = read_metadata(base + ".txt");
+            ref.spp = meta.count("reference_spp") ? int(meta["reference_spp"]) : reference_passes * reference_pass_spp;
+        }
+
+        camera cam = case_camera(qc, test_seed);
+        framebuffer fb;
+        cam.render_pass(world, fb, 0, test_spp);
+        float_image test = fb.resolved();
+
+        if (test.width != ref.mean.width || test.height != ref.mean.height)
+        {
+            std::cerr << qc.name << ": reference is " << ref.mean.width << "x" << ref.mean.height << ", render is "
+                      << test.width << "x" << test.height << "\n";
+            failed = true;
+            continue;
+        }
+
+        double mse = image_mse(test, ref.mean);
+        double relmse = image_relmse(test, ref.mean);
+        double ssim = image_ssim(test, ref.mean);
+        int bx = 0, by = 0;
+        double z = max_bias_z(test, ref, bx, by);
+
+        if (update)
+        {
+            std::ofstream meta(base + ".txt");
+            meta.precision(10);
+            meta << "reference_spp " << ref.spp << "\nrelmse " << relmse << "\nssim " << ssim << "\n";
+            std::clog << qc.name << ": reference updated (relMSE " << relmse << ", SSIM " << ssim << ")\n";
+            continue;
+        }
+
+        auto meta = read_metadata(base + ".txt");
+        double recorded_relmse = meta.count("relmse") ? meta["relmse"] : relmse;
+        double recorded_ssim = meta.count("ssim") ? meta["ssim"] : ssim;
+
+        bool biased = z > max_block_z;
+        bool noisy = relmse > max_relmse_ratio * recorded_relmse;
+        bool dissimilar = ssim < recorded_ssim - max_ssim_drop;
+
+        std::clog << (biased || noisy || dissimilar ? "FAIL " : "ok   ") << qc.name
+                  << ": MSE " << mse << ", relMSE " << relmse << " (recorded " << recorded_relmse << ")"
+                  << ", SSIM " << ssim << " (recorded " << recorded_ssim << ")"
+                  << ", max bias z " << z << " at block (" << bx << ", " << by << ")\n";
+        if (biased)
+            std::clog << "     bias: block mean differs from the reference by more than " << max_block_z << " sigma\n";
+        if (noisy)
+            std::clog << "     noise: relMSE exceeds " << max_relmse_ratio << "x the recorded value\n";
+        if (dissimilar)
+            std::clog << "     SSIM dropped by more than " << max_ssim_drop << "\n";
+
+        failed |= biased || noisy || dissimilar;
+    }
+
+    return failed ? 1 : 0;
+}
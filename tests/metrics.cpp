@@ -0,0 +1,156 @@
+/**
+ * @file metrics.cpp
+ * @brief Tests of the Prometheus text output of the render metrics.
+ *
+ * A small render with `render_metrics` attached must report every sample and tile
+ * it took, summed over the per-thread slots, with nothing left queued or in
+ * flight. The output is parsed back: every sample must follow the `# TYPE` line
+ * of its metric, and a latency histogram must have cumulative buckets that agree
+ * with its count.
+ */
+
+#include "check.h"
+#include "constants.h"
+#include "bvh.h"
+#include "metrics.h"
+#include "scenes.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+/**
+ * @brief Parses Prometheus text into `values` keyed by name and labels.
+ * @return False if a sample has no preceding `# TYPE` for its metric.
+ */
+static bool parse_prometheus(const std::string &text, std::map<std::string, double> &values,
+                             std::map<std::string, std::string> &types)
+{
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.compare(0, 7, "# TYPE ") == 0)
+        {
+            std::istringstream words(line.substr(7));
+            std::string name, type;
+            words >> name >> type;
+            types[name] = type;
+            continue;
+        }
+        if (line.empty() || line[0] == '#')
+            continue;
+        size_t space = line.rfind(' ');
+        if (space == std::string::npos)
+            return false;
+        std::string key = line.substr(0, space);
+        std::string name = key.substr(0, key.find('{'));
+        // Histogram series belong to the metric without their suffix
+        for (const char *suffix : {"_bucket", "_sum", "_count"})
+        {
+            size_t n = std::strlen(suffix);
+            if (!types.count(name) && name.size() > n && name.compare(name.size() - n, n, suffix) == 0)
+                name.resize(name.size() - n);
+        }
+        if (!types.count(name))
+            return false;
+        values[key] = std::stod(line.substr(space + 1));
+    }
+    return true;
+}
+
+int main()
+{
+    // A render with the metrics attached
+    hittable_list scene = material_spheres_scene();
+    bvh world(scene, 4, 1);
+    camera cam;
+    material_spheres_view(cam);
+    cam.image_width = 80;
+    cam.samples_per_pixel = 3;
+    cam.max_depth = 5;
+    cam.num_threads = 4;
+    cam.show_progress = false;
+    render_metrics metrics;
+    cam.metrics = &metrics;
+    cam.prepare();
+    framebuffer fb;
+    cam.render_pass(world, fb, 0, cam.samples_per_pixel);
+
+    std::ostringstream out;
+    metrics.write_prometheus(out);
+    std::map<std::string, double> values;
+    std::map<std::string, std::string> types;
+    check("the output parses, every sample after its TYPE line", parse_prometheus(out.str(), values, types));
+    check("totals are counters", types["raycraft_rays_total"] == "counter" &&
+                                     types["raycraft_samples_total"] == "counter" &&
+                                     types["raycraft_thread_busy_seconds_total"] == "counter");
+    check("in-flight and queued tiles are gauges", types["raycraft_tiles_in_flight"] == "gauge" &&
+                                                       types["raycraft_tiles_queued"] == "gauge");
+
+    int width = cam.image_width, height = cam.height();
+    int tiles = int(grid_tiles(width, height, cam.tile_size).size());
+    check("every pixel sample is counted",
+          values["raycraft_samples_total"] == double(width) * height * cam.samples_per_pixel);
+    check("every tile is counted", values["raycraft_tiles_total"] == tiles);
+    check("rays include at least the camera rays", values["raycraft_rays_total"] >= values["raycraft_samples_total"]);
+    check("nothing is left queued or in flight",
+          values["raycraft_tiles_in_flight"] == 0 && values["raycraft_tiles_queued"] == 0);
+    int threads = 0;
+    double busy = 0;
+    for (const auto &v : values)
+        if (v.first.compare(0, 42, "raycraft_thread_busy_seconds_total{thread=") == 0)
+        {
+            threads++;
+            busy += v.second;
+        }
+    check("busy time is reported per worker", threads >= 1 && threads <= cam.num_threads && busy > 0);
+
+    // Slots of several workers add up, including a worker index that wraps around
+    render_metrics slots;
+    slots.tiles_queued(3);
+    for (int worker : {0, 3, render_metrics::max_threads + 1})
+    {
+        slots.tile_started();
+        slots.tile_finished(worker, 100, 10, 0.5);
+    }
+    std::ostringstream slot_out;
+    slots.write_prometheus(slot_out);
+    values.clear();
+    parse_prometheus(slot_out.str(), values, types);
+    check("per-thread slots are summed", values["raycraft_rays_total"] == 300 &&
+                                             values["raycraft_samples_total"] == 30 &&
+                                             values["raycraft_tiles_total"] == 3);
+    check("a worker's busy time lands in its slot",
+          values["raycraft_thread_busy_seconds_total{thread=\"1\"}"] == 0.5 &&
+              values["raycraft_thread_busy_seconds_total{thread=\"3\"}"] == 0.5);
+
+    // Histogram: cumulative buckets, +Inf equals the count
+    latency_histogram latency;
+    for (double ms : {0.5, 3.0, 3.0, 1e5})
+        latency.add(ms);
+    std::ostringstream hist_out;
+    latency.write_prometheus(hist_out, "raycraft_test_seconds", "Test latencies.");
+    values.clear();
+    check("the histogram parses", parse_prometheus(hist_out.str(), values, types) &&
+                                      types["raycraft_test_seconds"] == "histogram");
+    double previous = 0;
+    bool cumulative = true;
+    for (double le : {0.001, 0.002, 0.005, 0.01, 60.0})
+    {
+        std::ostringstream key;
+        key << "raycraft_test_seconds_bucket{le=\"" << le << "\"}";
+        cumulative &= values[key.str()] >= previous;
+        previous = values[key.str()];
+    }
+    check("buckets are cumulative", cumulative && values["raycraft_test_seconds_bucket{le=\"0.001\"}"] == 1 &&
+                                        values["raycraft_test_seconds_bucket{le=\"0.005\"}"] == 3 && previous == 3);
+    check("+Inf holds every observation", values["raycraft_test_seconds_bucket{le=\"+Inf\"}"] == 4 &&
+                                              values["raycraft_test_seconds_count"] == 4);
+    check("the sum is in seconds", std::fabs(values["raycraft_test_seconds_sum"] - (1e5 + 6.5) / 1000) < 1e-3);
+
+    return check_summary();
+}
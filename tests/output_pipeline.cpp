@@ -0,0 +1,96 @@
+/**
+ * @file output_pipeline.cpp
+ * @brief Tests that the asynchronous output pipeline writes the same files as the
+ * synchronous writers.
+ *
+ * Frames with out-of-range radiance and unsampled pixels go through the pipeline as
+ * PPM, PFM and PNG; every file must equal, byte for byte, what `write_ppm`,
+ * `write_pfm` and `encode_png` produce for the same framebuffer.
+ */
+
+#include "check.h"
+#include "constants.h"
+#include "output_pipeline.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/** @brief A frame of random radiance, some of it above 1, with a few unsampled pixels. */
+static framebuffer random_frame(int width, int height, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> radiance(0.0, 1.5);
+    framebuffer fb(width, height);
+    for (int j = 0; j < height; j++)
+        for (int i = 0; i < width; i++)
+            if ((i + j) % 17 != 0)
+                for (int s = 0; s < 3; s++)
+                    fb.add_sample(i, j, color(radiance(rng), radiance(rng), radiance(rng)));
+    return fb;
+}
+
+/** @brief Returns the contents of the file at `path` (empty if it cannot be read). */
+static std::string read_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream data;
+    data << in.rdbuf();
+    return data.str();
+}
+
+int main()
+{
+    char dir[] = "/tmp/raycraft_output_pipeline_XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        std::cerr << "cannot create a temporary directory\n";
+        return 1;
+    }
+
+    const char *names[] = {"frame0.ppm", "frame1.pfm", "frame2.png", "frame3.ppm"};
+    std::vector<std::string> expected;
+    output_pipeline::report stats;
+    {
+        output_pipeline pipeline(1); // a short queue, so submit also exercises backpressure
+        for (int f = 0; f < 4; f++)
+        {
+            framebuffer fb = random_frame(37 + f, 23, unsigned(f));
+            std::ostringstream sync;
+            switch (format_for_path(names[f]))
+            {
+            case image_format::ppm:
+                write_ppm(sync, fb);
+                break;
+            case image_format::pfm:
+                write_pfm(sync, fb.resolved());
+                break;
+            case image_format::png:
+                sync << encode_png(fb.resolved_rgb8().data(), fb.width, fb.height);
+                break;
+            }
+            expected.push_back(sync.str());
+            pipeline.submit(std::move(fb), std::string(dir) + "/" + names[f]);
+        }
+        stats = pipeline.finish();
+    }
+
+    uint64_t bytes = 0;
+    for (int f = 0; f < 4; f++)
+    {
+        std::string path = std::string(dir) + "/" + names[f];
+        check(std::string(names[f]) + " equals the synchronous writer", read_file(path) == expected[f]);
+        bytes += expected[f].size();
+        unlink(path.c_str());
+    }
+    rmdir(dir);
+    check("the report counts every frame and byte", stats.frames == 4 && stats.bytes == bytes);
+    check("no write errors", stats.errors.empty());
+
+    return check_summary();
+}
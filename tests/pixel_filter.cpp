@@ -0,0 +1,90 @@
+/**
+ * @file pixel_filter.cpp
+ * @brief Tests of the reconstruction filters and of splatting across tile borders.
+ *
+ * Each filter must integrate to one. A filtered render cut into small tiles must
+ * match the same render done as a single tile (so every splat across a border was
+ * merged exactly once) and must not depend on the thread count; the box filter must
+ * still give every pixel exactly its own samples.
+ */
+
+#include "check.h"
+#include "constants.h"
+#include "hittable_list.h"
+#include "sphere.h"
+
+#include <iostream>
+#include <string>
+
+/** @brief Largest difference between two framebuffers' sums and weights. */
+static double max_difference(const framebuffer &a, const framebuffer &b)
+{
+    double diff = 0;
+    for (size_t p = 0; p < a.sum.size(); p++)
+    {
+        diff = std::max(diff, (a.sum[p] - b.sum[p]).length());
+        diff = std::max(diff, std::fabs(a.weight[p] - b.weight[p]));
+    }
+    return diff;
+}
+
+int main()
+{
+    const char *names[] = {"gaussian", "mitchell", "blackman-harris"};
+    for (const char *name : names)
+    {
+        filter_type type = filter_type::box;
+        check(std::string(name) + " parses", parse_filter_type(name, type));
+        pixel_filter filter(type);
+        double integral = 0;
+        const int steps = 100000;
+        for (int k = 0; k < steps; k++)
+            integral += filter.weight(-filter.radius + (k + 0.5) * 2 * filter.radius / steps) * 2 * filter.radius / steps;
+        check(std::string(name) + " integrates to one", std::fabs(integral - 1) < 1e-3);
+    }
+
+    hittable_list world;
+    world.add(make_shared<sphere>(point3(0, 0, -1), 0.5, make_shared<lambertian>(color(0.7, 0.3, 0.3))));
+    world.add(make_shared<sphere>(point3(0.6, 0.1, -1.4), 0.3, make_shared<metal>(color(0.8, 0.8, 0.8), 0.1)));
+    camera cam;
+    cam.aspect_ratio = 4.0 / 3;
+    cam.image_width = 40;
+    cam.samples_per_pixel = 4;
+    cam.max_depth = 5;
+    cam.show_progress = false;
+
+    framebuffer boxed;
+    cam.tile_size = 7;
+    cam.render_pass(world, boxed, 0, 4);
+    bool own_pixel = true;
+    for (double w : boxed.weight)
+        own_pixel = own_pixel && w == 4;
+    check("box filter keeps every sample in its own pixel", own_pixel);
+
+    for (const char *name : names)
+    {
+        filter_type type = filter_type::box;
+        parse_filter_type(name, type); // checked above
+        cam.filter = pixel_filter(type);
+
+        framebuffer whole, tiled, threaded;
+        cam.tile_size = 1000;
+        cam.num_threads = 1;
+        cam.render_pass(world, whole, 0, 4);
+        cam.tile_size = 7; // tiles smaller than twice the border, and partial ones
+        cam.render_pass(world, tiled, 0, 4);
+        cam.num_threads = 4;
+        cam.render_pass(world, threaded, 0, 4);
+
+        check(std::string(name) + ": small tiles match a single tile", max_difference(whole, tiled) < 1e-9);
+        check(std::string(name) + ": independent of the thread count", max_difference(tiled, threaded) == 0);
+
+        double weight = 0;
+        for (double w : tiled.weight)
+            weight += w;
+        double samples = double(tiled.width) * tiled.height * 4;
+        check(std::string(name) + ": total weight close to the sample count", std::fabs(weight / samples - 1) < 0.05);
+    }
+
+    return check_summary();
+}
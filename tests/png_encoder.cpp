@@ -0,0 +1,333 @@
+/**
+ * @file png_encoder.cpp
+ * @brief Round-trip tests of the parallel PNG encoder.
+ *
+ * The PNG files are decoded by the small reference inflater below (stored and
+ * dynamic Huffman blocks, as written by the encoder) and unfiltered, and must give
+ * back the pixels exactly. Also checked: every chunk CRC, the combined Adler-32, the
+ * SIMD filters against the scalar ones, and that the file does not depend on the
+ * number of encoder threads.
+ */
+
+#include "check.h"
+#include "png_encoder.h"
+
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @class inflater
+ * @brief Minimal deflate decoder; returns false on any malformed input.
+ */
+class inflater
+{
+public:
+    inflater(const unsigned char *data, size_t size) : data(data), size(size) {}
+
+    bool run(std::vector<unsigned char> &out)
+    {
+        int final = 0;
+        while (!final)
+        {
+            final = bits(1);
+            int type = bits(2);
+            if (type == 0)
+            {
+                bit_count = 0; // skip to the byte boundary
+                if (position + 4 > size)
+                    return false;
+                size_t length = data[position] | data[position + 1] << 8;
+                size_t check = data[position + 2] | data[position + 3] << 8;
+                position += 4;
+                if ((length ^ 0xffff) != check || position + length > size)
+                    return false;
+                out.insert(out.end(), data + position, data + position + length);
+                position += length;
+            }
+            else if (type == 2)
+            {
+                if (!dynamic_block(out))
+                    return false;
+            }
+            else
+                return false; // the encoder never writes fixed Huffman blocks
+            if (overrun)
+                return false;
+        }
+        return true;
+    }
+
+    /** @brief Offset of the first byte after the deflate stream. */
+    size_t end() const { return position; }
+
+private:
+    struct huffman
+    {
+        std::vector<int> count, symbol;
+    };
+
+    const unsigned char *data;
+    size_t size, position = 0;
+    uint32_t bit_buffer = 0;
+    int bit_count = 0;
+    bool overrun = false;
+
+    int bits(int need)
+    {
+        while (bit_count < need)
+        {
+            if (position >= size)
+            {
+                overrun = true;
+                return 0;
+            }
+            bit_buffer = (bit_count ? bit_buffer : 0) | uint32_t(data[position++]) << bit_count;
+            bit_count += 8;
+        }
+        int value = int(bit_buffer & ((1u << need) - 1));
+        bit_buffer >>= need;
+        bit_count -= need;
+        return value;
+    }
+
+    static bool build(huffman &h, const int *lengths, int n)
+    {
+        h.count.assign(16, 0);
+        h.symbol.assign(n, 0);
+        for (int s = 0; s < n; s++)
+            h.count[lengths[s]]++;
+        int left = 1;
+        for (int len = 1; len < 16; len++)
+        {
+            left = left * 2 - h.count[len];
+            if (left < 0)
+                return false; // over-subscribed
+        }
+        std::vector<int> offsets(16, 0);
+        for (int len = 1; len < 15; len++)
+            offsets[len + 1] = offsets[len] + h.count[len];
+        for (int s = 0; s < n; s++)
+            if (lengths[s])
+                h.symbol[offsets[lengths[s]]++] = s;
+        return true;
+    }
+
+    int decode(const huffman &h)
+    {
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len < 16; len++)
+        {
+            code |= bits(1);
+            int count = h.count[len];
+            if (code - count < first)
+                return h.symbol[index + (code - first)];
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        overrun = true;
+        return 0;
+    }
+
+    bool dynamic_block(std::vector<unsigned char> &out)
+    {
+        static const int order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+        static const int length_base[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                            31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const int length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                             2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const int distance_base[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                              33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                              1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        static const int distance_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                               6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+        int hlit = bits(5) + 257, hdist = bits(5) + 1, hclen = bits(4) + 4;
+        int lengths[320] = {0};
+        for (int k = 0; k < hclen; k++)
+            lengths[order[k]] = bits(3);
+        huffman code_lengths, literals, distances;
+        if (!build(code_lengths, lengths, 19))
+            return false;
+
+        for (int k = 0; k < hlit + hdist;)
+        {
+            int symbol = decode(code_lengths);
+            if (symbol < 16)
+            {
+                lengths[k++] = symbol;
+                continue;
+            }
+            int value = 0, repeat;
+            if (symbol == 16)
+            {
+                if (k == 0)
+                    return false;
+                value = lengths[k - 1];
+                repeat = 3 + bits(2);
+            }
+            else
+                repeat = symbol == 17 ? 3 + bits(3) : 11 + bits(7);
+            if (k + repeat > hlit + hdist || overrun)
+                return false;
+            while (repeat--)
+                lengths[k++] = value;
+        }
+        if (!build(literals, lengths, hlit) || !build(distances, lengths + hlit, hdist))
+            return false;
+
+        while (!overrun)
+        {
+            int symbol = decode(literals);
+            if (symbol < 256)
+                out.push_back((unsigned char)symbol);
+            else if (symbol == 256)
+                return true;
+            else
+            {
+                symbol -= 257;
+                if (symbol >= 29)
+                    return false;
+                int length = length_base[symbol] + bits(length_extra[symbol]);
+                int d = decode(distances);
+                if (d >= 30)
+                    return false;
+                size_t distance = size_t(distance_base[d] + bits(distance_extra[d]));
+                if (distance > out.size())
+                    return false;
+                for (int k = 0; k < length; k++)
+                    out.push_back(out[out.size() - distance]);
+            }
+        }
+        return false;
+    }
+};
+
+static uint32_t read_u32(const std::string &s, size_t at)
+{
+    return uint32_t((unsigned char)s[at]) << 24 | uint32_t((unsigned char)s[at + 1]) << 16 |
+           uint32_t((unsigned char)s[at + 2]) << 8 | uint32_t((unsigned char)s[at + 3]);
+}
+
+/** @brief Decodes an 8-bit RGB PNG into `rgb`; false if any part is invalid. */
+static bool decode_png(const std::string &png, int &width, int &height, std::vector<unsigned char> &rgb)
+{
+    if (png.compare(0, 8, std::string("\x89PNG\r\n\x1a\n", 8)) != 0)
+        return false;
+    std::string idat;
+    bool ended = false;
+    for (size_t p = 8; p + 12 <= png.size() && !ended; )
+    {
+        uint32_t length = read_u32(png, p);
+        if (p + 12 + length > png.size())
+            return false;
+        const unsigned char *chunk = reinterpret_cast<const unsigned char *>(png.data() + p + 4);
+        if (crc32_update(0, chunk, length + 4) != read_u32(png, p + 8 + length))
+            return false;
+        std::string type = png.substr(p + 4, 4), body = png.substr(p + 8, length);
+        if (type == "IHDR")
+        {
+            width = int(read_u32(body, 0));
+            height = int(read_u32(body, 4));
+            if (body[8] != 8 || body[9] != 2)
+                return false;
+        }
+        else if (type == "IDAT")
+            idat += body;
+        else if (type == "IEND")
+            ended = true;
+        p += 12 + length;
+    }
+    if (!ended || idat.size() < 6 || (((unsigned char)idat[0] << 8) | (unsigned char)idat[1]) % 31 != 0)
+        return false;
+
+    std::vector<unsigned char> filtered;
+    inflater in(reinterpret_cast<const unsigned char *>(idat.data()) + 2, idat.size() - 2);
+    if (!in.run(filtered) || in.end() + 2 + 4 != idat.size())
+        return false;
+    if (adler32(filtered.data(), filtered.size()) != read_u32(idat, idat.size() - 4))
+        return false;
+
+    size_t stride = size_t(width) * 3;
+    if (filtered.size() != (stride + 1) * height)
+        return false;
+    rgb.assign(stride * height, 0);
+    for (int y = 0; y < height; y++)
+    {
+        int type = filtered[y * (stride + 1)];
+        const unsigned char *f = &filtered[y * (stride + 1) + 1];
+        unsigned char *row = &rgb[y * stride];
+        const unsigned char *up = y > 0 ? row - stride : nullptr;
+        for (size_t x = 0; x < stride; x++)
+        {
+            int a = x >= 3 ? row[x - 3] : 0, b = up ? up[x] : 0, c = up && x >= 3 ? up[x - 3] : 0;
+            int pred = type == 1 ? a : type == 2 ? b : type == 3 ? (a + b) >> 1 : type == 4 ? paeth_predictor(a, b, c) : 0;
+            if (type > 4)
+                return false;
+            row[x] = (unsigned char)(f[x] + pred);
+        }
+    }
+    return true;
+}
+
+/** @brief A smooth gradient with noise, long flat runs and hard edges. */
+static std::vector<unsigned char> test_image(int width, int height, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<unsigned char> rgb(size_t(width) * height * 3);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned char v;
+                if (y % 17 < 5)
+                    v = (unsigned char)(40 * k); // flat band
+                else if (x % 23 < 3)
+                    v = (unsigned char)rng(); // noise column
+                else
+                    v = (unsigned char)((x * (k + 1) + y * 2) / 3 + rng() % 4);
+                rgb[(size_t(y) * width + x) * 3 + k] = v;
+            }
+    return rgb;
+}
+
+int main()
+{
+    const int sizes[][2] = {{1, 1}, {5, 3}, {17, 9}, {640, 360}, {1500, 400}};
+    for (const auto &size : sizes)
+    {
+        int width = size[0], height = size[1];
+        auto rgb = test_image(width, height, unsigned(width * 31 + height));
+        std::string name = std::to_string(width) + "x" + std::to_string(height);
+
+        std::vector<unsigned char> simd((size_t(width) * 3 + 1) * height), scalar(simd.size());
+        png_filter_rows(rgb.data(), size_t(width) * 3, 0, height, 3, simd.data(), true);
+        png_filter_rows(rgb.data(), size_t(width) * 3, 0, height, 3, scalar.data(), false);
+        check(name + " SIMD filters match scalar", simd == scalar);
+
+        png_encode_stats stats;
+        std::string png = encode_png(rgb.data(), width, height, 4, &stats);
+        int decoded_width = 0, decoded_height = 0;
+        std::vector<unsigned char> decoded;
+        check(name + " decodes to the same pixels (" + std::to_string(stats.groups) + " row groups)",
+              decode_png(png, decoded_width, decoded_height, decoded) && decoded_width == width &&
+                  decoded_height == height && decoded == rgb);
+        check(name + " independent of the thread count", encode_png(rgb.data(), width, height, 1) == png);
+    }
+
+    // Combining the Adler-32 of the parts must give the Adler-32 of the whole
+    std::vector<unsigned char> bytes(200000);
+    std::mt19937 rng(5);
+    for (auto &b : bytes)
+        b = (unsigned char)rng();
+    bool combined = true;
+    for (size_t split : {size_t(0), size_t(1), size_t(5552), size_t(65521), size_t(131071), bytes.size()})
+        combined &= adler32_combine(adler32(bytes.data(), split), adler32(bytes.data() + split, bytes.size() - split),
+                                    bytes.size() - split) == adler32(bytes.data(), bytes.size());
+    check("adler32_combine", combined);
+
+    return check_summary();
+}
@@ -0,0 +1,70 @@
+/**
+ * @file progress.cpp
+ * @brief Tests of progress events written to a pipe.
+ *
+ * An open pipe must receive a start and a done event for the pass; a pipe whose
+ * reader has gone away must not stop the render, which still fills every pixel.
+ */
+
+#include "check.h"
+#include "constants.h"
+#include "bvh.h"
+#include "scenes.h"
+
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+/** @brief Renders a small image with JSON progress events written to `fd`. */
+static bool render_with_progress(const hittable &world, int fd)
+{
+    camera cam;
+    material_spheres_view(cam);
+    cam.image_width = 64;
+    cam.samples_per_pixel = 2;
+    cam.max_depth = 4;
+    cam.num_threads = 2;
+    cam.show_progress = false;
+    progress_reporter progress(progress_format::json, fd);
+    progress.interval = 0; // an event for every tile
+    cam.progress = &progress;
+    cam.prepare();
+
+    framebuffer fb;
+    cam.render_pass(world, fb, 0, cam.samples_per_pixel);
+    bool covered = fb.width == cam.image_width && fb.height == cam.height();
+    for (double w : fb.weight)
+        covered &= w > 0;
+    return covered;
+}
+
+int main()
+{
+    // As RayCraft does for --progress-fd
+    std::signal(SIGPIPE, SIG_IGN);
+
+    hittable_list scene = material_spheres_scene();
+    bvh world(scene, 4, 1);
+
+    int open_pipe[2];
+    check("pipe created", pipe(open_pipe) == 0);
+    check("renders with progress on an open pipe", render_with_progress(world, open_pipe[1]));
+    close(open_pipe[1]);
+    std::string events;
+    char buf[4096];
+    for (ssize_t n; (n = read(open_pipe[0], buf, sizeof(buf))) > 0;)
+        events.append(buf, size_t(n));
+    close(open_pipe[0]);
+    check("the pipe receives a start event", events.find("{\"event\":\"start\"") == 0);
+    check("the pipe receives a done event", events.find("{\"event\":\"done\"") != std::string::npos &&
+                                                events.back() == '\n');
+
+    int closed_pipe[2];
+    check("pipe created", pipe(closed_pipe) == 0);
+    close(closed_pipe[0]);
+    check("a closed progress pipe does not stop the render", render_with_progress(world, closed_pipe[1]));
+    close(closed_pipe[1]);
+
+    return check_summary();
+}
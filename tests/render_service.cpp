@@ -0,0 +1,114 @@
+/**
+ * @file render_service.cpp
+ * @brief Tests of the render service's job ordering, pool and scene cache.
+ *
+ * An urgent job submitted while a large one is rendering must finish first; a job
+ * rendered on several pool workers must equal the same job on one; and the scene
+ * cache must stay within its byte budget by evicting the least recently used scene.
+ */
+
+#include "check.h"
+#include "constants.h"
+#include "render_service.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+/** @brief Submits `params` and waits for the image; nullptr if the job was rejected. */
+static std::shared_ptr<render_job> render_now(render_service &service, const job_params &params)
+{
+    std::string error;
+    auto job = service.submit(params, error);
+    if (job)
+        job->done.get_future().wait();
+    return job;
+}
+
+int main()
+{
+    tuning_profile profile;
+
+    // One worker, so the urgent job can only finish first by overtaking the queue
+    {
+        render_service service(1, profile, size_t(1) << 30);
+        job_params large;
+        large.width = 320;
+        large.height = 180;
+        large.spp = 32;
+        large.priority = 0;
+        job_params urgent;
+        urgent.width = 32;
+        urgent.height = 18;
+        urgent.spp = 1;
+        urgent.priority = 10;
+
+        std::string error;
+        auto slow = service.submit(large, error);
+        auto fast = service.submit(urgent, error);
+        check("both jobs are accepted", slow && fast);
+        if (slow && fast)
+        {
+            fast->done.get_future().wait();
+            slow->done.get_future().wait();
+            std::clog << "urgent finished after " << fast->total_ms() << " ms, large after " << slow->total_ms()
+                      << " ms\n";
+            check("the urgent job finishes before the large one", fast->finished < slow->finished);
+        }
+    }
+
+    // Tiles spread over several workers render the same image as one worker
+    {
+        job_params params;
+        params.width = 160;
+        params.height = 90;
+        params.spp = 4;
+        render_service one(1, profile, size_t(1) << 30), four(4, profile, size_t(1) << 30);
+        auto a = render_now(one, params), b = render_now(four, params);
+        check("the pool renders the same image on one and four workers",
+              a && b && a->fb.sum.size() == b->fb.sum.size() &&
+                  std::memcmp(a->fb.sum.data(), b->fb.sum.data(), a->fb.sum.size() * sizeof(a->fb.sum[0])) == 0);
+    }
+
+    // Scene cache: measure the scenes, then give the cache room for two of the three
+    const char *names[3] = {"builtin:material_spheres", "builtin:sphere_grid", "builtin:random_spheres"};
+    size_t sizes[3];
+    {
+        scene_cache sizing(size_t(1) << 30, profile.leaf_size, 2);
+        std::string error;
+        for (int s = 0; s < 3; s++)
+        {
+            auto scene = sizing.get(names[s], error);
+            sizes[s] = scene ? scene->bytes : 0;
+        }
+    }
+    check("the built-in scenes load", sizes[0] > 0 && sizes[1] > 0 && sizes[2] > 0);
+
+    scene_cache cache(sizes[0] + sizes[1] + sizes[2] - 1, profile.leaf_size, 2);
+    std::string error;
+    cache.get(names[0], error);
+    cache.get(names[1], error);
+    cache.get(names[0], error); // now the second scene is the least recently used
+    cache.get(names[2], error);
+
+    uint64_t hits, misses, evictions;
+    size_t entries, bytes;
+    cache.counts(hits, misses, evictions, entries, bytes);
+    std::clog << "cache: " << entries << " entries, " << bytes << " of " << cache.capacity_bytes << " bytes\n";
+    check("the cache evicts beyond its budget", evictions == 1 && entries == 2 && bytes <= cache.capacity_bytes);
+
+    cache.get(names[0], error);
+    cache.counts(hits, misses, evictions, entries, bytes);
+    check("the recently used scene stays cached", hits == 2 && misses == 3);
+    cache.get(names[1], error);
+    cache.counts(hits, misses, evictions, entries, bytes);
+    check("the least recently used scene was evicted", misses == 4);
+
+    scene_cache tiny(1, profile.leaf_size, 2);
+    for (const char *name : names)
+        tiny.get(name, error);
+    tiny.counts(hits, misses, evictions, entries, bytes);
+    check("a scene larger than the budget still stays until the next one", evictions == 2 && entries == 1);
+
+    return check_summary();
+}
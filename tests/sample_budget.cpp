@@ -0,0 +1,93 @@
+/**
+ * @file sample_budget.cpp
+ * @brief Tests of per-pixel sample budgets.
+ *
+ * The foveated profile must be full at the focus point, at the floor beyond the
+ * outer radius and monotone in between. A render with a budget must take exactly
+ * the budgeted samples per pixel (framebuffer weight, cost AOV, pass report), and
+ * pixels at full density must come out bit-identical to a render without a budget,
+ * since every pixel is seeded on its own.
+ */
+
+#include "check.h"
+#include "constants.h"
+#include "hittable_list.h"
+#include "sample_budget.h"
+#include "sphere.h"
+
+#include <iostream>
+#include <string>
+
+int main()
+{
+    const int width = 48, height = 32, spp = 16;
+    const double floor = 2.0 / spp;
+
+    sample_budget budget;
+    budget.foveated(width, height, 0.5, 0.5, 0.2, 0.6, floor);
+    check("full density at the focus point", budget.samples(width / 2, height / 2, width, height, spp) == spp);
+    check("floor in the corners", budget.samples(0, 0, width, height, spp) == 2 &&
+                                      budget.samples(width - 1, height - 1, width, height, spp) == 2);
+    bool monotone = true;
+    for (int i = width / 2 + 1; i < width; i++)
+        monotone = monotone && budget.samples(i, height / 2, width, height, spp) <=
+                                   budget.samples(i - 1, height / 2, width, height, spp);
+    check("density falls off monotonically from the focus", monotone);
+    check("lookup works at another resolution",
+          budget.samples(2 * width - 1, 0, 2 * width, 2 * height, spp) == 2 &&
+              budget.samples(width, height, 2 * width, 2 * height, spp) == spp);
+
+    float_image importance(4, 1);
+    importance.at(0, 0) = color(0, 0, 0);
+    importance.at(1, 0) = color(1, 1, 1);
+    importance.at(2, 0) = color(0.5, 0.5, 0.5);
+    importance.at(3, 0) = color(4, 4, 4);
+    sample_budget painted;
+    painted.from_importance(importance, floor);
+    check("importance image maps black to the floor and white to full",
+          painted.samples(0, 0, 4, 1, spp) == 2 && painted.samples(1, 0, 4, 1, spp) == spp &&
+              painted.samples(2, 0, 4, 1, spp) == 9 && painted.samples(3, 0, 4, 1, spp) == spp);
+
+    hittable_list world;
+    world.add(make_shared<sphere>(point3(0, 0, -1), 0.5, make_shared<lambertian>(color(0.5, 0.5, 0.5))));
+    camera cam;
+    cam.aspect_ratio = double(width) / height;
+    cam.image_width = width;
+    cam.samples_per_pixel = spp;
+    cam.show_progress = false;
+    cam.sampler = sampler_type::stratified;
+
+    framebuffer uniform;
+    cam.render_pass(world, uniform, 0, spp);
+    check("uniform pass reports pixels x spp samples", cam.last_pass.samples == uint64_t(width) * height * spp);
+
+    cost_aov cost;
+    cost.resize(width, height);
+    cam.cost = &cost;
+    cam.budget = &budget;
+    framebuffer budgeted;
+    cam.render_pass(world, budgeted, 0, spp);
+
+    uint64_t expected_total = 0;
+    bool weights = true, aov = true, identical = true;
+    for (int j = 0; j < height; j++)
+        for (int i = 0; i < width; i++)
+        {
+            int n = budget.samples(i, j, width, height, spp);
+            expected_total += n;
+            size_t idx = budgeted.index(i, j);
+            weights = weights && budgeted.weight[idx] == n;
+            aov = aov && cost.samples[idx] == n;
+            if (n == spp)
+                identical = identical && budgeted.sum[idx].x() == uniform.sum[idx].x() &&
+                            budgeted.sum[idx].y() == uniform.sum[idx].y() &&
+                            budgeted.sum[idx].z() == uniform.sum[idx].z();
+        }
+    check("framebuffer weight is the budgeted sample count", weights);
+    check("cost AOV records the effective spp", aov);
+    check("pass report counts the budgeted samples", cam.last_pass.samples == expected_total);
+    check("budget saves samples", expected_total < uint64_t(width) * height * spp);
+    check("full-density pixels match the uniform render exactly", identical);
+
+    return check_summary();
+}
@@ -0,0 +1,122 @@
+/**
+ * @file sample_guard.cpp
+ * @brief Tests of robust accumulation: NaN/Inf guarding, indirect clamping and the
+ * median-of-means estimator.
+ *
+ * A material that returns NaN for half its scatters must not leave a single NaN
+ * pixel, and the guard must count the dropped samples and record where they came
+ * from. Clamping must cap surface samples but leave directly seen sky alone. On a
+ * heavy-tailed sample distribution (rare, huge values, as from caustics) the median
+ * of means at 16 samples must beat the plain mean at 256.
+ */
+
+#include "check.h"
+#include "constants.h"
+#include "hittable_list.h"
+#include "sphere.h"
+
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+
+/** @brief Diffuse material whose every other scatter is a NaN (a broken material or `refract`). */
+class nan_material : public material
+{
+public:
+    bool scatter(const ray &, const hit_record &rec, color &attenuation, ray &scattered) const override
+    {
+        scattered = ray(rec.p, rec.normal + random_unit_vector());
+        double v = random_double() < 0.5 ? std::numeric_limits<double>::quiet_NaN() : 0.5;
+        attenuation = color(v, v, v);
+        return true;
+    }
+};
+
+int main()
+{
+    // Estimator basics
+    std::vector<color> values = {color(1, 1, 1), color(2, 2, 2), color(9, 9, 9), color(3, 3, 3)};
+    check("one group is the plain mean", (median_of_means(values, 1) - color(3.75, 3.75, 3.75)).length() < 1e-12);
+    check("one sample per group is the median", (median_of_means(values, 4) - color(2.5, 2.5, 2.5)).length() < 1e-12);
+
+    // Heavy tail: 0.1 almost always, 100 with probability 1/1000 (true mean 0.1999)
+    std::mt19937_64 rng(3);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    const double truth = 0.1 * 0.999 + 100 * 0.001;
+    auto mse = [&](int n, bool median)
+    {
+        double sum = 0;
+        const int trials = 4000;
+        std::vector<color> s(n);
+        for (int t = 0; t < trials; t++)
+        {
+            color mean(0, 0, 0);
+            for (auto &c : s)
+            {
+                double v = uniform(rng) < 0.001 ? 100 : 0.1;
+                c = color(v, v, v);
+                mean += c;
+            }
+            double estimate = median ? median_of_means(s, 5).x() : mean.x() / n;
+            sum += (estimate - truth) * (estimate - truth);
+        }
+        return sum / trials;
+    };
+    double mom16 = mse(16, true), mean16 = mse(16, false), mean256 = mse(256, false);
+    std::clog << "heavy tail MSE: median of means 16 spp " << mom16 << ", mean 16 spp " << mean16 << ", mean 256 spp "
+              << mean256 << "\n";
+    check("median of means at 16 spp beats the mean at 256 spp on a heavy tail", mom16 < mean256);
+
+    // NaN guarding in the renderer
+    hittable_list world;
+    world.add(make_shared<sphere>(point3(0, 0, -1), 0.5, make_shared<nan_material>()));
+    camera cam;
+    cam.aspect_ratio = 1.0;
+    cam.image_width = 24;
+    cam.samples_per_pixel = 8;
+    cam.max_depth = 4;
+    cam.show_progress = false;
+    sample_guard guard;
+    cam.guard = &guard;
+
+    framebuffer fb;
+    cam.render_pass(world, fb, 0, 8);
+    bool finite = true;
+    for (int j = 0; j < fb.height; j++)
+        for (int i = 0; i < fb.width; i++)
+            finite = finite && is_finite(fb.resolve(i, j));
+    check("no NaN pixel survives", finite);
+    check("dropped samples are counted", guard.nans() > 0 && guard.infs() == 0);
+    auto offenders = guard.offenders();
+    bool located = !offenders.empty() && offenders.size() <= guard.max_offenders;
+    for (const auto &o : offenders)
+        located = located && o.x >= 0 && o.x < fb.width && o.y >= 0 && o.y < fb.height && o.sample >= 0 &&
+                  o.sample < 8 && std::isnan(o.value.x()) && fb.weight[fb.index(o.x, o.y)] < 8;
+    check("offenders name their pixel and sample", located);
+
+    cam.estimator = estimator_type::median_of_means;
+    framebuffer median_fb;
+    cam.render_pass(world, median_fb, 0, 8);
+    finite = true;
+    for (int j = 0; j < median_fb.height; j++)
+        for (int i = 0; i < median_fb.width; i++)
+            finite = finite && is_finite(median_fb.resolve(i, j));
+    check("median of means drops NaN samples too", finite);
+
+    // Clamping caps surface samples only
+    hittable_list grey;
+    grey.add(make_shared<sphere>(point3(0, 0, -1), 0.5, make_shared<lambertian>(color(0.9, 0.9, 0.9))));
+    cam.estimator = estimator_type::mean;
+    cam.clamp_indirect = 0.3;
+    sample_guard clamp_guard;
+    cam.guard = &clamp_guard;
+    framebuffer clamped;
+    cam.render_pass(grey, clamped, 0, 8);
+    color centre = clamped.resolve(12, 12), corner = clamped.resolve(0, 0);
+    check("surface samples are capped", std::fmax(centre.x(), std::fmax(centre.y(), centre.z())) <= 0.3 + 1e-12);
+    check("directly seen sky is not clamped", corner.z() > 0.3);
+    check("clamped samples are counted", clamp_guard.clamped() > 0);
+
+    return check_summary();
+}
@@ -0,0 +1,332 @@
+/**
+ * @file sampling_distributions.cpp
+ * @brief Statistical unbiasedness tests for the samplers and material scatter functions.
+ *
+ * Faster replacements for the rejection samplers in `vec3.h` or the scatter logic
+ * in `material.h` must produce exactly the same distributions. Each sampler is run
+ * millions of times (spread over all hardware threads) and its output is mapped to
+ * a pair (u, v) that is uniform on the unit square if and only if the sampler
+ * follows its analytic PDF:
+ *
+ *  - random_unit_vector:  u = (z + 1) / 2, v = phi / 2pi    (uniform sphere)
+ *  - random_in_unit_disk: u = r^2,         v = phi / 2pi    (uniform disk)
+ *  - lambertian::scatter: u = cos^2(theta), v = phi / 2pi   (pdf cos(theta) / pi)
+ *  - metal::scatter:      the fuzz offset, (dir - mirror) / fuzz, mapped like a
+ *                         random_unit_vector, plus the absorption probability
+ *
+ * (u, v) is checked with a 2D chi-square test and u and v each with a
+ * Kolmogorov–Smirnov test. dielectric::scatter is checked for Snell's law and
+ * mirror reflection exactly, and its reflect/refract split against Schlick's
+ * approximation and total internal reflection per incidence-angle bin.
+ *
+ * Seeds are fixed, so the test is deterministic; a check fails when p < 1e-5.
+ */
+
+#include "check.h"
+#include "constants.h"
+#include "material.h"
+#include "statistics.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <vector>
+
+static const size_t sample_count = 2000000;
+static const int grid = 32;          // chi-square bins per axis
+static const double min_p = 1e-5;    // smallest acceptable p-value
+
+/** @brief Prints and records the outcome of one check. */
+static void report(const char *test, const char *check, double p, bool pass)
+{
+    std::clog << (pass ? "ok   " : "FAIL ") << test << ": " << check;
+    if (p >= 0)
+        std::clog << " (p = " << p << ")";
+    std::clog << "\n";
+    failures += pass ? 0 : 1;
+}
+
+/**
+ * @class uv_samples
+ * @brief Mapped samples of one test, collected per thread and merged.
+ */
+struct uv_samples
+{
+    std::vector<double> u, v;
+    size_t invalid = 0; ///< Samples violating an exact invariant (e.g. not unit length)
+    size_t rejected = 0; ///< Samples the sampler reported as absorbed
+};
+
+/**
+ * @brief Runs `sampler` `count` times spread over all hardware threads.
+ *
+ * Every thread reseeds its generator deterministically from (test_id, thread),
+ * and the sampler appends to that thread's `uv_samples`.
+ */
+static uv_samples run_parallel(uint64_t test_id, size_t count, const std::function<void(uv_samples &)> &sampler)
+{
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uv_samples> parts(threads);
+    std::vector<std::thread> pool;
+
+    for (int t = 0; t < threads; t++)
+    {
+        pool.emplace_back([&, t]()
+                          {
+            seed_random(mix_bits(test_id * 1000003 + t));
+            size_t n = count / threads + (size_t(t) < count % threads ? 1 : 0);
+            parts[t].u.reserve(n);
+            parts[t].v.reserve(n);
+            for (size_t k = 0; k < n; k++)
+                sampler(parts[t]); });
+    }
+    for (auto &t : pool)
+        t.join();
+
+    uv_samples all;
+    for (auto &p : parts)
+    {
+        all.u.insert(all.u.end(), p.u.begin(), p.u.end());
+        all.v.insert(all.v.end(), p.v.begin(), p.v.end());
+        all.invalid += p.invalid;
+        all.rejected += p.rejected;
+    }
+    return all;
+}
+
+/** @brief Chi-square test of (u, v) against the uniform distribution on the unit square. */
+static void check_uniform_square(const char *test, uv_samples &s)
+{
+    std::vector<double> observed(grid * grid, 0.0);
+    for (size_t k = 0; k < s.u.size(); k++)
+    {
+        int bu = std::min(grid - 1, std::max(0, int(s.u[k] * grid)));
+        int bv = std::min(grid - 1, std::max(0, int(s.v[k] * grid)));
+        observed[bv * grid + bu] += 1;
+    }
+    std::vector<double> expected(grid * grid, double(s.u.size()) / (grid * grid));
+
+    int df = 0;
+    double chi2 = chi_square_statistic(observed, expected, df);
+    double p = chi_square_sf(chi2, df);
+    report(test, "chi-square of (u, v) on a 32x32 grid", p, p >= min_p);
+
+    auto uniform_cdf = [](double x)
+    { return std::min(1.0, std::max(0.0, x)); };
+    double pu = kolmogorov_smirnov_pvalue(kolmogorov_smirnov_statistic(s.u, uniform_cdf), s.u.size());
+    report(test, "Kolmogorov-Smirnov of u", pu, pu >= min_p);
+    double pv = kolmogorov_smirnov_pvalue(kolmogorov_smirnov_statistic(s.v, uniform_cdf), s.v.size());
+    report(test, "Kolmogorov-Smirnov of v", pv, pv >= min_p);
+}
+
+/** @brief Maps a direction to (u, v) = ((z + 1) / 2, phi / 2pi) and appends it. */
+static void push_sphere(uv_samples &s, const vec3 &d)
+{
+    s.u.push_back((d.z() + 1) / 2);
+    s.v.push_back((std::atan2(d.y(), d.x()) + pi) / (2 * pi));
+}
+
+/** @brief Two-sided binomial z-test p-value for `hits` out of `n` at probability `p`. */
+static double binomial_pvalue(double hits, double n, double p)
+{
+    double sd = std::sqrt(n * p * (1 - p));
+    if (sd == 0)
+        return hits == n * p ? 1.0 : 0.0;
+    double z = std::fabs(hits - n * p) / sd;
+    return std::erfc(z / std::sqrt(2.0));
+}
+
+/** @brief Returns a hit record on the z = 0 plane with normal +z. */
+static hit_record plane_hit(bool front_face)
+{
+    hit_record rec;
+    rec.p = point3(0, 0, 0);
+    rec.normal = vec3(0, 0, 1);
+    rec.t = 1;
+    rec.front_face = front_face;
+    return rec;
+}
+
+static void test_random_unit_vector()
+{
+    auto s = run_parallel(1, sample_count, [](uv_samples &out)
+                          {
+        vec3 d = random_unit_vector();
+        if (std::fabs(d.length() - 1) > 1e-12)
+            out.invalid++;
+        push_sphere(out, d); });
+
+    report("random_unit_vector", "all samples have unit length", -1, s.invalid == 0);
+    check_uniform_square("random_unit_vector", s);
+}
+
+static void test_random_in_unit_disk()
+{
+    auto s = run_parallel(2, sample_count, [](uv_samples &out)
+                          {
+        vec3 p = random_in_unit_disk();
+        if (p.z() != 0 || p.length_squared() >= 1)
+            out.invalid++;
+        out.u.push_back(p.length_squared());
+        out.v.push_back((std::atan2(p.y(), p.x()) + pi) / (2 * pi)); });
+
+    report("random_in_unit_disk", "all samples inside the unit disk", -1, s.invalid == 0);
+    check_uniform_square("random_in_unit_disk", s);
+}
+
+static void test_lambertian()
+{
+    const color albedo(0.3, 0.5, 0.7);
+    lambertian mat(albedo);
+    hit_record rec = plane_hit(true);
+
+    auto s = run_parallel(3, sample_count, [&](uv_samples &out)
+                          {
+        ray in(point3(0, 0, 1), vec3(0.3, -0.2, -1));
+        color attenuation;
+        ray scattered;
+        if (!mat.scatter(in, rec, attenuation, scattered))
+        {
+            out.rejected++;
+            return;
+        }
+        vec3 d = unit_vector(scattered.direction());
+        if ((attenuation - albedo).length_squared() > 0 || d.z() < 0)
+            out.invalid++;
+        out.u.push_back(d.z() * d.z());
+        out.v.push_back((std::atan2(d.y(), d.x()) + pi) / (2 * pi)); });
+
+    report("lambertian::scatter", "always scatters into the upper hemisphere with the albedo", -1,
+           s.invalid == 0 && s.rejected == 0);
+    check_uniform_square("lambertian::scatter", s);
+}
+
+static void test_metal()
+{
+    const color albedo(0.8, 0.6, 0.2);
+    const double fuzz = 0.8;
+    metal mat(albedo, fuzz);
+    hit_record rec = plane_hit(true);
+
+    // Incidence with reflect(d, n) . n = 0.5, so part of the fuzz sphere lies below the surface
+    vec3 in_dir = unit_vector(vec3(std::sqrt(0.75), 0, -0.5));
+    vec3 mirror = unit_vector(reflect(in_dir, rec.normal));
+
+    auto s = run_parallel(4, sample_count, [&](uv_samples &out)
+                          {
+        ray in(point3(0, 0, 1), in_dir);
+        color attenuation;
+        ray scattered;
+        bool kept = mat.scatter(in, rec, attenuation, scattered);
+
+        // The scattered direction is mirror + fuzz * u with u uniform on the unit sphere
+        vec3 u = (scattered.direction() - mirror) / fuzz;
+        if (std::fabs(u.length() - 1) > 1e-9 || (attenuation - albedo).length_squared() > 0)
+            out.invalid++;
+        if (!kept)
+            out.rejected++;
+        push_sphere(out, u); });
+
+    report("metal::scatter", "fuzz offsets have unit length, attenuation is the albedo", -1, s.invalid == 0);
+    check_uniform_square("metal::scatter", s);
+
+    // Absorbed when (mirror + fuzz u) . n <= 0, i.e. u_z <= -0.5 / fuzz, which for
+    // u_z uniform on [-1, 1] has probability (1 - 0.5 / fuzz) / 2
+    double p_absorb = (1 - dot(mirror, rec.normal) / fuzz) / 2;
+    double p = binomial_pvalue(double(s.rejected), double(s.u.size()), p_absorb);
+    report("metal::scatter", "absorption probability below the surface", p, p >= min_p);
+
+    metal mirror_mat(albedo, 0.0);
+    color attenuation;
+    ray scattered;
+    mirror_mat.scatter(ray(point3(0, 0, 1), in_dir), rec, attenuation, scattered);
+    report("metal::scatter", "zero fuzz is an exact mirror", -1,
+           (unit_vector(scattered.direction()) - mirror).length() < 1e-12);
+}
+
+/**
+ * @brief Checks one side of a dielectric interface.
+ *
+ * Incidence cosines are drawn uniformly; for every sample the scattered ray must
+ * be either the exact mirror direction or obey Snell's law, and the number of
+ * reflections per cosine bin must match the Schlick / TIR probability.
+ */
+static void test_dielectric_side(bool front_face, uint64_t test_id)
+{
+    const double ior = 1.5;
+    const int bins = 20;
+    dielectric mat(ior);
+    hit_record rec = plane_hit(front_face);
+    double ri = front_face ? 1.0 / ior : ior;
+    const char *name = front_face ? "dielectric::scatter (entering)" : "dielectric::scatter (leaving)";
+
+    // u carries the incidence cosine, v is 1 for a reflection and 0 for a refraction
+    auto s = run_parallel(test_id, sample_count, [&](uv_samples &out)
+                          {
+        double cos_i = 1 - random_double(); // (0, 1]
+        double sin_i = std::sqrt(1 - cos_i * cos_i);
+        vec3 in_dir(sin_i, 0, -cos_i);
+        color attenuation;
+        ray scattered;
+        mat.scatter(ray(point3(0, 0, 1), in_dir), rec, attenuation, scattered);
+
+        vec3 d = unit_vector(scattered.direction());
+        bool reflected = d.z() > 0;
+        bool ok = (attenuation - color(1, 1, 1)).length_squared() == 0;
+        if (reflected)
+            ok = ok && (d - reflect(in_dir, rec.normal)).length() < 1e-9;
+        else
+            ok = ok && std::fabs(std::sqrt(d.x() * d.x() + d.y() * d.y()) - ri * sin_i) < 1e-9;
+        if (!ok)
+            out.invalid++;
+        out.u.push_back(cos_i);
+        out.v.push_back(reflected ? 1 : 0); });
+
+    report(name, "directions obey mirror reflection or Snell's law", -1, s.invalid == 0);
+
+    // Sum of independent Bernoulli trials per bin: (R - sum p)^2 / sum p(1 - p) ~ chi-square(1)
+    std::vector<double> reflections(bins, 0), expected(bins, 0), variance(bins, 0);
+    bool tir_ok = true;
+    for (size_t k = 0; k < s.u.size(); k++)
+    {
+        double cos_i = s.u[k];
+        double sin_i = std::sqrt(1 - cos_i * cos_i);
+        double r0 = (1 - ri) / (1 + ri);
+        r0 *= r0;
+        bool tir = ri * sin_i > 1.0;
+        double p = tir ? 1.0 : r0 + (1 - r0) * std::pow(1 - cos_i, 5);
+        if (tir && s.v[k] != 1)
+            tir_ok = false;
+
+        int b = std::min(bins - 1, int(cos_i * bins));
+        reflections[b] += s.v[k];
+        expected[b] += p;
+        variance[b] += p * (1 - p);
+    }
+
+    double chi2 = 0;
+    int df = 0;
+    for (int b = 0; b < bins; b++)
+    {
+        if (variance[b] <= 0)
+            continue;
+        chi2 += (reflections[b] - expected[b]) * (reflections[b] - expected[b]) / variance[b];
+        df++;
+    }
+    if (!front_face)
+        report(name, "total internal reflection beyond the critical angle", -1, tir_ok);
+    double p = chi_square_sf(chi2, df);
+    report(name, "reflection probability matches Schlick per incidence bin", p, p >= min_p);
+}
+
+int main()
+{
+    test_random_unit_vector();
+    test_random_in_unit_disk();
+    test_lambertian();
+    test_metal();
+    test_dielectric_side(true, 5);
+    test_dielectric_side(false, 6);
+
+    return check_summary();
+}
@@ -0,0 +1,153 @@
+/**
+ * @file shared_scene.cpp
+ * @brief Tests of compiled scene images in shared memory.
+ *
+ * A scene published to a POSIX shared-memory segment, and one passed as a sealed
+ * memfd, must render exactly like the in-process `sphere_set` it was compiled from,
+ * also in a forked process that maps it itself. Mapping must be much cheaper than
+ * building, a memfd image must refuse writes, and damaged or half-written images
+ * must be rejected.
+ */
+
+#include "check.h"
+#include "constants.h"
+#include "shared_scene.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+
+/** @brief Renders `scene` with a small fixed camera. */
+static framebuffer render(const hittable &scene, double extent)
+{
+    camera cam;
+    generated_scene_view(cam, extent);
+    cam.image_width = 48;
+    cam.samples_per_pixel = 4;
+    cam.max_depth = 5;
+    cam.num_threads = 2;
+    cam.show_progress = false;
+    framebuffer fb;
+    cam.render_pass(scene, fb, 0, 4);
+    return fb;
+}
+
+/** @brief True if both framebuffers hold exactly the same samples. */
+static bool same(const framebuffer &a, const framebuffer &b)
+{
+    if (a.sum.size() != b.sum.size())
+        return false;
+    for (size_t p = 0; p < a.sum.size(); p++)
+        if (a.sum[p].x() != b.sum[p].x() || a.sum[p].y() != b.sum[p].y() || a.sum[p].z() != b.sum[p].z() ||
+            a.weight[p] != b.weight[p])
+            return false;
+    return true;
+}
+
+/** @brief Runs `body` in a forked child and returns whether it exited with 0. */
+template <typename Body>
+static bool in_child(Body body)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+        _exit(body() ? 0 : 1);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main()
+{
+    using clock = std::chrono::steady_clock;
+    auto seconds = [](clock::time_point a, clock::time_point b) { return std::chrono::duration<double>(b - a).count(); };
+
+    scene_gen_params params;
+    params.count = 200000;
+    params.distribution = scene_distribution::clustered;
+    params.threads = 2;
+    sphere_set scene = generate_scene(params);
+    auto built = clock::now();
+    scene.build(4, 2);
+    double build_seconds = seconds(built, clock::now());
+    framebuffer expected = render(scene, generated_scene_extent(scene));
+
+    // POSIX shared memory
+    std::string name = "/raycraft-test-" + std::to_string(getpid());
+    std::string error;
+    check("publishes the scene", publish_shared_scene(scene, name, error));
+
+    shared_scene mapped;
+    auto attach_start = clock::now();
+    bool attached = mapped.attach(name, error);
+    double attach_seconds = seconds(attach_start, clock::now());
+    check("maps the published scene", attached && mapped.sphere_count() == scene.spheres.size());
+    std::clog << "build " << build_seconds * 1e3 << " ms, map " << attach_seconds * 1e3 << " ms ("
+              << mapped.mapped_bytes() / 1e6 << " MB shared)\n";
+    check("mapping is much cheaper than building", attach_seconds * 10 < build_seconds);
+    check("renders exactly like the sphere_set", same(render(mapped, mapped.extent()), expected));
+    check("bounds and view extent survive",
+          mapped.extent() == generated_scene_extent(scene) &&
+              mapped.bounding_box().axis_interval(1).min == scene.bounding_box().axis_interval(1).min);
+
+    check("another process renders it identically", in_child([&]()
+                                                              {
+                                                                  shared_scene child;
+                                                                  std::string e;
+                                                                  return child.attach(name, e) &&
+                                                                         same(render(child, child.extent()), expected);
+                                                              }));
+
+    // Replacing a segment leaves existing mappings intact
+    check("republishes over an existing segment", publish_shared_scene(scene, name, error));
+    check("old mapping still renders", same(render(mapped, mapped.extent()), expected));
+    check("removes the segment", unlink_shared_scene(name));
+    shared_scene gone;
+    check("a removed segment cannot be mapped", !gone.attach(name, error));
+
+#if defined(__linux__)
+    // Sealed memfd inherited by a child
+    int fd = create_shared_scene_memfd(scene, error);
+    check("creates a sealed memfd", fd >= 0);
+    if (fd >= 0)
+    {
+        char byte = 0;
+        check("the memfd refuses writes", pwrite(fd, &byte, 1, 0) < 0 && errno == EPERM);
+        check("a child maps the inherited memfd", in_child([&]()
+                                                            {
+                                                                shared_scene child;
+                                                                std::string e;
+                                                                return child.attach_fd(fd, e) &&
+                                                                       same(render(child, child.extent()), expected);
+                                                            }));
+        close(fd);
+    }
+#endif
+
+    // Damaged images
+    auto rejects = [&](const std::string &what, auto damage)
+    {
+        std::string bad = name + "-bad";
+        publish_shared_scene(scene, bad, error);
+        int fd = shm_open(bad.c_str(), O_RDWR, 0);
+        damage(fd);
+        close(fd);
+        shared_scene s;
+        std::string e;
+        check("rejects " + what, !s.attach(bad, e) && !e.empty());
+        unlink_shared_scene(bad);
+    };
+    rejects("a half-written image", [](int fd)
+            {
+                char zero[8] = {};
+                pwrite(fd, zero, sizeof(zero), 0);
+            });
+    rejects("a truncated image", [](int fd) { ftruncate(fd, 4096); });
+    rejects("a different record layout", [](int fd)
+            {
+                uint32_t wrong = 24;
+                pwrite(fd, &wrong, sizeof(wrong), offsetof(shared_scene_header, record_bytes) + 4);
+            });
+
+    return check_summary();
+}
@@ -0,0 +1,96 @@
+/**
+ * @file temporal.cpp
+ * @brief Tests of temporal accumulation: reprojection, tap rejection and the
+ * history cap.
+ *
+ * With a camera that does not move, every pixel must keep its whole history. The
+ * history must be capped at `max_history` samples without changing the image. When
+ * the camera moves sideways, ground that a sphere hid in the previous frame must
+ * start from zero rather than inherit the sphere's samples.
+ */
+
+#include "check.h"
+#include "constants.h"
+#include "hittable_list.h"
+#include "sphere.h"
+#include "temporal.h"
+
+#include <cmath>
+
+int main()
+{
+    hittable_list world;
+    world.add(make_shared<sphere>(point3(0, 0, -1), 0.5, make_shared<lambertian>(color(0.7, 0.3, 0.3))));
+    world.add(make_shared<sphere>(point3(0, -100.5, -1), 100, make_shared<lambertian>(color(0.5, 0.5, 0.5))));
+    camera cam;
+    cam.image_width = 64;
+    cam.max_depth = 3;
+    cam.num_threads = 1;
+    cam.show_progress = false;
+    cam.lookfrom = point3(0, 0.3, 1);
+    cam.lookat = point3(0, 0, -1);
+
+    // A static camera reuses everything
+    temporal_accumulator temporal;
+    framebuffer first;
+    temporal.begin_frame(cam, world, first);
+    check("the first frame starts empty", temporal.last.reused == 0);
+    cam.render_pass(world, first, 0, 4);
+    temporal.end_frame(first);
+
+    framebuffer still;
+    temporal.begin_frame(cam, world, still);
+    bool kept = true;
+    for (size_t p = 0; p < still.weight.size(); p++)
+        kept = kept && std::fabs(still.weight[p] - 4) < 1e-9;
+    check("a static camera reuses every pixel", temporal.last.reused_fraction() == 1 && kept);
+    check("a static camera has no motion", temporal.last.mean_motion < 1e-6);
+
+    // The cap scales sums and weights together, so the image stays the same
+    temporal_accumulator capped;
+    capped.max_history = 2;
+    framebuffer capped_first, capped_next;
+    capped.begin_frame(cam, world, capped_first);
+    cam.render_pass(world, capped_first, 0, 4);
+    capped.end_frame(capped_first);
+    capped.begin_frame(cam, world, capped_next);
+    bool at_cap = true;
+    for (int j = 0; j < capped_next.height; j++)
+        for (int i = 0; i < capped_next.width; i++)
+            at_cap = at_cap && std::fabs(capped_next.weight[capped_next.index(i, j)] - 2) < 1e-9 &&
+                     (capped_next.resolve(i, j) - capped_first.resolve(i, j)).length() < 1e-9;
+    check("history is capped at max_history without changing the image", at_cap);
+
+    // Moving sideways uncovers ground the sphere hid; it must not inherit the sphere
+    geometry_aov before;
+    cam.render_geometry(world, before);
+    camera_projection before_view = cam.projection();
+    cam.lookfrom = point3(0.4, 0.3, 1);
+    framebuffer moved;
+    temporal.begin_frame(cam, world, moved);
+    const geometry_aov &now = temporal.geometry();
+    int uncovered = 0, inherited = 0;
+    for (int j = 0; j < now.height; j++)
+        for (int i = 0; i < now.width; i++)
+        {
+            size_t idx = size_t(j) * now.width + i;
+            double x, y;
+            if (!now.object[idx] || !before_view.project(now.position[idx], x, y))
+                continue;
+            // All four history taps showed another object: the point was hidden
+            int x0 = int(std::floor(x)), y0 = int(std::floor(y));
+            bool hidden = x0 >= 0 && y0 >= 0 && x0 + 1 < before.width && y0 + 1 < before.height;
+            for (int k = 0; hidden && k < 4; k++)
+                hidden = before.object[size_t(y0 + (k >> 1)) * before.width + x0 + (k & 1)] != now.object[idx];
+            if (!hidden)
+                continue;
+            uncovered++;
+            if (moved.weight[moved.index(i, j)] != 0)
+                inherited++;
+        }
+    check("the camera move uncovers hidden ground", uncovered > 0);
+    check("uncovered pixels are rejected", inherited == 0 && temporal.last.rejected_object >= uncovered);
+    check("visible surfaces are still reused", temporal.last.reused_fraction() > 0.5);
+
+    return check_summary();
+}
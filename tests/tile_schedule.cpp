@@ -0,0 +1,116 @@
+/**
+ * @file tile_schedule.cpp
+ * @brief Tests of the predictive tile schedule.
+ *
+ * Tiles predicted above a fair share of the frame must be split, the plan must
+ * hand out the most expensive work first, and the measured cost of split
+ * sub-tiles must be added back to the grid tile they came from. A render planned
+ * from the cost history must equal the row-major render exactly, since every
+ * pixel seeds its own random stream.
+ */
+
+#include "check.h"
+#include "constants.h"
+#include "bvh.h"
+#include "scenes.h"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+static bool same_rect(const tile_rect &a, const tile_rect &b)
+{
+    return a.x0 == b.x0 && a.y0 == b.y0 && a.x1 == b.x1 && a.y1 == b.y1;
+}
+
+static bool inside(const tile_rect &inner, const tile_rect &outer)
+{
+    return inner.x0 >= outer.x0 && inner.y0 >= outer.y0 && inner.x1 <= outer.x1 && inner.y1 <= outer.y1;
+}
+
+int main()
+{
+    const int width = 64, height = 48, tile = 16; // 4 x 3 tiles
+    std::vector<tile_rect> grid = grid_tiles(width, height, tile);
+
+    // Without history the plan is the grid
+    tile_schedule schedule;
+    schedule.blend = 1; // the newest frame only, so the costs below are exact
+    std::vector<tile_rect> plan = schedule.plan(width, height, tile, 1);
+    bool is_grid = plan.size() == grid.size();
+    for (size_t t = 0; is_grid && t < plan.size(); t++)
+        is_grid = same_rect(plan[t], grid[t]);
+    check("the first plan is the row-major grid", is_grid && !schedule.has_history());
+
+    // One expensive tile: 100 against a total of 111, a fair share of 111 / 4
+    std::vector<double> seconds(grid.size(), 1.0);
+    const size_t hot = 5;
+    seconds[hot] = 100;
+    schedule.record(plan, seconds);
+    plan = schedule.plan(width, height, tile, 1);
+    int parts = 0;
+    for (const auto &item : plan)
+        if (inside(item, grid[hot]))
+            parts++;
+    check("a tile above the fair share is split", schedule.splits == 1 && parts == 4 &&
+                                                      plan.size() == grid.size() + 3);
+    int covered = 0;
+    for (size_t n = 0; n < 4; n++)
+        covered += inside(plan[n], grid[hot]) ? plan[n].pixels() : 0;
+    check("its quadrants come first and cover it", covered == grid[hot].pixels());
+
+    // Split items report their own cost; the history adds them up per grid tile
+    // (the four quadrants of the hot tile add up to 4, more than any single item)
+    std::vector<double> measured(plan.size(), 1.0);
+    measured[plan.size() - 1] = 3; // the last item is a plain grid tile
+    tile_rect runner_up = plan.back();
+    schedule.record(plan, measured);
+    schedule.items_per_thread = 1; // the fair share is the whole frame: nothing is split
+    plan = schedule.plan(width, height, tile, 1);
+    check("split tiles are recorded against their grid tile", schedule.splits == 0 && plan.size() == grid.size() &&
+                                                                  same_rect(plan[0], grid[hot]) &&
+                                                                  same_rect(plan[1], runner_up));
+
+    // Longest processing time first: distinct costs come out in descending order
+    for (size_t t = 0; t < grid.size(); t++)
+        seconds[t] = double(t + 1);
+    schedule.record(grid, seconds);
+    plan = schedule.plan(width, height, tile, 1);
+    bool descending = plan.size() == grid.size();
+    for (size_t n = 0; descending && n < plan.size(); n++)
+        descending = same_rect(plan[n], grid[grid.size() - 1 - n]);
+    check("the plan orders work longest first", descending);
+
+    check("a new image size drops the history",
+          schedule.plan(width + 1, height, tile, 1).size() == grid_tiles(width + 1, height, tile).size() &&
+              !schedule.has_history());
+
+    // A scheduled render equals the row-major one bit for bit
+    hittable_list scene = material_spheres_scene();
+    bvh world(scene, 4, 1);
+    camera cam;
+    material_spheres_view(cam);
+    cam.image_width = 96;
+    cam.samples_per_pixel = 4;
+    cam.max_depth = 6;
+    cam.num_threads = 3;
+    cam.show_progress = false;
+    cam.prepare();
+    framebuffer plain;
+    cam.render_pass(world, plain, 0, cam.samples_per_pixel);
+
+    tile_schedule history;
+    history.items_per_thread = 16; // small fair share, so the second pass splits tiles
+    cam.schedule = &history;
+    framebuffer first, planned;
+    cam.render_pass(world, first, 0, cam.samples_per_pixel);
+    cam.render_pass(world, planned, 0, cam.samples_per_pixel);
+    std::clog << "second pass split " << history.splits << " tiles\n";
+    check("the scheduled pass split tiles", history.splits > 0);
+    check("a scheduled render equals the row-major render",
+          planned.sum.size() == plain.sum.size() &&
+              std::memcmp(planned.sum.data(), plain.sum.data(), plain.sum.size() * sizeof(plain.sum[0])) == 0 &&
+              planned.weight == plain.weight);
+
+    return check_summary();
+}
@@ -0,0 +1,92 @@
+/**
+ * @file video_stream.cpp
+ * @brief Tests of the video stream: RGB to YUV conversion, frame order and a reader
+ * that goes away.
+ *
+ * The SSE2 conversion must give exactly the bytes of the scalar one, also for
+ * lengths that leave a partial block of 16 pixels. Frames submitted out of order
+ * must be written in order, and a closed pipe must end in a reported error rather
+ * than a killed process.
+ */
+
+#include "check.h"
+#include "constants.h"
+#include "video_stream.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <random>
+#include <unistd.h>
+
+/** @brief A `width` x `height` frame filled with one grey level. */
+static framebuffer grey_frame(int width, int height, double level)
+{
+    framebuffer fb(width, height);
+    for (int j = 0; j < height; j++)
+        for (int i = 0; i < width; i++)
+            fb.add_sample(i, j, color(level, level, level));
+    return fb;
+}
+
+int main()
+{
+    // Conversion: random pixels plus the extremes, at lengths around the block size
+    std::mt19937 rng(11);
+    bool same = true;
+    for (size_t count : {0, 1, 15, 16, 17, 31, 33, 1000, 4099})
+    {
+        std::vector<unsigned char> r(count), g(count), b(count);
+        for (size_t n = 0; n < count; n++)
+        {
+            r[n] = (unsigned char)rng();
+            g[n] = (unsigned char)rng();
+            b[n] = (unsigned char)rng();
+            if (n % 13 == 0)
+                r[n] = g[n] = b[n] = n % 2 ? 255 : 0;
+        }
+        std::vector<unsigned char> y(count), u(count), v(count), ys(count), us(count), vs(count);
+        rgb_to_yuv(r.data(), g.data(), b.data(), y.data(), u.data(), v.data(), count);
+        rgb_to_yuv_scalar(r.data(), g.data(), b.data(), ys.data(), us.data(), vs.data(), count);
+        same = same && y == ys && u == us && v == vs;
+    }
+    check("vector conversion gives the scalar bytes", same);
+
+    // Frames submitted out of order come out in order
+    const int width = 16, height = 8, frames = 5;
+    char path[] = "/tmp/raycraft_video_XXXXXX";
+    int fd = mkstemp(path);
+    {
+        video_stream stream(fd, video_format::rgb, 30, 3);
+        for (int f : {2, 0, 4, 1, 3})
+            stream.submit(f, grey_frame(width, height, f / 4.0));
+        const auto &written = stream.finish();
+        check("writes every frame", written.frames == frames && written.error.empty());
+    }
+    std::vector<unsigned char> bytes(size_t(width) * height * 3 * frames + 1);
+    ssize_t got = pread(fd, bytes.data(), bytes.size(), 0);
+    close(fd);
+    unlink(path);
+    bool ordered = got == ssize_t(bytes.size() - 1);
+    for (int f = 0; ordered && f < frames; f++)
+    {
+        std::vector<unsigned char> expected = grey_frame(width, height, f / 4.0).resolved_rgb8();
+        ordered = std::equal(expected.begin(), expected.end(), bytes.begin() + f * expected.size());
+    }
+    check("frames are written in index order", ordered);
+
+    // The reader goes away: writes fail, the remaining frames are drained
+    std::signal(SIGPIPE, SIG_IGN);
+    int pipe_fds[2];
+    check("creates a pipe", pipe(pipe_fds) == 0);
+    close(pipe_fds[0]);
+    {
+        video_stream stream(pipe_fds[1], video_format::y4m);
+        for (int f = 0; f < frames; f++)
+            stream.submit(f, grey_frame(width, height, 0.5));
+        const auto &written = stream.finish();
+        check("a closed reader is reported as an error", !written.error.empty() && written.bytes == 0);
+    }
+    close(pipe_fds[1]);
+
+    return check_summary();
+}